@@ -18,6 +18,14 @@
 #include <FastLED.h>
 #include <esp_log.h>
 #include <esp_wifi.h>
+#include <Preferences.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <esp_rom_crc.h>
+#include <mbedtls/sha256.h>
+#include <WiFiUdp.h>
+#include <lwip/sockets.h>
+#include <LittleFS.h>
 
 String repeat(String str, int count) {
   String result = "";
@@ -31,17 +39,304 @@ String repeat(String str, int count) {
 // CONFIGURATION & HARDWARE SETUP
 // =============================================================================
 #define LED_PIN         13
-#define LED_WIDTH       32
+#define LED_WIDTH       32    // Default panel geometry, see 'layout' command
 #define LED_HEIGHT      8
-#define NUM_LEDS        (LED_WIDTH * LED_HEIGHT)
+#define NUM_LEDS        (LED_WIDTH * LED_HEIGHT)  // Framebuffer capacity
 #define LED_TYPE        WS2812B
 #define COLOR_ORDER     GRB
 
+// Parallel output: every pin gets its own RMT channel and FastLED.show()
+// drives them concurrently, so wire time is set by the longest segment.
+#define OUTPUT_CHANNELS       1     // Pins in use, up to MAX_OUTPUT_CHANNELS
+#define MAX_OUTPUT_CHANNELS   4
+#define WS2812_BIT_TIME_NS    1250  // 800 kHz
+#define WS2812_RESET_US       300
+#define FRAME_REFRESH_MS      1000  // Resend an unchanged frame at least this often
+
+// 4-channel strips (SK6812 RGBW / RGBWW). Pixels are rendered as RGB and the
+// white LED is extracted at output time. WHITE_POINT_* is the color of the
+// strip's white LED expressed in RGB, so warm-white strips pull mostly from red.
+#define LED_WHITE_CHANNEL     0     // 1 = 4-channel strip
+#define RGBW_ORDER_R          1     // Byte positions on the wire (SK6812: G, R, B, W)
+#define RGBW_ORDER_G          0
+#define RGBW_ORDER_B          2
+#define RGBW_ORDER_W          3
+#define WHITE_POINT_R         255
+#define WHITE_POINT_G         224
+#define WHITE_POINT_B         190
+
+#if LED_WHITE_CHANNEL
+  #define WIRE_COLOR_ORDER    RGB   // Bytes are already in strip order
+#else
+  #define WIRE_COLOR_ORDER    COLOR_ORDER
+#endif
+
 // Performance & Timing
 #define LED_UPDATE_INTERVAL_MS    33  // ~30 FPS for smooth animations
 #define SERIAL_BAUD_RATE         115200
 #define REQUEST_TIMEOUT_MS       3000
-#define HEARTBEAT_INTERVAL_MS    10000
+#define HEARTBEAT_INTERVAL_MS    10000 // Legacy polling, until the controller speaks state versions
+#define STATE_ACK_INTERVAL_MS    1000  // Keepalive ack once state versions are in use
+                                       // (scaled by link quality, see linkAckIntervalMs)
+#define STATE_LINK_FAILURES      3     // Consecutive unacked sends before "disconnected"
+#define STATE_STALE_LATE_MS      100   // Updates applied later than this count as late
+
+// Transport. ESP-NOW in production; UDP over WiFi lets a PC drive the same
+// wire protocol (tools/load_gen.cpp) for load testing.
+#define TRANSPORT_UDP            0     // 1 = WiFi UDP instead of ESP-NOW
+#define UDP_WIFI_SSID            "your-ssid"
+#define UDP_WIFI_PASSWORD        "your-password"
+#define UDP_PORT                 4210
+#define UDP_CONNECT_TIMEOUT_MS   10000
+#define UDP_MAX_ENDPOINTS        4     // Distinct senders we can reply to
+#define UDP_POLL_BUDGET          16    // Datagrams handled per loop pass
+
+// UDP pixel input from lighting desks: E1.31 (sACN), Art-Net and DDP. Joins
+// WiFi with the UDP_WIFI_* credentials; keep the AP on the ESP-NOW channel.
+#define PIXEL_INPUT_UDP          0     // 1 = listen for pixel data
+#define PIXEL_UNIVERSE_START     1     // sACN universe of pixel 0; Art-Net numbers from one less
+#define PIXEL_UNIVERSE_CHANNELS  510   // 170 RGB pixels per universe
+#define PIXEL_MAX_SOURCES        4
+#define PIXEL_SOURCE_TIMEOUT_MS  2500  // E1.31 network data loss timeout
+#define PIXEL_FRAME_TIMEOUT_MS   40    // Show a frame missing universes after this
+#define SACN_PORT                5568
+#define ARTNET_PORT              6454
+#define DDP_PORT                 4048
+#define SACN_HEADER_BYTES        126   // Through the DMX start code
+#define SACN_DEFAULT_PRIORITY    100
+#define SACN_OPTION_TERMINATED   0x40
+#define ARTNET_HEADER_BYTES      18
+#define ARTNET_OP_DMX            0x5000
+#define DDP_HEADER_BYTES         10    // 14 with a timecode
+#define DDP_VERSION_1            0x40
+#define DDP_FLAG_TIMECODE        0x10
+#define DDP_FLAG_REPLY           0x04
+#define DDP_FLAG_QUERY           0x02
+#define DDP_FLAG_PUSH            0x01
+#define DDP_ID_DISPLAY           1
+
+// Zones: independent effect regions sharing one framebuffer
+#define MAX_ZONES                8
+#define ZONE_ALL                 0xFF  // Zone id that addresses every active zone
+#define ZONE_NONE                0xFF  // zoneOf[] entry for pixels outside all zones
+#define MASTER_BRIGHTNESS        255   // Zone brightness is applied per pixel
+
+// Effects
+#define EFFECT_STREAM            7     // Shows frames pushed by the controller
+#define EFFECT_MAX               7
+
+// Frame streaming
+#define FRAME_BYTES_MAX          (NUM_LEDS * 3)
+#define STREAM_ENCODED_MAX       (FRAME_BYTES_MAX + FRAME_BYTES_MAX / 128 + 16)  // RLE worst case
+#define STREAM_FRAGMENT_TIMEOUT_MS  100  // Give up on a partial frame after this
+#define STREAM_IDLE_TIMEOUT_MS   2000  // Leave streaming mode after this without frames
+#define FRAME_CODEC_RAW          0     // Plain RGB bytes
+#define FRAME_CODEC_RLE          1     // Zero-run RLE of RGB bytes (key frame)
+#define FRAME_CODEC_DELTA_RLE    2     // Zero-run RLE of XOR against baseSeq
+
+// Binary serial frame input. Adalight and TPM2 are recognised by their
+// headers; the native protocol is COBS framed ([type][flags][u16 seq]
+// [payload][CRC-32 LE], 0x00 delimited). Frames land in the stream buffers.
+#define SERIAL_BINARY_BAUD       2000000
+#define SERIAL_BINARY_AT_BOOT    0     // 1 = start in binary mode for PC-driven installs
+#define SERIAL_RX_BUFFER_SIZE    4096  // UART driver ring, ~20 ms at 2 Mbaud
+#define SERIAL_FRAME_GAP_MS      50    // Abandon a partial frame after this much silence
+#define SERIAL_LINE_MAX          64    // Text commands still work between binary frames
+#define SERIAL_COMMAND_MAX       256   // Text mode line, room for a run of 'layout map' pairs
+#define SERIAL_LOCK_FAILURES     16    // Errors in a row before every protocol is hunted for again
+#define SERIAL_MSG_FRAME         0x01  // Native: RGB bytes, missing pixels go dark
+#define SERIAL_MSG_COMMAND       0x02  // Native: a text command, e.g. "text"
+
+// Serial bridge: a byte stream between the controller and a device on a
+// second UART. Messages travel as fragments; the side taking them in
+// returns credits (last message delivered, ring space left) and the
+// sender keeps its unacknowledged bytes within that space.
+#define SERIAL_BRIDGE_PORT       Serial1
+#define SERIAL_BRIDGE_BAUD       115200
+#define SERIAL_BRIDGE_RX_PIN     16
+#define SERIAL_BRIDGE_TX_PIN     17
+#define SERIAL_BRIDGE_RING       4096  // Bytes per direction, power of two
+#define SERIAL_BRIDGE_MSG_MAX    1024  // Largest message
+#define SERIAL_BRIDGE_FRAG_MAX   224   // Message bytes per fragment; leaves room for a credit
+#define SERIAL_BRIDGE_RETRY_MS   60    // Resend an unacknowledged upstream message after this
+#define SERIAL_BRIDGE_CREDIT_MS  500   // Credit keepalive while the bridge is in use...
+#define SERIAL_BRIDGE_IDLE_MS    10000 // ...which it is until this long without traffic
+#define SERIAL_BRIDGE_RATE_MS    1000  // Throughput sample window
+#define SERIAL_BRIDGE_STACK      3072
+#define SERIAL_BRIDGE_PRIORITY   2     // Above the loop, below WiFi
+
+// Wire protocol v2
+#define WIRE_VERSION_2           0xE2
+#define WIRE_REC_PAD             0x00  // Ignored
+#define WIRE_REC_COMMAND         0x01  // led_command_t for every zone
+#define WIRE_REC_ZONE_COMMAND    0x02  // zone_command_t
+#define WIRE_REC_FRAME_FRAGMENT  0x03  // frame_fragment_header_t + slice
+#define WIRE_REC_SERIAL_DATA     0x04  // Raw bytes for the bridge UART, unsequenced
+#define WIRE_REC_TARGET          0x05  // wire_target_t, must be the first record
+#define WIRE_REC_TIME_PING       0x06  // time_ping_t, receiver -> controller
+#define WIRE_REC_TIME_PONG       0x07  // time_pong_t, controller -> receiver
+#define WIRE_REC_APPLY_AT        0x08  // apply_at_t, holds the commands after it
+#define WIRE_REC_STATE_VERSION   0x09  // state_version_t, versions the commands after it
+#define WIRE_REC_STATE_HEARTBEAT 0x0A  // state_heartbeat_t, controller's current version
+#define WIRE_REC_STATE_ACK       0x0B  // state_heartbeat_t, version the receiver applied
+#define WIRE_REC_RELAY           0x0C  // relay_header_t + a whole inner v2 packet
+#define WIRE_REC_OTA_BEGIN       0x0D  // ota_begin_t
+#define WIRE_REC_OTA_CHUNK       0x0E  // ota_chunk_header_t + image bytes
+#define WIRE_REC_OTA_STATUS      0x0F  // ota_status_t, receiver -> controller
+#define WIRE_REC_OTA_END         0x10  // ota_end_t
+#define WIRE_REC_TELEMETRY       0x11  // Varint telemetry report, receiver -> controller
+#define WIRE_REC_TELEMETRY_REQ   0x12  // Empty; asks for a full report now
+#define WIRE_REC_SERIAL_FRAGMENT 0x13  // serial_fragment_header_t + message bytes, either direction
+#define WIRE_REC_SERIAL_CREDIT   0x14  // serial_credit_t, either direction
+#define WIRE_REC_LIVE_SAMPLE     0x15  // live_sample_t
+#define WIRE_REC_TRIGGER         0x16  // trigger_t; send it in 2-3 packets, the cue fires once
+#define WIRE_REC_PREVIEW         0x17  // preview_header_t + RLE pixels, receiver -> controller
+#define WIRE_REC_PREVIEW_CONFIG  0x18  // preview_config_t; also asks for a key frame
+
+// Time sync: NTP-style exchange with the controller's clock
+#define TIME_SYNC_INTERVAL_MS    2000
+#define TIME_SYNC_FAST_MS        250   // Until TIME_SAMPLES samples are in
+#define TIME_SAMPLES             8     // Clock filter window, best = lowest RTT
+#define TIME_STEP_THRESHOLD_US   50000 // Larger errors are stepped, not slewed
+#define TIME_SLEW_PPM            1000  // Max correction rate (1 ms per second)
+#define TIME_MAX_RTT_US          20000 // Samples slower than this are ignored
+#define APPLY_AT_MAX_AHEAD_MS    10000 // Further ahead than this = apply now
+
+// Live parameters: timestamped slider samples are rendered liveDelayMs in
+// the past, interpolated between the samples either side of that point
+// and extrapolated briefly past the newest one when samples go missing.
+#define LIVE_SAMPLES             8     // History per zone
+#define LIVE_DELAY_DEFAULT_MS    60    // Smoothing latency; 2-3 periods at 20-50 Hz
+#define LIVE_DELAY_MAX_MS        500
+#define LIVE_EXTRAPOLATE_MS      100   // Then hold until samples resume
+#define LIVE_IDLE_MS             2000  // Leave live mode after this without samples
+#define LIVE_FRAME_MS            10    // Render interval while live
+
+// Triggers: one-shot overlays from a registered table, composited over
+// whatever the zones are showing. The loop is woken on arrival so the
+// first overlay frame goes out well inside one frame interval.
+#define TRIGGER_EVENTS           16    // Registered event ids
+#define TRIGGER_OVERLAYS         8     // Running at once; a new one replaces the oldest
+#define TRIGGER_QUEUE            8     // WiFi task -> loop
+#define TRIGGER_RECENT_CUES      8     // Cue numbers remembered for duplicate suppression
+#define TRIGGER_CUE_WINDOW_MS    250   // Copies of a cue arrive within this
+#define TRIGGER_FRAME_MS         10    // Render interval while overlays run
+#define TRIGGER_BAND_PX          2     // Half-width of ripple rings and sweep bars
+#define TRIGGER_CENTRE           0xFFFF // Ripple origin: middle of the matrix
+#define TRIGGER_BUDGET_US        (LED_UPDATE_INTERVAL_MS * 1000UL)  // One frame
+
+// Capture: every incoming packet with a µs timestamp. The WiFi task fills
+// a byte ring, the loop writes it to LittleFS in two rotating segments, so
+// the newest 1-2 segments' worth is always on flash. 'capture dump' prints
+// it as base64 for tools/capture_tool; 'capture replay' runs it back through
+// the receiver on a virtual clock.
+#define CAPTURE_SEGMENT_BYTES    (128 * 1024)
+#define CAPTURE_FLUSH_BYTES      1024  // Write to flash once this much is waiting...
+#define CAPTURE_FLUSH_MS         1000  // ...or this long after the last write
+#define CAPTURE_DUMP_LINE        57    // Bytes per base64 line (76 characters)
+#define CAPTURE_VERSION          1
+#define CAPTURE_FLAG_BROADCAST   0x01
+#define REPLAY_TICK_US           5000  // Virtual loop period, the delay(5) in loop()
+#define REPLAY_SLICE_MS          10    // Real time per loop() spent replaying
+#define REPLAY_TAIL_MS           1000  // Keep rendering this long after the last packet
+#define REPLAY_PENDING           16    // Packets awaiting their first frame
+
+// Instant-on: the scene (zones and their parameters) goes to NVS once it
+// settles and is shown again at boot before the radio is up. Writes are
+// coalesced and capped so a slider or a live stream can't wear the flash.
+#define SCENE_VERSION            2     // 2: matrix size saved with the zones
+#define SCENE_CHECK_MS           250   // Compare with the saved scene this often
+#define SCENE_QUIET_MS           2000  // Save once unchanged this long...
+#define SCENE_MAX_DEFER_MS       30000 // ...or this long after the first change
+#define SCENE_MIN_INTERVAL_MS    10000 // Never two writes closer than this
+#define SCENE_WRITES_PER_HOUR    30    // Write budget, full at boot
+#define TRANSPORT_INIT_STACK     4096  // WiFi / ESP-NOW bring-up task
+
+// Status animations (boot test pattern, error and success flashes) are
+// stepped by updateLEDEffects() like any frame; a command from the
+// controller, a streamed frame or a trigger cuts them short.
+#define STATUS_FRAME_MS          20    // Finest step of the patterns below
+#define BOOT_SWEEP_STEP_MS       300   // Per colour
+#define BOOT_WAVE_STEP_MS        50
+#define BOOT_WAVE_STEPS          20
+#define BOOT_FADE_MS             1040  // Full brightness to black
+#define ERROR_FLASH_MS           200   // Red, then dark, ERROR_FLASHES times
+#define ERROR_FLASHES            3
+#define SUCCESS_FLASH_MS         300
+
+// Group addressing: the controller broadcasts once per group and every
+// receiver filters. Header seq is counted per controller and group for
+// duplicate suppression.
+#define GROUP_DIRECT             0     // Unicast / no target record
+#define GROUP_EVERYONE           0xFF  // Every receiver is implicitly subscribed
+#define MAX_GROUPS               8     // Explicit subscriptions
+#define SEQ_WINDOW               32    // Reordering tolerated before "too old"
+#define SEQ_RESYNC_SILENCE_MS    2000  // After this long quiet, an old seq means the sender restarted
+#define AIRTIME_PREAMBLE_US      192   // 1 Mbps long preamble
+#define AIRTIME_OVERHEAD_BYTES   43    // MAC header + vendor action frame + FCS
+
+// Authorized controllers. Lookup hashes the MAC into an open-addressed
+// index table; arbitration is by priority, then last writer wins.
+#define MAX_PEERS                8
+#define PEER_HASH_SLOTS          16    // Power of two, > MAX_PEERS
+#define PEER_DEFAULT_PRIORITY    1
+#define PEER_HOLD_MS             5000  // Owner keeps control this long after its last command
+#define PAIRING_WINDOW_MS        30000
+
+// Relay mesh: receivers rebroadcast group traffic for ones out of range
+#define RELAY_ENABLED_DEFAULT    false
+#define RELAY_DEFAULT_TTL        3     // Relays a packet may still take
+#define RELAY_MAX_TTL            7
+#define RELAY_CACHE_SIZE         64    // (origin, group, seq) seen recently
+#define RELAY_QUEUE_SIZE         4
+#define RELAY_BACKOFF_MIN_MS     2     // Randomized so neighbours don't collide
+#define RELAY_BACKOFF_MAX_MS     20
+#define RELAY_SUPPRESS_COUNT     3     // Copies heard during backoff that cancel our relay
+
+// Firmware update over ESP-NOW into the next OTA partition
+#define OTA_CHUNK_MAX            224   // Image bytes per chunk
+#define OTA_WINDOW               32    // Chunks accepted past the watermark (status bitmap width)
+#define OTA_QUEUE_SIZE           8     // Chunks handed from the WiFi task to the loop
+#define OTA_STATUS_EVERY         8     // Status after this many new chunks...
+#define OTA_STATUS_INTERVAL_MS   100   // ...or this long, while chunks keep coming
+#define OTA_IDLE_STATUS_MS       2000  // Stop volunteering status after this much silence
+#define OTA_PERSIST_BYTES        65536 // Resume watermark saved to NVS this often
+#define OTA_REBOOT_DELAY_MS      1000
+#define OTA_HASH_SLICE           4096  // Image bytes read back and hashed per loop pass
+
+// Telemetry uplink. Reports are zigzag varints in a fixed field order;
+// every TELEMETRY_KEYFRAME_EVERY-th is absolute, the rest are deltas
+// from the previous report.
+#define TELEMETRY_INTERVAL_MS    5000
+#define TELEMETRY_KEYFRAME_EVERY 6
+#define TELEMETRY_FLAG_KEYFRAME  0x01
+#define TIMING_BUCKETS           32    // Half-octave µs buckets, top one open-ended
+#define LED_MA_PER_CHANNEL       20    // WS2812 at full drive
+#define LED_IDLE_MA              1     // Per LED, all dark
+
+// Framebuffer preview uplink for the controller's display. What the LEDs
+// show is box-downsampled, quantized to RGB332 and run-length coded as an
+// XOR delta against the previous preview, at a low rate and within a
+// share of airtime.
+#define PREVIEW_FPS_DEFAULT      0     // Off until the controller or 'preview' asks
+#define PREVIEW_FPS_MAX          10
+#define PREVIEW_SHARE_DEFAULT    2     // Percent of airtime
+#define PREVIEW_SHARE_MAX        20
+#define PREVIEW_BURST_US         20000 // Unused airtime banked, at most; covers a key frame
+#define PREVIEW_MAX_PIXELS       192   // A key frame must fit one packet
+#define PREVIEW_KEYFRAME_MS      2000  // Resync a controller that missed a delta
+#define PREVIEW_FLAG_KEYFRAME    0x01
+
+// Link quality. Single-writer counters: the WiFi task writes, the loop reads.
+#define LINK_RSSI_MIN            -100  // dBm, lowest histogram bucket edge
+#define LINK_RSSI_STEP           4
+#define LINK_RSSI_BUCKETS        20    // -100 .. -20 dBm
+#define LINK_WINDOW_MS           10000 // Recent rates are over this window
+#define LINK_POOR_LOSS_PERMILLE  100   // Above this, keepalives speed up
+#define LINK_GOOD_LOSS_PERMILLE  10    // Below this (and strong RSSI), they slow down
+#define LINK_GOOD_RSSI           -70
+#define LINK_RETRY_BASE_MS       5     // Ack retry backoff doubles per failure...
+#define LINK_RETRY_MAX_MS        320   // ...up to this
 
 // =============================================================================
 // DATA STRUCTURES (Must match transmitter exactly)
@@ -68,18 +363,1075 @@ typedef struct {
     uint8_t length;       // Actual length of the data
 } serial_message_t;
 
+// -----------------------------------------------------------------------------
+// Wire protocol v2: a 4-byte header followed by typed records, each
+// [type][length][value]. Values may grow in later versions; parsers read
+// the fields they know and skip the rest. Legacy packets have no header and
+// are told apart by length, so a v2 packet must never be exactly 8 bytes
+// (pad with a WIRE_REC_PAD record).
+// -----------------------------------------------------------------------------
+typedef struct __attribute__((packed)) {
+    uint8_t version;        // WIRE_VERSION_2
+    uint8_t flags;          // Reserved, 0
+    uint16_t seq;           // Per-sender packet sequence
+} wire_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t type;           // WIRE_REC_*
+    uint8_t length;         // Bytes of value that follow
+} wire_record_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t zone;           // Zone id, ZONE_ALL for every zone
+    led_command_t command;
+} zone_command_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t group;          // GROUP_* or a subscribed group id
+} wire_target_t;
+
+typedef struct __attribute__((packed)) {
+    int64_t t1;             // Receiver clock at send, µs
+} time_ping_t;
+
+typedef struct __attribute__((packed)) {
+    int64_t t1;             // Echoed from the ping
+    int64_t t2;             // Controller clock at ping arrival, µs
+    int64_t t3;             // Controller clock at pong send, µs
+} time_pong_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t sharedMs;      // Shared-clock time the following commands take effect
+} apply_at_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t version;       // Wraps; compared with serial arithmetic
+    uint32_t issuedMs;      // Shared-clock time the controller first sent it
+} state_version_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t version;
+} state_heartbeat_t;
+
+// Frames larger than one ESP-NOW payload are split into fragments. The
+// encoded frame is a byte stream; each fragment carries a slice of it.
+typedef struct __attribute__((packed)) {
+    uint8_t codec;          // FRAME_CODEC_*
+    uint16_t frameSeq;
+    uint16_t baseSeq;       // FRAME_CODEC_DELTA_RLE: frame this one patches
+    uint8_t fragIndex;
+    uint8_t fragCount;      // Up to 32
+    uint16_t encodedLength; // Whole encoded frame
+    uint16_t offset;        // Position of this slice in the encoded frame
+} frame_fragment_header_t;
+
+// RLE control byte: 0x00-0x7F = (n + 1) zero bytes, 0x80-0xFF = (n & 0x7F) + 1
+// literal bytes follow. For delta frames a zero byte means "unchanged".
+
+// Physical wiring of the matrix. Compiled into pixelMap[] by rebuildPixelMap().
+typedef struct {
+    uint8_t panelWidth;      // LEDs per row on one panel
+    uint8_t panelHeight;     // Rows on one panel
+    uint8_t tilesX;          // Panels across the wall
+    uint8_t tilesY;          // Panels down the wall
+    uint8_t serpentine;      // 1 = rows alternate direction inside a panel
+    uint8_t tileSerpentine;  // 1 = panel rows alternate direction along the chain
+    uint8_t rotation;        // Quarter turns clockwise (0-3)
+    uint8_t mirror;          // Bit 0 = mirror X, bit 1 = mirror Y
+} matrix_layout_t;
+
+// One contiguous run of physical LEDs driven from one pin
+typedef struct {
+    uint8_t pin;
+    uint16_t start;
+    uint16_t count;
+} output_segment_t;
+
+// One pixel of a 4-channel strip, bytes in wire order
+typedef struct {
+    uint8_t raw[4];
+} rgbw_pixel_t;
+
+// White/warm-white request folded into a per-pixel mix, rebuilt per command
+typedef struct {
+    uint8_t white;        // Pull toward the pixel's own max channel
+    uint8_t warmAmount;   // Blend toward warmColor
+    CRGB warmColor;
+} white_mix_t;
+
+// A region of the logical frame with its own effect, parameters and frame rate
+typedef struct {
+    bool active;
+    uint8_t shape;              // ZONE_RECT or ZONE_RANGE
+    uint16_t x, y, w, h;        // ZONE_RECT: logical rectangle
+    uint16_t start;             // ZONE_RANGE: first logical index
+    uint16_t pixelCount;
+    
+    uint8_t effect;
+    uint8_t speed;
+    uint8_t brightness;         // 1-100
+    CRGB color;
+    white_mix_t whiteMix;
+    uint16_t frameIntervalMs;
+    unsigned long lastRenderTime;
+    
+    // Effect-specific state
+    unsigned long effectEpoch;  // Shared-clock ms the effect started, phase anchor
+    uint8_t rainbowHue;
+    bool strobeState;
+    bool fadingIn;
+    float pulsePhase;
+} led_zone_t;
+
+// Reassembly of the frame currently arriving
+typedef struct {
+    bool active;
+    uint16_t frameSeq;
+    uint16_t baseSeq;
+    uint8_t codec;
+    uint8_t fragCount;
+    uint32_t receivedMask;
+    uint16_t fragOffset[32];
+    uint8_t fragLength[32];
+    uint16_t encodedLength;
+    unsigned long firstFragmentUs;
+    uint8_t data[STREAM_ENCODED_MAX];
+} stream_assembly_t;
+
+typedef struct {
+    unsigned long fragments;
+    unsigned long duplicateFragments;
+    unsigned long framesCompleted;
+    unsigned long framesLost;          // Abandoned or never seen
+    unsigned long framesConcealed;     // Shown patched from the previous frame
+    unsigned long baseMismatches;      // Delta against a frame we do not have
+    unsigned long decodeErrors;
+    unsigned long wireBytes;
+    unsigned long rawBytes;
+    unsigned long reassemblyUsTotal;
+    unsigned long reassemblyUsMax;
+} stream_stats_t;
+
+typedef enum {
+    SERIAL_IN_HUNT,             // Between frames; printable bytes collect into a text line
+    SERIAL_IN_ADA_HEADER,       // "Ada" hi lo (hi ^ lo ^ 0x55)
+    SERIAL_IN_TPM2_HEADER,      // 0xC9 0xDA hi lo
+    SERIAL_IN_PIXELS,           // Adalight/TPM2 payload, read straight into the frame buffer
+    SERIAL_IN_TPM2_END,         // 0x36
+    SERIAL_IN_COBS              // Native frames; stays here across the 0x00 delimiters
+} serial_in_state_t;
+
+typedef enum {
+    SERIAL_PROTO_ADALIGHT,
+    SERIAL_PROTO_TPM2,
+    SERIAL_PROTO_NATIVE,
+    SERIAL_PROTO_COUNT
+} serial_proto_t;
+
+typedef struct {
+    bool binary;
+    uint32_t baud;
+    serial_in_state_t state;
+    uint8_t header[6];
+    uint8_t headerLength;
+    uint8_t frame[FRAME_BYTES_MAX];  // Assembled here, copied to the stream on publish
+    uint32_t payloadLength;     // Adalight/TPM2: bytes the header announced
+    uint32_t received;
+    uint8_t cobsCode;           // Code byte of the current block, 0 before the first
+    uint8_t cobsRemaining;      // Data bytes left in the block
+    uint32_t decoded;           // Bytes decoded so far in this native frame
+    uint8_t tail[4];            // Last four decoded bytes, held back: they may be the CRC
+    bool overflow;
+    int8_t lockedProto;         // Protocol of the last good frame, -1 = any
+    uint8_t failures;           // Errors since the last good frame
+    uint16_t lastSeq;
+    bool seqValid;
+    char line[SERIAL_LINE_MAX];
+    uint8_t lineLength;
+    unsigned long lastByteMs;
+    unsigned long errorUs;      // First error since the last good frame, 0 when in sync
+    uint32_t bytesSinceError;
+} serial_input_t;
+
+typedef struct {
+    unsigned long frames[SERIAL_PROTO_COUNT];
+    unsigned long bytes;
+    unsigned long skipped;          // Passed over while hunting for a header
+    unsigned long headerErrors;     // Adalight checksum, TPM2 end byte
+    unsigned long crcErrors;
+    unsigned long malformed;        // Bad COBS, too short, too long, unknown type
+    unsigned long timeouts;         // Partial frames abandoned
+    unsigned long seqGaps;          // Native frames missing by sequence
+    unsigned long resyncs;
+    unsigned long resyncUsLast, resyncUsMax;
+    unsigned long resyncBytesLast, resyncBytesMax;
+} serial_input_stats_t;
+
+typedef enum {
+    PIXEL_PROTO_SACN,
+    PIXEL_PROTO_ARTNET,
+    PIXEL_PROTO_DDP,
+    PIXEL_PROTO_COUNT
+} pixel_proto_t;
+
+// Where one datagram's channel data goes, from its header
+typedef struct {
+    uint8_t sourceId[16];       // sACN CID; sender IPv4 and protocol otherwise
+    uint8_t priority;
+    uint8_t seq;
+    uint8_t seqBits;            // 8, or 4 for DDP
+    bool hasSeq;
+    bool push;                  // DDP: frame complete
+    uint8_t headerLength;
+    uint8_t universe;           // Index from PIXEL_UNIVERSE_START; 0 for DDP
+    uint32_t universeBit;       // 0 for DDP
+    uint32_t offset;            // Byte offset into the frame
+    uint32_t length;
+} pixel_packet_t;
+
+typedef struct {
+    uint8_t id[16];
+    uint8_t priority;
+    uint8_t lastSeq[32];        // Per universe
+    uint32_t seqValid;
+    unsigned long lastSeenMs;
+    bool active;
+} pixel_source_t;
+
+typedef struct {
+    unsigned long packets[PIXEL_PROTO_COUNT];
+    unsigned long frames;
+    unsigned long timeouts;         // Shown with universes missing
+    unsigned long outOfOrder;
+    unsigned long outranked;        // A higher-priority source is live
+    unsigned long unmapped;         // Universe beyond the panel
+    unsigned long malformed;
+    unsigned long sources;
+    unsigned long sourcesFull;
+} pixel_input_stats_t;
+
+// Serial bridge records. Fragment i of a message carries bytes
+// i * SERIAL_BRIDGE_FRAG_MAX onward. A receiver adopts a new session at
+// message 0, or at any message when it has none yet (it just booted).
+typedef struct __attribute__((packed)) {
+    uint16_t session;       // Sender's stream id, never 0
+    uint16_t msgSeq;
+    uint8_t fragIndex;
+    uint8_t fragCount;
+    uint16_t msgLength;
+} serial_fragment_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t session;       // Stream acknowledged, 0 = none yet
+    uint16_t deliveredSeq;  // Every message through this one is in the ring
+    uint16_t freeBytes;     // Ring space once those were taken in
+} serial_credit_t;
+
+// Single-producer, single-consumer byte ring. head and tail run free and
+// are published with release stores, so neither side takes a lock.
+typedef struct {
+    uint8_t data[SERIAL_BRIDGE_RING];
+    uint32_t head;          // Written by the producer only
+    uint32_t tail;          // Written by the consumer only
+} byte_ring_t;
+
+typedef struct {
+    // Downstream, written by the WiFi task
+    uint16_t downSession;
+    uint16_t downDelivered;
+    uint16_t assemblySeq;
+    uint16_t assemblyLength;
+    uint32_t assemblyMask;          // Fragments present
+    uint8_t assembly[SERIAL_BRIDGE_MSG_MAX];
+    volatile bool creditDue;        // Answer now: a message landed or a repeat arrived
+    volatile unsigned long lastActivityMs;
+    // Upstream, loop only; one message in flight at a time
+    uint16_t upSession;
+    uint16_t upNextSeq;
+    bool upPeerReady;               // The controller has sent a credit
+    uint16_t upPeerFree;
+    uint16_t upInFlightSeq;
+    uint16_t upInFlightLength;      // 0 = nothing awaiting a credit
+    unsigned long upSentMs;
+    unsigned long lastCreditMs;
+    uint16_t lastFreeAdvertised;
+} serial_bridge_t;
+
+typedef struct {
+    unsigned long downMessages;
+    unsigned long downFragments;
+    unsigned long downDuplicates;   // Already delivered, or a fragment we had
+    unsigned long downOutOfOrder;   // Ahead of the next expected message
+    unsigned long downOverruns;     // Sender exceeded its credit
+    unsigned long downMalformed;
+    unsigned long downLegacyBytes;  // Unsequenced passthrough
+    volatile uint32_t downBytes;    // Written to the UART, by the bridge task
+    unsigned long upMessages;
+    unsigned long upFragments;
+    unsigned long upRetransmits;
+    volatile uint32_t upOverruns;   // UART bytes dropped with the ring full, by the bridge task
+    uint32_t upBytes;               // Acknowledged by the controller
+    unsigned long creditsSent;
+    unsigned long creditsReceived;
+    // Throughput, bytes per second
+    unsigned long rateStartMs;
+    uint32_t rateDownBase;
+    uint32_t rateUpBase;
+    uint32_t downRate, upRate;
+    uint32_t downPeak, upPeak;
+    uint32_t busyWindows;           // Windows that moved data, for the sustained rate
+    uint32_t busyDownBytes;
+    uint32_t busyUpBytes;
+} serial_bridge_stats_t;
+
+// Packet I/O backend. Whatever the backend, received packets go to
+// OnDataRecv and unicast send results to OnDataSent.
+typedef struct {
+    const char* name;
+    bool (*begin)();
+    esp_err_t (*send)(const uint8_t* mac, const uint8_t* data, size_t len);
+    void (*addPeer)(const uint8_t* mac);
+    void (*removePeer)(const uint8_t* mac);
+    void (*poll)();             // From loop(); nullptr when receive is callback driven
+} transport_t;
+
+// Duplicate suppression for one sender's sequence in one group
+typedef struct {
+    bool valid;
+    uint16_t lastSeq;
+    uint32_t seenMask;      // Bit n = lastSeq - n already accepted
+    unsigned long lastMs;   // Arrival of the newest accepted seq
+} seq_window_t;
+
+// One group slot: counters, plus a window for packets without a known sender
+typedef struct {
+    uint8_t group;
+    seq_window_t window;
+    unsigned long accepted;
+    unsigned long duplicates;
+    unsigned long broadcasts;
+    unsigned long airtimeUs;
+} group_state_t;
+
+// Persisted part of a peer
+typedef struct __attribute__((packed)) {
+    uint8_t mac[6];
+    uint8_t priority;
+} peer_record_t;
+
+typedef struct {
+    peer_record_t record;
+    seq_window_t windows[MAX_GROUPS + 2];   // Seq dedupe per group slot, slot 0 = unicast
+    unsigned long packets;
+    unsigned long commands;
+    unsigned long overruled;    // Commands dropped by arbitration
+    unsigned long lastSeenMs;
+} peer_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t origin[6];      // Controller that sent the inner packet
+    uint8_t ttl;            // Relays left
+    uint8_t hops;           // Relays taken so far
+    uint32_t delayUs;       // Time spent queued in relays, summed over hops
+} relay_header_t;
+
+typedef struct {
+    uint32_t key;           // Origin and group hash
+    uint16_t seq;           // Inner header seq
+    uint8_t heard;          // Copies received
+} relay_cache_entry_t;
+
+typedef struct {
+    bool used;
+    uint32_t key;
+    uint16_t seq;
+    uint8_t len;
+    int64_t receivedUs;
+    unsigned long dueMs;
+    uint8_t data[ESP_NOW_MAX_DATA_LEN];  // Complete outgoing packet
+} relay_slot_t;
+
+typedef struct {
+    unsigned long relayed;
+    unsigned long suppressed;   // Enough neighbours relayed it first
+    unsigned long duplicates;
+    unsigned long unknownOrigin;
+    unsigned long unicast;      // Relayed packets without a group target
+    unsigned long refused;      // Records that must come straight from a controller
+    unsigned long tooLarge;
+    unsigned long queueFull;
+    unsigned long received[RELAY_MAX_TTL + 1];  // By hop count
+    uint64_t delayUs[RELAY_MAX_TTL + 1];
+} relay_stats_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t transferId;    // Identifies the image for resume
+    uint32_t imageSize;
+    uint16_t chunkSize;
+    uint8_t sha256[32];
+} ota_begin_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t transferId;
+    uint32_t index;
+    uint32_t crc32;         // Of this chunk's image bytes
+} ota_chunk_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t transferId;
+    uint32_t watermark;     // Chunks below this are stored
+    uint32_t receivedMask;  // Bit n = chunk watermark + 1 + n stored; gaps are NACKs
+    uint8_t state;          // OTA_*
+} ota_status_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t transferId;
+} ota_end_t;
+
+enum {
+    OTA_IDLE = 0,
+    OTA_RECEIVING,
+    OTA_VERIFYING,
+    OTA_DONE,
+    OTA_FAILED
+};
+
+typedef struct {
+    bool used;
+    uint32_t index;
+    uint16_t length;
+    uint8_t data[OTA_CHUNK_MAX];
+} ota_slot_t;
+
+typedef struct {
+    uint8_t state;
+    uint32_t transferId;
+    uint32_t imageSize;
+    uint16_t chunkSize;
+    uint32_t chunkCount;
+    uint8_t sha256[32];
+    uint8_t owner[6];               // Controller that started the session
+    const esp_partition_t* partition;
+    volatile uint32_t watermark;
+    volatile uint32_t windowMask;   // Bit n = chunk watermark + n stored
+    volatile uint32_t erasedEnd;    // Partition bytes below this are erased
+    uint32_t eraseTarget;           // Image size rounded up to a sector
+    volatile bool eraseFailed;
+    uint32_t hashedBytes;           // Image prefix already fed to the SHA-256
+    bool imageVerified;             // SHA-256 matched; the boot switch follows
+    volatile esp_err_t bootResult;  // From esp_ota_set_boot_partition()
+    uint32_t persistedWatermark;
+    uint32_t resumedFrom;
+    unsigned long startMs;
+    unsigned long lastChunkMs;
+    unsigned long lastStatusMs;
+    unsigned long doneMs;
+    unsigned long verifyStartMs;
+    uint8_t chunksSinceStatus;
+    // Statistics
+    unsigned long chunksReceived;   // Every copy that arrived
+    unsigned long chunksStored;
+    unsigned long duplicates;       // Retransmits of chunks we already had
+    unsigned long crcErrors;
+    unsigned long outOfWindow;
+    unsigned long queueFull;
+    unsigned long notOwner;         // Chunks or ends from another controller
+    unsigned long waitedForErase;   // Passes a chunk stayed queued for the eraser
+    unsigned long statusesSent;
+} ota_session_t;
+
+// Fixed-size timing distribution, reset every telemetry interval
+typedef struct {
+    uint16_t counts[TIMING_BUCKETS];
+    uint32_t total;
+    uint32_t maxUs;
+} timing_histogram_t;
+
+typedef struct {
+    uint32_t rssiBuckets[LINK_RSSI_BUCKETS];
+    int32_t rssiEwmaX16;        // dBm * 16, alpha 1/16
+    int8_t rssiMin;
+    int8_t rssiMax;
+    uint32_t packets;
+    int64_t lastArrivalUs;
+    uint32_t lastGapUs;         // Previous inter-arrival time
+    uint32_t jitterUsX16;       // Mean |change in inter-arrival|, * 16
+    uint32_t seqLost;           // Sequence numbers skipped
+    uint32_t seqRecovered;      // Skipped ones that arrived late after all
+    uint32_t sends;             // Unicast sends with a status callback
+    uint32_t sendFailures;
+} link_stats_t;
+
+// Counter snapshot at the start of the current window
+typedef struct {
+    unsigned long startMs;
+    uint32_t packets;
+    uint32_t lost;
+    uint32_t sends;
+    uint32_t failures;
+    uint16_t lossPermille;      // Results of the previous window
+    uint16_t failPermille;
+} link_window_t;
+
+// Field order on the wire; append only
+enum {
+    TELEM_FPS_X10 = 0,          // Frames rendered, identical ones the cache skipped included
+    TELEM_RENDER_P50_US,
+    TELEM_RENDER_P95_US,
+    TELEM_SHOW_P50_US,
+    TELEM_SHOW_P95_US,
+    TELEM_SHOW_MAX_US,
+    TELEM_COMMANDS,             // Counters from here on, since boot
+    TELEM_DROPPED,
+    TELEM_COALESCED,
+    TELEM_FREE_HEAP,
+    TELEM_MIN_HEAP,
+    TELEM_RSSI,
+    TELEM_CURRENT_MA,
+    TELEM_UPTIME_S,
+    TELEM_SHOWN_FPS_X10,        // Of those, frames that changed and went out to the LEDs
+    TELEM_FIELD_COUNT
+};
+
+typedef struct {
+    int64_t offsetUs;       // Controller minus local
+    int64_t rttUs;
+    int64_t localUs;        // When the sample was taken
+} time_sample_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t zone;           // Zone id, ZONE_ALL for every zone
+    uint32_t sharedMs;      // Shared-clock time the values belong to
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+    uint8_t white;
+    uint8_t warmWhite;
+    uint8_t brightness;     // 1-100
+} live_sample_t;
+
+// How a live frame was derived
+enum {
+    LIVE_INTERPOLATED = 0,
+    LIVE_EXTRAPOLATED,
+    LIVE_HELD
+};
+
+// Interpolated values, in live_sample_t order from red
+enum {
+    LIVE_RED = 0,
+    LIVE_GREEN,
+    LIVE_BLUE,
+    LIVE_WHITE,
+    LIVE_WARM_WHITE,
+    LIVE_BRIGHTNESS,
+    LIVE_PARAM_COUNT
+};
+
+typedef struct {
+    uint32_t t;             // effectMillis() time
+    uint8_t v[LIVE_PARAM_COUNT];
+} live_point_t;
+
+// Oldest first; a full history drops its oldest point
+typedef struct {
+    live_point_t points[LIVE_SAMPLES];
+    uint8_t count;
+    bool active;
+    unsigned long lastSampleMs;
+} live_track_t;
+
+typedef struct {
+    unsigned long samples;
+    unsigned long reordered;        // Arrived before an older one
+    unsigned long duplicates;
+    unsigned long late;             // Already behind the render point on arrival
+    int32_t leadMinMs;              // Arrival ahead of the render point, since 'live reset'
+    int64_t leadTotalMs;
+    unsigned long interpolated;     // Frames by kind
+    unsigned long extrapolated;
+    unsigned long held;
+} live_stats_t;
+
+enum {
+    TRIGGER_NONE = 0,
+    TRIGGER_FLASH,              // Whole zone, fast decay
+    TRIGGER_RIPPLE,             // Ring growing from a point
+    TRIGGER_SWEEP               // Bar crossing the matrix
+};
+
+// Sweep directions
+enum {
+    SWEEP_RIGHT = 0,
+    SWEEP_LEFT,
+    SWEEP_DOWN,
+    SWEEP_UP
+};
+
+// Registered event, as stored in flash
+typedef struct {
+    uint8_t kind;
+    uint8_t direction;          // Sweeps
+    uint16_t durationMs;
+    uint16_t x;                 // Ripple origin, logical pixels or TRIGGER_CENTRE
+    uint16_t y;
+} trigger_event_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t event;              // Index into the registered table
+    uint8_t zone;               // Zone id, ZONE_ALL for every zone
+    uint8_t cue;                // Same cue = same firing; 0 is never deduplicated
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+    uint8_t intensity;          // Scales the colour
+} trigger_t;
+
+typedef struct {
+    trigger_t trigger;
+    uint32_t arrivalUs;
+} trigger_pending_t;
+
+// Running overlay; envelope and position are refreshed once per frame so
+// the per-pixel work is a compare and a scale
+typedef struct {
+    trigger_event_t event;
+    uint8_t zone;
+    CRGB color;
+    uint32_t startUs;
+    uint32_t arrivalUs;
+    bool shown;                 // Has reached the LEDs; latency recorded
+    uint8_t envelope;           // 0-255 for this frame
+    int32_t position;           // Ring radius or bar position, 1/16 pixel
+    int32_t extent;             // Largest radius or travel, 1/16 pixel
+    uint16_t originX;
+    uint16_t originY;
+} trigger_overlay_t;
+
+typedef struct {
+    unsigned long received;
+    unsigned long duplicates;       // Repeated cues
+    unsigned long unregistered;     // Event id with nothing registered
+    unsigned long queueFull;
+    unsigned long replaced;         // Oldest overlay dropped for a new one
+    unsigned long overBudget;       // Trigger-to-show slower than one frame
+    timing_histogram_t latency;     // Arrival to the end of the first show, since 'trigger reset'
+} trigger_stats_t;
+
+// Start of each capture segment file
+typedef struct __attribute__((packed)) {
+    char magic[4];              // "LCAP"
+    uint8_t version;
+    uint8_t reserved;
+    uint16_t ledCount;          // Logical LEDs
+    uint16_t width;
+    uint16_t height;
+    uint32_t segment;           // Counts up; the lower of the two files is older
+    int64_t startUs;            // esp_timer_get_time() when the segment opened
+    int64_t clockOffsetUs;      // Shared clock minus local when the segment opened
+} capture_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t timeUs;            // esp_timer_get_time(), low 32 bits
+    uint8_t mac[6];             // Sender
+    uint8_t flags;              // CAPTURE_FLAG_*
+    uint8_t length;             // Packet bytes that follow
+} capture_record_t;
+
+typedef struct {
+    unsigned long packets;
+    unsigned long bytes;            // Records written to flash, headers included
+    unsigned long ramDrops;         // Ring full; the flash writes fell behind
+    unsigned long writeErrors;
+    unsigned long segments;
+    uint32_t flushMaxUs;            // Longest single flash write
+} capture_stats_t;
+
+typedef struct {
+    unsigned long packets;          // Fed to the receive path
+    unsigned long skipped;          // OTA, bridge, time and relay traffic is not replayed
+    unsigned long frames;
+    unsigned long deadlineMisses;   // Ticks whose render and show ran past one frame
+    uint32_t digest;                // CRC-32 chained over every frame
+    timing_histogram_t tickTime;    // Real µs per rendering tick
+    timing_histogram_t latency;     // Virtual µs from packet to the next frame
+    int64_t startUs;                // Virtual time of the first packet
+} replay_stats_t;
+
+// Followed by encodeStreamRle() output over one RGB332 byte per preview
+// pixel, row-major. A delta XORs against frame 'base' and applies only on
+// top of exactly that frame; anything else waits for the next key frame.
+typedef struct __attribute__((packed)) {
+    uint16_t frame;
+    uint16_t base;              // Equal to frame on a key frame
+    uint8_t flags;              // PREVIEW_FLAG_*
+    uint8_t width;
+    uint8_t height;
+} preview_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t fps;                // 0 = off
+    uint8_t sharePct;           // Airtime cap, 0 = leave as is
+    uint8_t scale;              // LEDs per preview pixel side, 0 = smallest that fits
+} preview_config_t;
+
+typedef struct {
+    unsigned long sent;
+    unsigned long keyframes;
+    unsigned long unchanged;        // Same as the last preview, nothing sent
+    unsigned long overBudget;       // Held back by the airtime share
+    unsigned long sendErrors;
+    unsigned long bytes;            // Whole packets
+    unsigned long airtimeUs;
+    timing_histogram_t encodeTime;  // Downsample, quantize and RLE, per frame
+} preview_stats_t;
+
+enum {
+    STATUS_ANIM_NONE,
+    STATUS_ANIM_BOOT,
+    STATUS_ANIM_ERROR,
+    STATUS_ANIM_SUCCESS
+};
+
+// One zone as saved; effect state starts over on restore
+typedef struct __attribute__((packed)) {
+    uint8_t active;
+    uint8_t shape;
+    uint16_t x, y, w, h;
+    uint16_t start;
+    uint16_t pixelCount;
+    uint8_t effect;
+    uint8_t speed;
+    uint8_t brightness;
+    uint8_t color[3];
+    uint8_t white;
+    uint8_t warmAmount;
+    uint8_t warmColor[3];
+    uint16_t frameIntervalMs;
+} scene_zone_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t version;
+    uint16_t width, height;     // Matrix the zone rectangles were drawn on
+    scene_zone_t zones[MAX_ZONES];
+} scene_t;
+
+typedef struct {
+    unsigned long changes;          // Distinct scenes seen by the checks
+    unsigned long writes;
+    unsigned long heldByBudget;     // Saves that had to wait for the hourly budget
+    uint32_t lastWriteUs;
+    int64_t firstFrameUs;           // esp_timer_get_time() at each boot milestone
+    int64_t setupDoneUs;
+    int64_t radioReadyUs;
+} scene_stats_t;
+
+// Outgoing v2 packet under construction
+typedef struct {
+    uint8_t data[ESP_NOW_MAX_DATA_LEN];
+    int len;
+} wire_packet_t;
+
+typedef struct {
+    unsigned long v2Packets;
+    unsigned long legacyPackets;
+    unsigned long records;
+    unsigned long unknownRecords;
+    unsigned long malformed;
+    unsigned long badVersion;
+    unsigned long notSubscribed;
+    unsigned long zoneFiltered;
+    unsigned long seqResyncs;       // Windows restarted after a sender reboot
+    uint16_t lastSeq;
+    unsigned long simulatedDrops;
+} wire_stats_t;
+
+typedef struct {
+    unsigned long applied;          // New versions taken
+    unsigned long duplicates;       // Retransmits of a version already applied
+    unsigned long behind;           // Heartbeats showing a version we missed
+    unsigned long resyncs;          // Controller restarted its version count
+    unsigned long acksSent;
+    unsigned long sendFailures;     // No link-layer ack from the controller
+    unsigned long staleSamples;     // Applied updates with a synced issue time
+    unsigned long staleTotalMs;
+    unsigned long staleMaxMs;
+    unsigned long staleLate;        // Of those, later than STATE_STALE_LATE_MS
+} state_stats_t;
+
+// What each queued ESP-NOW send was, so OnDataSent can attribute its status
+enum {
+    SEND_OTHER = 0,
+    SEND_COLOR_REQUEST,
+    SEND_STATE_ACK
+};
+
+// Walks a zone's pixels in logical row-major order
+typedef struct {
+    uint16_t ordinal;           // 0 .. pixelCount-1
+    uint16_t index;             // Logical frame index
+    uint16_t x, y;
+} zone_cursor_t;
+
+#define ZONE_RECT         0
+#define ZONE_RANGE        1
+
+#define LAYOUT_UNMAPPED   0xFFFF
+#define LAYOUT_MIRROR_X   0x01
+#define LAYOUT_MIRROR_Y   0x02
+
 // =============================================================================
 // GLOBAL VARIABLES
 // =============================================================================
-CRGB leds[NUM_LEDS];
+CRGB leds[NUM_LEDS];      // Physical order, handed to FastLED
+CRGB frame[NUM_LEDS];     // Logical row-major order, effects render here
+
+// Matrix geometry
+matrix_layout_t matrixLayout = {LED_WIDTH, LED_HEIGHT, 1, 1, 1, 0, 0, 0};
+uint16_t pixelMap[NUM_LEDS];          // Logical index -> physical index
+uint16_t matrixWidth = LED_WIDTH;     // Logical width after rotation
+uint16_t matrixHeight = LED_HEIGHT;   // Logical height after rotation
+uint16_t logicalLedCount = NUM_LEDS;  // matrixWidth * matrixHeight
+uint16_t physicalLedCount = NUM_LEDS; // LEDs actually wired
+bool customLayoutActive = false;
+uint8_t customCoords[NUM_LEDS][2];    // Active coordinate list, (x, y) per wired LED
+uint8_t stagedCoords[NUM_LEDS][2];    // Filled by 'layout map', applied on 'layout map end'
+uint16_t stagedCoordCount = 0;
+bool layoutMapOpen = false;
+Preferences layoutPrefs;
+
+// Output channels
+const uint8_t outputPins[MAX_OUTPUT_CHANNELS] = {LED_PIN, 12, 14, 27};
+output_segment_t outputSegments[MAX_OUTPUT_CHANNELS];
+CLEDController* outputControllers[MAX_OUTPUT_CHANNELS];
+uint8_t outputChannelCount = 0;
+unsigned long lastShowTimeUs = 0;
+unsigned long maxShowTimeUs = 0;
+timing_histogram_t renderTiming;
+timing_histogram_t showTiming;
+uint32_t estimatedCurrentMa = 0;
 
-// Communication
-uint8_t controllerAddress[] = {0x64, 0xE8, 0x33, 0x7A, 0x88, 0x70}; // UPDATE THIS!
-volatile led_command_t receivedCommand;
-volatile bool newCommandReceived = false;
+// Last frame on the wire. WS2812s latch their color, so an identical frame
+// only needs resending as a periodic refresh against glitches.
+CRGB shownLeds[NUM_LEDS];
+uint8_t shownBrightness = 0;
+bool frameCacheValid = false;
+
+#if LED_WHITE_CHANNEL
+// 4-channel framebuffer in physical order; the controllers see it as packed
+// CRGB triplets. Two bytes of slack for the last partial triplet.
+rgbw_pixel_t rgbwLeds[NUM_LEDS + 1];
+#endif
+unsigned long lastFrameRefresh = 0;
+unsigned long framesShown = 0;
+unsigned long framesSkipped = 0;
+
+// Communication. controllerAddress is the active controller, the one acks
+// and pings go to; the default only seeds an empty peer table.
+const uint8_t defaultControllerAddress[] = {0x64, 0xE8, 0x33, 0x7A, 0x88, 0x70};
+uint8_t controllerAddress[6];
+portMUX_TYPE commandMux = portMUX_INITIALIZER_UNLOCKED;
+led_command_t pendingCommands[MAX_ZONES];  // Latest command per zone, guarded by commandMux
+uint32_t pendingApplyAt[MAX_ZONES];        // Shared-clock ms, 0 = immediately
+volatile uint8_t pendingZoneMask = 0;
+uint16_t txSeq = 0;
+uint8_t sendKinds[8];                      // FIFO; send callbacks arrive in send order
+volatile uint8_t sendKindHead = 0;
+volatile uint8_t sendKindTail = 0;
 bool expectingResponse = false;
 unsigned long responseTimeout = 0;
 unsigned long lastHeartbeat = 0;
+wire_stats_t wireStats;
+
+// State versions: the controller numbers every state change, we ack what we applied
+bool stateSyncActive = false;              // Controller has sent a version at least once
+uint16_t appliedVersion = 0;
+uint16_t controllerVersion = 0;            // Latest version the controller announced
+unsigned long lastStateRxMs = 0;           // Last version or heartbeat, on the render clock
+volatile bool stateAckPending = false;
+unsigned long lastStateAck = 0;
+uint8_t consecutiveSendFailures = 0;
+uint8_t simulatedLossPct = 0;              // Incoming packets dropped on purpose
+state_stats_t stateStats;
+
+// Shared clock: local esp_timer plus a slewed offset toward the controller
+time_sample_t timeSamples[TIME_SAMPLES];
+uint8_t timeSampleCount = 0;
+uint8_t timeSampleNext = 0;
+int64_t clockOffsetUs = 0;        // Applied offset
+int64_t targetOffsetUs = 0;       // Best estimate at targetOffsetAtUs
+int64_t targetOffsetAtUs = 0;
+float clockDriftPpm = 0.0;        // Controller clock rate relative to ours
+int64_t driftRefOffsetUs = 0;
+int64_t driftRefAtUs = 0;
+int64_t lastSlewUs = 0;
+bool clockSynced = false;
+unsigned long lastTimeSync = 0;
+unsigned long timePingsSent = 0;
+unsigned long timePongsUsed = 0;
+int64_t lastSyncErrorUs = 0;      // Half the RTT of the best sample
+
+// Live parameters. The WiFi task inserts samples, the loop evaluates them.
+portMUX_TYPE liveMux = portMUX_INITIALIZER_UNLOCKED;
+live_track_t liveTracks[MAX_ZONES];
+uint16_t liveDelayMs = LIVE_DELAY_DEFAULT_MS;
+live_stats_t liveStats;
+
+// Triggers. The WiFi task queues, the loop runs the overlays.
+portMUX_TYPE triggerMux = portMUX_INITIALIZER_UNLOCKED;
+trigger_event_t triggerEvents[TRIGGER_EVENTS];
+trigger_pending_t triggerQueue[TRIGGER_QUEUE];
+uint8_t triggerQueueHead = 0, triggerQueueTail = 0;
+uint8_t recentCues[TRIGGER_RECENT_CUES];
+unsigned long recentCueMs[TRIGGER_RECENT_CUES];
+uint8_t recentCueNext = 0;
+trigger_overlay_t overlays[TRIGGER_OVERLAYS];
+uint8_t overlayCount = 0;
+bool overlayFrameDue = false;
+unsigned long lastOverlayFrame = 0;
+trigger_stats_t triggerStats;
+Preferences triggerPrefs;
+TaskHandle_t loopTask = nullptr;    // Woken early by triggers
+
+// Capture and replay. The WiFi task pushes records, the loop does the rest.
+byte_ring_t captureRing;            // Same ring type as the serial bridge
+volatile bool captureActive = false;
+bool fsMounted = false;
+File captureFile;
+uint8_t captureSlot = 0;            // File being written, /capture<slot>.bin
+uint32_t captureSegment = 0;
+uint32_t captureFileBytes = 0;
+unsigned long lastCaptureFlush = 0;
+capture_stats_t captureStats;
+bool dumpActive = false;
+File dumpFile;
+uint8_t dumpSlots[2];
+uint8_t dumpSlotCount = 0, dumpSlotNext = 0;
+uint32_t dumpCrc = 0;
+volatile bool replayActive = false;
+bool replayVerbose = false;
+File replayFile;
+uint8_t replaySlots[2];
+uint8_t replaySlotCount = 0, replaySlotNext = 0;
+capture_record_t replayRecord;
+uint8_t replayPacket[ESP_NOW_MAX_DATA_LEN];
+bool replayHavePacket = false;
+bool replayClockStarted = false;
+uint32_t replayLastRawUs = 0;
+int64_t replayPacketUs = 0;         // Unwrapped time of replayRecord
+int64_t replayClockUs = 0;          // The virtual clock
+int64_t replayNextTickUs = 0;
+int64_t replayClockOffsetUs = 0;    // From the segment header, for sharedMicros()
+int64_t replayPendingUs[REPLAY_PENDING];
+uint8_t replayPendingCount = 0;
+replay_stats_t replayStats;
+
+// Instant-on scene and boot timing
+Preferences scenePrefs;
+scene_t savedScene;                 // What flash holds
+scene_t lastSceneCheck;             // Snapshot at the previous check
+bool sceneRestored = false;
+bool sceneDirty = false;            // Differs from flash
+bool sceneBudgetNoted = false;
+unsigned long lastSceneCheckMs = 0;
+unsigned long sceneDirtySinceMs = 0;
+unsigned long sceneChangedMs = 0;   // Last time the snapshot moved
+unsigned long lastSceneWriteMs = 0;
+unsigned long sceneTokenMs = 0;
+uint8_t sceneWriteTokens = SCENE_WRITES_PER_HOUR;
+scene_stats_t sceneStats;
+TaskHandle_t transportTask = nullptr;
+volatile bool transportDone = false;    // Init task finished
+bool transportOk = false;
+bool pixelInputOk = false;
+bool transportReady = false;            // Loop has taken over the radio
+
+// Status animation, and how long loop() passes take
+uint8_t statusAnimation = STATUS_ANIM_NONE;
+unsigned long statusAnimationStart = 0;
+unsigned long lastStatusFrame = 0;
+unsigned long statusPreempted = 0;
+timing_histogram_t loopTiming;          // Work per pass, the wait at the end excluded
+unsigned long loopOverruns = 0;         // Passes longer than one frame
+
+// Peer table, written from the loop only; the WiFi task reads it
+peer_t peers[MAX_PEERS];
+uint8_t peerCount = 0;
+uint8_t peerHash[PEER_HASH_SLOTS];        // Peer index + 1, 0 = empty
+Preferences peerPrefs;
+peer_t* rxPeer = nullptr;                 // Sender of the packet being dispatched
+int8_t rxArbitration = -1;                // Per packet: -1 undecided, 0 overruled, 1 allowed
+int8_t arbOwner = -1;                     // Peer currently in control
+unsigned long arbOwnerLastMs = 0;
+int8_t activePeer = -1;
+volatile int8_t pendingActivePeer = -1;   // Handed from the WiFi task to the loop
+unsigned long pairingUntil = 0;
+volatile bool pairingRequested = false;
+uint8_t pairingMac[6];
+unsigned long unknownSenders = 0;
+
+// Relay mesh
+const uint8_t broadcastAddress[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+bool relayEnabled = RELAY_ENABLED_DEFAULT;
+uint8_t relayTtl = RELAY_DEFAULT_TTL;
+portMUX_TYPE relayMux = portMUX_INITIALIZER_UNLOCKED;
+relay_cache_entry_t relayCache[RELAY_CACHE_SIZE];
+uint8_t relayCacheNext = 0;
+relay_slot_t relayQueue[RELAY_QUEUE_SIZE];
+relay_stats_t relayStats;
+
+// OTA. The WiFi task checks and queues chunks; flash work happens in the loop.
+portMUX_TYPE otaMux = portMUX_INITIALIZER_UNLOCKED;
+ota_session_t ota;
+ota_slot_t otaQueue[OTA_QUEUE_SIZE];
+ota_begin_t otaPendingBegin;
+uint8_t otaPendingOwner[6];
+volatile bool otaBeginPending = false;
+mbedtls_sha256_context otaHash;           // Runs behind the watermark while chunks arrive
+TaskHandle_t otaEraseTask = nullptr;
+volatile bool otaEraseRunning = false;
+volatile bool otaEraseStop = false;
+volatile bool otaEndPending = false;
+volatile bool otaBootSwitching = false;   // esp_ota_set_boot_partition() running on its task
+Preferences otaPrefs;
+
+// Telemetry
+unsigned long commandsDropped = 0;        // Filtered by zone or lost arbitration
+unsigned long commandsCoalesced = 0;      // Overwritten before the loop applied them
+volatile int8_t lastRssi = 0;
+
+// Link quality
+link_stats_t linkStats;
+link_window_t linkWindow;
+unsigned long nextAckRetryMs = 0;
+int32_t telemetryLast[TELEM_FIELD_COUNT]; // Values in the previous report
+uint16_t telemetrySeq = 0;
+unsigned long lastTelemetry = 0;
+unsigned long telemetryFramesAtLast = 0;   // framesShown at the previous report
+unsigned long telemetrySkippedAtLast = 0;  // framesSkipped at the previous report
+volatile bool telemetryRequested = false;
+uint8_t lastTelemetryBytes = 0;
+
+// Framebuffer preview. The WiFi task may change the config; the loop sends.
+volatile uint8_t previewFps = PREVIEW_FPS_DEFAULT;
+volatile uint8_t previewSharePct = PREVIEW_SHARE_DEFAULT;
+volatile uint8_t previewScale = 0;
+volatile bool previewKeyframeWanted = false;
+uint8_t previewReference[PREVIEW_MAX_PIXELS];   // Last preview sent, delta base
+uint8_t previewRefWidth = 0, previewRefHeight = 0;
+uint16_t previewFrameSeq = 0;
+unsigned long lastPreviewMs = 0;
+unsigned long lastPreviewKeyMs = 0;
+unsigned long previewFramesAtLast = 0;
+unsigned long previewEnabledMs = 0;
+uint32_t previewCreditUs = 0;
+int64_t previewCreditAtUs = 0;
+preview_stats_t previewStats;
+
+// Group subscriptions; slot 0 = direct, slot 1 = everyone
+uint8_t subscribedGroups[MAX_GROUPS];
+uint8_t subscribedGroupCount = 0;
+group_state_t groupStates[MAX_GROUPS + 2];
 
 // Performance tracking
 unsigned long lastLedUpdateTime = 0;
@@ -87,27 +1439,63 @@ unsigned long commandsReceived = 0;
 unsigned long requestsSent = 0;
 bool isConnected = false;
 
+// Frame streaming. Triple buffered: the WiFi task decodes into the write
+// buffer and swaps it with the ready one; the loop swaps ready with display.
+portMUX_TYPE streamMux = portMUX_INITIALIZER_UNLOCKED;
+stream_assembly_t streamAssembly;
+uint8_t streamBuffers[3][FRAME_BYTES_MAX];
+uint8_t streamWriteIdx = 0, streamReadyIdx = 1, streamDisplayIdx = 2;
+volatile bool streamFrameFresh = false;
+uint8_t streamReference[FRAME_BYTES_MAX];  // Last decoded frame, delta base
+uint16_t streamReferenceSeq = 0;
+bool streamReferenceValid = false;
+uint16_t streamLastSeq = 0;
+bool streamSeqValid = false;
+bool streamModeActive = false;             // Frames override every zone
+unsigned long lastStreamFrameTime = 0;
+stream_stats_t streamStats;
+
+// Binary serial input, loop only
+serial_input_t serialInput;
+serial_input_stats_t serialStats;
+
+// Text mode command line, filled as bytes arrive
+char commandLine[SERIAL_COMMAND_MAX];
+uint16_t commandLength = 0;
+bool commandTooLong = false;
+
+// Serial bridge. The WiFi task fills bridgeDown and the bridge task drains
+// it to the UART; the bridge task fills bridgeUp and the loop sends it.
+portMUX_TYPE bridgeMux = portMUX_INITIALIZER_UNLOCKED;
+byte_ring_t bridgeDown;
+byte_ring_t bridgeUp;
+serial_bridge_t bridge;
+serial_credit_t bridgePendingCredit;       // Handed from the WiFi task to the loop
+volatile bool bridgeCreditPending = false;
+TaskHandle_t bridgeTask = nullptr;
+serial_bridge_stats_t bridgeStats;
+
+// UDP pixel input, loop only
+int pixelSockets[PIXEL_PROTO_COUNT] = {-1, -1, -1};
+pixel_source_t pixelSources[PIXEL_MAX_SOURCES];
+uint8_t pixelFrame[FRAME_BYTES_MAX];        // Assembled here; keeps the last frame as the next one's base
+bool pixelFrameOpen = false;
+uint32_t pixelUniverseMask = 0;
+unsigned long pixelFrameStartMs = 0;
+pixel_input_stats_t pixelStats;
+
 // LED State Management
-uint8_t currentEffect = 0;
-uint8_t currentSpeed = 50;
-uint8_t currentBrightness = 50;
-CRGB currentColor = CRGB::Red;
-unsigned long lastEffectRunTime = 0;
-
-// Effect-specific variables
-uint8_t rainbowHue = 0;
-bool strobeState = false;
-unsigned long fadeStartTime = 0;
-CRGB fadeStartColor = CRGB::Black;
-CRGB fadeTargetColor = CRGB::Red;
-bool fadingIn = true;
-float pulsePhase = 0.0;
+led_zone_t zones[MAX_ZONES];
+uint8_t zoneOf[NUM_LEDS];       // Logical index -> owning zone
+uint8_t zoneScale[MAX_ZONES];   // Zone brightness as a 0-255 scale
 
 // =============================================================================
 // FUNCTION PROTOTYPES
 // =============================================================================
 void initializeHardware();
-void initializeESPNOW();
+bool initializeTransport();
+void transportInitTask(void*);
+void finishTransportInit();
 void setupPeerConnection();
 void handleSerialCommands();
 void processReceivedCommand();
@@ -117,67 +1505,567 @@ void printStatus();
 void printDiagnostics();
 
 // LED Effects
-void applyEffect();
-void effectSolid();
-void effectRainbow();
-void effectFade();
-void effectStrobe();
-void effectPulse();
-void effectSparkle();
-void effectWave();
-CRGB applyWhiteAndWarmWhite(CRGB color, uint8_t white, uint8_t warmWhite);
+void applyEffect(led_zone_t& zone);
+void effectSolid(led_zone_t& zone);
+void effectRainbow(led_zone_t& zone);
+void effectFade(led_zone_t& zone);
+void effectStrobe(led_zone_t& zone);
+void effectPulse(led_zone_t& zone);
+void effectSparkle(led_zone_t& zone);
+void effectWave(led_zone_t& zone);
+void effectStream(led_zone_t& zone);
+void updateWhiteMix(white_mix_t& mix, uint8_t white, uint8_t warmWhite);
+CRGB applyWhiteMix(const white_mix_t& mix, CRGB color);
+rgbw_pixel_t extractWhite(CRGB color);
 
 // Utility functions
 void bootSequence();
 void showError(const char* message);
 void showSuccess(const char* message);
+void startStatusAnimation(uint8_t kind);
+bool renderStatusAnimation(unsigned long elapsedMs);
+bool serviceStatusAnimation();
+void preemptStatusAnimation();
+void endStatusAnimation();
+void noteLoopPass(unsigned long passStart);
 int16_t getMatrixIndex(int16_t x, int16_t y);
 
+// Zones
+void initializeZones();
+void resetZones();
+bool setZoneRect(uint8_t id, uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+bool setZoneRange(uint8_t id, uint16_t start, uint16_t count);
+void rebuildZoneMap();
+void queueZoneCommand(uint8_t zone, const led_command_t* command, uint32_t applyAtMs = 0);
+void applyZoneCommand(led_zone_t& zone, const led_command_t& command);
+void resetZoneEffectState(led_zone_t& zone);
+void zoneCursorBegin(const led_zone_t& zone, zone_cursor_t& c);
+void zoneCursorNext(const led_zone_t& zone, zone_cursor_t& c);
+uint16_t zonePixelAt(const led_zone_t& zone, uint16_t ordinal);
+void fillZone(const led_zone_t& zone, CRGB color);
+void handleZoneCommand(String args);
+void printZones();
+
+// Instant-on scene
+void snapshotScene(scene_t& scene);
+bool restoreScene();
+void writeScene(const scene_t& scene);
+void serviceScene();
+void handleSceneCommand(String args);
+void printScene();
+
+// Wire protocol
+bool dispatchWirePacket(const uint8_t* data, int len, bool broadcast, bool relayed = false);
+uint8_t wireTargetGroup(const uint8_t* data, int len);
+bool directOnlyRecord(uint8_t type);
+group_state_t* findGroupState(uint8_t group);
+bool acceptGroupSeq(seq_window_t* window, uint16_t seq);
+void resetSeqWindows();
+bool subscribeGroup(uint8_t group);
+bool unsubscribeGroup(uint8_t group);
+uint32_t estimateAirtimeUs(int len);
+void handleGroupCommand(String args);
+void printGroups();
+void noteCommandReceived();
+void handleSerialPassthrough(const uint8_t* data, uint16_t length);
+void printWireStats();
+
+void wireBegin(wire_packet_t& packet);
+bool wireAppend(wire_packet_t& packet, uint8_t type, const void* value, uint8_t length);
+esp_err_t wireSend(wire_packet_t& packet, const uint8_t* mac, uint8_t kind = SEND_OTHER);
+esp_err_t sendToController(const uint8_t* data, int len, uint8_t kind);
+
+// Peers
+uint8_t peerHashOf(const uint8_t* mac);
+peer_t* findPeer(const uint8_t* mac);
+void rebuildPeerHash();
+int addPeer(const uint8_t* mac, uint8_t priority);
+bool removePeer(uint8_t index);
+void loadPeers();
+void savePeers();
+bool peerMayCommand();
+bool fromActivePeer();
+void setActivePeer(int8_t index);
+void servicePeers();
+bool parseMac(String text, uint8_t* mac);
+void handlePeerCommand(String args);
+void printPeers();
+
+// Relay mesh
+uint32_t relayKeyOf(const uint8_t* origin, const uint8_t* inner, int innerLen);
+bool noteRelaySeen(uint32_t key, uint16_t seq);
+uint8_t relayCopiesHeard(uint32_t key, uint16_t seq);
+void queueRelay(const uint8_t* origin, uint8_t ttl, uint8_t hops, uint32_t delayUs,
+                const uint8_t* inner, int innerLen);
+void handleRelayPacket(const uint8_t* data, int len);
+void serviceRelay();
+void handleRelayCommand(String args);
+void printRelayStats();
+
+// OTA update
+void handleOtaBegin(const ota_begin_t* begin);
+void handleOtaChunk(const uint8_t* value, uint8_t length);
+void handleOtaEnd(const ota_end_t* end);
+void startOtaSession(const ota_begin_t* begin);
+bool storeOtaChunk(const ota_slot_t& slot);
+void persistOtaWatermark(bool force);
+bool fromOtaOwner();
+void otaEraseTaskMain(void*);
+void otaBootTaskMain(void*);
+bool hashOtaSlice();
+void serviceOtaVerify();
+void sendOtaStatus();
+void serviceOta();
+void handleOtaCommand(String args);
+void printOtaStatus();
+
+// Telemetry
+void recordTiming(timing_histogram_t& h, uint32_t us);
+uint32_t timingPercentile(const timing_histogram_t& h, uint8_t pct);
+uint32_t estimateCurrentMa(const CRGB* pixels, uint16_t count, uint8_t brightness);
+uint8_t* putVarint(uint8_t* out, uint32_t value);
+void collectTelemetry(int32_t* fields);
+uint8_t encodeTelemetry(const int32_t* fields, bool keyframe, uint8_t* out);
+void sendTelemetry(bool keyframe);
+void serviceTelemetry();
+void printTelemetry();
+
+// Framebuffer preview
+void configurePreview(const preview_config_t* config);
+uint8_t previewGeometry(uint8_t* width, uint8_t* height);
+void samplePreview(uint8_t* out, uint8_t scale, uint8_t width, uint8_t height);
+void servicePreview();
+void handlePreviewCommand(String args);
+void printPreview();
+
+// Link quality
+void noteLinkArrival(int8_t rssi);
+void noteLinkSend(bool success);
+void serviceLinkWindow();
+unsigned long linkAckIntervalMs();
+unsigned long linkRetryDelayMs();
+int8_t linkRssiPercentile(uint8_t pct);
+void printLinkStats();
+
+// State versions
+bool versionNewer(uint16_t a, uint16_t b);
+bool acceptStateVersion(const state_version_t* state);
+bool stateVersionRestarted(uint16_t version);
+void handleStateHeartbeat(const state_heartbeat_t* heartbeat);
+void sendStateAck();
+void serviceStateSync();
+void handleLossCommand(String args);
+void printStateSync();
+
+// Time sync
+int64_t sharedMicros();
+unsigned long effectMillis();
+void sendTimePing();
+void handleTimePong(const time_pong_t* pong);
+void serviceTimeSync();
+void printTimeSync();
+
+// Live parameters
+void queueLiveSample(const live_sample_t* sample);
+void insertLivePoint(live_track_t& track, const live_point_t& point);
+uint8_t evaluateLive(const live_track_t& track, uint32_t t, uint8_t* out);
+void applyLiveParameters(uint8_t z);
+void endLive(uint8_t z);
+void handleLiveCommand(String args);
+void printLive();
+
+// Triggers
+void loadTriggers();
+void saveTriggers();
+void queueTrigger(const trigger_t* trigger);
+void serviceTriggers();
+void startOverlay(const trigger_pending_t& pending);
+int32_t overlayDistance16(uint16_t dx, uint16_t dy);
+void compositeOverlays(uint16_t i, uint8_t z, CRGB& pixel);
+void noteOverlaysShown();
+void handleTriggerCommand(String args);
+void printTriggers();
+
+// Capture and replay
+unsigned long renderMillis();
+uint32_t renderMicros();
+bool mountCaptureFs();
+void capturePacket(const esp_now_recv_info_t* info, const uint8_t* data, int len);
+bool openCaptureSegment();
+void startCapture();
+void stopCapture();
+void flushCapture();
+uint8_t captureSlotsOldestFirst(uint8_t* slots);
+void serviceCapture();
+void startCaptureDump();
+void serviceCaptureDump();
+void startReplay(bool verbose);
+bool replayOpenNextSegment();
+bool replayReadPacket();
+bool replayablePacket(const uint8_t* data, int len);
+void serviceReplay();
+void runReplayTick();
+void noteReplayFrame();
+void finishReplay();
+void handleCaptureCommand(String args);
+void printCapture();
+
+// Frame streaming
+void handleFrameFragment(const uint8_t* data, int len);
+void finishStreamAssembly(bool complete);
+bool decodeStreamFrame(const uint8_t* encoded, uint16_t length, uint8_t codec, uint8_t* out, uint16_t frameBytes);
+uint16_t encodeStreamRle(const uint8_t* frameData, const uint8_t* reference, uint16_t frameBytes, uint8_t* out, uint16_t outMax);
+void publishStreamFrame();
+bool takeStreamFrame();
+void serviceFrameStream();
+void printStreamStats();
+void localFramePublish(const uint8_t* frame);
+
+// Serial frame input
+void runCommand(String command);
+void setSerialBinary(bool on, uint32_t baud);
+void serviceSerialInput();
+void serialInputByte(uint8_t b);
+void cobsEmit(uint8_t b);
+bool finishCobsFrame();
+void serialFramePublish(serial_proto_t proto, uint32_t length);
+void serialInputGood(serial_proto_t proto);
+void serialInputError(unsigned long& counter);
+void serialInputLostSync();
+void printSerialInput();
+
+// Serial bridge
+uint32_t ringUsed(const byte_ring_t& ring);
+uint32_t ringFree(const byte_ring_t& ring);
+void ringPush(byte_ring_t& ring, const uint8_t* data, uint32_t length);
+void ringPeek(const byte_ring_t& ring, uint32_t offset, uint8_t* out, uint32_t length);
+uint32_t ringContiguous(const byte_ring_t& ring, const uint8_t** data);
+void ringDrop(byte_ring_t& ring, uint32_t length);
+void serialBridgeBegin();
+void serialBridgeTask(void*);
+void handleSerialFragment(const uint8_t* value, uint8_t length);
+void handleSerialCredit(const serial_credit_t* credit);
+void appendSerialCredit(wire_packet_t& packet);
+void sendSerialMessage(bool retransmit);
+void serviceSerialBridge();
+void printSerialBridge();
+
+// UDP pixel input
+bool pixelInputBegin();
+int openPixelSocket(uint16_t port, uint8_t multicastUniverses);
+void servicePixelInput();
+bool receivePixelPacket(pixel_proto_t proto);
+bool parsePixelHeader(pixel_proto_t proto, const uint8_t* h, int length, uint32_t fromIp,
+                      pixel_packet_t* packet);
+bool acceptPixelPacket(const pixel_packet_t& packet);
+void forgetPixelSource(const uint8_t* cid);
+void startPixelFrame();
+void finishPixelFrame();
+void printPixelInput();
+
+// Matrix geometry
+bool rebuildPixelMap();
+bool buildCustomLayout(const uint8_t (*coords)[2], uint16_t count);
+void renderToOutput();
+void handleLayoutCommand(String args);
+void handleLayoutMapCommand(String args);
+void loadLayout();
+void saveLayout();
+void printLayout();
+
+// Output channels
+void initializeOutputs();
+CLEDController* addOutputController(uint8_t pin, CRGB* data, int count);
+void splitOutputSegments();
+bool applyOutputSegments(const output_segment_t* segments, uint8_t count);
+uint32_t segmentWireTimeUs(uint16_t count);
+void showFrame();
+void invalidateFrameCache();
+void showImmediate();
+void encodeWirePixels();
+void handleOutputsCommand(String args);
+void printOutputs();
+
+// Transport backends
+void OnDataRecv(const esp_now_recv_info_t *recv_info, const uint8_t *incomingData, int len);
+void receivePacket(const esp_now_recv_info_t *recv_info, const uint8_t *incomingData, int len);
+void OnDataSent(const uint8_t *mac_addr, esp_now_send_status_t status);
+bool espnowBegin();
+esp_err_t espnowSend(const uint8_t* mac, const uint8_t* data, size_t len);
+void espnowAddPeer(const uint8_t* mac);
+void espnowRemovePeer(const uint8_t* mac);
+#if TRANSPORT_UDP
+bool udpBegin();
+esp_err_t udpSend(const uint8_t* mac, const uint8_t* data, size_t len);
+void udpNoPeer(const uint8_t* mac);
+void udpPoll();
+#endif
+
 // =============================================================================
-// ESP-NOW CALLBACKS
+// TRANSPORT
 // =============================================================================
-void OnDataRecv(const esp_now_recv_info *recv_info, const uint8_t *incomingData, int len) {
-    // Verify sender MAC address for security
-    bool validSender = true;
-    for (int i = 0; i < 6; i++) {
-        if (recv_info->src_addr[i] != controllerAddress[i]) {
-            validSender = false;
+const transport_t espnowTransport = {
+    "ESP-NOW", espnowBegin, espnowSend, espnowAddPeer, espnowRemovePeer, nullptr
+};
+
+bool espnowBegin() {
+    if (esp_now_init() != ESP_OK) return false;
+    
+    esp_now_register_recv_cb(OnDataRecv);
+    esp_now_register_send_cb(OnDataSent);
+    return true;
+}
+
+esp_err_t espnowSend(const uint8_t* mac, const uint8_t* data, size_t len) {
+    return esp_now_send(mac, data, len);
+}
+
+void espnowAddPeer(const uint8_t* mac) {
+    if (esp_now_is_peer_exist(mac)) return;
+    
+    esp_now_peer_info_t peerInfo;
+    memset(&peerInfo, 0, sizeof(peerInfo));
+    memcpy(peerInfo.peer_addr, mac, 6);
+    peerInfo.channel = 1;
+    peerInfo.encrypt = false;
+    esp_now_add_peer(&peerInfo);
+}
+
+void espnowRemovePeer(const uint8_t* mac) {
+    esp_now_del_peer(mac);
+}
+
+#if TRANSPORT_UDP
+// Senders appear as locally administered MACs 02:55:<IPv4>, so the peer
+// table, pairing and arbitration work unchanged.
+typedef struct {
+    uint8_t mac[6];
+    IPAddress ip;
+    uint16_t port;
+} udp_endpoint_t;
+
+typedef struct {
+    uint8_t mac[6];
+    esp_now_send_status_t status;
+} udp_send_result_t;
+
+WiFiUDP udp;
+udp_endpoint_t udpEndpoints[UDP_MAX_ENDPOINTS];
+uint8_t udpEndpointCount = 0;
+uint8_t udpEndpointNext = 0;
+udp_send_result_t udpResults[8];          // Delivered to OnDataSent on the next poll
+uint8_t udpResultHead = 0, udpResultTail = 0;
+uint8_t udpOwnMac[6];
+uint8_t udpRxBuffer[ESP_NOW_MAX_DATA_LEN];
+
+const transport_t udpTransport = {
+    "UDP", udpBegin, udpSend, udpNoPeer, udpNoPeer, udpPoll
+};
+
+bool udpBegin() {
+    WiFi.mode(WIFI_STA);
+    WiFi.begin(UDP_WIFI_SSID, UDP_WIFI_PASSWORD);
+    unsigned long start = millis();
+    while (WiFi.status() != WL_CONNECTED) {
+        if (millis() - start > UDP_CONNECT_TIMEOUT_MS) return false;
+        delay(100);
+    }
+    WiFi.macAddress(udpOwnMac);
+    udp.begin(UDP_PORT);
+    
+    Serial.printf("  📍 UDP %s:%d\n", WiFi.localIP().toString().c_str(), UDP_PORT);
+    
+    // Load-test senders are new every run; let the first one in
+    pairingUntil = millis() + PAIRING_WINDOW_MS;
+    return true;
+}
+
+esp_err_t udpSend(const uint8_t* mac, const uint8_t* data, size_t len) {
+    bool sent = false;
+    if (memcmp(mac, broadcastAddress, 6) == 0) {
+        sent = udp.beginPacket(IPAddress(255, 255, 255, 255), UDP_PORT) &&
+               udp.write(data, len) == len && udp.endPacket();
+    } else {
+        for (uint8_t i = 0; i < udpEndpointCount; i++) {
+            if (memcmp(udpEndpoints[i].mac, mac, 6) != 0) continue;
+            sent = udp.beginPacket(udpEndpoints[i].ip, udpEndpoints[i].port) &&
+                   udp.write(data, len) == len && udp.endPacket();
             break;
         }
     }
     
-    if (!validSender) {
-        Serial.println("⚠️  Ignoring data from unknown sender");
-        return;
+    // No MAC-layer ack over UDP; a datagram handed to the stack counts as delivered
+    uint8_t next = (udpResultHead + 1) % 8;
+    if (next != udpResultTail) {
+        memcpy(udpResults[udpResultHead].mac, mac, 6);
+        udpResults[udpResultHead].status = sent ? ESP_NOW_SEND_SUCCESS : ESP_NOW_SEND_FAIL;
+        udpResultHead = next;
     }
+    return ESP_OK;
+}
 
-    if (len == sizeof(led_command_t)) {
-        memcpy((void*)&receivedCommand, incomingData, sizeof(receivedCommand));
-        newCommandReceived = true;
-        expectingResponse = false;
-        isConnected = true;
-        commandsReceived++;
-        
-        Serial.printf("📨 Command received: R:%d G:%d B:%d Effect:%d\n", 
-                     receivedCommand.red, receivedCommand.green, 
-                     receivedCommand.blue, receivedCommand.effect);
-    }
+void udpNoPeer(const uint8_t* mac) {
+}
 
-    if (len >= sizeof(serial_message_t)) {
-        serial_message_t serialMsg;
-        memcpy(&serialMsg, incomingData, sizeof(serialMsg));
+void udpPoll() {
+    while (udpResultTail != udpResultHead) {
+        udp_send_result_t& result = udpResults[udpResultTail];
+        udpResultTail = (udpResultTail + 1) % 8;
+        OnDataSent(result.mac, result.status);
+    }
+    
+    for (uint8_t n = 0; n < UDP_POLL_BUDGET; n++) {
+        int size = udp.parsePacket();
+        if (size <= 0) break;
+        int len = udp.read(udpRxBuffer, sizeof(udpRxBuffer));
+        if (len <= 0) continue;
         
-        if (serialMsg.requestType == 2) {  // It's serial data
-            
-            // Process the received serial data here
-            // For example, you could echo it to the local serial port:
-            Serial.write((uint8_t*)serialMsg.data, serialMsg.length);
-            Serial.println();
+        IPAddress ip = udp.remoteIP();
+        uint8_t mac[6] = {0x02, 0x55, ip[0], ip[1], ip[2], ip[3]};
+        
+        udp_endpoint_t* endpoint = nullptr;
+        for (uint8_t i = 0; i < udpEndpointCount && !endpoint; i++) {
+            if (memcmp(udpEndpoints[i].mac, mac, 6) == 0) endpoint = &udpEndpoints[i];
         }
+        if (!endpoint) {
+            endpoint = &udpEndpoints[udpEndpointNext];
+            udpEndpointNext = (udpEndpointNext + 1) % UDP_MAX_ENDPOINTS;
+            if (udpEndpointCount < UDP_MAX_ENDPOINTS) udpEndpointCount++;
+            memcpy(endpoint->mac, mac, 6);
+        }
+        endpoint->ip = ip;
+        endpoint->port = udp.remotePort();
+        
+        esp_now_recv_info_t info;
+        memset(&info, 0, sizeof(info));
+        info.src_addr = mac;
+        info.des_addr = udpOwnMac;
+        OnDataRecv(&info, udpRxBuffer, len);
+    }
+}
+
+const transport_t* transport = &udpTransport;
+#else
+const transport_t* transport = &espnowTransport;
+#endif
+
+// =============================================================================
+// ESP-NOW CALLBACKS
+// =============================================================================
+void OnDataRecv(const esp_now_recv_info *recv_info, const uint8_t *incomingData, int len) {
+    if (captureActive) capturePacket(recv_info, incomingData, len);
+    // A replay owns the receiver's state until it ends
+    if (replayActive) return;
+    receivePacket(recv_info, incomingData, len);
+}
+
+void receivePacket(const esp_now_recv_info *recv_info, const uint8_t *incomingData, int len) {
+    // Relayed packets come from other receivers; their origin is checked instead
+    if (len >= (int)(sizeof(wire_header_t) + sizeof(wire_record_t) + sizeof(relay_header_t)) &&
+        incomingData[0] == WIRE_VERSION_2 && incomingData[sizeof(wire_header_t)] == WIRE_REC_RELAY) {
+        handleRelayPacket(incomingData, len);
+        return;
+    }
+    
+    // Only paired controllers are heard; pairing mode admits the next new one
+    peer_t* peer = findPeer(recv_info->src_addr);
+    if (!peer) {
+        unknownSenders++;
+        if (pairingUntil && !pairingRequested) {
+            memcpy(pairingMac, recv_info->src_addr, 6);
+            pairingRequested = true;
+        }
+        return;
+    }
+    peer->packets++;
+    peer->lastSeenMs = millis();
+    rxPeer = peer;
+    rxArbitration = -1;
+    if (recv_info->rx_ctrl) {
+        lastRssi = recv_info->rx_ctrl->rssi;
+        noteLinkArrival(lastRssi);
+    }
+    
+    if (simulatedLossPct && (int)random(100) < simulatedLossPct) {
+        wireStats.simulatedDrops++;
+        return;
+    }
+    
+    if (len >= (int)sizeof(wire_header_t) && len != sizeof(led_command_t) &&
+        incomingData[0] == WIRE_VERSION_2) {
+        bool broadcast = recv_info->des_addr && memcmp(recv_info->des_addr, broadcastAddress, 6) == 0;
+        
+        // Group traffic straight from a controller seeds the relay flood
+        if (broadcast) {
+            uint32_t key = relayKeyOf(peer->record.mac, incomingData, len);
+            uint16_t seq = ((const wire_header_t*)incomingData)->seq;
+            if (noteRelaySeen(key, seq)) {
+                relayStats.received[0]++;
+                dispatchWirePacket(incomingData, len, broadcast);
+                if (relayEnabled && !replayActive && wireTargetGroup(incomingData, len) != GROUP_DIRECT) {
+                    queueRelay(peer->record.mac, relayTtl, 0, 0, incomingData, len);
+                }
+            } else {
+                relayStats.duplicates++;
+            }
+            return;
+        }
+        dispatchWirePacket(incomingData, len, broadcast);
+        return;
+    }
+    
+    // Legacy formats, told apart by length
+    if (len == sizeof(led_command_t)) {
+        // The whole wall follows a legacy command
+        const led_command_t* command = (const led_command_t*)incomingData;
+        wireStats.legacyPackets++;
+        if (!peerMayCommand()) return;
+        queueZoneCommand(ZONE_ALL, command);
+        noteCommandReceived();
+        
+        Serial.printf("📨 Command received: R:%d G:%d B:%d Effect:%d\n", 
+                     command->red, command->green, 
+                     command->blue, command->effect);
+    }
+    else if (len >= (int)sizeof(serial_message_t) && incomingData[0] == 2) {
+        const serial_message_t* serialMsg = (const serial_message_t*)incomingData;
+        handleSerialPassthrough((const uint8_t*)serialMsg->data,
+                                min<uint8_t>(serialMsg->length, sizeof(serialMsg->data)));
+        wireStats.legacyPackets++;
+    }
+    else {
+        wireStats.malformed++;
     }
 }
 
+// A unicast send that the controller's radio did not ack is the disconnect
+// signal; replies at the application layer are no longer needed for it.
 void OnDataSent(const uint8_t *mac_addr, esp_now_send_status_t status) {
+    uint8_t kind = SEND_OTHER;
+    if (sendKindTail != sendKindHead) {
+        kind = sendKinds[sendKindTail];
+        sendKindTail = (sendKindTail + 1) % sizeof(sendKinds);
+    }
+    
+    if (memcmp(mac_addr, broadcastAddress, 6) != 0) {
+        noteLinkSend(status == ESP_NOW_SEND_SUCCESS);
+    }
+    
+    if (status == ESP_NOW_SEND_SUCCESS) {
+        consecutiveSendFailures = 0;
+        if (stateSyncActive) isConnected = true;
+    } else {
+        stateStats.sendFailures++;
+        if (consecutiveSendFailures < 255) consecutiveSendFailures++;
+        if (consecutiveSendFailures >= STATE_LINK_FAILURES) isConnected = false;
+    }
+    
+    if (kind == SEND_STATE_ACK && status != ESP_NOW_SEND_SUCCESS) {
+        nextAckRetryMs = millis() + linkRetryDelayMs();
+        stateAckPending = true;
+    }
+    if (kind != SEND_COLOR_REQUEST) return;
+    
     if (status == ESP_NOW_SEND_SUCCESS) {
         Serial.println("✅ Request sent successfully");
         expectingResponse = true;
@@ -192,364 +2080,5831 @@ void OnDataSent(const uint8_t *mac_addr, esp_now_send_status_t status) {
 // INITIALIZATION FUNCTIONS
 // =============================================================================
 void setup() {
+    loopTask = xTaskGetCurrentTaskHandle();
+    Serial.setRxBufferSize(SERIAL_RX_BUFFER_SIZE);
     Serial.begin(SERIAL_BAUD_RATE);
-    delay(1000);
+    serialInput.baud = SERIAL_BAUD_RATE;
     
     Serial.println("\n" + repeat("=", 60));
     Serial.println("🚀 ESP-NOW LED RECEIVER - Enhanced Version");
     Serial.println(repeat("=", 60));
     
+    // The last scene is up before anything slow; the radio starts in its
+    // own task while the loop is already rendering
     initializeHardware();
-    initializeESPNOW();
-    bootSequence();
+    restoreScene();
+    updateLEDEffects();
+    sceneStats.firstFrameUs = esp_timer_get_time();
+    Serial.printf("💡 First frame %lu ms after boot (%s)\n", (unsigned long)(sceneStats.firstFrameUs / 1000),
+                  sceneRestored ? "saved scene" : "defaults");
+    
+    loadPeers();
+    if (xTaskCreatePinnedToCore(transportInitTask, "transport", TRANSPORT_INIT_STACK, nullptr, 1,
+                                &transportTask, 0) != pdPASS) {
+        transportDone = true;   // The loop reports it as a failed transport
+    }
+    serialBridgeBegin();
+    
+    // Nothing saved yet, so no scene to keep: run the test pattern instead
+    if (!sceneRestored) bootSequence();
+    sceneStats.setupDoneUs = esp_timer_get_time();
     
     Serial.println("✅ System ready! Type 'help' for commands\n");
+    
+#if SERIAL_BINARY_AT_BOOT
+    setSerialBinary(true, SERIAL_BINARY_BAUD);
+#endif
+}
+
+void initializeHardware() {
+    Serial.println("🔧 Initializing hardware...");
+    
+    // Configure ESP-NOW log levels
+    esp_log_level_set("wifi", ESP_LOG_WARN);
+    esp_log_level_set("esp_now", ESP_LOG_WARN);
+    
+    // Initialize FastLED
+    initializeOutputs();
+    FastLED.setBrightness(50);
+    FastLED.clear();
+    FastLED.show();
+    
+#if LED_WHITE_CHANNEL
+    FastLED.setDither(0);  // Temporal dithering would straddle packed pixels
+#endif
+    
+    Serial.printf("  ✓ FastLED initialized (%d output channel%s, %s)\n",
+                  outputChannelCount, outputChannelCount == 1 ? "" : "s",
+                  LED_WHITE_CHANNEL ? "RGBW" : "RGB");
+    
+    initializeZones();
+    loadLayout();
+    Serial.printf("  ✓ LED matrix configured (%dx%d)\n", matrixWidth, matrixHeight);
+    loadTriggers();
+}
+
+bool initializeTransport() {
+    Serial.printf("📡 Initializing %s...\n", transport->name);
+    
+    WiFi.mode(WIFI_STA);
+    delay(100);
+    
+    Serial.printf("  📍 MAC Address: %s\n", WiFi.macAddress().c_str());
+    return transport->begin();
+}
+
+// Radio bring-up off the loop: ESP-NOW takes a few hundred ms, a UDP build
+// may spend seconds joining the network. Only the radio is touched here;
+// the loop does the rest once transportDone is set.
+void transportInitTask(void*) {
+    transportOk = initializeTransport();
+#if PIXEL_INPUT_UDP
+    pixelInputOk = pixelInputBegin();
+#endif
+    transportDone = true;
+    xTaskNotifyGive(loopTask);
+    vTaskDelete(nullptr);
+}
+
+void finishTransportInit() {
+    transportReady = true;
+    sceneStats.radioReadyUs = esp_timer_get_time();
+    
+    if (!transportOk) {
+        showError("Transport initialization failed!");
+    } else {
+        setupPeerConnection();
+        Serial.printf("  ✅ %s ready %lu ms after boot\n", transport->name,
+                      (unsigned long)(sceneStats.radioReadyUs / 1000));
+    }
+#if PIXEL_INPUT_UDP
+    if (!pixelInputOk) showError("Pixel input: WiFi connect failed!");
+#endif
+}
+
+// The peer table is loaded before the radio is up; this registers it,
+// plus the broadcast peer, with the transport and reports what's there.
+void setupPeerConnection() {
+    // Relays and previews go out as broadcasts
+    transport->addPeer(broadcastAddress);
+    
+    for (uint8_t i = 0; i < peerCount; i++) {
+        const uint8_t* mac = peers[i].record.mac;
+        transport->addPeer(mac);
+        Serial.printf("  ✅ Controller peer added: %02X:%02X:%02X:%02X:%02X:%02X (priority %d)\n",
+                      mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], peers[i].record.priority);
+    }
+    if (peerCount) setActivePeer(0);
+}
+
+// =============================================================================
+// MAIN LOOP
+// =============================================================================
+void loop() {
+    unsigned long passStart = micros();
+    
+    if (replayActive) {
+        // Radio and the usual services wait; the replay runs its own ticks
+        handleSerialCommands();
+        serviceReplay();
+        delay(1);
+        return;
+    }
+    
+    if (!transportReady) {
+        if (!transportDone) {
+            // Keep the restored scene running; serial commands wait too,
+            // since several of them use the transport
+            processReceivedCommand();
+            updateLEDEffects();
+            noteLoopPass(passStart);
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(5));
+            return;
+        }
+        finishTransportInit();
+    }
+    
+    if (transport->poll) transport->poll();
+#if PIXEL_INPUT_UDP
+    servicePixelInput();
+#endif
+    handleSerialCommands();
+    servicePeers();
+    serviceSerialBridge();
+    serviceRelay();
+    serviceOta();
+    serviceTelemetry();
+    serviceLinkWindow();
+    serviceTimeSync();
+    processReceivedCommand();
+    serviceFrameStream();
+    serviceTriggers();
+    updateLEDEffects();
+    servicePreview();
+    serviceCapture();
+    serviceScene();
+    
+    serviceStateSync();
+    
+    // Handle response timeout
+    if (expectingResponse && millis() > responseTimeout) {
+        expectingResponse = false;
+        isConnected = false;
+        Serial.println("⏰ Response timeout - controller may be offline");
+    }
+    
+    // Legacy heartbeat polling, replaced by state acks once versions arrive
+    if (!stateSyncActive && millis() - lastHeartbeat > HEARTBEAT_INTERVAL_MS) {
+        if (!expectingResponse) {
+            Serial.println("💓 Sending heartbeat request...");
+            sendColorRequest();
+        }
+        lastHeartbeat = millis();
+    }
+    
+    noteLoopPass(passStart);
+    
+    // Same pace as delay(5), but a trigger cuts the wait short
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(5));
+}
+
+// =============================================================================
+// COMMAND PROCESSING
+// =============================================================================
+// Takes what the UART has and runs each command once its line is complete;
+// a terminal that sends half a line never holds up the loop
+void handleSerialCommands() {
+    if (serialInput.binary) {
+        serviceSerialInput();
+        return;
+    }
+    
+    int available = Serial.available();
+    while (available-- > 0) {
+        int c = Serial.read();
+        if (c < 0) break;
+        
+        if (c != '\n' && c != '\r') {
+            if (commandLength < SERIAL_COMMAND_MAX - 1) {
+                commandLine[commandLength++] = c;
+            } else {
+                commandTooLong = true;
+            }
+            continue;
+        }
+        if (commandTooLong) {
+            Serial.printf("❌ Command longer than %d characters ignored\n", SERIAL_COMMAND_MAX - 1);
+        } else if (commandLength) {
+            commandLine[commandLength] = '\0';
+            commandLength = 0;
+            runCommand(String(commandLine));
+            // 'binary' hands the bytes after it to the frame parser
+            if (serialInput.binary) return;
+        }
+        commandLength = 0;
+        commandTooLong = false;
+    }
+}
+
+void runCommand(String command) {
+    command.trim();
+    command.toLowerCase();
+    
+    if (command.length() == 0) return;
+    
+    Serial.println("📝 Command: " + command);
+    
+    if (command == "request" || command == "r") {
+        sendColorRequest();
+    } 
+    else if (command == "status" || command == "s") {
+        printStatus();
+    }
+    else if (command == "diag" || command == "d") {
+        printDiagnostics();
+    }
+    else if (command == "test" || command == "t") {
+        bootSequence();
+    }
+    else if (command == "clear" || command == "c") {
+        preemptStatusAnimation();
+        FastLED.clear();
+        showImmediate();
+        Serial.println("🔄 LEDs cleared");
+    }
+    else if (command == "layout" || command.startsWith("layout ")) {
+        handleLayoutCommand(command.length() > 7 ? command.substring(7) : String(""));
+    }
+    else if (command == "outputs" || command.startsWith("outputs ")) {
+        handleOutputsCommand(command.length() > 8 ? command.substring(8) : String(""));
+    }
+    else if (command == "groups" || command.startsWith("group ")) {
+        handleGroupCommand(command.startsWith("group ") ? command.substring(6) : String(""));
+    }
+    else if (command == "time") {
+        printTimeSync();
+    }
+    else if (command == "live" || command.startsWith("live ")) {
+        handleLiveCommand(command.length() > 5 ? command.substring(5) : String(""));
+    }
+    else if (command == "trigger" || command == "triggers" || command.startsWith("trigger ")) {
+        handleTriggerCommand(command.startsWith("trigger ") ? command.substring(8) : String(""));
+    }
+    else if (command == "capture" || command.startsWith("capture ")) {
+        handleCaptureCommand(command.length() > 8 ? command.substring(8) : String(""));
+    }
+    else if (command == "link") {
+        printLinkStats();
+    }
+    else if (command == "telemetry") {
+        printTelemetry();
+    }
+    else if (command == "preview" || command.startsWith("preview ")) {
+        handlePreviewCommand(command.length() > 8 ? command.substring(8) : String(""));
+    }
+    else if (command == "ota" || command == "ota abort") {
+        handleOtaCommand(command.substring(3));
+    }
+    else if (command == "relay" || command.startsWith("relay ")) {
+        handleRelayCommand(command.length() > 6 ? command.substring(6) : String(""));
+    }
+    else if (command == "peers" || command == "pair" || command.startsWith("unpair ") ||
+             command.startsWith("peer ")) {
+        handlePeerCommand(command);
+    }
+    else if (command == "state") {
+        printStateSync();
+    }
+    else if (command.startsWith("loss ")) {
+        handleLossCommand(command.substring(5));
+    }
+    else if (command == "stream") {
+        printStreamStats();
+    }
+    else if (command == "binary" || command.startsWith("binary ")) {
+        long baud = command.length() > 7 ? command.substring(7).toInt() : SERIAL_BINARY_BAUD;
+        if (baud < 9600) {
+            Serial.println("❌ Baud must be at least 9600");
+        } else {
+            setSerialBinary(true, baud);
+        }
+    }
+    else if (command == "text") {
+        setSerialBinary(false, SERIAL_BAUD_RATE);
+    }
+    else if (command == "serial") {
+        printSerialInput();
+    }
+    else if (command == "pixels") {
+        printPixelInput();
+    }
+    else if (command == "bridge") {
+        printSerialBridge();
+    }
+    else if (command == "help" || command == "h") {
+        printHelp();
+    }
+    else if (command.startsWith("bright ")) {
+        int brightness = command.substring(7).toInt();
+        if (brightness >= 1 && brightness <= 100) {
+            for (uint8_t z = 0; z < MAX_ZONES; z++) {
+                zones[z].brightness = brightness;
+                zoneScale[z] = map(brightness, 1, 100, 0, 255);
+            }
+            Serial.printf("☀️  Brightness set to %d%%\n", brightness);
+        } else {
+            Serial.println("❌ Brightness must be 1-100");
+        }
+    }
+    else if (command.startsWith("effect ")) {
+        int effect = command.substring(7).toInt();
+        if (effect >= 0 && effect <= EFFECT_MAX) {
+            for (uint8_t z = 0; z < MAX_ZONES; z++) {
+                zones[z].effect = effect;
+            }
+            Serial.printf("✨ Effect set to %d\n", effect);
+        } else {
+            Serial.println("❌ Effect must be 0-7");
+        }
+    }
+    else if (command == "scene" || command.startsWith("scene ")) {
+        handleSceneCommand(command.length() > 6 ? command.substring(6) : String(""));
+    }
+    else if (command == "zones" || command.startsWith("zone ") || command.startsWith("zones ")) {
+        int space = command.indexOf(' ');
+        handleZoneCommand(space > 0 ? command.substring(space + 1) : String(""));
+    }
+    else {
+        Serial.println("❓ Unknown command. Type 'help' for available commands.");
+    }
+}
+
+// Commands scheduled with an apply-at time stay pending until the shared
+// clock reaches it, so every receiver switches on the same frame.
+void processReceivedCommand() {
+    if (!pendingZoneMask) return;
+    
+    led_command_t commands[MAX_ZONES];
+    uint32_t applyAt[MAX_ZONES];
+    uint8_t mask = 0;
+    uint32_t now = effectMillis();
+    
+    portENTER_CRITICAL(&commandMux);
+    for (uint8_t z = 0; z < MAX_ZONES; z++) {
+        if (!(pendingZoneMask & (1 << z))) continue;
+        int32_t wait = (int32_t)(pendingApplyAt[z] - now);
+        if (pendingApplyAt[z] != 0 && wait > 0 && wait < APPLY_AT_MAX_AHEAD_MS) continue;
+        commands[z] = pendingCommands[z];
+        applyAt[z] = pendingApplyAt[z];
+        mask |= (1 << z);
+    }
+    pendingZoneMask &= ~mask;
+    portEXIT_CRITICAL(&commandMux);
+    
+    if (mask) preemptStatusAnimation();
+    for (uint8_t z = 0; z < MAX_ZONES; z++) {
+        if (mask & (1 << z)) {
+            applyZoneCommand(zones[z], commands[z]);
+            if (applyAt[z] != 0) zones[z].effectEpoch = applyAt[z];
+            Serial.printf("🎨 Zone %d: Color(%d,%d,%d) Effect:%d Speed:%d Brightness:%d%%\n",
+                         z, zones[z].color.r, zones[z].color.g, zones[z].color.b,
+                         zones[z].effect, zones[z].speed, zones[z].brightness);
+        }
+    }
+}
+
+// Renders each zone that is due into the shared frame; pixels of zones that
+// are not due keep their previous content.
+void updateLEDEffects() {
+    bool rendered = false;
+    unsigned long renderStart = micros();
+    
+    if (serviceStatusAnimation()) return;
+    
+    if (streamModeActive) {
+        // Streamed frames replace every zone until the stream goes idle
+        if (takeStreamFrame()) {
+            memcpy(frame, streamBuffers[streamDisplayIdx], logicalLedCount * 3);
+            rendered = true;
+        }
+    }
+    else for (uint8_t z = 0; z < MAX_ZONES; z++) {
+        led_zone_t& zone = zones[z];
+        if (!zone.active) continue;
+        bool live = liveTracks[z].active;
+        uint16_t interval = live ? min<uint16_t>(zone.frameIntervalMs, LIVE_FRAME_MS) : zone.frameIntervalMs;
+        // 0 means due now, also in the first interval after boot
+        if (zone.lastRenderTime && renderMillis() - zone.lastRenderTime < interval) continue;
+        
+        zone.lastRenderTime = renderMillis();
+        if (live) applyLiveParameters(z);
+        applyEffect(zone);
+        rendered = true;
+    }
+    
+    // Overlays need the output pass even when no zone was due
+    if (!rendered && !overlayFrameDue) return;
+    
+    lastLedUpdateTime = renderMillis();
+    FastLED.setBrightness(MASTER_BRIGHTNESS);
+    renderToOutput();
+    recordTiming(renderTiming, micros() - renderStart);
+    if (replayActive) noteReplayFrame();
+    showFrame();
+    if (overlayFrameDue) noteOverlaysShown();
+}
+
+// =============================================================================
+// LED EFFECTS
+// =============================================================================
+void applyEffect(led_zone_t& zone) {
+    switch (zone.effect) {
+        case 0: effectSolid(zone); break;
+        case 1: effectRainbow(zone); break;
+        case 2: effectFade(zone); break;
+        case 3: effectStrobe(zone); break;
+        case 4: effectPulse(zone); break;
+        case 5: effectSparkle(zone); break;
+        case 6: effectWave(zone); break;
+        case EFFECT_STREAM: effectStream(zone); break;
+        default: effectSolid(zone); break;
+    }
+}
+
+void effectSolid(led_zone_t& zone) {
+    CRGB adjustedColor = applyWhiteMix(zone.whiteMix, zone.color);
+    fillZone(zone, adjustedColor);
+}
+
+void effectRainbow(led_zone_t& zone) {
+    uint16_t speedFactor = map(zone.speed, 1, 100, 200, 20);
+    uint8_t hueOffset = (effectMillis() / speedFactor) % 256;
+    
+    zone_cursor_t c;
+    for (zoneCursorBegin(zone, c); c.ordinal < zone.pixelCount; zoneCursorNext(zone, c)) {
+        CRGB rainbowColor = CHSV(hueOffset + (c.ordinal * 256 / zone.pixelCount), 255, 255);
+        frame[c.index] = applyWhiteMix(zone.whiteMix, rainbowColor);
+    }
+}
+
+// Fade and strobe derive their phase from the effect epoch on the shared
+// clock, so receivers that started together stay in step.
+void effectFade(led_zone_t& zone) {
+    unsigned long fadeDuration = map(zone.speed, 1, 100, 3000, 300);
+    unsigned long elapsed = effectMillis() - zone.effectEpoch;
+    
+    zone.fadingIn = ((elapsed / fadeDuration) & 1) == 0;
+    elapsed %= fadeDuration;
+    
+    CRGB adjustedColor = applyWhiteMix(zone.whiteMix, zone.color);
+    CRGB fadeStartColor = zone.fadingIn ? CRGB::Black : adjustedColor;
+    CRGB fadeTargetColor = zone.fadingIn ? adjustedColor : CRGB::Black;
+    
+    float progress = constrain((float)elapsed / fadeDuration, 0.0, 1.0);
+    // Use sine wave for smoother easing
+    progress = (sin(progress * PI - PI/2) + 1.0) / 2.0;
+    
+    CRGB interpolatedColor = blend(fadeStartColor, fadeTargetColor, (uint8_t)(progress * 255));
+    fillZone(zone, interpolatedColor);
+}
+
+void effectStrobe(led_zone_t& zone) {
+    unsigned long strobeDelay = map(zone.speed, 1, 100, 800, 30);
+    zone.strobeState = (((effectMillis() - zone.effectEpoch) / strobeDelay) & 1) == 0;
+    
+    CRGB strobeColor = zone.strobeState ? 
+                      applyWhiteMix(zone.whiteMix, zone.color) : 
+                      CRGB::Black;
+    fillZone(zone, strobeColor);
+}
+
+void effectPulse(led_zone_t& zone) {
+    unsigned long pulsePeriod = map(zone.speed, 1, 100, 4000, 400);
+    zone.pulsePhase = (float)(effectMillis() % pulsePeriod) / pulsePeriod * TWO_PI;
+    float brightnessFactor = (sin(zone.pulsePhase) + 1.0) / 2.0;
+    
+    // Apply smooth cubic easing
+    brightnessFactor = brightnessFactor * brightnessFactor * (3.0 - 2.0 * brightnessFactor);
+    
+    CRGB baseColor = applyWhiteMix(zone.whiteMix, zone.color);
+    CRGB pulsedColor = baseColor;
+    pulsedColor.nscale8_video(brightnessFactor * 255);
+    fillZone(zone, pulsedColor);
+}
+
+void effectSparkle(led_zone_t& zone) {
+    // Fade existing sparkles
+    zone_cursor_t c;
+    for (zoneCursorBegin(zone, c); c.ordinal < zone.pixelCount; zoneCursorNext(zone, c)) {
+        frame[c.index].nscale8(240); // Fade by ~6%
+    }
+    
+    // Add new sparkles based on speed
+    int sparkleCount = map(zone.speed, 1, 100, 1, 8);
+    CRGB sparkleColor = applyWhiteMix(zone.whiteMix, zone.color);
+    
+    for (int i = 0; i < sparkleCount; i++) {
+        if (random(100) < 30) { // 30% chance per sparkle
+            int pos = zonePixelAt(zone, random(zone.pixelCount));
+            frame[pos] = sparkleColor;
+        }
+    }
+}
+
+void effectWave(led_zone_t& zone) {
+    unsigned long waveSpeed = map(zone.speed, 1, 100, 100, 10);
+    float timeOffset = (float)(effectMillis() % (waveSpeed * 6283UL)) / waveSpeed;
+    
+    CRGB waveColor = applyWhiteMix(zone.whiteMix, zone.color);
+    
+    zone_cursor_t c;
+    for (zoneCursorBegin(zone, c); c.ordinal < zone.pixelCount; zoneCursorNext(zone, c)) {
+        float wave1 = sin((c.x * 0.3) + timeOffset);
+        float wave2 = sin((c.y * 0.5) + timeOffset * 1.2);
+        float brightness = (wave1 + wave2 + 2.0) / 4.0; // Normalize to 0-1
+        
+        CRGB pixelColor = waveColor;
+        pixelColor.nscale8_video(brightness * 255);
+        frame[c.index] = pixelColor;
+    }
+}
+
+// Shows the zone's region of the latest streamed frame
+void effectStream(led_zone_t& zone) {
+    takeStreamFrame();
+    const CRGB* streamed = (const CRGB*)streamBuffers[streamDisplayIdx];
+    
+    zone_cursor_t c;
+    for (zoneCursorBegin(zone, c); c.ordinal < zone.pixelCount; zoneCursorNext(zone, c)) {
+        frame[c.index] = streamed[c.index];
+    }
+}
+
+// =============================================================================
+// UTILITY FUNCTIONS
+// =============================================================================
+// Precompute the white/warm-white mix once per command instead of per pixel
+void updateWhiteMix(white_mix_t& mix, uint8_t white, uint8_t warmWhite) {
+    mix.white = white;
+    mix.warmAmount = warmWhite >> 2; // Subtle warm blend
+    mix.warmColor = CRGB(255, map(warmWhite, 0, 255, 120, 255), 20);
+}
+
+// Higher white = less saturation: each channel moves toward the brightest
+// one, which keeps the value of the HSV desaturation without the round trip.
+CRGB applyWhiteMix(const white_mix_t& mix, CRGB color) {
+    if (mix.white > 0) {
+        uint8_t peak = max(color.r, max(color.g, color.b));
+        color.r += scale8(peak - color.r, mix.white);
+        color.g += scale8(peak - color.g, mix.white);
+        color.b += scale8(peak - color.b, mix.white);
+    }
+    
+    if (mix.warmAmount > 0) {
+        color = blend(color, mix.warmColor, mix.warmAmount);
+    }
+    
+    return color;
+}
+
+// Move as much light as possible onto the white LED, measured against the
+// white point so the remaining RGB corrects the strip's color temperature.
+rgbw_pixel_t extractWhite(CRGB color) {
+    uint16_t wr = (uint16_t)color.r * 255 / WHITE_POINT_R;
+    uint16_t wg = (uint16_t)color.g * 255 / WHITE_POINT_G;
+    uint16_t wb = (uint16_t)color.b * 255 / WHITE_POINT_B;
+    uint8_t w = min<uint16_t>(255, min(wr, min(wg, wb)));
+    
+    rgbw_pixel_t px;
+    px.raw[RGBW_ORDER_R] = color.r - scale8(w, WHITE_POINT_R);
+    px.raw[RGBW_ORDER_G] = color.g - scale8(w, WHITE_POINT_G);
+    px.raw[RGBW_ORDER_B] = color.b - scale8(w, WHITE_POINT_B);
+    px.raw[RGBW_ORDER_W] = w;
+    return px;
+}
+
+int16_t getMatrixIndex(int16_t x, int16_t y) {
+    if (x < 0 || x >= matrixWidth || y < 0 || y >= matrixHeight) return -1;
+    
+    // Logical row-major; wiring is resolved once per frame in renderToOutput()
+    return y * matrixWidth + x;
+}
+
+void sendColorRequest() {
+    if (expectingResponse) {
+        Serial.println("⏳ Already waiting for response...");
+        return;
+    }
+    
+    color_request_t request = {1, 1}; // requestType=1, fromReceiver=1
+    
+    Serial.println("📤 Sending color request...");
+    esp_err_t result = sendToController((uint8_t*)&request, sizeof(request), SEND_COLOR_REQUEST);
+    
+    if (result == ESP_OK) {
+        requestsSent++;
+        Serial.println("✅ Request queued successfully");
+    } else {
+        Serial.printf("❌ Request failed: 0x%X\n", result);
+    }
+}
+
+// =============================================================================
+// MATRIX GEOMETRY
+// =============================================================================
+// Compiles matrixLayout into pixelMap[]. Logical (x, y) is first un-mirrored,
+// then un-rotated onto the physical wall, then resolved to a panel in the
+// chain and a position inside that panel.
+bool rebuildPixelMap() {
+    const matrix_layout_t& l = matrixLayout;
+    uint16_t physWidth = l.panelWidth * l.tilesX;
+    uint16_t physHeight = l.panelHeight * l.tilesY;
+    uint32_t total = (uint32_t)physWidth * physHeight;
+    
+    if (total == 0 || total > NUM_LEDS) {
+        Serial.printf("❌ Layout needs %lu LEDs, capacity is %d\n", (unsigned long)total, NUM_LEDS);
+        return false;
+    }
+    
+    bool swapAxes = l.rotation & 1;
+    matrixWidth = swapAxes ? physHeight : physWidth;
+    matrixHeight = swapAxes ? physWidth : physHeight;
+    logicalLedCount = total;
+    physicalLedCount = total;
+    customLayoutActive = false;
+    
+    uint16_t panelSize = l.panelWidth * l.panelHeight;
+    
+    for (uint16_t y = 0; y < matrixHeight; y++) {
+        for (uint16_t x = 0; x < matrixWidth; x++) {
+            uint16_t mx = (l.mirror & LAYOUT_MIRROR_X) ? matrixWidth - 1 - x : x;
+            uint16_t my = (l.mirror & LAYOUT_MIRROR_Y) ? matrixHeight - 1 - y : y;
+            
+            uint16_t px, py;
+            switch (l.rotation & 3) {
+                case 1:  px = my;                  py = physHeight - 1 - mx; break;
+                case 2:  px = physWidth - 1 - mx;  py = physHeight - 1 - my; break;
+                case 3:  px = physWidth - 1 - my;  py = mx;                  break;
+                default: px = mx;                  py = my;                  break;
+            }
+            
+            uint16_t tileX = px / l.panelWidth;
+            uint16_t tileY = py / l.panelHeight;
+            uint16_t localX = px % l.panelWidth;
+            uint16_t localY = py % l.panelHeight;
+            
+            if (l.tileSerpentine && (tileY & 1)) tileX = l.tilesX - 1 - tileX;
+            if (l.serpentine && (localY & 1)) localX = l.panelWidth - 1 - localX;
+            
+            uint16_t tileIndex = tileY * l.tilesX + tileX;
+            pixelMap[y * matrixWidth + x] = tileIndex * panelSize + localY * l.panelWidth + localX;
+        }
+    }
+    
+    fill_solid(frame, NUM_LEDS, CRGB::Black);
+    fill_solid(leds, NUM_LEDS, CRGB::Black);
+    splitOutputSegments();
+    resetZones();
+    return true;
+}
+
+// Non-rectangular installs: coords[i] is the logical (x, y) of physical LED i.
+// The logical canvas becomes the bounding box; cells without an LED are skipped.
+bool buildCustomLayout(const uint8_t (*coords)[2], uint16_t count) {
+    if (count == 0 || count > NUM_LEDS) return false;
+    
+    uint16_t width = 0, height = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        width = max<uint16_t>(width, coords[i][0] + 1);
+        height = max<uint16_t>(height, coords[i][1] + 1);
+    }
+    
+    if ((uint32_t)width * height > NUM_LEDS) {
+        Serial.printf("❌ Custom layout bounding box %dx%d exceeds capacity\n", width, height);
+        return false;
+    }
+    
+    // Two LEDs on one cell would leave the first one dark for good
+    uint8_t taken[(NUM_LEDS + 7) / 8] = {0};
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t cell = coords[i][1] * width + coords[i][0];
+        if (taken[cell / 8] & (1 << (cell % 8))) {
+            Serial.printf("❌ LED %d repeats (%d,%d)\n", i, coords[i][0], coords[i][1]);
+            return false;
+        }
+        taken[cell / 8] |= 1 << (cell % 8);
+    }
+    
+    if (coords != customCoords) memcpy(customCoords, coords, count * 2);
+    matrixWidth = width;
+    matrixHeight = height;
+    logicalLedCount = width * height;
+    physicalLedCount = count;
+    customLayoutActive = true;
+    
+    for (uint16_t i = 0; i < logicalLedCount; i++) {
+        pixelMap[i] = LAYOUT_UNMAPPED;
+    }
+    for (uint16_t i = 0; i < count; i++) {
+        pixelMap[coords[i][1] * width + coords[i][0]] = i;
+    }
+    
+    fill_solid(frame, NUM_LEDS, CRGB::Black);
+    fill_solid(leds, NUM_LEDS, CRGB::Black);
+    splitOutputSegments();
+    resetZones();
+    return true;
+}
+
+// Single remap pass from the logical frame to the wired order, applying
+// each zone's brightness on the way
+void renderToOutput() {
+    for (uint16_t i = 0; i < logicalLedCount; i++) {
+        uint16_t p = pixelMap[i];
+        if (p == LAYOUT_UNMAPPED) continue;
+        
+        uint8_t z = zoneOf[i];
+        if (z == ZONE_NONE) {
+            leds[p] = CRGB::Black;
+            continue;
+        }
+        
+        leds[p] = frame[i];
+        leds[p].nscale8_video(zoneScale[z]);
+        if (overlayCount) compositeOverlays(i, z, leds[p]);
+    }
+}
+
+void handleLayoutCommand(String args) {
+    matrix_layout_t previous = matrixLayout;
+    
+    if (args.length() == 0) {
+        printLayout();
+        return;
+    }
+    else if (args == "map" || args.startsWith("map ")) {
+        handleLayoutMapCommand(args.length() > 4 ? args.substring(4) : String(""));
+        return;
+    }
+    else if (args == "serp") {
+        matrixLayout.serpentine = 1;
+    }
+    else if (args == "prog") {
+        matrixLayout.serpentine = 0;
+    }
+    else if (args.startsWith("rot ")) {
+        int quarterTurns = args.substring(4).toInt();
+        if (quarterTurns < 0 || quarterTurns > 3) {
+            Serial.println("❌ Rotation must be 0-3 (quarter turns clockwise)");
+            return;
+        }
+        matrixLayout.rotation = quarterTurns;
+    }
+    else if (args.startsWith("mirror ")) {
+        String axes = args.substring(7);
+        if (axes == "none")      matrixLayout.mirror = 0;
+        else if (axes == "x")    matrixLayout.mirror = LAYOUT_MIRROR_X;
+        else if (axes == "y")    matrixLayout.mirror = LAYOUT_MIRROR_Y;
+        else if (axes == "xy")   matrixLayout.mirror = LAYOUT_MIRROR_X | LAYOUT_MIRROR_Y;
+        else {
+            Serial.println("❌ Mirror must be none, x, y or xy");
+            return;
+        }
+    }
+    else if (args.startsWith("tiles ")) {
+        String rest = args.substring(6);
+        int space = rest.indexOf(' ');
+        int cols = rest.toInt();
+        int rows = space > 0 ? rest.substring(space + 1).toInt() : 1;
+        if (cols < 1 || cols > 255 || rows < 1 || rows > 255) {
+            Serial.println("❌ Usage: layout tiles <cols> <rows> [serp], 1-255 each");
+            return;
+        }
+        matrixLayout.tilesX = cols;
+        matrixLayout.tilesY = rows;
+        matrixLayout.tileSerpentine = rest.endsWith("serp") ? 1 : 0;
+    }
+    else {
+        int space = args.indexOf(' ');
+        int width = args.toInt();
+        int height = space > 0 ? args.substring(space + 1).toInt() : 0;
+        if (width < 1 || width > 255 || height < 1 || height > 255) {
+            Serial.println("❌ Usage: layout <w> <h> | serp | prog | rot <0-3> | mirror <none|x|y|xy> | tiles <c> <r> [serp]");
+            return;
+        }
+        matrixLayout.panelWidth = width;
+        matrixLayout.panelHeight = height;
+    }
+    
+    // A rejected geometry changed nothing but matrixLayout; the pixel map,
+    // zones and picture are still the previous layout's
+    if (!rebuildPixelMap()) {
+        matrixLayout = previous;
+        return;
+    }
+    saveLayout();
+    printLayout();
+}
+
+// layout map begin            - start a coordinate list, nothing changes yet
+// layout map <x> <y> [...]    - append LEDs in wiring order
+// layout map end              - compile the list and make it the layout
+void handleLayoutMapCommand(String args) {
+    if (args == "begin") {
+        stagedCoordCount = 0;
+        layoutMapOpen = true;
+        Serial.println("🧩 Coordinate list started; add LEDs with 'layout map <x> <y> ...'");
+        return;
+    }
+    if (!layoutMapOpen) {
+        Serial.println("❌ Start with 'layout map begin'");
+        return;
+    }
+    if (args == "end") {
+        layoutMapOpen = false;
+        if (!buildCustomLayout(stagedCoords, stagedCoordCount)) {
+            Serial.printf("❌ Coordinate list of %d LEDs rejected, layout unchanged\n", stagedCoordCount);
+            return;
+        }
+        saveLayout();
+        printLayout();
+        return;
+    }
+    
+    // Pairs of numbers; a bad line adds nothing
+    int values[2];
+    uint8_t have = 0;
+    uint16_t before = stagedCoordCount;
+    int pos = 0;
+    while (pos < (int)args.length()) {
+        int space = args.indexOf(' ', pos);
+        if (space < 0) space = args.length();
+        if (space > pos) {
+            values[have++] = args.substring(pos, space).toInt();
+            if (have == 2) {
+                if (values[0] < 0 || values[0] > 255 || values[1] < 0 || values[1] > 255) {
+                    Serial.println("❌ Coordinates must be 0-255");
+                    stagedCoordCount = before;
+                    return;
+                }
+                if (stagedCoordCount >= NUM_LEDS) {
+                    Serial.printf("❌ List is full (%d LEDs)\n", NUM_LEDS);
+                    stagedCoordCount = before;
+                    return;
+                }
+                stagedCoords[stagedCoordCount][0] = values[0];
+                stagedCoords[stagedCoordCount][1] = values[1];
+                stagedCoordCount++;
+                have = 0;
+            }
+        }
+        pos = space + 1;
+    }
+    if (have || stagedCoordCount == before) {
+        stagedCoordCount = before;
+        Serial.println("❌ Usage: layout map begin | <x> <y> [<x> <y> ...] | end");
+        return;
+    }
+    Serial.printf("🧩 %d LEDs in the list\n", stagedCoordCount);
+}
+
+// Falls back to the compiled-in matrix when nothing is saved or the saved
+// geometry no longer fits this build
+void loadLayout() {
+    matrix_layout_t saved;
+    uint16_t coordCount = 0;
+    
+    layoutPrefs.begin("layout", true);
+    bool haveGeometry = layoutPrefs.getBytesLength("geometry") == sizeof(saved) &&
+                        layoutPrefs.getBytes("geometry", &saved, sizeof(saved)) == sizeof(saved);
+    size_t coordBytes = layoutPrefs.getBytesLength("coords");
+    if (coordBytes && coordBytes % 2 == 0 && coordBytes <= sizeof(customCoords)) {
+        coordCount = layoutPrefs.getBytes("coords", customCoords, coordBytes) / 2;
+    }
+    layoutPrefs.end();
+    
+    if (coordCount && buildCustomLayout(customCoords, coordCount)) return;
+    if (haveGeometry) {
+        matrixLayout = saved;
+        if (rebuildPixelMap()) return;
+        Serial.println("⚠️  Saved layout doesn't fit, using the default");
+    }
+    matrixLayout = {LED_WIDTH, LED_HEIGHT, 1, 1, 1, 0, 0, 0};
+    rebuildPixelMap();
+}
+
+void saveLayout() {
+    layoutPrefs.begin("layout", false);
+    layoutPrefs.putBytes("geometry", &matrixLayout, sizeof(matrixLayout));
+    if (customLayoutActive) {
+        layoutPrefs.putBytes("coords", customCoords, physicalLedCount * 2);
+    } else {
+        layoutPrefs.remove("coords");
+    }
+    layoutPrefs.end();
+}
+
+void printLayout() {
+    const matrix_layout_t& l = matrixLayout;
+    Serial.printf("🧩 Layout: %dx%d logical, %d LEDs wired\n", matrixWidth, matrixHeight, physicalLedCount);
+    if (customLayoutActive) {
+        Serial.println("   Custom coordinate map");
+        return;
+    }
+    Serial.printf("   Panel %dx%d %s | Tiles %dx%d%s | Rotation %d° | Mirror %s%s\n",
+                  l.panelWidth, l.panelHeight, l.serpentine ? "serpentine" : "progressive",
+                  l.tilesX, l.tilesY, l.tileSerpentine ? " serpentine" : "",
+                  l.rotation * 90,
+                  (l.mirror & LAYOUT_MIRROR_X) ? "X" : "",
+                  (l.mirror & LAYOUT_MIRROR_Y) ? "Y" : (l.mirror ? "" : "none"));
+}
+
+// =============================================================================
+// WIRE PROTOCOL
+// =============================================================================
+// Single pass over the records, each handed straight from the radio buffer
+// to its consumer. A truncated record stops the walk; records before it
+// have already been applied.
+bool dispatchWirePacket(const uint8_t* data, int len, bool broadcast, bool relayed) {
+    const wire_header_t* header = (const wire_header_t*)data;
+    if (header->version != WIRE_VERSION_2) {
+        wireStats.badVersion++;
+        return false;
+    }
+    
+    wireStats.v2Packets++;
+    wireStats.lastSeq = header->seq;
+    
+    // Group filter and duplicate suppression happen before any record runs
+    int pos = sizeof(wire_header_t);
+    uint8_t group = wireTargetGroup(data, len);
+    if (relayed && group == GROUP_DIRECT) {
+        relayStats.unicast++;
+        return false;
+    }
+    
+    // Every controller numbers its own packets, so two controllers in one
+    // group each get a window. The loop shifts the group slots when a group
+    // is dropped, so the lookup and the window are one critical section.
+    portENTER_CRITICAL(&commandMux);
+    group_state_t* groupState = findGroupState(group);
+    bool fresh = false;
+    if (groupState) {
+        seq_window_t* window = rxPeer ? &rxPeer->windows[groupState - groupStates] : &groupState->window;
+        fresh = acceptGroupSeq(window, header->seq);
+        if (!fresh) {
+            groupState->duplicates++;
+        } else {
+            groupState->accepted++;
+            if (broadcast) {
+                groupState->broadcasts++;
+                groupState->airtimeUs += estimateAirtimeUs(len);
+            }
+        }
+    }
+    portEXIT_CRITICAL(&commandMux);
+    if (!groupState) {
+        wireStats.notSubscribed++;
+        return false;
+    }
+    if (!fresh) return false;
+    
+    uint32_t applyAtMs = 0;
+    bool skipCommands = false;  // Set by a retransmitted state version
+    
+    while (pos < len) {
+        if (pos + (int)sizeof(wire_record_t) > len) {
+            wireStats.malformed++;
+            return false;
+        }
+        
+        const wire_record_t* record = (const wire_record_t*)(data + pos);
+        const uint8_t* value = data + pos + sizeof(wire_record_t);
+        pos += sizeof(wire_record_t) + record->length;
+        
+        if (pos > len) {
+            wireStats.malformed++;
+            return false;
+        }
+        wireStats.records++;
+        
+        if (relayed && directOnlyRecord(record->type)) {
+            relayStats.refused++;
+            continue;
+        }
+        
+        switch (record->type) {
+            case WIRE_REC_PAD:
+            case WIRE_REC_TARGET:
+                break;
+            
+            case WIRE_REC_COMMAND:
+                if (record->length < sizeof(led_command_t)) goto malformed;
+                if (skipCommands || !peerMayCommand()) break;
+                queueZoneCommand(ZONE_ALL, (const led_command_t*)value, applyAtMs);
+                noteCommandReceived();
+                break;
+            
+            case WIRE_REC_ZONE_COMMAND: {
+                if (record->length < sizeof(zone_command_t)) goto malformed;
+                if (skipCommands || !peerMayCommand()) break;
+                const zone_command_t* zoneCommand = (const zone_command_t*)value;
+                queueZoneCommand(zoneCommand->zone, &zoneCommand->command, applyAtMs);
+                noteCommandReceived();
+                break;
+            }
+            
+            case WIRE_REC_LIVE_SAMPLE:
+                if (record->length < sizeof(live_sample_t)) goto malformed;
+                if (skipCommands || !peerMayCommand()) break;
+                queueLiveSample((const live_sample_t*)value);
+                noteCommandReceived();
+                break;
+            
+            case WIRE_REC_TRIGGER:
+                if (record->length < sizeof(trigger_t)) goto malformed;
+                if (skipCommands || !peerMayCommand()) break;
+                queueTrigger((const trigger_t*)value);
+                noteCommandReceived();
+                break;
+            
+            case WIRE_REC_APPLY_AT:
+                if (record->length < sizeof(apply_at_t)) goto malformed;
+                // 0 is reserved for "now"
+                applyAtMs = ((const apply_at_t*)value)->sharedMs | 1;
+                break;
+            
+            case WIRE_REC_TELEMETRY_REQ:
+                telemetryRequested = true;
+                break;
+            
+            case WIRE_REC_PREVIEW_CONFIG:
+                if (record->length < sizeof(preview_config_t)) goto malformed;
+                if (!fromActivePeer()) break;
+                configurePreview((const preview_config_t*)value);
+                break;
+            
+            // Firmware only from a paired controller in charge, heard
+            // directly (relays are refused above), and only from the one
+            // that began the session
+            case WIRE_REC_OTA_BEGIN:
+                if (record->length < sizeof(ota_begin_t)) goto malformed;
+                if (!rxPeer || !peerMayCommand()) break;
+                handleOtaBegin((const ota_begin_t*)value);
+                break;
+            
+            case WIRE_REC_OTA_CHUNK:
+                if (record->length <= sizeof(ota_chunk_header_t)) goto malformed;
+                if (!fromOtaOwner()) break;
+                handleOtaChunk(value, record->length);
+                break;
+            
+            case WIRE_REC_OTA_END:
+                if (record->length < sizeof(ota_end_t)) goto malformed;
+                if (!fromOtaOwner()) break;
+                handleOtaEnd((const ota_end_t*)value);
+                break;
+            
+            case WIRE_REC_STATE_VERSION:
+                if (record->length < sizeof(state_version_t)) goto malformed;
+                skipCommands = !peerMayCommand() || !acceptStateVersion((const state_version_t*)value);
+                break;
+            
+            case WIRE_REC_STATE_HEARTBEAT:
+                if (record->length < sizeof(state_heartbeat_t)) goto malformed;
+                if (!fromActivePeer()) break;
+                handleStateHeartbeat((const state_heartbeat_t*)value);
+                break;
+            
+            case WIRE_REC_TIME_PONG:
+                if (record->length < sizeof(time_pong_t)) goto malformed;
+                if (!fromActivePeer()) break;  // Clock belongs to the active controller
+                handleTimePong((const time_pong_t*)value);
+                break;
+            
+            case WIRE_REC_FRAME_FRAGMENT:
+                if (record->length <= sizeof(frame_fragment_header_t)) goto malformed;
+                if (!peerMayCommand()) break;
+                handleFrameFragment(value, record->length);
+                isConnected = true;
+                break;
+            
+            case WIRE_REC_SERIAL_DATA:
+                handleSerialPassthrough(value, record->length);
+                break;
+            
+            case WIRE_REC_SERIAL_FRAGMENT:
+                if (record->length <= sizeof(serial_fragment_header_t)) goto malformed;
+                if (!peerMayCommand()) break;  // The bridge follows the controller in charge
+                handleSerialFragment(value, record->length);
+                break;
+            
+            case WIRE_REC_SERIAL_CREDIT:
+                if (record->length < sizeof(serial_credit_t)) goto malformed;
+                if (!peerMayCommand()) break;
+                handleSerialCredit((const serial_credit_t*)value);
+                break;
+            
+            default:
+                wireStats.unknownRecords++;
+                break;
+        }
+    }
+    return true;
+    
+malformed:
+    wireStats.malformed++;
+    return false;
+}
+
+// GROUP_DIRECT unless the packet opens with a target record
+uint8_t wireTargetGroup(const uint8_t* data, int len) {
+    int pos = sizeof(wire_header_t);
+    if (pos + (int)sizeof(wire_record_t) + (int)sizeof(wire_target_t) <= len &&
+        data[pos] == WIRE_REC_TARGET && data[pos + 1] >= sizeof(wire_target_t)) {
+        return ((const wire_target_t*)(data + pos + sizeof(wire_record_t)))->group;
+    }
+    return GROUP_DIRECT;
+}
+
+// Firmware and bridge records are never taken from a relay: the origin in
+// the relay header is whatever the relaying station wrote there
+bool directOnlyRecord(uint8_t type) {
+    switch (type) {
+        case WIRE_REC_OTA_BEGIN:
+        case WIRE_REC_OTA_CHUNK:
+        case WIRE_REC_OTA_END:
+        case WIRE_REC_SERIAL_DATA:
+        case WIRE_REC_SERIAL_FRAGMENT:
+        case WIRE_REC_SERIAL_CREDIT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Slots 0 and 1 are the implicit direct and everyone groups
+group_state_t* findGroupState(uint8_t group) {
+    if (group == GROUP_DIRECT) return &groupStates[0];
+    if (group == GROUP_EVERYONE) return &groupStates[1];
+    for (uint8_t i = 0; i < subscribedGroupCount; i++) {
+        if (subscribedGroups[i] == group) return &groupStates[i + 2];
+    }
+    return nullptr;
+}
+
+// Sliding window: newer seqs advance the window, recent ones are checked
+// against the seen mask. A sender that restarted counts from 0 again, so a
+// jump back past the window, or any old seq after a quiet spell, starts the
+// window over instead of being dropped until the count catches up.
+bool acceptGroupSeq(seq_window_t* window, uint16_t seq) {
+    unsigned long now = renderMillis();  // A replay resyncs where the live run did
+    int16_t ahead = (int16_t)(seq - window->lastSeq);
+    
+    // The newest seq again is a copy, never a restart, however late it is
+    if (window->valid && ahead < 0 &&
+        (-ahead >= SEQ_WINDOW || now - window->lastMs > SEQ_RESYNC_SILENCE_MS)) {
+        wireStats.seqResyncs++;
+        window->valid = false;
+    }
+    if (!window->valid) {
+        window->valid = true;
+        window->lastSeq = seq;
+        window->seenMask = 1;
+        window->lastMs = now;
+        return true;
+    }
+    
+    if (ahead > 1 && ahead < SEQ_WINDOW) {
+        linkStats.seqLost += ahead - 1;
+    }
+    if (ahead > 0) {
+        window->seenMask = (ahead >= SEQ_WINDOW) ? 1 : ((window->seenMask << ahead) | 1);
+        window->lastSeq = seq;
+        window->lastMs = now;
+        return true;
+    }
+    
+    uint32_t bit = 1UL << -ahead;
+    if (window->seenMask & bit) return false;
+    window->seenMask |= bit;
+    linkStats.seqRecovered++;
+    return true;
+}
+
+void resetSeqWindows() {
+    for (uint8_t i = 0; i < MAX_GROUPS + 2; i++) {
+        groupStates[i].window.valid = false;
+        for (uint8_t p = 0; p < peerCount; p++) peers[p].windows[i].valid = false;
+    }
+}
+
+bool subscribeGroup(uint8_t group) {
+    if (group == GROUP_DIRECT || group == GROUP_EVERYONE) return false;
+    if (findGroupState(group)) return true;
+    if (subscribedGroupCount >= MAX_GROUPS) return false;
+    
+    // dispatchWirePacket() looks groups up under the same lock
+    portENTER_CRITICAL(&commandMux);
+    uint8_t slot = subscribedGroupCount + 2;
+    group_state_t& state = groupStates[slot];
+    memset(&state, 0, sizeof(state));
+    state.group = group;
+    for (uint8_t p = 0; p < peerCount; p++) peers[p].windows[slot].valid = false;
+    subscribedGroups[subscribedGroupCount++] = group;
+    portEXIT_CRITICAL(&commandMux);
+    return true;
+}
+
+bool unsubscribeGroup(uint8_t group) {
+    for (uint8_t i = 0; i < subscribedGroupCount; i++) {
+        if (subscribedGroups[i] != group) continue;
+        // Hide the shift from dispatchWirePacket(), which looks groups up per packet
+        portENTER_CRITICAL(&commandMux);
+        for (uint8_t j = i; j + 1 < subscribedGroupCount; j++) {
+            subscribedGroups[j] = subscribedGroups[j + 1];
+            groupStates[j + 2] = groupStates[j + 3];
+            for (uint8_t p = 0; p < peerCount; p++) peers[p].windows[j + 2] = peers[p].windows[j + 3];
+        }
+        subscribedGroupCount--;
+        portEXIT_CRITICAL(&commandMux);
+        return true;
+    }
+    return false;
+}
+
+// Rough on-air time of one ESP-NOW frame at 1 Mbps
+uint32_t estimateAirtimeUs(int len) {
+    return AIRTIME_PREAMBLE_US + (uint32_t)(len + AIRTIME_OVERHEAD_BYTES) * 8;
+}
+
+// groups             - list subscriptions
+// group add <id>     - subscribe (1-254)
+// group del <id>     - unsubscribe
+void handleGroupCommand(String args) {
+    int id = args.length() > 4 ? args.substring(4).toInt() : -1;
+    
+    if (args.startsWith("add ") && id > GROUP_DIRECT && id < GROUP_EVERYONE) {
+        if (!subscribeGroup(id)) {
+            Serial.printf("❌ At most %d groups\n", MAX_GROUPS);
+            return;
+        }
+    }
+    else if (args.startsWith("del ") && id > GROUP_DIRECT && id < GROUP_EVERYONE) {
+        if (!unsubscribeGroup(id)) {
+            Serial.printf("❌ Not subscribed to group %d\n", id);
+            return;
+        }
+    }
+    else if (args.length() > 0) {
+        Serial.println("❌ Usage: group add|del <1-254>");
+        return;
+    }
+    printGroups();
+}
+
+void printGroups() {
+    Serial.println("👥 Groups:");
+    for (uint8_t i = 0; i < subscribedGroupCount + 2; i++) {
+        const group_state_t& state = groupStates[i];
+        const char* name = i == 0 ? "direct" : (i == 1 ? "everyone" : "");
+        uint8_t id = i == 0 ? GROUP_DIRECT : (i == 1 ? GROUP_EVERYONE : state.group);
+        Serial.printf("   %-8s %3d | %lu accepted, %lu duplicate | %lu broadcast, %lu µs airtime\n",
+                      name, id, state.accepted, state.duplicates, state.broadcasts, state.airtimeUs);
+    }
+    Serial.printf("   Filtered: %lu not subscribed, %lu for absent zones | %lu seq resyncs\n",
+                  wireStats.notSubscribed, wireStats.zoneFiltered, wireStats.seqResyncs);
+    Serial.println("   Each broadcast reaches every member for the airtime of one unicast");
+}
+
+void wireBegin(wire_packet_t& packet) {
+    wire_header_t* header = (wire_header_t*)packet.data;
+    header->version = WIRE_VERSION_2;
+    header->flags = 0;
+    header->seq = txSeq++;
+    packet.len = sizeof(wire_header_t);
+}
+
+bool wireAppend(wire_packet_t& packet, uint8_t type, const void* value, uint8_t length) {
+    if (packet.len + (int)sizeof(wire_record_t) + length > ESP_NOW_MAX_DATA_LEN) return false;
+    
+    wire_record_t* record = (wire_record_t*)(packet.data + packet.len);
+    record->type = type;
+    record->length = length;
+    if (length) memcpy(packet.data + packet.len + sizeof(wire_record_t), value, length);
+    packet.len += sizeof(wire_record_t) + length;
+    return true;
+}
+
+// Pads away from the legacy 8-byte length before sending
+esp_err_t wireSend(wire_packet_t& packet, const uint8_t* mac, uint8_t kind) {
+    if (packet.len == sizeof(led_command_t)) {
+        wireAppend(packet, WIRE_REC_PAD, nullptr, 0);
+    }
+    if (memcmp(mac, controllerAddress, 6) == 0) {
+        return sendToController(packet.data, packet.len, kind);
+    }
+    return transport->send(mac, packet.data, packet.len);
+}
+
+esp_err_t sendToController(const uint8_t* data, int len, uint8_t kind) {
+    esp_err_t result = transport->send(controllerAddress, data, len);
+    if (result == ESP_OK) {
+        uint8_t next = (sendKindHead + 1) % sizeof(sendKinds);
+        if (next != sendKindTail) {
+            sendKinds[sendKindHead] = kind;
+            sendKindHead = next;
+        }
+    }
+    return result;
+}
+
+void noteCommandReceived() {
+    expectingResponse = false;
+    isConnected = true;
+    commandsReceived++;
+    if (rxPeer) rxPeer->commands++;
+}
+
+// Unsequenced bytes join the bridge stream; without credits they may not fit
+void handleSerialPassthrough(const uint8_t* data, uint16_t length) {
+    if (ringFree(bridgeDown) < length) {
+        bridgeStats.downOverruns++;
+        return;
+    }
+    ringPush(bridgeDown, data, length);
+    bridgeStats.downLegacyBytes += length;
+    if (bridgeTask) xTaskNotifyGive(bridgeTask);
+}
+
+void printWireStats() {
+    Serial.println("\n📦 Protocol:");
+    Serial.printf("  v2 packets: %lu (%lu records, last seq %u)\n",
+                  wireStats.v2Packets, wireStats.records, wireStats.lastSeq);
+    Serial.printf("  Legacy packets: %lu\n", wireStats.legacyPackets);
+    Serial.printf("  Rejected: %lu malformed, %lu bad version, %lu unknown records\n",
+                  wireStats.malformed, wireStats.badVersion, wireStats.unknownRecords);
+    if (simulatedLossPct) {
+        Serial.printf("  Simulated loss: %d%% (%lu dropped)\n", simulatedLossPct, wireStats.simulatedDrops);
+    }
+}
+
+// =============================================================================
+// PEERS
+// =============================================================================
+// FNV-1a over the NIC half of the MAC; the OUI half is often shared
+uint8_t peerHashOf(const uint8_t* mac) {
+    uint32_t h = 2166136261UL;
+    for (int i = 3; i < 6; i++) {
+        h = (h ^ mac[i]) * 16777619UL;
+    }
+    return h & (PEER_HASH_SLOTS - 1);
+}
+
+peer_t* findPeer(const uint8_t* mac) {
+    uint8_t slot = peerHashOf(mac);
+    for (uint8_t probe = 0; probe < PEER_HASH_SLOTS; probe++) {
+        uint8_t entry = peerHash[slot];
+        if (entry == 0) return nullptr;
+        if (memcmp(peers[entry - 1].record.mac, mac, 6) == 0) return &peers[entry - 1];
+        slot = (slot + 1) & (PEER_HASH_SLOTS - 1);
+    }
+    return nullptr;
+}
+
+void rebuildPeerHash() {
+    memset(peerHash, 0, sizeof(peerHash));
+    for (uint8_t i = 0; i < peerCount; i++) {
+        uint8_t slot = peerHashOf(peers[i].record.mac);
+        while (peerHash[slot]) slot = (slot + 1) & (PEER_HASH_SLOTS - 1);
+        peerHash[slot] = i + 1;
+    }
+}
+
+// Returns the peer index, or -1 when the table is full
+int addPeer(const uint8_t* mac, uint8_t priority) {
+    peer_t* existing = findPeer(mac);
+    if (existing) {
+        existing->record.priority = priority;
+        return existing - peers;
+    }
+    if (peerCount >= MAX_PEERS) return -1;
+    
+    peer_t& peer = peers[peerCount];
+    peer = peer_t();
+    memcpy(peer.record.mac, mac, 6);
+    peer.record.priority = priority;
+    
+    // Publish the entry before the hash slot that makes it visible
+    uint8_t slot = peerHashOf(mac);
+    while (peerHash[slot]) slot = (slot + 1) & (PEER_HASH_SLOTS - 1);
+    peerCount++;
+    peerHash[slot] = peerCount;
+    
+    // Before that, setupPeerConnection() registers the whole table
+    if (transportReady) transport->addPeer(mac);
+    return peerCount - 1;
+}
+
+bool removePeer(uint8_t index) {
+    if (index >= peerCount) return false;
+    
+    if (transportReady) transport->removePeer(peers[index].record.mac);
+    
+    // Hide the table from the WiFi task while entries shift
+    portENTER_CRITICAL(&commandMux);
+    memset(peerHash, 0, sizeof(peerHash));
+    rxPeer = nullptr;
+    portEXIT_CRITICAL(&commandMux);
+    
+    for (uint8_t i = index; i + 1 < peerCount; i++) {
+        peers[i] = peers[i + 1];
+    }
+    peerCount--;
+    
+    if (arbOwner == index) arbOwner = -1;
+    else if (arbOwner > index) arbOwner--;
+    
+    rebuildPeerHash();
+    setActivePeer(peerCount ? 0 : -1);
+    return true;
+}
+
+void loadPeers() {
+    peer_record_t records[MAX_PEERS];
+    uint8_t count = 0;
+    
+    peerPrefs.begin("peers", true);
+    size_t length = peerPrefs.getBytesLength("table");
+    if (length && length % sizeof(peer_record_t) == 0 && length <= sizeof(records)) {
+        count = peerPrefs.getBytes("table", records, length) / sizeof(peer_record_t);
+    }
+    peerPrefs.end();
+    
+    peerCount = 0;
+    rebuildPeerHash();
+    for (uint8_t i = 0; i < count; i++) {
+        addPeer(records[i].mac, records[i].priority);
+    }
+    if (peerCount == 0) {
+        addPeer(defaultControllerAddress, PEER_DEFAULT_PRIORITY);
+    }
+    Serial.printf("  ✓ %d controller peer%s (%s)\n", peerCount, peerCount == 1 ? "" : "s",
+                  count ? "from flash" : "default");
+}
+
+void savePeers() {
+    peer_record_t records[MAX_PEERS];
+    for (uint8_t i = 0; i < peerCount; i++) {
+        records[i] = peers[i].record;
+    }
+    peerPrefs.begin("peers", false);
+    peerPrefs.putBytes("table", records, peerCount * sizeof(peer_record_t));
+    peerPrefs.end();
+}
+
+// Runs in the WiFi task, decided once per packet. A peer takes control if
+// nobody holds it, it already does, its priority is at least the owner's
+// (equal priority: the latest command wins), or the owner went quiet.
+// Timestamps are this receiver's arrival times; controller clocks are not
+// comparable with each other.
+bool peerMayCommand() {
+    if (!rxPeer) return true;
+    if (rxArbitration >= 0) return rxArbitration;
+    
+    int8_t index = rxPeer - peers;
+    unsigned long now = millis();
+    bool allowed = arbOwner < 0 || arbOwner == index ||
+                   now - arbOwnerLastMs > PEER_HOLD_MS ||
+                   rxPeer->record.priority >= peers[arbOwner].record.priority;
+    
+    if (allowed) {
+        arbOwner = index;
+        arbOwnerLastMs = now;
+        if (index != activePeer) pendingActivePeer = index;
+    } else {
+        rxPeer->overruled++;
+        commandsDropped++;
+    }
+    rxArbitration = allowed;
+    return allowed;
+}
+
+bool fromActivePeer() {
+    return rxPeer && rxPeer - peers == activePeer;
+}
+
+// Acks, pings and heartbeats follow the controller in charge. Its version
+// and clock state are its own, so both start over.
+void setActivePeer(int8_t index) {
+    activePeer = index;
+    if (index < 0) return;
+    
+    memcpy(controllerAddress, peers[index].record.mac, 6);
+    stateSyncActive = false;
+    timeSampleCount = 0;
+    timeSampleNext = 0;
+}
+
+void servicePeers() {
+    int8_t pending = pendingActivePeer;
+    if (pending >= 0) {
+        pendingActivePeer = -1;
+        if (pending != activePeer && pending < peerCount) {
+            setActivePeer(pending);
+            const uint8_t* mac = controllerAddress;
+            Serial.printf("🎛️  Active controller: %02X:%02X:%02X:%02X:%02X:%02X\n",
+                          mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+        }
+    }
+    
+    if (pairingRequested) {
+        int index = addPeer(pairingMac, PEER_DEFAULT_PRIORITY);
+        pairingRequested = false;
+        pairingUntil = 0;
+        if (index < 0) {
+            Serial.printf("❌ Peer table full (%d)\n", MAX_PEERS);
+        } else {
+            savePeers();
+            Serial.printf("🤝 Paired controller %02X:%02X:%02X:%02X:%02X:%02X\n",
+                          pairingMac[0], pairingMac[1], pairingMac[2],
+                          pairingMac[3], pairingMac[4], pairingMac[5]);
+        }
+    }
+    else if (pairingUntil && (long)(millis() - pairingUntil) > 0) {
+        pairingUntil = 0;
+        Serial.println("⌛ Pairing window closed");
+    }
+}
+
+bool parseMac(String text, uint8_t* mac) {
+    unsigned int b[6];
+    if (sscanf(text.c_str(), "%x:%x:%x:%x:%x:%x", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) != 6) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) {
+        if (b[i] > 0xFF) return false;
+        mac[i] = b[i];
+    }
+    return true;
+}
+
+void handlePeerCommand(String args) {
+    if (args == "pair") {
+        pairingUntil = millis() + PAIRING_WINDOW_MS;
+        pairingRequested = false;
+        Serial.printf("📡 Pairing: the next unknown controller heard in %d s is added\n",
+                      PAIRING_WINDOW_MS / 1000);
+        return;
+    }
+    
+    if (args.startsWith("unpair ")) {
+        int index = args.substring(7).toInt();
+        if (peerCount <= 1 || !removePeer(index)) {
+            Serial.println("❌ Unknown peer, or it is the last one");
+            return;
+        }
+        savePeers();
+    }
+    else if (args.startsWith("peer add ")) {
+        uint8_t mac[6];
+        String rest = args.substring(9);
+        int space = rest.indexOf(' ');
+        int priority = space > 0 ? rest.substring(space + 1).toInt() : PEER_DEFAULT_PRIORITY;
+        if (!parseMac(space > 0 ? rest.substring(0, space) : rest, mac) || priority < 0 || priority > 255) {
+            Serial.println("❌ Usage: peer add <aa:bb:cc:dd:ee:ff> [priority]");
+            return;
+        }
+        if (addPeer(mac, priority) < 0) {
+            Serial.printf("❌ Peer table full (%d)\n", MAX_PEERS);
+            return;
+        }
+        savePeers();
+    }
+    else if (args.startsWith("peer prio ")) {
+        String rest = args.substring(10);
+        int space = rest.indexOf(' ');
+        int index = rest.toInt();
+        int priority = space > 0 ? rest.substring(space + 1).toInt() : -1;
+        if (index < 0 || index >= peerCount || priority < 0 || priority > 255) {
+            Serial.println("❌ Usage: peer prio <n> <0-255>");
+            return;
+        }
+        peers[index].record.priority = priority;
+        savePeers();
+    }
+    else if (args != "peers") {
+        Serial.println("❌ Usage: peers | pair | unpair <n> | peer add <mac> [prio] | peer prio <n> <p>");
+        return;
+    }
+    printPeers();
+}
+
+void printPeers() {
+    Serial.printf("🎛️  Controllers (%d/%d)%s:\n", peerCount, MAX_PEERS,
+                  pairingUntil ? ", pairing open" : "");
+    for (uint8_t i = 0; i < peerCount; i++) {
+        const peer_t& p = peers[i];
+        const uint8_t* mac = p.record.mac;
+        Serial.printf("  %d: %02X:%02X:%02X:%02X:%02X:%02X prio %3d%s%s | %lu pkts, %lu cmds, %lu overruled",
+                      i, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], p.record.priority,
+                      i == activePeer ? " [active]" : "", i == arbOwner ? " [owner]" : "",
+                      p.packets, p.commands, p.overruled);
+        if (p.packets) Serial.printf(", seen %lu ms ago", millis() - p.lastSeenMs);
+        Serial.println();
+    }
+    if (unknownSenders) Serial.printf("  Ignored %lu packets from unknown senders\n", unknownSenders);
+}
+
+// =============================================================================
+// RELAY MESH
+// =============================================================================
+// Controlled flooding. Every receiver that first hears a group packet
+// (directly or relayed) applies it, then rebroadcasts it after a random
+// backoff unless it hears enough neighbours do so first. The TTL bounds
+// the flood; the (origin, group, seq) cache stops loops and storms.
+// Unicast traffic is never relayed.
+
+// Group seq counters are per group, so the group is part of the key
+uint32_t relayKeyOf(const uint8_t* origin, const uint8_t* inner, int innerLen) {
+    uint8_t group = wireTargetGroup(inner, innerLen);
+    
+    uint32_t h = 2166136261UL;
+    for (int i = 0; i < 6; i++) {
+        h = (h ^ origin[i]) * 16777619UL;
+    }
+    return (h ^ group) * 16777619UL;
+}
+
+// Runs in the WiFi task. True the first time a packet is seen.
+bool noteRelaySeen(uint32_t key, uint16_t seq) {
+    for (uint8_t i = 0; i < RELAY_CACHE_SIZE; i++) {
+        relay_cache_entry_t& entry = relayCache[i];
+        if (entry.heard && entry.key == key && entry.seq == seq) {
+            if (entry.heard < 255) entry.heard++;
+            return false;
+        }
+    }
+    
+    relay_cache_entry_t& entry = relayCache[relayCacheNext];
+    entry.key = key;
+    entry.seq = seq;
+    entry.heard = 1;
+    relayCacheNext = (relayCacheNext + 1) % RELAY_CACHE_SIZE;
+    return true;
+}
+
+uint8_t relayCopiesHeard(uint32_t key, uint16_t seq) {
+    for (uint8_t i = 0; i < RELAY_CACHE_SIZE; i++) {
+        if (relayCache[i].key == key && relayCache[i].seq == seq) return relayCache[i].heard;
+    }
+    return 0;
+}
+
+// Wraps the inner packet and parks it until its backoff expires
+void queueRelay(const uint8_t* origin, uint8_t ttl, uint8_t hops, uint32_t delayUs,
+                const uint8_t* inner, int innerLen) {
+    int total = sizeof(wire_header_t) + sizeof(wire_record_t) + sizeof(relay_header_t) + innerLen;
+    if (total > ESP_NOW_MAX_DATA_LEN) {
+        relayStats.tooLarge++;
+        return;
+    }
+    
+    portENTER_CRITICAL(&relayMux);
+    relay_slot_t* slot = nullptr;
+    for (uint8_t i = 0; i < RELAY_QUEUE_SIZE && !slot; i++) {
+        if (!relayQueue[i].used) slot = &relayQueue[i];
+    }
+    if (slot) {
+        uint8_t* out = slot->data;
+        wire_record_t* record = (wire_record_t*)(out + sizeof(wire_header_t));
+        record->type = WIRE_REC_RELAY;
+        record->length = sizeof(relay_header_t) + innerLen;
+        
+        relay_header_t* header = (relay_header_t*)(record + 1);
+        memcpy(header->origin, origin, 6);
+        header->ttl = ttl;
+        header->hops = hops + 1;
+        header->delayUs = delayUs;
+        memcpy(header + 1, inner, innerLen);
+        
+        slot->key = relayKeyOf(origin, inner, innerLen);
+        slot->seq = ((const wire_header_t*)inner)->seq;
+        slot->len = total;
+        slot->receivedUs = esp_timer_get_time();
+        slot->dueMs = millis() + random(RELAY_BACKOFF_MIN_MS, RELAY_BACKOFF_MAX_MS + 1);
+        slot->used = true;
+    }
+    portEXIT_CRITICAL(&relayMux);
+    
+    if (!slot) relayStats.queueFull++;
+}
+
+// Runs in the WiFi task
+void handleRelayPacket(const uint8_t* data, int len) {
+    const wire_record_t* record = (const wire_record_t*)(data + sizeof(wire_header_t));
+    const relay_header_t* header = (const relay_header_t*)(record + 1);
+    const uint8_t* inner = (const uint8_t*)(header + 1);
+    int innerLen = (int)record->length - (int)sizeof(relay_header_t);
+    
+    if (innerLen < (int)sizeof(wire_header_t) ||
+        sizeof(wire_header_t) + sizeof(wire_record_t) + record->length > (size_t)len ||
+        inner[0] != WIRE_VERSION_2 ||
+        (innerLen > (int)sizeof(wire_header_t) && inner[sizeof(wire_header_t)] == WIRE_REC_RELAY)) {
+        wireStats.malformed++;
+        return;
+    }
+    
+    if (simulatedLossPct && (int)random(100) < simulatedLossPct) {
+        wireStats.simulatedDrops++;
+        return;
+    }
+    
+    // Only group traffic from our own controllers is applied or passed on.
+    // Both are checked before the cache, so strangers can't evict entries.
+    peer_t* peer = findPeer(header->origin);
+    if (!peer) {
+        relayStats.unknownOrigin++;
+        return;
+    }
+    if (wireTargetGroup(inner, innerLen) == GROUP_DIRECT) {
+        relayStats.unicast++;
+        return;
+    }
+    
+    if (!noteRelaySeen(relayKeyOf(header->origin, inner, innerLen), ((const wire_header_t*)inner)->seq)) {
+        relayStats.duplicates++;
+        return;
+    }
+    
+    peer->packets++;
+    peer->lastSeenMs = millis();
+    rxPeer = peer;
+    rxArbitration = -1;
+    
+    uint8_t hops = min<uint8_t>(header->hops, RELAY_MAX_TTL);
+    relayStats.received[hops]++;
+    relayStats.delayUs[hops] += header->delayUs;
+    
+    dispatchWirePacket(inner, innerLen, true, true);
+    
+    if (relayEnabled && header->ttl > 1) {
+        queueRelay(header->origin, min<uint8_t>(header->ttl - 1, relayTtl), header->hops,
+                   header->delayUs, inner, innerLen);
+    }
+}
+
+// Sends relays whose backoff has run out, unless neighbours beat us to it
+void serviceRelay() {
+    for (uint8_t i = 0; i < RELAY_QUEUE_SIZE; i++) {
+        relay_slot_t& slot = relayQueue[i];
+        if (!slot.used || (long)(millis() - slot.dueMs) < 0) continue;
+        
+        if (relayCopiesHeard(slot.key, slot.seq) >= RELAY_SUPPRESS_COUNT) {
+            relayStats.suppressed++;
+        } else {
+            wire_header_t* header = (wire_header_t*)slot.data;
+            header->version = WIRE_VERSION_2;
+            header->flags = 0;
+            header->seq = txSeq++;
+            
+            relay_header_t* relay = (relay_header_t*)(slot.data + sizeof(wire_header_t) + sizeof(wire_record_t));
+            relay->delayUs += (uint32_t)(esp_timer_get_time() - slot.receivedUs);
+            
+            if (transport->send(broadcastAddress, slot.data, slot.len) == ESP_OK) {
+                relayStats.relayed++;
+            }
+        }
+        
+        portENTER_CRITICAL(&relayMux);
+        slot.used = false;
+        portEXIT_CRITICAL(&relayMux);
+    }
+}
+
+// relay            - statistics
+// relay on|off     - enable or disable relaying
+// relay ttl <n>    - hops a packet we originate a relay for may take
+void handleRelayCommand(String args) {
+    if (args == "on" || args == "off") {
+        relayEnabled = (args == "on");
+    }
+    else if (args.startsWith("ttl ")) {
+        int ttl = args.substring(4).toInt();
+        if (ttl < 1 || ttl > RELAY_MAX_TTL) {
+            Serial.printf("❌ TTL must be 1-%d\n", RELAY_MAX_TTL);
+            return;
+        }
+        relayTtl = ttl;
+    }
+    else if (args.length()) {
+        Serial.println("❌ Usage: relay [on|off|ttl <n>]");
+        return;
+    }
+    printRelayStats();
+}
+
+void printRelayStats() {
+    Serial.printf("🛰️  Relay: %s, TTL %d\n", relayEnabled ? "on" : "off", relayTtl);
+    Serial.printf("   Relayed %lu | Suppressed %lu | Duplicates %lu\n",
+                  relayStats.relayed, relayStats.suppressed, relayStats.duplicates);
+    Serial.printf("   Dropped: %lu unknown origin, %lu unicast, %lu too large, %lu queue full\n",
+                  relayStats.unknownOrigin, relayStats.unicast, relayStats.tooLarge, relayStats.queueFull);
+    Serial.printf("   Refused %lu OTA/serial records from relays\n", relayStats.refused);
+    
+    // Per-hop latency: queued time in relays plus estimated airtime per hop
+    for (uint8_t hops = 0; hops <= RELAY_MAX_TTL; hops++) {
+        unsigned long count = relayStats.received[hops];
+        if (!count) continue;
+        if (hops == 0) {
+            Serial.printf("   Direct: %lu packets\n", count);
+            continue;
+        }
+        uint32_t avgDelay = relayStats.delayUs[hops] / count;
+        Serial.printf("   %d hop%s: %lu packets, relay delay avg %lu µs (%lu µs per hop incl. airtime)\n",
+                      hops, hops == 1 ? "" : "s", count, (unsigned long)avgDelay,
+                      (unsigned long)(avgDelay / hops + estimateAirtimeUs(ESP_NOW_MAX_DATA_LEN / 2)));
+    }
+}
+
+// =============================================================================
+// OTA UPDATE
+// =============================================================================
+// The controller announces an image (size, chunk size, SHA-256), then keeps
+// up to OTA_WINDOW chunks in flight past our watermark. Our status carries
+// the watermark plus a bitmap of what we hold beyond it; every gap below
+// the highest set bit is a NACK the controller resends. Chunks go straight
+// to their offset in the OTA partition, which a background task erases
+// ahead of them. The watermark is kept in NVS, so a repeated BEGIN for the
+// same image resumes there instead of starting over.
+//
+// Flash erases (tens of ms per sector) never run in the loop, and the
+// SHA-256 is taken over the stored image OTA_HASH_SLICE bytes per pass,
+// following the watermark, so END only has to hash the last stretch.
+// Switching the boot partition reads and checks the whole image once
+// more, so that runs on a task as well.
+
+// Runs in the WiFi task; the loop starts or resumes the session
+void handleOtaBegin(const ota_begin_t* begin) {
+    if (ota.state == OTA_RECEIVING && begin->transferId == ota.transferId &&
+        memcmp(rxPeer->record.mac, ota.owner, 6) == 0) {
+        ota.chunksSinceStatus = OTA_STATUS_EVERY;  // Controller retried; answer now
+        return;
+    }
+    memcpy(&otaPendingBegin, begin, sizeof(otaPendingBegin));
+    memcpy(otaPendingOwner, rxPeer->record.mac, 6);
+    otaBeginPending = true;
+}
+
+// Runs in the WiFi task
+bool fromOtaOwner() {
+    if (rxPeer && memcmp(rxPeer->record.mac, ota.owner, 6) == 0) return true;
+    if (ota.state == OTA_RECEIVING) ota.notOwner++;
+    return false;
+}
+
+// Runs in the WiFi task. Cheap checks only; the chunk is queued for the loop.
+void handleOtaChunk(const uint8_t* value, uint8_t length) {
+    const ota_chunk_header_t* header = (const ota_chunk_header_t*)value;
+    const uint8_t* data = value + sizeof(ota_chunk_header_t);
+    uint16_t dataLength = length - sizeof(ota_chunk_header_t);
+    
+    if (ota.state != OTA_RECEIVING || header->transferId != ota.transferId) return;
+    ota.chunksReceived++;
+    ota.lastChunkMs = millis();
+    
+    uint32_t expected = header->index + 1 < ota.chunkCount
+                        ? ota.chunkSize : ota.imageSize - header->index * ota.chunkSize;
+    if (header->index >= ota.chunkCount || dataLength != expected ||
+        esp_rom_crc32_le(0, data, dataLength) != header->crc32) {
+        ota.crcErrors++;
+        return;
+    }
+    
+    uint32_t ahead = header->index - ota.watermark;
+    if (header->index < ota.watermark || (ahead < OTA_WINDOW && (ota.windowMask & (1UL << ahead)))) {
+        ota.duplicates++;
+        return;
+    }
+    if (ahead >= OTA_WINDOW) {
+        ota.outOfWindow++;
+        return;
+    }
+    
+    portENTER_CRITICAL(&otaMux);
+    ota_slot_t* slot = nullptr;
+    for (uint8_t i = 0; i < OTA_QUEUE_SIZE; i++) {
+        if (otaQueue[i].used && otaQueue[i].index == header->index) {
+            slot = &otaQueue[i];    // Already queued, not yet stored
+            break;
+        }
+        if (!otaQueue[i].used && !slot) slot = &otaQueue[i];
+    }
+    bool queued = slot && !slot->used;
+    if (queued) {
+        slot->index = header->index;
+        slot->length = dataLength;
+        memcpy(slot->data, data, dataLength);
+        slot->used = true;
+    }
+    portEXIT_CRITICAL(&otaMux);
+    
+    if (!slot) ota.queueFull++;
+    else if (!queued) ota.duplicates++;
+}
+
+void handleOtaEnd(const ota_end_t* end) {
+    if (ota.state == OTA_RECEIVING && end->transferId == ota.transferId) {
+        otaEndPending = true;
+    }
+}
+
+void startOtaSession(const ota_begin_t* begin) {
+    const esp_partition_t* partition = esp_ota_get_next_update_partition(NULL);
+    
+    memset(&ota, 0, sizeof(ota));
+    memset(otaQueue, 0, sizeof(otaQueue));
+    memcpy(ota.owner, otaPendingOwner, 6);
+    ota.transferId = begin->transferId;
+    ota.imageSize = begin->imageSize;
+    ota.chunkSize = begin->chunkSize;
+    memcpy(ota.sha256, begin->sha256, sizeof(ota.sha256));
+    ota.partition = partition;
+    ota.startMs = millis();
+    ota.lastChunkMs = millis();
+    
+    if (!partition || begin->chunkSize == 0 || begin->chunkSize > OTA_CHUNK_MAX ||
+        begin->imageSize == 0 || begin->imageSize > partition->size) {
+        Serial.printf("❌ OTA rejected: %lu byte image, %u byte chunks, partition %lu bytes\n",
+                      (unsigned long)begin->imageSize, begin->chunkSize,
+                      partition ? (unsigned long)partition->size : 0UL);
+        ota.state = OTA_FAILED;
+        sendOtaStatus();
+        return;
+    }
+    ota.chunkCount = (begin->imageSize + begin->chunkSize - 1) / begin->chunkSize;
+    
+    // Resume only the very same image
+    uint8_t savedSha[32];
+    otaPrefs.begin("ota", false);
+    bool resume = otaPrefs.getUInt("id", 0) == begin->transferId &&
+                  otaPrefs.getUInt("size", 0) == begin->imageSize &&
+                  otaPrefs.getUInt("chunk", 0) == begin->chunkSize &&
+                  otaPrefs.getBytes("sha", savedSha, sizeof(savedSha)) == sizeof(savedSha) &&
+                  memcmp(savedSha, begin->sha256, sizeof(savedSha)) == 0;
+    if (resume) {
+        ota.watermark = min<uint32_t>(otaPrefs.getUInt("mark", 0), ota.chunkCount);
+    } else {
+        otaPrefs.putUInt("id", begin->transferId);
+        otaPrefs.putUInt("size", begin->imageSize);
+        otaPrefs.putUInt("chunk", begin->chunkSize);
+        otaPrefs.putBytes("sha", begin->sha256, sizeof(begin->sha256));
+        otaPrefs.putUInt("mark", 0);
+    }
+    otaPrefs.end();
+    
+    // The sector holding the watermark was erased before the interruption;
+    // anything past it may hold stale writes and is erased again on demand.
+    uint32_t stored = ota.watermark * ota.chunkSize;
+    ota.erasedEnd = (stored + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE * SPI_FLASH_SEC_SIZE;
+    ota.eraseTarget = (ota.imageSize + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE * SPI_FLASH_SEC_SIZE;
+    ota.persistedWatermark = ota.watermark;
+    ota.resumedFrom = ota.watermark;
+    ota.state = OTA_RECEIVING;
+    
+    // A resumed image is hashed again from the start, behind the watermark
+    mbedtls_sha256_free(&otaHash);
+    mbedtls_sha256_init(&otaHash);
+    mbedtls_sha256_starts(&otaHash, 0);
+    
+    otaEraseStop = false;
+    otaEraseRunning = true;
+    if (xTaskCreatePinnedToCore(otaEraseTaskMain, "ota_erase", 3072, nullptr, 1, &otaEraseTask, 0) != pdPASS) {
+        otaEraseRunning = false;    // storeOtaChunk() erases on demand instead
+    }
+    
+    Serial.printf("📥 OTA %08lX: %lu bytes in %lu chunks to %s%s\n",
+                  (unsigned long)ota.transferId, (unsigned long)ota.imageSize,
+                  (unsigned long)ota.chunkCount, partition->label,
+                  resume ? "" : " (new)");
+    if (resume) {
+        Serial.printf("   Resuming at chunk %lu (%d%%)\n", (unsigned long)ota.watermark,
+                      (int)(100ULL * ota.watermark / ota.chunkCount));
+    }
+    sendOtaStatus();
+}
+
+// Low priority, one sector at a time, always ahead of the window
+void otaEraseTaskMain(void*) {
+    while (!otaEraseStop && ota.erasedEnd < ota.eraseTarget) {
+        if (esp_partition_erase_range(ota.partition, ota.erasedEnd, SPI_FLASH_SEC_SIZE) != ESP_OK) {
+            ota.eraseFailed = true;
+            break;
+        }
+        ota.erasedEnd += SPI_FLASH_SEC_SIZE;
+        vTaskDelay(1);
+    }
+    otaEraseRunning = false;
+    otaEraseTask = nullptr;
+    vTaskDelete(nullptr);
+}
+
+// IDF verifies the image before it switches, hundreds of ms for a full one
+void otaBootTaskMain(void*) {
+    ota.bootResult = esp_ota_set_boot_partition(ota.partition);
+    otaBootSwitching = false;
+    vTaskDelete(nullptr);
+}
+
+bool storeOtaChunk(const ota_slot_t& slot) {
+    // Requeued by the WiFi task from a stale window; already stored
+    uint32_t ahead = slot.index - ota.watermark;
+    if (slot.index < ota.watermark || (ota.windowMask & (1UL << ahead))) {
+        ota.duplicates++;
+        return true;
+    }
+    
+    uint32_t offset = slot.index * ota.chunkSize;
+    uint32_t end = offset + slot.length;
+    
+    while (ota.erasedEnd < end) {
+        if (esp_partition_erase_range(ota.partition, ota.erasedEnd, SPI_FLASH_SEC_SIZE) != ESP_OK) {
+            return false;
+        }
+        ota.erasedEnd += SPI_FLASH_SEC_SIZE;
+    }
+    if (esp_partition_write(ota.partition, offset, slot.data, slot.length) != ESP_OK) {
+        return false;
+    }
+    
+    // Slide the window over every contiguous stored chunk
+    uint32_t bit = 1UL << ahead;
+    portENTER_CRITICAL(&otaMux);
+    uint32_t mask = ota.windowMask | bit;
+    uint32_t mark = ota.watermark;
+    while (mask & 1) {
+        mask >>= 1;
+        mark++;
+    }
+    ota.windowMask = mask;
+    ota.watermark = mark;
+    portEXIT_CRITICAL(&otaMux);
+    
+    ota.chunksStored++;
+    ota.chunksSinceStatus++;
+    return true;
+}
+
+// Flash wear: one NVS write per OTA_PERSIST_BYTES of progress
+void persistOtaWatermark(bool force) {
+    uint32_t pending = (ota.watermark - ota.persistedWatermark) * ota.chunkSize;
+    if (!force && pending < OTA_PERSIST_BYTES) return;
+    if (ota.watermark == ota.persistedWatermark) return;
+    
+    otaPrefs.begin("ota", false);
+    otaPrefs.putUInt("mark", ota.watermark);
+    otaPrefs.end();
+    ota.persistedWatermark = ota.watermark;
+}
+
+// Reads back what flash holds below the watermark, so the digest covers
+// the stored image rather than the chunks as they arrived. False on a
+// read error.
+bool hashOtaSlice() {
+    uint8_t buffer[256];
+    uint32_t stored = min<uint32_t>(ota.watermark * ota.chunkSize, ota.imageSize);
+    uint32_t end = min<uint32_t>(stored, ota.hashedBytes + OTA_HASH_SLICE);
+    
+    while (ota.hashedBytes < end) {
+        uint32_t length = min<uint32_t>(sizeof(buffer), end - ota.hashedBytes);
+        if (esp_partition_read(ota.partition, ota.hashedBytes, buffer, length) != ESP_OK) return false;
+        mbedtls_sha256_update(&otaHash, buffer, length);
+        ota.hashedBytes += length;
+    }
+    return true;
+}
+
+void sendOtaStatus() {
+    ota_status_t status;
+    status.transferId = ota.transferId;
+    status.watermark = ota.watermark;
+    status.receivedMask = ota.windowMask >> 1;
+    status.state = ota.state;
+    
+    wire_packet_t packet;
+    wireBegin(packet);
+    wireAppend(packet, WIRE_REC_OTA_STATUS, &status, sizeof(status));
+    wireSend(packet, ota.owner);
+    
+    ota.statusesSent++;
+    ota.chunksSinceStatus = 0;
+    ota.lastStatusMs = millis();
+}
+
+void serviceOta() {
+    if (otaBeginPending) {
+        // The previous session's eraser stops after its current sector
+        otaEraseStop = true;
+        if (!otaEraseRunning && !otaBootSwitching) {
+            otaBeginPending = false;
+            startOtaSession(&otaPendingBegin);
+        }
+    }
+    
+    if (ota.state == OTA_DONE && millis() - ota.doneMs >= OTA_REBOOT_DELAY_MS) {
+        Serial.println("🔄 Rebooting into the new firmware...");
+        Serial.flush();
+        ESP.restart();
+    }
+    if (ota.state == OTA_VERIFYING) {
+        serviceOtaVerify();
+        return;
+    }
+    if (ota.state != OTA_RECEIVING) return;
+    
+    if (ota.eraseFailed) {
+        Serial.println("❌ OTA partition erase failed");
+        ota.state = OTA_FAILED;
+        sendOtaStatus();
+        return;
+    }
+    
+    for (uint8_t i = 0; i < OTA_QUEUE_SIZE; i++) {
+        ota_slot_t& slot = otaQueue[i];
+        if (!slot.used) continue;
+        
+        // Stays queued until the eraser has passed it; a full queue makes
+        // the controller back off
+        if (otaEraseRunning && slot.index * ota.chunkSize + slot.length > ota.erasedEnd) {
+            ota.waitedForErase++;
+            continue;
+        }
+        if (!storeOtaChunk(slot)) {
+            Serial.printf("❌ OTA flash write failed at chunk %lu\n", (unsigned long)slot.index);
+            ota.state = OTA_FAILED;
+        }
+        portENTER_CRITICAL(&otaMux);
+        slot.used = false;
+        portEXIT_CRITICAL(&otaMux);
+        if (ota.state == OTA_FAILED) {
+            sendOtaStatus();
+            return;
+        }
+    }
+    persistOtaWatermark(false);
+    if (!hashOtaSlice()) {
+        Serial.println("❌ OTA partition read failed");
+        ota.state = OTA_FAILED;
+        sendOtaStatus();
+        return;
+    }
+    
+    if (otaEndPending) {
+        otaEndPending = false;
+        if (ota.watermark >= ota.chunkCount) {
+            ota.state = OTA_VERIFYING;
+            ota.verifyStartMs = millis();
+            persistOtaWatermark(true);
+        }
+        sendOtaStatus();
+        return;
+    }
+    
+    bool active = millis() - ota.lastChunkMs < OTA_IDLE_STATUS_MS;
+    if (ota.chunksSinceStatus >= OTA_STATUS_EVERY ||
+        (active && millis() - ota.lastStatusMs >= OTA_STATUS_INTERVAL_MS)) {
+        sendOtaStatus();
+    }
+}
+
+// Finishes the hash a slice per pass, then waits for the boot switch; the
+// controller sees VERIFYING until then
+void serviceOtaVerify() {
+    if (otaBootSwitching) return;
+    
+    if (!ota.imageVerified) {
+        bool readOk = hashOtaSlice();
+        if (readOk && ota.hashedBytes < ota.imageSize) return;
+        
+        uint8_t digest[32];
+        mbedtls_sha256_finish(&otaHash, digest);
+        if (readOk && memcmp(digest, ota.sha256, sizeof(digest)) == 0) {
+            ota.imageVerified = true;
+            otaBootSwitching = true;
+            if (xTaskCreatePinnedToCore(otaBootTaskMain, "ota_boot", 4096, nullptr, 1, nullptr, 0) == pdPASS) {
+                return;
+            }
+            otaBootSwitching = false;
+            ota.bootResult = esp_ota_set_boot_partition(ota.partition);  // No task to be had; don't fail a good image
+        } else {
+            Serial.printf("❌ OTA %s\n", !readOk ? "partition read failed" : "SHA-256 mismatch");
+        }
+    }
+    
+    if (ota.imageVerified && ota.bootResult == ESP_OK) {
+        ota.state = OTA_DONE;
+        ota.doneMs = millis();
+        Serial.printf("✅ OTA image verified (%lu ms after END), boot partition switched\n",
+                      millis() - ota.verifyStartMs);
+    } else {
+        ota.state = OTA_FAILED;
+        if (ota.imageVerified) Serial.println("❌ OTA boot partition switch failed");
+    }
+    
+    // Either way this image is finished with; don't resume into it
+    otaPrefs.begin("ota", false);
+    otaPrefs.clear();
+    otaPrefs.end();
+    sendOtaStatus();
+}
+
+void handleOtaCommand(String args) {
+    args.trim();
+    if (args == "abort") {
+        portENTER_CRITICAL(&otaMux);
+        ota.state = OTA_IDLE;
+        memset(otaQueue, 0, sizeof(otaQueue));
+        portEXIT_CRITICAL(&otaMux);
+        otaEraseStop = true;
+        
+        otaPrefs.begin("ota", false);
+        otaPrefs.clear();
+        otaPrefs.end();
+        Serial.println("🛑 OTA aborted, resume point cleared");
+        return;
+    }
+    printOtaStatus();
+}
+
+void printOtaStatus() {
+    static const char* stateNames[] = {"idle", "receiving", "verifying", "done", "failed"};
+    Serial.printf("📥 OTA: %s", stateNames[ota.state]);
+    if (ota.state == OTA_IDLE) {
+        Serial.println();
+        return;
+    }
+    Serial.printf(" | image %08lX, %lu bytes\n", (unsigned long)ota.transferId, (unsigned long)ota.imageSize);
+    
+    uint32_t stored = min<uint32_t>(ota.watermark * ota.chunkSize, ota.imageSize);
+    Serial.printf("   Progress: %lu/%lu chunks (%d%%)%s\n", (unsigned long)ota.watermark,
+                  (unsigned long)ota.chunkCount, ota.chunkCount ? (int)(100ULL * ota.watermark / ota.chunkCount) : 0,
+                  ota.resumedFrom ? " resumed" : "");
+    
+    // Throughput counts only bytes moved in this session
+    unsigned long elapsed = ota.lastChunkMs - ota.startMs;
+    uint32_t sessionBytes = stored - min<uint32_t>(ota.resumedFrom * ota.chunkSize, stored);
+    if (elapsed) {
+        Serial.printf("   Throughput: %lu B/s over %lu ms\n",
+                      (unsigned long)(1000ULL * sessionBytes / elapsed), elapsed);
+    }
+    Serial.printf("   Chunks: %lu received, %lu stored, %lu duplicate (retransmit rate %.1f%%)\n",
+                  ota.chunksReceived, ota.chunksStored, ota.duplicates,
+                  ota.chunksReceived ? 100.0 * ota.duplicates / ota.chunksReceived : 0.0);
+    Serial.printf("   Dropped: %lu CRC, %lu out of window, %lu queue full, %lu not from %02X:%02X:%02X:%02X:%02X:%02X\n",
+                  ota.crcErrors, ota.outOfWindow, ota.queueFull, ota.notOwner,
+                  ota.owner[0], ota.owner[1], ota.owner[2], ota.owner[3], ota.owner[4], ota.owner[5]);
+    Serial.printf("   Flash: %lu/%lu KB erased ahead%s, %lu KB hashed | %lu waits for the eraser | %lu statuses sent\n",
+                  (unsigned long)(ota.erasedEnd / 1024), (unsigned long)(ota.eraseTarget / 1024),
+                  otaEraseRunning ? " (erasing)" : "", (unsigned long)(ota.hashedBytes / 1024),
+                  ota.waitedForErase, ota.statusesSent);
+}
+
+// =============================================================================
+// TELEMETRY
+// =============================================================================
+// Bucket = 2 * bit length + the next bit down: 1, 2, 3, 4, 6, 8, 12, 16, ...
+void recordTiming(timing_histogram_t& h, uint32_t us) {
+    uint8_t bucket = 0;
+    if (us >= 2) {
+        uint8_t msb = 31 - __builtin_clz(us);
+        bucket = 2 * msb + ((us >> (msb - 1)) & 1) - 1;
+    }
+    h.counts[min<uint8_t>(bucket, TIMING_BUCKETS - 1)]++;
+    h.total++;
+    if (us > h.maxUs) h.maxUs = us;
+}
+
+// Lower edge of the bucket holding the percentile; within half an octave
+uint32_t timingPercentile(const timing_histogram_t& h, uint8_t pct) {
+    if (!h.total) return 0;
+    
+    uint32_t rank = ((uint64_t)h.total * pct + 99) / 100;
+    uint32_t seen = 0;
+    for (uint8_t bucket = 0; bucket < TIMING_BUCKETS; bucket++) {
+        seen += h.counts[bucket];
+        if (seen >= rank) {
+            if (bucket == 0) return min<uint32_t>(1, h.maxUs);
+            uint8_t msb = (bucket + 1) / 2;
+            uint32_t edge = (2 | ((bucket + 1) & 1)) << (msb - 1);
+            return min<uint32_t>(edge, h.maxUs);
+        }
+    }
+    return h.maxUs;
+}
+
+// Same model as FastLED's power management: per-channel drive plus idle draw
+uint32_t estimateCurrentMa(const CRGB* pixels, uint16_t count, uint8_t brightness) {
+    uint32_t channelSum = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        channelSum += pixels[i].r + pixels[i].g + pixels[i].b;
+    }
+    return (uint64_t)channelSum * brightness * LED_MA_PER_CHANNEL / (255UL * 255UL) +
+           (uint32_t)count * LED_IDLE_MA;
+}
+
+uint8_t* putVarint(uint8_t* out, uint32_t value) {
+    while (value >= 0x80) {
+        *out++ = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    *out++ = value;
+    return out;
+}
+
+void collectTelemetry(int32_t* fields) {
+    unsigned long elapsed = millis() - lastTelemetry;
+    
+    // A static scene renders at full rate but sends almost nothing to the LEDs
+    unsigned long shown = framesShown - telemetryFramesAtLast;
+    unsigned long rendered = shown + framesSkipped - telemetrySkippedAtLast;
+    fields[TELEM_FPS_X10] = elapsed ? rendered * 10000UL / elapsed : 0;
+    fields[TELEM_SHOWN_FPS_X10] = elapsed ? shown * 10000UL / elapsed : 0;
+    fields[TELEM_RENDER_P50_US] = timingPercentile(renderTiming, 50);
+    fields[TELEM_RENDER_P95_US] = timingPercentile(renderTiming, 95);
+    fields[TELEM_SHOW_P50_US] = timingPercentile(showTiming, 50);
+    fields[TELEM_SHOW_P95_US] = timingPercentile(showTiming, 95);
+    fields[TELEM_SHOW_MAX_US] = showTiming.maxUs;
+    fields[TELEM_COMMANDS] = commandsReceived;
+    fields[TELEM_DROPPED] = commandsDropped;
+    fields[TELEM_COALESCED] = commandsCoalesced;
+    fields[TELEM_FREE_HEAP] = ESP.getFreeHeap();
+    fields[TELEM_MIN_HEAP] = ESP.getMinFreeHeap();
+    fields[TELEM_RSSI] = lastRssi;
+    fields[TELEM_CURRENT_MA] = estimatedCurrentMa;
+    fields[TELEM_UPTIME_S] = millis() / 1000;
+}
+
+// [flags][seq varint][field count][zigzag varint per field]
+uint8_t encodeTelemetry(const int32_t* fields, bool keyframe, uint8_t* out) {
+    uint8_t* p = out;
+    *p++ = keyframe ? TELEMETRY_FLAG_KEYFRAME : 0;
+    p = putVarint(p, telemetrySeq);
+    *p++ = TELEM_FIELD_COUNT;
+    for (uint8_t i = 0; i < TELEM_FIELD_COUNT; i++) {
+        int32_t value = keyframe ? fields[i] : fields[i] - telemetryLast[i];
+        p = putVarint(p, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+    }
+    return p - out;
+}
+
+void sendTelemetry(bool keyframe) {
+    int32_t fields[TELEM_FIELD_COUNT];
+    uint8_t encoded[TELEM_FIELD_COUNT * 5 + 8];
+    
+    collectTelemetry(fields);
+    uint8_t length = encodeTelemetry(fields, keyframe, encoded);
+    
+    wire_packet_t packet;
+    wireBegin(packet);
+    wireAppend(packet, WIRE_REC_TELEMETRY, encoded, length);
+    wireSend(packet, controllerAddress);
+    
+    memcpy(telemetryLast, fields, sizeof(telemetryLast));
+    telemetrySeq++;
+    lastTelemetryBytes = packet.len;
+    lastTelemetry = millis();
+    telemetryFramesAtLast = framesShown;
+    telemetrySkippedAtLast = framesSkipped;
+    memset(&renderTiming, 0, sizeof(renderTiming));
+    memset(&showTiming, 0, sizeof(showTiming));
+}
+
+void serviceTelemetry() {
+    if (telemetryRequested) {
+        telemetryRequested = false;
+        sendTelemetry(true);
+    }
+    else if (millis() - lastTelemetry >= TELEMETRY_INTERVAL_MS) {
+        sendTelemetry(telemetrySeq % TELEMETRY_KEYFRAME_EVERY == 0);
+    }
+}
+
+void printTelemetry() {
+    int32_t f[TELEM_FIELD_COUNT];
+    collectTelemetry(f);
+    
+    Serial.printf("📊 Telemetry: report #%u every %d s, last %d bytes on air\n",
+                  telemetrySeq, TELEMETRY_INTERVAL_MS / 1000, lastTelemetryBytes);
+    Serial.printf("   FPS %d.%d rendered, %d.%d shown | render p50 %ld µs p95 %ld µs | show p50 %ld µs p95 %ld µs max %ld µs\n",
+                  (int)(f[TELEM_FPS_X10] / 10), (int)(f[TELEM_FPS_X10] % 10),
+                  (int)(f[TELEM_SHOWN_FPS_X10] / 10), (int)(f[TELEM_SHOWN_FPS_X10] % 10),
+                  (long)f[TELEM_RENDER_P50_US], (long)f[TELEM_RENDER_P95_US],
+                  (long)f[TELEM_SHOW_P50_US], (long)f[TELEM_SHOW_P95_US], (long)f[TELEM_SHOW_MAX_US]);
+    Serial.printf("   Commands %ld, dropped %ld, coalesced %ld\n",
+                  (long)f[TELEM_COMMANDS], (long)f[TELEM_DROPPED], (long)f[TELEM_COALESCED]);
+    Serial.printf("   Heap %ld free, %ld min | RSSI %ld dBm | ~%ld mA\n",
+                  (long)f[TELEM_FREE_HEAP], (long)f[TELEM_MIN_HEAP],
+                  (long)f[TELEM_RSSI], (long)f[TELEM_CURRENT_MA]);
+}
+
+// =============================================================================
+// FRAMEBUFFER PREVIEW
+// =============================================================================
+// From the WiFi task or the serial command. Any config change starts over
+// with a key frame, which is also how a controller that lost sync gets one.
+void configurePreview(const preview_config_t* config) {
+    if (config->fps && !previewFps) {
+        previewEnabledMs = millis();
+        memset(&previewStats, 0, sizeof(previewStats));
+    }
+    previewFps = min<uint8_t>(config->fps, PREVIEW_FPS_MAX);
+    if (config->sharePct) previewSharePct = min<uint8_t>(config->sharePct, PREVIEW_SHARE_MAX);
+    previewScale = config->scale;
+    previewKeyframeWanted = true;
+}
+
+// Same scale on both axes; grows until the preview fits one packet
+uint8_t previewGeometry(uint8_t* width, uint8_t* height) {
+    uint8_t scale = previewScale ? previewScale : 1;
+    while ((uint32_t)((matrixWidth + scale - 1) / scale) * ((matrixHeight + scale - 1) / scale) > PREVIEW_MAX_PIXELS ||
+           (matrixWidth + scale - 1) / scale > 255 || (matrixHeight + scale - 1) / scale > 255) {
+        scale++;
+    }
+    *width = (matrixWidth + scale - 1) / scale;
+    *height = (matrixHeight + scale - 1) / scale;
+    return scale;
+}
+
+// Averages each scale x scale block of what was last rendered (zone
+// brightness and overlays included), then keeps 3-3-2 bits of R, G, B
+void samplePreview(uint8_t* out, uint8_t scale, uint8_t width, uint8_t height) {
+    for (uint8_t py = 0; py < height; py++) {
+        for (uint8_t px = 0; px < width; px++) {
+            uint16_t r = 0, g = 0, b = 0, n = 0;
+            for (uint16_t y = py * scale; y < min<uint16_t>((py + 1) * scale, matrixHeight); y++) {
+                for (uint16_t x = px * scale; x < min<uint16_t>((px + 1) * scale, matrixWidth); x++) {
+                    uint16_t p = pixelMap[y * matrixWidth + x];
+                    n++;
+                    if (p == LAYOUT_UNMAPPED) continue;
+                    r += leds[p].r;
+                    g += leds[p].g;
+                    b += leds[p].b;
+                }
+            }
+            r /= n;
+            g /= n;
+            b /= n;
+            *out++ = (r & 0xE0) | ((g >> 3) & 0x1C) | (b >> 6);
+        }
+    }
+}
+
+// At most previewFps, only after a new frame was shown (or a key frame is
+// due), and only while the airtime credit covers the packet
+void servicePreview() {
+    uint8_t fps = previewFps;
+    if (!fps) return;
+    
+    unsigned long now = millis();
+    if (now - lastPreviewMs < 1000UL / fps) return;
+    bool keyframeDue = previewKeyframeWanted || now - lastPreviewKeyMs >= PREVIEW_KEYFRAME_MS;
+    if (framesShown == previewFramesAtLast && !keyframeDue) return;
+    lastPreviewMs = now;
+    
+    // Credit accrues at the configured share of wall time
+    int64_t nowUs = esp_timer_get_time();
+    uint64_t credit = previewCreditUs + (uint64_t)(nowUs - previewCreditAtUs) * previewSharePct / 100;
+    previewCreditUs = min<uint64_t>(credit, PREVIEW_BURST_US);
+    previewCreditAtUs = nowUs;
+    
+    unsigned long encodeStart = micros();
+    uint8_t width, height;
+    uint8_t scale = previewGeometry(&width, &height);
+    uint16_t count = width * height;
+    uint8_t pixels[PREVIEW_MAX_PIXELS];
+    samplePreview(pixels, scale, width, height);
+    
+    bool keyframe = keyframeDue || width != previewRefWidth || height != previewRefHeight;
+    if (!keyframe && memcmp(pixels, previewReference, count) == 0) {
+        previewStats.unchanged++;
+        previewFramesAtLast = framesShown;
+        return;
+    }
+    
+    uint8_t value[ESP_NOW_MAX_DATA_LEN - sizeof(wire_header_t) - sizeof(wire_record_t)];
+    uint16_t room = sizeof(value) - sizeof(preview_header_t);
+    uint8_t* encoded = value + sizeof(preview_header_t);
+    uint16_t length = encodeStreamRle(pixels, keyframe ? nullptr : previewReference, count, encoded, room);
+    if (!length) {
+        // A noisy delta can outgrow the raw frame
+        keyframe = true;
+        length = encodeStreamRle(pixels, nullptr, count, encoded, room);
+    }
+    
+    preview_header_t* header = (preview_header_t*)value;
+    header->frame = previewFrameSeq + 1;
+    header->base = keyframe ? header->frame : previewFrameSeq;
+    header->flags = keyframe ? PREVIEW_FLAG_KEYFRAME : 0;
+    header->width = width;
+    header->height = height;
+    recordTiming(previewStats.encodeTime, micros() - encodeStart);
+    
+    wire_packet_t packet;
+    int packetLen = sizeof(wire_header_t) + sizeof(wire_record_t) + sizeof(preview_header_t) + length;
+    uint32_t airtimeUs = estimateAirtimeUs(packetLen);
+    if (previewCreditUs < airtimeUs) {
+        // Try again next period with more credit; the frame is not lost
+        previewStats.overBudget++;
+        return;
+    }
+    
+    wireBegin(packet);
+    wireAppend(packet, WIRE_REC_PREVIEW, value, sizeof(preview_header_t) + length);
+    if (wireSend(packet, controllerAddress) != ESP_OK) {
+        previewStats.sendErrors++;
+        return;
+    }
+    
+    previewCreditUs -= airtimeUs;
+    previewFrameSeq++;
+    memcpy(previewReference, pixels, count);
+    previewRefWidth = width;
+    previewRefHeight = height;
+    previewFramesAtLast = framesShown;
+    if (keyframe) {
+        previewKeyframeWanted = false;
+        lastPreviewKeyMs = now;
+        previewStats.keyframes++;
+    }
+    previewStats.sent++;
+    previewStats.bytes += packet.len;
+    previewStats.airtimeUs += airtimeUs;
+}
+
+// preview                 - show settings and stats
+// preview off | fps <n>   - stop / send up to n previews a second
+// preview share <pct>     - airtime cap
+// preview scale <n>       - LEDs per preview pixel side, 0 = automatic
+void handlePreviewCommand(String args) {
+    preview_config_t config = {previewFps, 0, previewScale};
+    int value = args.indexOf(' ') > 0 ? args.substring(args.indexOf(' ') + 1).toInt() : -1;
+    
+    if (args == "off") {
+        config.fps = 0;
+    }
+    else if (args.startsWith("fps ") && value >= 1 && value <= PREVIEW_FPS_MAX) {
+        config.fps = value;
+    }
+    else if (args.startsWith("share ") && value >= 1 && value <= PREVIEW_SHARE_MAX) {
+        config.sharePct = value;
+    }
+    else if (args.startsWith("scale ") && value >= 0 && value <= 16) {
+        config.scale = value;
+    }
+    else if (args.length() > 0) {
+        Serial.printf("❌ Usage: preview [off|fps <1-%d>|share <1-%d>|scale <0-16>]\n",
+                      PREVIEW_FPS_MAX, PREVIEW_SHARE_MAX);
+        return;
+    }
+    if (args.length() > 0) configurePreview(&config);
+    printPreview();
+}
+
+void printPreview() {
+    uint8_t width, height;
+    uint8_t scale = previewGeometry(&width, &height);
+    const preview_stats_t& p = previewStats;
+    
+    if (previewFps) {
+        Serial.printf("📺 Preview: %dx%d (1:%d) at up to %d fps, %d%% of airtime at most\n",
+                      width, height, scale, previewFps, previewSharePct);
+    } else {
+        Serial.printf("📺 Preview: off (would be %dx%d, 1:%d)\n", width, height, scale);
+    }
+    unsigned long elapsedMs = millis() - previewEnabledMs;
+    Serial.printf("   Sent %lu (%lu key) | %lu unchanged, %lu over budget, %lu send errors\n",
+                  p.sent, p.keyframes, p.unchanged, p.overBudget, p.sendErrors);
+    Serial.printf("   %lu bytes, %lu per preview | %lu µs airtime = %lu.%lu%% since enabled\n",
+                  p.bytes, p.sent ? p.bytes / p.sent : 0, p.airtimeUs,
+                  elapsedMs ? p.airtimeUs / 10 / elapsedMs : 0, elapsedMs ? p.airtimeUs / elapsedMs % 10 : 0);
+    Serial.printf("   Encode p50 %lu µs p95 %lu µs max %lu µs\n",
+                  (unsigned long)timingPercentile(p.encodeTime, 50),
+                  (unsigned long)timingPercentile(p.encodeTime, 95), (unsigned long)p.encodeTime.maxUs);
+}
+
+// =============================================================================
+// LINK QUALITY
+// =============================================================================
+// Runs in the WiFi task for every packet from a paired controller
+void noteLinkArrival(int8_t rssi) {
+    link_stats_t& l = linkStats;
+    int bucket = (rssi - LINK_RSSI_MIN) / LINK_RSSI_STEP;
+    l.rssiBuckets[constrain(bucket, 0, LINK_RSSI_BUCKETS - 1)]++;
+    
+    if (l.packets == 0) {
+        l.rssiEwmaX16 = rssi * 16;
+        l.rssiMin = l.rssiMax = rssi;
+    } else {
+        l.rssiEwmaX16 += rssi - l.rssiEwmaX16 / 16;
+        if (rssi < l.rssiMin) l.rssiMin = rssi;
+        if (rssi > l.rssiMax) l.rssiMax = rssi;
+    }
+    
+    // RFC 3550 style: smoothed change between consecutive inter-arrival gaps
+    int64_t now = esp_timer_get_time();
+    if (l.packets > 0) {
+        uint32_t gap = now - l.lastArrivalUs;
+        if (l.packets > 1) {
+            uint32_t change = gap > l.lastGapUs ? gap - l.lastGapUs : l.lastGapUs - gap;
+            l.jitterUsX16 += change - l.jitterUsX16 / 16;
+        }
+        l.lastGapUs = gap;
+    }
+    l.lastArrivalUs = now;
+    l.packets++;
+}
+
+void noteLinkSend(bool success) {
+    linkStats.sends++;
+    if (!success) linkStats.sendFailures++;
+}
+
+// Closes the window every LINK_WINDOW_MS; adaptation uses the last full one
+void serviceLinkWindow() {
+    link_window_t& w = linkWindow;
+    if (millis() - w.startMs < LINK_WINDOW_MS) return;
+    
+    uint32_t lost = linkStats.seqLost - min(linkStats.seqRecovered, linkStats.seqLost);
+    uint32_t packets = linkStats.packets - w.packets;
+    uint32_t windowLost = lost - w.lost;
+    uint32_t sends = linkStats.sends - w.sends;
+    uint32_t failures = linkStats.sendFailures - w.failures;
+    
+    w.lossPermille = (packets + windowLost) ? 1000UL * windowLost / (packets + windowLost) : 0;
+    w.failPermille = sends ? 1000UL * failures / sends : 0;
+    
+    w.startMs = millis();
+    w.packets = linkStats.packets;
+    w.lost = lost;
+    w.sends = linkStats.sends;
+    w.failures = linkStats.sendFailures;
+}
+
+// A lossy link gets faster keepalives so missed state is found sooner; a
+// clean strong one gets slower ones to save airtime.
+unsigned long linkAckIntervalMs() {
+    const link_window_t& w = linkWindow;
+    if (w.lossPermille > LINK_POOR_LOSS_PERMILLE || w.failPermille > LINK_POOR_LOSS_PERMILLE) {
+        return STATE_ACK_INTERVAL_MS / 2;
+    }
+    if (linkStats.packets && w.lossPermille < LINK_GOOD_LOSS_PERMILLE &&
+        w.failPermille < LINK_GOOD_LOSS_PERMILLE && linkStats.rssiEwmaX16 / 16 > LINK_GOOD_RSSI) {
+        return STATE_ACK_INTERVAL_MS * 3;
+    }
+    return STATE_ACK_INTERVAL_MS;
+}
+
+// Back off retries while the controller isn't acking at the MAC layer
+unsigned long linkRetryDelayMs() {
+    uint8_t failures = min<uint8_t>(consecutiveSendFailures, 6);
+    return min<unsigned long>((unsigned long)LINK_RETRY_BASE_MS << failures, LINK_RETRY_MAX_MS);
+}
+
+// Upper edge of the bucket holding the percentile
+int8_t linkRssiPercentile(uint8_t pct) {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < LINK_RSSI_BUCKETS; i++) total += linkStats.rssiBuckets[i];
+    if (!total) return 0;
+    
+    uint32_t rank = ((uint64_t)total * pct + 99) / 100;
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < LINK_RSSI_BUCKETS; i++) {
+        seen += linkStats.rssiBuckets[i];
+        if (seen >= rank) return LINK_RSSI_MIN + (i + 1) * LINK_RSSI_STEP;
+    }
+    return linkStats.rssiMax;
+}
+
+void printLinkStats() {
+    const link_stats_t& l = linkStats;
+    uint32_t lost = l.seqLost - min(l.seqRecovered, l.seqLost);
+    
+    Serial.printf("📶 Link: %lu packets\n", (unsigned long)l.packets);
+    if (l.packets) {
+        Serial.printf("   RSSI: avg %d dBm, p10 %d, p50 %d, p90 %d, range %d..%d\n",
+                      (int)(l.rssiEwmaX16 / 16), linkRssiPercentile(10), linkRssiPercentile(50),
+                      linkRssiPercentile(90), l.rssiMin, l.rssiMax);
+        
+        // Histogram, one row per non-empty bucket
+        uint32_t peak = 1;
+        for (uint8_t i = 0; i < LINK_RSSI_BUCKETS; i++) peak = max(peak, l.rssiBuckets[i]);
+        for (uint8_t i = 0; i < LINK_RSSI_BUCKETS; i++) {
+            if (!l.rssiBuckets[i]) continue;
+            Serial.printf("   %4d dBm | %-30s %lu\n", LINK_RSSI_MIN + i * LINK_RSSI_STEP,
+                          repeat("#", max(1UL, 30UL * l.rssiBuckets[i] / peak)).c_str(),
+                          (unsigned long)l.rssiBuckets[i]);
+        }
+        Serial.printf("   Jitter: %lu µs | last gap %lu µs\n",
+                      (unsigned long)(l.jitterUsX16 / 16), (unsigned long)l.lastGapUs);
+    }
+    Serial.printf("   Loss: %lu of %lu by sequence (%lu arrived late) | last %ds: %d.%d%%\n",
+                  (unsigned long)lost, (unsigned long)(l.packets + lost), (unsigned long)l.seqRecovered,
+                  LINK_WINDOW_MS / 1000, linkWindow.lossPermille / 10, linkWindow.lossPermille % 10);
+    Serial.printf("   Sends: %lu, %lu failed | last %ds: %d.%d%%\n",
+                  (unsigned long)l.sends, (unsigned long)l.sendFailures,
+                  LINK_WINDOW_MS / 1000, linkWindow.failPermille / 10, linkWindow.failPermille % 10);
+    Serial.printf("   Adapted: keepalive every %lu ms, ack retry after %lu ms\n",
+                  linkAckIntervalMs(), linkRetryDelayMs());
+}
+
+// =============================================================================
+// STATE VERSIONS
+// =============================================================================
+// The controller bumps a 16-bit version on every state change and repeats
+// the full state with it until we ack. Its idle heartbeat carries only the
+// version, so a link that is in sync costs two bytes of payload.
+bool versionNewer(uint16_t a, uint16_t b) {
+    return (int16_t)(a - b) > 0;
+}
+
+// A rebooted controller counts from 0 again. Same rule as the seq windows:
+// a version well behind ours, or any older one after a quiet spell, starts
+// the count over. Equal versions are never a restart.
+bool stateVersionRestarted(uint16_t version) {
+    int16_t ahead = (int16_t)(version - appliedVersion);
+    unsigned long quietMs = renderMillis() - lastStateRxMs;
+    lastStateRxMs = renderMillis();
+    if (!stateSyncActive || ahead >= 0) return false;
+    if (-ahead < SEQ_WINDOW && quietMs <= SEQ_RESYNC_SILENCE_MS) return false;
+    stateStats.resyncs++;
+    return true;
+}
+
+// Runs in the WiFi task. False means the commands that follow are a
+// retransmit of something already applied; they are acked but skipped.
+bool acceptStateVersion(const state_version_t* state) {
+    bool restarted = stateVersionRestarted(state->version);
+    bool fresh = !stateSyncActive || restarted || versionNewer(state->version, appliedVersion);
+    stateSyncActive = true;
+    stateAckPending = true;
+    
+    if (!fresh) {
+        stateStats.duplicates++;
+        return false;
+    }
+    
+    appliedVersion = state->version;
+    if (restarted || versionNewer(appliedVersion, controllerVersion)) controllerVersion = appliedVersion;
+    stateStats.applied++;
+    
+    // Issue-to-apply delay on the shared clock, retransmit rounds included
+    if (clockSynced) {
+        unsigned long stale = effectMillis() - state->issuedMs;
+        if (stale < 60000UL) {
+            stateStats.staleSamples++;
+            stateStats.staleTotalMs += stale;
+            if (stale > stateStats.staleMaxMs) stateStats.staleMaxMs = stale;
+            if (stale > STATE_STALE_LATE_MS) stateStats.staleLate++;
+        }
+    }
+    return true;
+}
+
+void handleStateHeartbeat(const state_heartbeat_t* heartbeat) {
+    // After a restart, claim to be one behind: the ack then names a version
+    // the controller knows, and it resends its full state
+    if (stateVersionRestarted(heartbeat->version)) appliedVersion = heartbeat->version - 1;
+    stateSyncActive = true;
+    isConnected = true;
+    controllerVersion = heartbeat->version;
+    
+    // Only answer when out of step; an in-sync heartbeat needs no reply
+    if (heartbeat->version != appliedVersion) {
+        if (versionNewer(heartbeat->version, appliedVersion)) stateStats.behind++;
+        stateAckPending = true;
+    }
+}
+
+void sendStateAck() {
+    state_heartbeat_t ack = {appliedVersion};
+    wire_packet_t packet;
+    wireBegin(packet);
+    wireAppend(packet, WIRE_REC_STATE_ACK, &ack, sizeof(ack));
+    if (wireSend(packet, controllerAddress, SEND_STATE_ACK) == ESP_OK) {
+        stateStats.acksSent++;
+    }
+    lastStateAck = millis();
+}
+
+// Acks are sent from the loop rather than the receive callback
+void serviceStateSync() {
+    if (!stateSyncActive) return;
+    
+    bool retryDue = stateAckPending && (long)(millis() - nextAckRetryMs) >= 0;
+    if (retryDue || millis() - lastStateAck >= linkAckIntervalMs()) {
+        stateAckPending = false;
+        sendStateAck();
+    }
+}
+
+void handleLossCommand(String args) {
+    int pct = args.toInt();
+    if (pct < 0 || pct > 100) {
+        Serial.println("❌ Loss must be 0-100");
+        return;
+    }
+    simulatedLossPct = pct;
+    memset(&stateStats, 0, sizeof(stateStats));
+    wireStats.simulatedDrops = 0;
+    Serial.printf("🎲 Dropping %d%% of incoming packets, state stats reset\n", pct);
+}
+
+void printStateSync() {
+    Serial.printf("🔁 State sync: %s\n", stateSyncActive ? "versioned" : "legacy polling");
+    Serial.printf("   Applied v%u | Controller v%u%s\n", appliedVersion, controllerVersion,
+                  appliedVersion == controllerVersion ? " (in sync)" : " (behind)");
+    Serial.printf("   Updates: %lu applied, %lu retransmits skipped, %lu times behind, %lu resyncs\n",
+                  stateStats.applied, stateStats.duplicates, stateStats.behind, stateStats.resyncs);
+    Serial.printf("   Acks: %lu sent | Link: %lu send failures\n",
+                  stateStats.acksSent, stateStats.sendFailures);
+    if (stateStats.staleSamples) {
+        Serial.printf("   Stale: avg %lu ms, max %lu ms, %lu late (>%d ms) of %lu\n",
+                      stateStats.staleTotalMs / stateStats.staleSamples, stateStats.staleMaxMs,
+                      stateStats.staleLate, STATE_STALE_LATE_MS, stateStats.staleSamples);
+    } else {
+        Serial.println("   Stale: no samples (needs time sync)");
+    }
+    if (simulatedLossPct) {
+        Serial.printf("   Simulated loss: %d%% (%lu dropped)\n", simulatedLossPct, wireStats.simulatedDrops);
+    }
+}
+
+// =============================================================================
+// TIME SYNC
+// =============================================================================
+int64_t sharedMicros() {
+    if (replayActive) return replayClockUs + replayClockOffsetUs;
+    return esp_timer_get_time() + clockOffsetUs;
+}
+
+// Time base for effect phase: the controller's clock once synced
+unsigned long effectMillis() {
+    return (unsigned long)(sharedMicros() / 1000);
+}
+
+void sendTimePing() {
+    time_ping_t ping = {esp_timer_get_time()};
+    wire_packet_t packet;
+    wireBegin(packet);
+    wireAppend(packet, WIRE_REC_TIME_PING, &ping, sizeof(ping));
+    if (wireSend(packet, controllerAddress) == ESP_OK) {
+        timePingsSent++;
+    }
+}
+
+// Runs in the WiFi task. Offset and RTT per NTP; the sample with the lowest
+// RTT in the window is the least disturbed by queuing and wins.
+void handleTimePong(const time_pong_t* pong) {
+    int64_t t4 = esp_timer_get_time();
+    // Our own recent ping, and a controller clock counting up from its boot;
+    // anything else is garbage that would overflow the sums below
+    if (pong->t1 > t4 || t4 - pong->t1 > TIME_MAX_RTT_US) return;
+    if (pong->t2 < 0 || pong->t3 < pong->t2 || pong->t3 > INT64_MAX / 4) return;
+    int64_t rtt = (t4 - pong->t1) - (pong->t3 - pong->t2);
+    if (rtt < 0 || rtt > TIME_MAX_RTT_US) return;
+    
+    time_sample_t& sample = timeSamples[timeSampleNext];
+    sample.offsetUs = ((pong->t2 - pong->t1) + (pong->t3 - t4)) / 2;
+    sample.rttUs = rtt;
+    sample.localUs = t4;
+    timeSampleNext = (timeSampleNext + 1) % TIME_SAMPLES;
+    if (timeSampleCount < TIME_SAMPLES) timeSampleCount++;
+    timePongsUsed++;
+    
+    const time_sample_t* best = &timeSamples[0];
+    for (uint8_t i = 1; i < timeSampleCount; i++) {
+        if (timeSamples[i].rttUs < best->rttUs) best = &timeSamples[i];
+    }
+    
+    // Drift from how the best offset moved over at least 10 s
+    if (!clockSynced) {
+        driftRefOffsetUs = best->offsetUs;
+        driftRefAtUs = best->localUs;
+    } else if (best->localUs - driftRefAtUs > 10000000LL) {
+        float ppm = (float)(best->offsetUs - driftRefOffsetUs) * 1e6 / (best->localUs - driftRefAtUs);
+        clockDriftPpm = clockDriftPpm * 0.75 + constrain(ppm, -500.0, 500.0) * 0.25;
+        driftRefOffsetUs = best->offsetUs;
+        driftRefAtUs = best->localUs;
+    }
+    
+    targetOffsetUs = best->offsetUs;
+    targetOffsetAtUs = best->localUs;
+    lastSyncErrorUs = best->rttUs / 2;
+    
+    if (!clockSynced) {
+        clockOffsetUs = targetOffsetUs;
+        lastSlewUs = t4;
+        clockSynced = true;
+    }
+}
+
+// Slews the applied offset toward the drift-corrected estimate so the shared
+// clock never jumps (except for gross errors) and never runs backwards.
+void serviceTimeSync() {
+    unsigned long interval = timeSampleCount < TIME_SAMPLES ? TIME_SYNC_FAST_MS : TIME_SYNC_INTERVAL_MS;
+    if (millis() - lastTimeSync >= interval) {
+        lastTimeSync = millis();
+        sendTimePing();
+    }
+    
+    if (!clockSynced) return;
+    
+    int64_t now = esp_timer_get_time();
+    int64_t target = targetOffsetUs + (int64_t)(clockDriftPpm * (now - targetOffsetAtUs) / 1e6);
+    int64_t error = target - clockOffsetUs;
+    int64_t maxStep = (now - lastSlewUs) * TIME_SLEW_PPM / 1000000;
+    lastSlewUs = now;
+    
+    if (error > TIME_STEP_THRESHOLD_US || error < -TIME_STEP_THRESHOLD_US) {
+        clockOffsetUs = target;
+    } else {
+        clockOffsetUs += constrain(error, -maxStep, maxStep);
+    }
+}
+
+void printTimeSync() {
+    int64_t now = esp_timer_get_time();
+    int64_t target = targetOffsetUs + (int64_t)(clockDriftPpm * (now - targetOffsetAtUs) / 1e6);
+    
+    Serial.printf("⏱️  Time sync: %s\n", clockSynced ? "locked" : "unsynced (local clock)");
+    Serial.printf("   Offset: %lld µs applied, %lld µs still slewing\n",
+                  (long long)clockOffsetUs, (long long)(target - clockOffsetUs));
+    Serial.printf("   Sync error: ±%lld µs (half best RTT) | Drift: %.1f ppm\n",
+                  (long long)lastSyncErrorUs, clockDriftPpm);
+    Serial.printf("   Pings: %lu sent, %lu usable replies\n", timePingsSent, timePongsUsed);
+}
+
+// =============================================================================
+// LIVE PARAMETERS
+// =============================================================================
+// Runs in the WiFi task. Samples carry the controller's time once the
+// clocks are synced; before that, arrival time is the best there is.
+void queueLiveSample(const live_sample_t* sample) {
+    uint8_t zone = sample->zone;
+    if (zone != ZONE_ALL && (zone >= MAX_ZONES || !zones[zone].active)) {
+        wireStats.zoneFiltered++;
+        commandsDropped++;
+        return;
+    }
+    
+    live_point_t point;
+    point.t = clockSynced ? sample->sharedMs : effectMillis();
+    memcpy(point.v, &sample->red, LIVE_PARAM_COUNT);
+    int32_t lead = (int32_t)(point.t - (effectMillis() - liveDelayMs));
+    
+    portENTER_CRITICAL(&liveMux);
+    liveStats.samples++;
+    if (lead < 0) liveStats.late++;
+    if (liveStats.samples == 1 || lead < liveStats.leadMinMs) liveStats.leadMinMs = lead;
+    liveStats.leadTotalMs += lead;
+    for (uint8_t z = 0; z < MAX_ZONES; z++) {
+        if (zone == z || (zone == ZONE_ALL && zones[z].active)) {
+            insertLivePoint(liveTracks[z], point);
+            liveTracks[z].active = true;
+            liveTracks[z].lastSampleMs = millis();
+        }
+    }
+    portEXIT_CRITICAL(&liveMux);
+}
+
+// Keeps the history in time order, so reordered samples still interpolate
+void insertLivePoint(live_track_t& track, const live_point_t& point) {
+    uint8_t i = track.count;
+    while (i > 0 && (int32_t)(track.points[i - 1].t - point.t) > 0) i--;
+    if (i > 0 && track.points[i - 1].t == point.t) {
+        liveStats.duplicates++;
+        return;
+    }
+    if (i < track.count) liveStats.reordered++;
+    
+    if (track.count == LIVE_SAMPLES) {
+        if (i == 0) return;   // Older than the whole history
+        memmove(&track.points[0], &track.points[1], (i - 1) * sizeof(live_point_t));
+        track.count--;
+        i--;
+    } else {
+        memmove(&track.points[i + 1], &track.points[i], (track.count - i) * sizeof(live_point_t));
+    }
+    track.points[i] = point;
+    track.count++;
+}
+
+// Values at time t: linear between the samples around t, continued along
+// the last slope for up to LIVE_EXTRAPOLATE_MS past the newest, then held
+uint8_t evaluateLive(const live_track_t& track, uint32_t t, uint8_t* out) {
+    const live_point_t* p = track.points;
+    uint8_t n = track.count;
+    
+    if ((int32_t)(t - p[0].t) <= 0) {
+        memcpy(out, p[0].v, LIVE_PARAM_COUNT);
+        return LIVE_HELD;
+    }
+    for (uint8_t i = 1; i < n; i++) {
+        if ((int32_t)(t - p[i].t) > 0) continue;
+        int32_t span = p[i].t - p[i - 1].t;
+        int32_t into = t - p[i - 1].t;
+        for (uint8_t j = 0; j < LIVE_PARAM_COUNT; j++) {
+            out[j] = p[i - 1].v[j] + ((int32_t)p[i].v[j] - p[i - 1].v[j]) * into / span;
+        }
+        return LIVE_INTERPOLATED;
+    }
+    
+    const live_point_t& last = p[n - 1];
+    if (n < 2) {
+        memcpy(out, last.v, LIVE_PARAM_COUNT);
+        return LIVE_HELD;
+    }
+    const live_point_t& prev = p[n - 2];
+    int32_t span = last.t - prev.t;
+    int32_t ahead = t - last.t;
+    uint8_t kind = LIVE_EXTRAPOLATED;
+    if (ahead > LIVE_EXTRAPOLATE_MS) {
+        ahead = LIVE_EXTRAPOLATE_MS;
+        kind = LIVE_HELD;
+    }
+    for (uint8_t j = 0; j < LIVE_PARAM_COUNT; j++) {
+        int32_t value = last.v[j] + ((int32_t)last.v[j] - prev.v[j]) * ahead / span;
+        out[j] = constrain(value, 0, 255);
+    }
+    return kind;
+}
+
+// Sets the zone's parameters for this frame; the effect keeps its phase
+void applyLiveParameters(uint8_t z) {
+    live_track_t track;
+    portENTER_CRITICAL(&liveMux);
+    track = liveTracks[z];
+    portEXIT_CRITICAL(&liveMux);
+    if (!track.count) return;
+    
+    uint8_t v[LIVE_PARAM_COUNT];
+    uint8_t kind = evaluateLive(track, effectMillis() - liveDelayMs, v);
+    if (kind == LIVE_INTERPOLATED) liveStats.interpolated++;
+    else if (kind == LIVE_EXTRAPOLATED) liveStats.extrapolated++;
+    else liveStats.held++;
+    
+    led_zone_t& zone = zones[z];
+    zone.color = CRGB(v[LIVE_RED], v[LIVE_GREEN], v[LIVE_BLUE]);
+    zone.brightness = constrain(v[LIVE_BRIGHTNESS], 1, 100);
+    updateWhiteMix(zone.whiteMix, v[LIVE_WHITE], v[LIVE_WARM_WHITE]);
+    zoneScale[z] = map(zone.brightness, 1, 100, 0, 255);
+    
+    if (millis() - track.lastSampleMs > LIVE_IDLE_MS) endLive(z);
+}
+
+// A plain command, or silence, ends live mode; the last values stay
+void endLive(uint8_t z) {
+    portENTER_CRITICAL(&liveMux);
+    liveTracks[z].active = false;
+    liveTracks[z].count = 0;
+    portEXIT_CRITICAL(&liveMux);
+}
+
+void handleLiveCommand(String args) {
+    args.trim();
+    if (args.startsWith("delay ")) {
+        long ms = args.substring(6).toInt();
+        if (ms < 0 || ms > LIVE_DELAY_MAX_MS) {
+            Serial.printf("❌ Delay must be 0-%d ms\n", LIVE_DELAY_MAX_MS);
+            return;
+        }
+        liveDelayMs = ms;
+        Serial.printf("🎚️  Live delay set to %u ms\n", liveDelayMs);
+        return;
+    }
+    if (args == "reset") {
+        portENTER_CRITICAL(&liveMux);
+        memset(&liveStats, 0, sizeof(liveStats));
+        portEXIT_CRITICAL(&liveMux);
+        Serial.println("🔄 Live statistics reset");
+        return;
+    }
+    printLive();
+}
+
+void printLive() {
+    live_stats_t st = liveStats;
+    
+    Serial.printf("🎚️  Live parameters: delay %u ms, extrapolate up to %d ms, %s timestamps\n",
+                  liveDelayMs, LIVE_EXTRAPOLATE_MS, clockSynced ? "controller" : "arrival");
+    Serial.print("   Live zones:");
+    bool any = false;
+    for (uint8_t z = 0; z < MAX_ZONES; z++) {
+        if (!liveTracks[z].active) continue;
+        Serial.printf(" %d (%d samples)", z, liveTracks[z].count);
+        any = true;
+    }
+    Serial.println(any ? "" : " none");
+    Serial.printf("   Samples: %lu | %lu reordered, %lu duplicate, %lu late\n",
+                  st.samples, st.reordered, st.duplicates, st.late);
+    if (st.samples) {
+        Serial.printf("   Lead over the render point: min %ld ms, avg %ld ms\n",
+                      (long)st.leadMinMs, (long)(st.leadTotalMs / (int64_t)st.samples));
+        if (st.leadMinMs < 0) {
+            Serial.printf("   ⚠️  Some samples arrived too late to interpolate; 'live delay %ld' would cover them\n",
+                          (long)min<int32_t>(liveDelayMs - st.leadMinMs + 10, LIVE_DELAY_MAX_MS));
+        }
+    }
+    Serial.printf("   Frames: %lu interpolated, %lu extrapolated, %lu held\n",
+                  st.interpolated, st.extrapolated, st.held);
+}
+
+// =============================================================================
+// TRIGGER OVERLAYS
+// =============================================================================
+const char* const triggerKindNames[] = {"off", "flash", "ripple", "sweep"};
+const char* const sweepDirectionNames[] = {"right", "left", "down", "up"};
+
+// Factory table until 'trigger <id> ...' saves one
+void loadTriggers() {
+    memset(triggerEvents, 0, sizeof(triggerEvents));
+    triggerPrefs.begin("triggers", true);
+    bool stored = triggerPrefs.getBytesLength("table") == sizeof(triggerEvents);
+    if (stored) triggerPrefs.getBytes("table", triggerEvents, sizeof(triggerEvents));
+    triggerPrefs.end();
+    
+    if (!stored) {
+        triggerEvents[0] = {TRIGGER_FLASH, 0, 120, 0, 0};
+        triggerEvents[1] = {TRIGGER_FLASH, 0, 400, 0, 0};
+        triggerEvents[2] = {TRIGGER_RIPPLE, 0, 600, TRIGGER_CENTRE, TRIGGER_CENTRE};
+        triggerEvents[3] = {TRIGGER_SWEEP, SWEEP_RIGHT, 300, 0, 0};
+        triggerEvents[4] = {TRIGGER_SWEEP, SWEEP_LEFT, 300, 0, 0};
+        triggerEvents[5] = {TRIGGER_SWEEP, SWEEP_DOWN, 200, 0, 0};
+        triggerEvents[6] = {TRIGGER_SWEEP, SWEEP_UP, 200, 0, 0};
+    }
+    
+    uint8_t count = 0;
+    for (uint8_t e = 0; e < TRIGGER_EVENTS; e++) {
+        if (triggerEvents[e].kind != TRIGGER_NONE) count++;
+    }
+    Serial.printf("  ✓ %d trigger event%s (%s)\n", count, count == 1 ? "" : "s",
+                  stored ? "from flash" : "default");
+}
+
+void saveTriggers() {
+    triggerPrefs.begin("triggers", false);
+    triggerPrefs.putBytes("table", triggerEvents, sizeof(triggerEvents));
+    triggerPrefs.end();
+}
+
+// Runs in the WiFi task: note the arrival, queue it and wake the loop
+void queueTrigger(const trigger_t* trigger) {
+    uint32_t arrivalUs = micros();
+    uint8_t zone = trigger->zone;
+    if (zone != ZONE_ALL && (zone >= MAX_ZONES || !zones[zone].active)) {
+        wireStats.zoneFiltered++;
+        commandsDropped++;
+        return;
+    }
+    
+    bool duplicate = false;
+    bool queued = false;
+    portENTER_CRITICAL(&triggerMux);
+    triggerStats.received++;
+    if (trigger->cue) {
+        for (uint8_t i = 0; i < TRIGGER_RECENT_CUES; i++) {
+            if (recentCues[i] == trigger->cue && millis() - recentCueMs[i] < TRIGGER_CUE_WINDOW_MS) {
+                duplicate = true;
+            }
+        }
+        if (!duplicate) {
+            recentCues[recentCueNext] = trigger->cue;
+            recentCueMs[recentCueNext] = millis();
+            recentCueNext = (recentCueNext + 1) % TRIGGER_RECENT_CUES;
+        }
+    }
+    uint8_t next = (triggerQueueHead + 1) % TRIGGER_QUEUE;
+    if (duplicate) {
+        triggerStats.duplicates++;
+    } else if (next == triggerQueueTail) {
+        triggerStats.queueFull++;
+    } else {
+        triggerQueue[triggerQueueHead].trigger = *trigger;
+        triggerQueue[triggerQueueHead].arrivalUs = arrivalUs;
+        triggerQueueHead = next;
+        queued = true;
+    }
+    portEXIT_CRITICAL(&triggerMux);
+    
+    if (queued && loopTask) xTaskNotifyGive(loopTask);
+}
+
+// Starts queued triggers, retires finished overlays and works out this
+// frame's envelopes. Running overlays render every TRIGGER_FRAME_MS; a
+// new one, or one that just ended, gets a frame straight away.
+void serviceTriggers() {
+    bool changed = false;
+    trigger_pending_t pending;
+    while (true) {
+        bool any = false;
+        portENTER_CRITICAL(&triggerMux);
+        if (triggerQueueTail != triggerQueueHead) {
+            pending = triggerQueue[triggerQueueTail];
+            triggerQueueTail = (triggerQueueTail + 1) % TRIGGER_QUEUE;
+            any = true;
+        }
+        portEXIT_CRITICAL(&triggerMux);
+        if (!any) break;
+        
+        startOverlay(pending);
+        changed = true;
+    }
+    
+    uint32_t now = renderMicros();
+    for (uint8_t k = 0; k < overlayCount;) {
+        trigger_overlay_t& o = overlays[k];
+        uint32_t elapsedMs = (now - o.startUs) / 1000;
+        // Every overlay is shown at least once, however short
+        if (elapsedMs >= o.event.durationMs && o.shown) {
+            overlays[k] = overlays[--overlayCount];
+            changed = true;
+            continue;
+        }
+        
+        uint8_t progress = min<uint32_t>(elapsedMs * 255 / max<uint16_t>(o.event.durationMs, 1), 255);
+        uint8_t left = 255 - progress;
+        if (o.event.kind == TRIGGER_FLASH) {
+            o.envelope = scale8(left, left);
+        } else if (o.event.kind == TRIGGER_SWEEP) {
+            // The bar enters and leaves the matrix completely
+            int32_t band = TRIGGER_BAND_PX * 16;
+            o.envelope = 255;
+            o.position = progress * (o.extent + 2 * band) / 255 - band;
+        } else {
+            o.envelope = left;
+            o.position = progress * o.extent / 255;
+        }
+        k++;
+    }
+    
+    overlayFrameDue = changed || (overlayCount && renderMillis() - lastOverlayFrame >= TRIGGER_FRAME_MS);
+    if (overlayFrameDue) lastOverlayFrame = renderMillis();
+}
+
+void startOverlay(const trigger_pending_t& pending) {
+    const trigger_t& t = pending.trigger;
+    if (t.event >= TRIGGER_EVENTS || triggerEvents[t.event].kind == TRIGGER_NONE) {
+        triggerStats.unregistered++;
+        return;
+    }
+    preemptStatusAnimation();
+    
+    uint8_t slot = overlayCount;
+    if (overlayCount == TRIGGER_OVERLAYS) {
+        slot = 0;
+        for (uint8_t k = 1; k < overlayCount; k++) {
+            if ((int32_t)(overlays[k].startUs - overlays[slot].startUs) < 0) slot = k;
+        }
+        triggerStats.replaced++;
+    } else {
+        overlayCount++;
+    }
+    
+    trigger_overlay_t& o = overlays[slot];
+    o.event = triggerEvents[t.event];
+    o.zone = t.zone;
+    o.color = CRGB(scale8_video(t.red, t.intensity), scale8_video(t.green, t.intensity),
+                   scale8_video(t.blue, t.intensity));
+    o.startUs = renderMicros();
+    o.arrivalUs = pending.arrivalUs;
+    o.shown = false;
+    o.envelope = 255;
+    o.position = 0;
+    
+    uint16_t right = matrixWidth - 1, bottom = matrixHeight - 1;
+    if (o.event.kind == TRIGGER_RIPPLE) {
+        o.originX = o.event.x == TRIGGER_CENTRE ? right / 2 : min(o.event.x, right);
+        o.originY = o.event.y == TRIGGER_CENTRE ? bottom / 2 : min(o.event.y, bottom);
+        // Grow until the ring has passed the furthest corner
+        o.extent = overlayDistance16(max<uint16_t>(o.originX, right - o.originX),
+                                     max<uint16_t>(o.originY, bottom - o.originY)) + TRIGGER_BAND_PX * 16;
+    } else if (o.event.kind == TRIGGER_SWEEP) {
+        o.extent = (o.event.direction <= SWEEP_LEFT ? right : bottom) * 16;
+    }
+}
+
+// Octagonal approximation of the Euclidean distance in 1/16 pixels,
+// within 7%; no square root per pixel
+int32_t overlayDistance16(uint16_t dx, uint16_t dy) {
+    uint16_t big = max(dx, dy), small = min(dx, dy);
+    return big * 16 + small * 6;
+}
+
+// Additive: a flash over a dark zone shows its own colour, over a lit one
+// it pushes towards white
+void compositeOverlays(uint16_t i, uint8_t z, CRGB& pixel) {
+    uint16_t x = i % matrixWidth, y = i / matrixWidth;
+    for (uint8_t k = 0; k < overlayCount; k++) {
+        const trigger_overlay_t& o = overlays[k];
+        if (o.zone != ZONE_ALL && o.zone != z) continue;
+        
+        uint8_t level = o.envelope;
+        if (o.event.kind != TRIGGER_FLASH) {
+            int32_t at;
+            if (o.event.kind == TRIGGER_RIPPLE) {
+                at = overlayDistance16(abs(x - o.originX), abs(y - o.originY));
+            } else switch (o.event.direction) {
+                case SWEEP_LEFT: at = (matrixWidth - 1 - x) * 16; break;
+                case SWEEP_DOWN: at = y * 16; break;
+                case SWEEP_UP: at = (matrixHeight - 1 - y) * 16; break;
+                default: at = x * 16; break;
+            }
+            int32_t distance = abs(at - o.position);
+            if (distance >= TRIGGER_BAND_PX * 16) continue;
+            level = scale8(level, 255 - distance * 255 / (TRIGGER_BAND_PX * 16));
+        }
+        
+        CRGB add = o.color;
+        add.nscale8_video(level);
+        pixel += add;
+    }
+}
+
+// After the show that first carried each new overlay
+void noteOverlaysShown() {
+    uint32_t now = micros();
+    for (uint8_t k = 0; k < overlayCount; k++) {
+        if (overlays[k].shown) continue;
+        
+        overlays[k].shown = true;
+        uint32_t latencyUs = now - overlays[k].arrivalUs;
+        recordTiming(triggerStats.latency, latencyUs);
+        if (latencyUs > TRIGGER_BUDGET_US) triggerStats.overBudget++;
+    }
+}
+
+void handleTriggerCommand(String args) {
+    args.trim();
+    if (args.length() == 0) {
+        printTriggers();
+        return;
+    }
+    
+    if (args == "reset") {
+        portENTER_CRITICAL(&triggerMux);
+        memset(&triggerStats, 0, sizeof(triggerStats));
+        portEXIT_CRITICAL(&triggerMux);
+        Serial.println("🔄 Trigger statistics reset");
+        return;
+    }
+    
+    // trigger fire <id> [r g b] [intensity] [zone]: the same path as the radio
+    if (args.startsWith("fire ")) {
+        long values[6] = {0, 255, 255, 255, 255, ZONE_ALL};
+        String rest = args.substring(5);
+        uint8_t valueCount = 0;
+        while (rest.length() > 0 && valueCount < 6) {
+            values[valueCount++] = rest.toInt();
+            int space = rest.indexOf(' ');
+            rest = space > 0 ? rest.substring(space + 1) : String("");
+        }
+        trigger_t trigger = {(uint8_t)values[0], (uint8_t)values[5], 0, (uint8_t)values[1],
+                             (uint8_t)values[2], (uint8_t)values[3], (uint8_t)values[4]};
+        queueTrigger(&trigger);
+        Serial.printf("⚡ Trigger %d fired\n", trigger.event);
+        return;
+    }
+    
+    // trigger <id> <kind> <ms> [x y | direction]
+    int space = args.indexOf(' ');
+    int id = args.toInt();
+    if (space < 0 || id < 0 || id >= TRIGGER_EVENTS) {
+        Serial.printf("❌ Trigger id must be 0-%d\n", TRIGGER_EVENTS - 1);
+        return;
+    }
+    
+    String rest = args.substring(space + 1);
+    space = rest.indexOf(' ');
+    String kind = space > 0 ? rest.substring(0, space) : rest;
+    rest = space > 0 ? rest.substring(space + 1) : String("");
+    long durationMs = rest.toInt();
+    space = rest.indexOf(' ');
+    rest = space > 0 ? rest.substring(space + 1) : String("");
+    
+    trigger_event_t event = {TRIGGER_NONE, 0, 0, 0, 0};
+    bool ok = kind == "off" || (durationMs >= 1 && durationMs <= 10000);
+    if (kind == "flash") {
+        event.kind = TRIGGER_FLASH;
+    }
+    else if (kind == "ripple") {
+        event.kind = TRIGGER_RIPPLE;
+        event.x = event.y = TRIGGER_CENTRE;
+        space = rest.indexOf(' ');
+        if (space > 0) {
+            event.x = rest.toInt();
+            event.y = rest.substring(space + 1).toInt();
+            ok = ok && event.x < matrixWidth && event.y < matrixHeight;
+        }
+    }
+    else if (kind == "sweep") {
+        event.kind = TRIGGER_SWEEP;
+        event.direction = SWEEP_RIGHT;
+        if (rest.length() > 0) {
+            ok = false;
+            for (uint8_t d = 0; d < 4; d++) {
+                if (rest == sweepDirectionNames[d]) {
+                    event.direction = d;
+                    ok = durationMs >= 1 && durationMs <= 10000;
+                }
+            }
+        }
+    }
+    else if (kind != "off") {
+        ok = false;
+    }
+    
+    if (!ok) {
+        Serial.println("❌ Usage: trigger <id> flash|ripple|sweep <1-10000 ms> [x y|right|left|down|up] | <id> off");
+        return;
+    }
+    event.durationMs = durationMs;
+    triggerEvents[id] = event;
+    saveTriggers();
+    printTriggers();
+}
+
+void printTriggers() {
+    portENTER_CRITICAL(&triggerMux);
+    trigger_stats_t st = triggerStats;
+    portEXIT_CRITICAL(&triggerMux);
+    
+    Serial.println("⚡ Trigger events:");
+    for (uint8_t e = 0; e < TRIGGER_EVENTS; e++) {
+        const trigger_event_t& event = triggerEvents[e];
+        if (event.kind == TRIGGER_NONE) continue;
+        
+        Serial.printf("   %2d: %-6s %5u ms", e, triggerKindNames[event.kind], event.durationMs);
+        if (event.kind == TRIGGER_RIPPLE) {
+            if (event.x == TRIGGER_CENTRE) Serial.print("  from the centre");
+            else Serial.printf("  from (%u,%u)", event.x, event.y);
+        }
+        if (event.kind == TRIGGER_SWEEP) Serial.printf("  %s", sweepDirectionNames[event.direction]);
+        Serial.println();
+    }
+    Serial.printf("   Running: %d overlay%s\n", overlayCount, overlayCount == 1 ? "" : "s");
+    Serial.printf("   Received: %lu | %lu duplicate cues, %lu unregistered, %lu queue full, %lu replaced\n",
+                  st.received, st.duplicates, st.unregistered, st.queueFull, st.replaced);
+    if (st.latency.total) {
+        Serial.printf("   Trigger to show: p50 %lu µs, p99 %lu µs, max %lu µs | %lu over one frame (%lu ms)\n",
+                      (unsigned long)timingPercentile(st.latency, 50),
+                      (unsigned long)timingPercentile(st.latency, 99),
+                      (unsigned long)st.latency.maxUs, st.overBudget, TRIGGER_BUDGET_US / 1000);
+    }
+}
+
+// =============================================================================
+// CAPTURE AND REPLAY
+// =============================================================================
+const char* const captureFiles[2] = {"/capture0.bin", "/capture1.bin"};
+
+// The render scheduler's clock: real time, or a replay's virtual clock
+unsigned long renderMillis() {
+    return replayActive ? (unsigned long)(replayClockUs / 1000) : millis();
+}
+
+uint32_t renderMicros() {
+    return replayActive ? (uint32_t)replayClockUs : micros();
+}
+
+// Mounted on first use; boots that never capture don't pay for it
+bool mountCaptureFs() {
+    if (!fsMounted) fsMounted = LittleFS.begin(true);
+    if (!fsMounted) Serial.println("❌ LittleFS mount failed");
+    return fsMounted;
+}
+
+// Runs in the WiFi task: two ring pushes, nothing else
+void capturePacket(const esp_now_recv_info_t* info, const uint8_t* data, int len) {
+    capture_record_t record;
+    record.timeUs = (uint32_t)esp_timer_get_time();
+    memcpy(record.mac, info->src_addr, 6);
+    record.flags = (info->des_addr && memcmp(info->des_addr, broadcastAddress, 6) == 0) ? CAPTURE_FLAG_BROADCAST : 0;
+    record.length = min(len, (int)ESP_NOW_MAX_DATA_LEN);
+    if (ringFree(captureRing) < sizeof(record) + record.length) {
+        captureStats.ramDrops++;
+        return;
+    }
+    ringPush(captureRing, (const uint8_t*)&record, sizeof(record));
+    ringPush(captureRing, data, record.length);
+    captureStats.packets++;
+}
+
+bool openCaptureSegment() {
+    captureFile = LittleFS.open(captureFiles[captureSlot], "w");
+    if (!captureFile) return false;
+    
+    capture_header_t header;
+    memcpy(header.magic, "LCAP", 4);
+    header.version = CAPTURE_VERSION;
+    header.reserved = 0;
+    header.ledCount = logicalLedCount;
+    header.width = matrixWidth;
+    header.height = matrixHeight;
+    header.segment = captureSegment;
+    header.startUs = esp_timer_get_time();
+    header.clockOffsetUs = clockSynced ? clockOffsetUs : 0;
+    if (captureFile.write((const uint8_t*)&header, sizeof(header)) != sizeof(header)) return false;
+    
+    captureFileBytes = sizeof(header);
+    captureStats.segments++;
+    return true;
+}
+
+void startCapture() {
+    if (replayActive) {
+        Serial.println("❌ Stop the replay first");
+        return;
+    }
+    if (!mountCaptureFs()) return;
+    
+    for (uint8_t slot = 0; slot < 2; slot++) {
+        if (LittleFS.exists(captureFiles[slot])) LittleFS.remove(captureFiles[slot]);
+    }
+    memset(&captureStats, 0, sizeof(captureStats));
+    ringDrop(captureRing, ringUsed(captureRing));
+    captureSlot = 0;
+    captureSegment = 0;
+    if (!openCaptureSegment()) {
+        Serial.println("❌ Could not create the capture file");
+        return;
+    }
+    lastCaptureFlush = millis();
+    captureActive = true;
+    Serial.printf("🔴 Capturing incoming packets (%d KB segments, the newest two kept)\n",
+                  CAPTURE_SEGMENT_BYTES / 1024);
+}
+
+void stopCapture() {
+    if (!captureActive) return;
+    
+    captureActive = false;
+    flushCapture();
+    captureFile.close();
+    Serial.printf("⏹️  Capture stopped: %lu packets, %lu bytes written\n",
+                  captureStats.packets, captureStats.bytes);
+}
+
+// Whole records only, so a segment never ends in the middle of a packet
+void flushCapture() {
+    capture_record_t record;
+    uint8_t buffer[sizeof(capture_record_t) + ESP_NOW_MAX_DATA_LEN];
+    unsigned long start = micros();
+    
+    while (captureFile && ringUsed(captureRing) >= sizeof(record)) {
+        ringPeek(captureRing, 0, (uint8_t*)&record, sizeof(record));
+        uint32_t total = sizeof(record) + record.length;
+        if (ringUsed(captureRing) < total) break;   // Payload not pushed yet
+        
+        if (captureFileBytes + total > CAPTURE_SEGMENT_BYTES) {
+            captureFile.close();
+            captureSlot ^= 1;
+            captureSegment++;
+            if (!openCaptureSegment()) {
+                captureStats.writeErrors++;
+                captureActive = false;
+                Serial.println("❌ Capture stopped: could not start a new segment");
+                break;
+            }
+        }
+        
+        ringPeek(captureRing, 0, buffer, total);
+        ringDrop(captureRing, total);
+        if (captureFile.write(buffer, total) != total) {
+            captureStats.writeErrors++;
+            continue;
+        }
+        captureFileBytes += total;
+        captureStats.bytes += total;
+    }
+    
+    uint32_t took = micros() - start;
+    if (took > captureStats.flushMaxUs) captureStats.flushMaxUs = took;
+    lastCaptureFlush = millis();
+}
+
+uint8_t captureSlotsOldestFirst(uint8_t* slots) {
+    uint32_t segments[2];
+    uint8_t count = 0;
+    for (uint8_t slot = 0; slot < 2; slot++) {
+        if (!LittleFS.exists(captureFiles[slot])) continue;
+        
+        File file = LittleFS.open(captureFiles[slot], "r");
+        capture_header_t header;
+        bool valid = file && file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                     memcmp(header.magic, "LCAP", 4) == 0 && header.version == CAPTURE_VERSION;
+        file.close();
+        if (!valid) continue;
+        
+        slots[count] = slot;
+        segments[count] = header.segment;
+        count++;
+    }
+    if (count == 2 && segments[1] < segments[0]) {
+        slots[0] = 1;
+        slots[1] = 0;
+    }
+    return count;
+}
+
+void serviceCapture() {
+    if (captureActive) {
+        uint32_t waiting = ringUsed(captureRing);
+        if (waiting >= CAPTURE_FLUSH_BYTES || (waiting && millis() - lastCaptureFlush >= CAPTURE_FLUSH_MS)) {
+            flushCapture();
+        }
+    }
+    if (dumpActive) serviceCaptureDump();
+}
+
+void startCaptureDump() {
+    if (replayActive) {
+        Serial.println("❌ Stop the replay first");
+        return;
+    }
+    if (!mountCaptureFs()) return;
+    
+    stopCapture();
+    dumpSlotCount = captureSlotsOldestFirst(dumpSlots);
+    if (!dumpSlotCount) {
+        Serial.println("❌ No capture on flash");
+        return;
+    }
+    dumpSlotNext = 0;
+    dumpActive = true;
+    Serial.printf("📼 Dumping %d segment%s\n", dumpSlotCount, dumpSlotCount == 1 ? "" : "s");
+}
+
+// A line at a time while the UART has room, so the receiver keeps running.
+// Each segment is "CAPTURE BEGIN <n> <bytes>", base64 lines prefixed with
+// "CAP:" and "CAPTURE END <crc32>"; other output may come in between.
+void serviceCaptureDump() {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    
+    while (Serial.availableForWrite() >= 4 + CAPTURE_DUMP_LINE / 3 * 4 + 2) {
+        if (!dumpFile) {
+            if (dumpSlotNext == dumpSlotCount) {
+                dumpActive = false;
+                Serial.println("📼 Dump complete");
+                return;
+            }
+            dumpFile = LittleFS.open(captureFiles[dumpSlots[dumpSlotNext++]], "r");
+            if (!dumpFile) continue;
+            dumpCrc = 0;
+            Serial.printf("CAPTURE BEGIN %d %u\n", dumpSlotNext, (unsigned)dumpFile.size());
+            continue;
+        }
+        
+        uint8_t chunk[CAPTURE_DUMP_LINE];
+        int n = dumpFile.read(chunk, sizeof(chunk));
+        if (n <= 0) {
+            dumpFile.close();
+            Serial.printf("CAPTURE END %08lX\n", (unsigned long)dumpCrc);
+            continue;
+        }
+        dumpCrc = esp_rom_crc32_le(dumpCrc, chunk, n);
+        
+        char line[4 + CAPTURE_DUMP_LINE / 3 * 4 + 1] = "CAP:";
+        uint8_t o = 4;
+        for (int i = 0; i < n; i += 3) {
+            uint32_t v = (uint32_t)chunk[i] << 16 | (i + 1 < n ? chunk[i + 1] << 8 : 0) | (i + 2 < n ? chunk[i + 2] : 0);
+            line[o++] = alphabet[(v >> 18) & 63];
+            line[o++] = alphabet[(v >> 12) & 63];
+            line[o++] = i + 1 < n ? alphabet[(v >> 6) & 63] : '=';
+            line[o++] = i + 2 < n ? alphabet[v & 63] : '=';
+        }
+        line[o] = 0;
+        Serial.println(line);
+    }
+}
+
+// Every run starts from the same place: power-on zones, nothing queued, a
+// fixed random seed and fresh duplicate windows. Capture times become the
+// virtual clock, so effects, live samples and apply-at times line up.
+void startReplay(bool verbose) {
+    if (!mountCaptureFs()) return;
+    
+    stopCapture();
+    if (dumpActive) {
+        dumpFile.close();
+        dumpActive = false;
+    }
+    replaySlotCount = captureSlotsOldestFirst(replaySlots);
+    replaySlotNext = 0;
+    replayClockStarted = false;
+    if (!replayOpenNextSegment() || !replayReadPacket()) {
+        Serial.println("❌ No capture on flash");
+        return;
+    }
+    
+    replayClockUs = replayPacketUs;
+    replayNextTickUs = replayPacketUs;
+    replayActive = true;    // From here the WiFi task keeps out
+    
+    portENTER_CRITICAL(&commandMux);
+    pendingZoneMask = 0;
+    portEXIT_CRITICAL(&commandMux);
+    initializeZones();
+    resetZones();
+    for (uint8_t z = 0; z < MAX_ZONES; z++) endLive(z);
+    overlayCount = 0;
+    lastOverlayFrame = 0;
+    if (statusAnimation != STATUS_ANIM_NONE) endStatusAnimation();
+    streamModeActive = false;
+    streamAssembly.active = false;
+    streamSeqValid = false;
+    streamReferenceValid = false;
+    stateSyncActive = false;
+    resetSeqWindows();
+    random16_set_seed(1);
+    randomSeed(1);
+    
+    memset(&replayStats, 0, sizeof(replayStats));
+    replayStats.startUs = replayPacketUs;
+    replayPendingCount = 0;
+    replayVerbose = verbose;
+    Serial.printf("▶️  Replaying %d segment%s on a virtual clock, %d ms loop ticks\n",
+                  replaySlotCount, replaySlotCount == 1 ? "" : "s", REPLAY_TICK_US / 1000);
+}
+
+bool replayOpenNextSegment() {
+    if (replayFile) replayFile.close();
+    
+    while (replaySlotNext < replaySlotCount) {
+        replayFile = LittleFS.open(captureFiles[replaySlots[replaySlotNext++]], "r");
+        capture_header_t header;
+        if (!replayFile || replayFile.read((uint8_t*)&header, sizeof(header)) != sizeof(header)) continue;
+        
+        // Record times are 32 bits; unwrapped from the first segment's start
+        if (!replayClockStarted) {
+            replayPacketUs = header.startUs;
+            replayLastRawUs = (uint32_t)header.startUs;
+            replayClockStarted = true;
+        }
+        replayClockOffsetUs = header.clockOffsetUs;
+        return true;
+    }
+    return false;
+}
+
+// A torn record at the end of a segment (power lost mid-write) ends it
+bool replayReadPacket() {
+    while (replayFile) {
+        if (replayFile.read((uint8_t*)&replayRecord, sizeof(replayRecord)) == sizeof(replayRecord) &&
+            replayRecord.length <= sizeof(replayPacket) &&
+            replayFile.read(replayPacket, replayRecord.length) == replayRecord.length) {
+            replayPacketUs += (uint32_t)(replayRecord.timeUs - replayLastRawUs);
+            replayLastRawUs = replayRecord.timeUs;
+            replayHavePacket = true;
+            return true;
+        }
+        if (!replayOpenNextSegment()) break;
+    }
+    replayHavePacket = false;
+    return false;
+}
+
+// Only what shapes the picture: OTA would write flash, the bridge would
+// talk to its UART and time pongs would move the real clock
+bool replayablePacket(const uint8_t* data, int len) {
+    if (len == sizeof(led_command_t)) return true;
+    if (len < (int)sizeof(wire_header_t) || data[0] != WIRE_VERSION_2) return false;
+    
+    for (int pos = sizeof(wire_header_t); pos + (int)sizeof(wire_record_t) <= len;
+         pos += sizeof(wire_record_t) + data[pos + 1]) {
+        switch (data[pos]) {
+            case WIRE_REC_SERIAL_DATA:
+            case WIRE_REC_TIME_PONG:
+            case WIRE_REC_RELAY:
+            case WIRE_REC_OTA_BEGIN:
+            case WIRE_REC_OTA_CHUNK:
+            case WIRE_REC_OTA_END:
+            case WIRE_REC_TELEMETRY_REQ:
+            case WIRE_REC_SERIAL_FRAGMENT:
+            case WIRE_REC_SERIAL_CREDIT:
+                return false;
+        }
+    }
+    return true;
+}
+
+// Slices of real time; within one, the virtual clock jumps from event to
+// event: packets at their capture times, loop ticks every REPLAY_TICK_US
+void serviceReplay() {
+    unsigned long sliceStart = millis();
+    while (replayActive && millis() - sliceStart < REPLAY_SLICE_MS) {
+        if (replayHavePacket && replayPacketUs <= replayNextTickUs) {
+            replayClockUs = replayPacketUs;
+            if (replayablePacket(replayPacket, replayRecord.length)) {
+                esp_now_recv_info_t info;
+                memset(&info, 0, sizeof(info));
+                info.src_addr = replayRecord.mac;
+                info.des_addr = (replayRecord.flags & CAPTURE_FLAG_BROADCAST) ? (uint8_t*)broadcastAddress : nullptr;
+                unsigned long commandsBefore = commandsReceived;
+                receivePacket(&info, replayPacket, replayRecord.length);
+                replayStats.packets++;
+                if (commandsReceived != commandsBefore && replayPendingCount < REPLAY_PENDING) {
+                    replayPendingUs[replayPendingCount++] = replayClockUs;
+                }
+            } else {
+                replayStats.skipped++;
+            }
+            replayReadPacket();
+            continue;
+        }
+        
+        if (!replayHavePacket && replayNextTickUs > replayPacketUs + REPLAY_TAIL_MS * 1000LL) {
+            finishReplay();
+            return;
+        }
+        replayClockUs = replayNextTickUs;
+        runReplayTick();
+        replayNextTickUs += REPLAY_TICK_US;
+    }
+}
+
+// One pass of the rendering half of loop(); its real duration is what a
+// frame costs with this firmware
+void runReplayTick() {
+    unsigned long start = micros();
+    unsigned long framesBefore = replayStats.frames;
+    processReceivedCommand();
+    serviceFrameStream();
+    serviceTriggers();
+    updateLEDEffects();
+    if (replayStats.frames == framesBefore) return;
+    
+    uint32_t took = micros() - start;
+    recordTiming(replayStats.tickTime, took);
+    if (took > LED_UPDATE_INTERVAL_MS * 1000UL) replayStats.deadlineMisses++;
+}
+
+// Called with the output pass done and before the show
+void noteReplayFrame() {
+    uint32_t hash = esp_rom_crc32_le(0, (const uint8_t*)leds, physicalLedCount * sizeof(CRGB));
+    replayStats.digest = esp_rom_crc32_le(replayStats.digest, (const uint8_t*)&hash, sizeof(hash));
+    replayStats.frames++;
+    for (uint8_t i = 0; i < replayPendingCount; i++) {
+        recordTiming(replayStats.latency, replayClockUs - replayPendingUs[i]);
+    }
+    replayPendingCount = 0;
+    
+    if (replayVerbose) {
+        Serial.printf("   frame %lu at %lu ms: %08lX\n", replayStats.frames,
+                      (unsigned long)((replayClockUs - replayStats.startUs) / 1000), (unsigned long)hash);
+    }
+}
+
+// The picture stays as the capture left it; the clocks and duplicate
+// windows go back to live traffic
+void finishReplay() {
+    if (replayFile) replayFile.close();
+    replayActive = false;
+    
+    for (uint8_t z = 0; z < MAX_ZONES; z++) zones[z].lastRenderTime = 0;
+    lastOverlayFrame = 0;
+    resetSeqWindows();
+    stateSyncActive = false;
+    stateAckPending = false;
+    telemetryRequested = false;
+    
+    const replay_stats_t& st = replayStats;
+    Serial.printf("⏹️  Replay %s: %lu packets (%lu skipped) over %.1f s of capture\n",
+                  replayHavePacket ? "stopped" : "finished", st.packets, st.skipped,
+                  (replayClockUs - st.startUs) / 1e6);
+    Serial.printf("   Frames: %lu, digest %08lX\n", st.frames, (unsigned long)st.digest);
+    if (st.tickTime.total) {
+        Serial.printf("   Frame ticks (real): p50 %lu µs, p99 %lu µs, max %lu µs | %lu over %d ms\n",
+                      (unsigned long)timingPercentile(st.tickTime, 50),
+                      (unsigned long)timingPercentile(st.tickTime, 99),
+                      (unsigned long)st.tickTime.maxUs, st.deadlineMisses, LED_UPDATE_INTERVAL_MS);
+    }
+    if (st.latency.total) {
+        Serial.printf("   Command to next frame (virtual): p50 %lu µs, p99 %lu µs, max %lu µs\n",
+                      (unsigned long)timingPercentile(st.latency, 50),
+                      (unsigned long)timingPercentile(st.latency, 99), (unsigned long)st.latency.maxUs);
+    }
+}
+
+void handleCaptureCommand(String args) {
+    args.trim();
+    if (args.length() == 0) {
+        printCapture();
+    }
+    else if (args == "start") {
+        startCapture();
+    }
+    else if (args == "stop") {
+        if (replayActive) finishReplay();
+        else if (dumpActive) {
+            dumpFile.close();
+            dumpActive = false;
+            Serial.println("⏹️  Dump stopped");
+        }
+        else stopCapture();
+    }
+    else if (args == "clear") {
+        if (replayActive || dumpActive || !mountCaptureFs()) return;
+        stopCapture();
+        for (uint8_t slot = 0; slot < 2; slot++) {
+            if (LittleFS.exists(captureFiles[slot])) LittleFS.remove(captureFiles[slot]);
+        }
+        Serial.println("🗑️  Capture cleared");
+    }
+    else if (args == "dump") {
+        startCaptureDump();
+    }
+    else if (args == "replay" || args == "replay verbose") {
+        startReplay(args == "replay verbose");
+    }
+    else {
+        Serial.println("❌ Usage: capture [start|stop|clear|dump|replay [verbose]]");
+    }
+}
+
+void printCapture() {
+    Serial.printf("📼 Capture: %s%s%s\n", captureActive ? "recording" : "stopped",
+                  dumpActive ? ", dumping" : "", replayActive ? ", replaying" : "");
+    Serial.printf("   Packets: %lu | %lu bytes to flash in %lu segment%s | %lu ring drops, %lu write errors\n",
+                  captureStats.packets, captureStats.bytes, captureStats.segments,
+                  captureStats.segments == 1 ? "" : "s", captureStats.ramDrops, captureStats.writeErrors);
+    Serial.printf("   Longest flash write: %lu µs\n", (unsigned long)captureStats.flushMaxUs);
+    if (fsMounted) {
+        uint8_t slots[2];
+        uint8_t count = captureSlotsOldestFirst(slots);
+        for (uint8_t i = 0; i < count; i++) {
+            File file = LittleFS.open(captureFiles[slots[i]], "r");
+            Serial.printf("   %s: %u bytes\n", captureFiles[slots[i]], (unsigned)file.size());
+            file.close();
+        }
+        Serial.printf("   LittleFS: %u of %u KB used\n", (unsigned)(LittleFS.usedBytes() / 1024),
+                      (unsigned)(LittleFS.totalBytes() / 1024));
+    }
+    if (replayStats.frames) {
+        Serial.printf("   Last replay: %lu frames, digest %08lX, %lu deadline miss%s\n", replayStats.frames,
+                      (unsigned long)replayStats.digest, replayStats.deadlineMisses,
+                      replayStats.deadlineMisses == 1 ? "" : "es");
+    }
+}
+
+// =============================================================================
+// FRAME STREAMING
+// =============================================================================
+// Runs in the WiFi task. Latest frame wins: a fragment of a newer frame
+// abandons the one being assembled, fragments of older frames are dropped.
+// data is the fragment record value: header then payload slice.
+void handleFrameFragment(const uint8_t* data, int len) {
+    const frame_fragment_header_t* header = (const frame_fragment_header_t*)data;
+    const uint8_t* payload = data + sizeof(frame_fragment_header_t);
+    uint16_t payloadLength = len - sizeof(frame_fragment_header_t);
+    
+    if (header->fragCount == 0 || header->fragCount > 32 || header->fragIndex >= header->fragCount ||
+        header->encodedLength > STREAM_ENCODED_MAX ||
+        (uint32_t)header->offset + payloadLength > header->encodedLength) {
+        streamStats.decodeErrors++;
+        return;
+    }
+    
+    portENTER_CRITICAL(&streamMux);
+    stream_assembly_t& a = streamAssembly;
+    streamStats.fragments++;
+    
+    if (streamSeqValid && (int16_t)(header->frameSeq - streamLastSeq) <= 0 &&
+        !(a.active && a.frameSeq == header->frameSeq)) {
+        // Older than (or a late copy of) a frame we already finished
+        streamStats.duplicateFragments++;
+        portEXIT_CRITICAL(&streamMux);
+        return;
+    }
+    
+    if (a.active && a.frameSeq != header->frameSeq) {
+        if ((int16_t)(header->frameSeq - a.frameSeq) < 0) {
+            streamStats.duplicateFragments++;
+            portEXIT_CRITICAL(&streamMux);
+            return;
+        }
+        finishStreamAssembly(false);
+    }
+    
+    if (!a.active) {
+        a.active = true;
+        a.frameSeq = header->frameSeq;
+        a.baseSeq = header->baseSeq;
+        a.codec = header->codec;
+        a.fragCount = header->fragCount;
+        a.encodedLength = header->encodedLength;
+        a.receivedMask = 0;
+        a.firstFragmentUs = renderMicros();
+    }
+    
+    uint32_t bit = 1UL << header->fragIndex;
+    if (a.receivedMask & bit) {
+        streamStats.duplicateFragments++;
+    } else {
+        memcpy(a.data + header->offset, payload, payloadLength);
+        a.fragOffset[header->fragIndex] = header->offset;
+        a.fragLength[header->fragIndex] = payloadLength;
+        a.receivedMask |= bit;
+        streamStats.wireBytes += len;
+    }
+    
+    uint32_t allFragments = (a.fragCount == 32) ? 0xFFFFFFFFUL : ((1UL << a.fragCount) - 1);
+    if (a.receivedMask == allFragments) {
+        finishStreamAssembly(true);
+    }
+    portEXIT_CRITICAL(&streamMux);
+}
+
+// Called with streamMux held. Incomplete raw frames are concealed by patching
+// the missing slices from the previous frame; incomplete compressed frames
+// cannot be decoded, so the previous frame simply stays on screen.
+void finishStreamAssembly(bool complete) {
+    stream_assembly_t& a = streamAssembly;
+    uint16_t frameBytes = logicalLedCount * 3;
+    uint8_t* out = streamBuffers[streamWriteIdx];
+    
+    // Frames that never showed up at all count as lost too
+    if (streamSeqValid) {
+        uint16_t skipped = a.frameSeq - streamLastSeq - 1;
+        if (skipped < 1000) streamStats.framesLost += skipped;
+    }
+    streamLastSeq = a.frameSeq;
+    streamSeqValid = true;
+    a.active = false;
+    
+    if (!complete) {
+        streamStats.framesLost++;
+        if (a.codec != FRAME_CODEC_RAW || a.receivedMask == 0 || !streamReferenceValid ||
+            a.encodedLength != frameBytes) {
+            return;
+        }
+        memcpy(out, streamReference, frameBytes);
+        for (uint8_t i = 0; i < a.fragCount; i++) {
+            if (!(a.receivedMask & (1UL << i))) continue;
+            memcpy(out + a.fragOffset[i], a.data + a.fragOffset[i], a.fragLength[i]);
+        }
+        streamStats.framesConcealed++;
+    } else {
+        if (a.codec == FRAME_CODEC_DELTA_RLE &&
+            (!streamReferenceValid || a.baseSeq != streamReferenceSeq)) {
+            streamStats.baseMismatches++;
+            return;
+        }
+        if (!decodeStreamFrame(a.data, a.encodedLength, a.codec, out, frameBytes)) {
+            streamStats.decodeErrors++;
+            return;
+        }
+        
+        unsigned long latency = renderMicros() - a.firstFragmentUs;
+        streamStats.framesCompleted++;
+        streamStats.rawBytes += frameBytes;
+        streamStats.reassemblyUsTotal += latency;
+        if (latency > streamStats.reassemblyUsMax) streamStats.reassemblyUsMax = latency;
+    }
+    
+    memcpy(streamReference, out, frameBytes);
+    streamReferenceSeq = a.frameSeq;
+    streamReferenceValid = true;
+    publishStreamFrame();
+}
+
+// Delta frames are applied on top of streamReference, in place
+bool decodeStreamFrame(const uint8_t* encoded, uint16_t length, uint8_t codec, uint8_t* out, uint16_t frameBytes) {
+    if (codec == FRAME_CODEC_RAW) {
+        if (length != frameBytes) return false;
+        memcpy(out, encoded, frameBytes);
+        return true;
+    }
+    
+    bool delta = (codec == FRAME_CODEC_DELTA_RLE);
+    if (!delta && codec != FRAME_CODEC_RLE) return false;
+    
+    uint16_t in = 0, pos = 0;
+    while (in < length) {
+        uint8_t control = encoded[in++];
+        uint16_t count = (control & 0x7F) + 1;
+        if (pos + count > frameBytes) return false;
+        
+        if (control & 0x80) {
+            if (in + count > length) return false;
+            for (uint16_t i = 0; i < count; i++) {
+                out[pos + i] = delta ? (streamReference[pos + i] ^ encoded[in + i]) : encoded[in + i];
+            }
+            in += count;
+        } else if (delta) {
+            memcpy(out + pos, streamReference + pos, count);
+        } else {
+            memset(out + pos, 0, count);
+        }
+        pos += count;
+    }
+    return pos == frameBytes;
+}
+
+// Encoder counterpart of decodeStreamFrame(), used by the controller side and
+// for measuring compression. Pass reference = nullptr for a key frame.
+uint16_t encodeStreamRle(const uint8_t* frameData, const uint8_t* reference, uint16_t frameBytes, uint8_t* out, uint16_t outMax) {
+    uint16_t in = 0, length = 0;
+    
+    while (in < frameBytes) {
+        uint8_t value = reference ? (frameData[in] ^ reference[in]) : frameData[in];
+        uint16_t run = 0;
+        
+        if (value == 0) {
+            while (in + run < frameBytes && run < 128 &&
+                   (reference ? (frameData[in + run] ^ reference[in + run]) : frameData[in + run]) == 0) {
+                run++;
+            }
+            if (length + 1 > outMax) return 0;
+            out[length++] = run - 1;
+        } else {
+            // Literal run ends at the next pair of zeros, where a zero run pays off
+            while (in + run < frameBytes && run < 128) {
+                uint8_t a = reference ? (frameData[in + run] ^ reference[in + run]) : frameData[in + run];
+                bool nextZero = in + run + 1 < frameBytes &&
+                    (reference ? (frameData[in + run + 1] ^ reference[in + run + 1]) : frameData[in + run + 1]) == 0;
+                if (a == 0 && nextZero) break;
+                run++;
+            }
+            if (length + 1 + run > outMax) return 0;
+            out[length++] = 0x80 | (run - 1);
+            for (uint16_t i = 0; i < run; i++) {
+                out[length++] = reference ? (frameData[in + i] ^ reference[in + i]) : frameData[in + i];
+            }
+        }
+        in += run;
+    }
+    return length;
+}
+
+// Writer side of the triple buffer, streamMux held
+void publishStreamFrame() {
+    uint8_t finished = streamWriteIdx;
+    streamWriteIdx = streamReadyIdx;
+    streamReadyIdx = finished;
+    streamFrameFresh = true;
+}
+
+// Loop-side writers (serial, UDP pixel input) assemble in their own
+// buffers over several passes. The radio decodes into the write buffer at
+// any time, so theirs is only touched here, copied and swapped in one go.
+void localFramePublish(const uint8_t* frame) {
+    portENTER_CRITICAL(&streamMux);
+    memcpy(streamBuffers[streamWriteIdx], frame, logicalLedCount * 3);
+    publishStreamFrame();
+    portEXIT_CRITICAL(&streamMux);
+}
+
+// Reader side: true when a new frame moved into the display buffer
+bool takeStreamFrame() {
+    if (!streamFrameFresh) return false;
+    
+    portENTER_CRITICAL(&streamMux);
+    uint8_t fresh = streamReadyIdx;
+    streamReadyIdx = streamDisplayIdx;
+    streamDisplayIdx = fresh;
+    streamFrameFresh = false;
+    portEXIT_CRITICAL(&streamMux);
+    
+    lastStreamFrameTime = renderMillis();
+    return true;
+}
+
+// Enters streaming mode on the first frame and leaves it when the stream goes
+// quiet; also gives up on partial frames whose remaining fragments are lost.
+void serviceFrameStream() {
+    if (streamAssembly.active && renderMicros() - streamAssembly.firstFragmentUs > STREAM_FRAGMENT_TIMEOUT_MS * 1000UL) {
+        portENTER_CRITICAL(&streamMux);
+        if (streamAssembly.active) finishStreamAssembly(false);
+        portEXIT_CRITICAL(&streamMux);
+    }
+    
+    bool zoneShowsStream = false;
+    for (uint8_t z = 0; z < MAX_ZONES; z++) {
+        if (zones[z].active && zones[z].effect == EFFECT_STREAM) zoneShowsStream = true;
+    }
+    
+    if (!streamModeActive && streamFrameFresh && !zoneShowsStream) {
+        streamModeActive = true;
+        Serial.println("📺 Frame stream started");
+    }
+    else if (streamModeActive && renderMillis() - lastStreamFrameTime > STREAM_IDLE_TIMEOUT_MS && !streamFrameFresh) {
+        streamModeActive = false;
+        for (uint8_t z = 0; z < MAX_ZONES; z++) zones[z].lastRenderTime = 0;
+        Serial.println("📺 Frame stream idle, effects resumed");
+    }
+}
+
+void printStreamStats() {
+    stream_stats_t st;
+    portENTER_CRITICAL(&streamMux);
+    st = streamStats;
+    portEXIT_CRITICAL(&streamMux);
+    
+    unsigned long attempted = st.framesCompleted + st.framesLost;
+    Serial.printf("📺 Stream: %s\n", streamModeActive ? "active" : "idle");
+    Serial.printf("   Frames: %lu complete, %lu lost (%.1f%%), %lu concealed\n",
+                  st.framesCompleted, st.framesLost,
+                  attempted ? 100.0 * st.framesLost / attempted : 0.0, st.framesConcealed);
+    Serial.printf("   Fragments: %lu (%lu duplicate/stale)\n", st.fragments, st.duplicateFragments);
+    Serial.printf("   Compression: %lu raw / %lu wire bytes = %.2fx\n",
+                  st.rawBytes, st.wireBytes, st.wireBytes ? (float)st.rawBytes / st.wireBytes : 0.0);
+    Serial.printf("   Reassembly: avg %lu µs, max %lu µs\n",
+                  st.framesCompleted ? st.reassemblyUsTotal / st.framesCompleted : 0, st.reassemblyUsMax);
+    Serial.printf("   Errors: %lu decode, %lu missing delta base\n", st.decodeErrors, st.baseMismatches);
+}
+
+// =============================================================================
+// SERIAL FRAME INPUT
+// =============================================================================
+// A PC drives the matrix over the USB UART. Bytes are parsed in the loop as
+// they come out of the driver's ring buffer: pixel payloads are read
+// straight into serialInput.frame and published like radio frames.
+// Text commands still work between frames, so 'text' gets back out.
+void setSerialBinary(bool on, uint32_t baud) {
+    if (on) {
+        Serial.printf("🔌 Binary frame input at %lu baud (Adalight, TPM2, native); 'text' to leave\n",
+                      (unsigned long)baud);
+    } else {
+        Serial.printf("🔌 Text commands at %lu baud\n", (unsigned long)baud);
+    }
+    Serial.flush();
+    Serial.updateBaudRate(baud);
+    
+    serial_input_t& s = serialInput;
+    s.binary = on;
+    s.baud = baud;
+    s.state = SERIAL_IN_HUNT;
+    s.lineLength = 0;
+    s.lockedProto = -1;
+    s.failures = 0;
+    s.seqValid = false;
+    s.errorUs = 0;
+    s.lastByteMs = millis();
+    if (on) Serial.print("Ada\n");   // Adalight hosts wait for this
+}
+
+void serviceSerialInput() {
+    serial_input_t& s = serialInput;
+    int available = Serial.available();
+    if (available <= 0) {
+        if (millis() - s.lastByteMs > SERIAL_FRAME_GAP_MS) {
+            bool idleCobs = s.state == SERIAL_IN_COBS && !s.decoded && !s.cobsCode;
+            if (s.state == SERIAL_IN_HUNT) {
+                s.lockedProto = -1;     // A pause is where a sender may switch protocols
+            }
+            else if (!idleCobs) {
+                serialInputError(serialStats.timeouts);
+                s.state = SERIAL_IN_HUNT;
+            }
+        }
+        return;
+    }
+    s.lastByteMs = millis();
+    serialStats.bytes += available;
+    
+    while (available > 0 && s.binary) {
+        if (s.state == SERIAL_IN_PIXELS) {
+            // Bulk copy from the UART ring
+            uint32_t want = min((uint32_t)available, s.payloadLength - s.received);
+            int n = Serial.read(s.frame + s.received, want);
+            if (n <= 0) break;
+            available -= n;
+            s.received += n;
+            s.bytesSinceError += n;
+            
+            if (s.received == s.payloadLength) {
+                if (s.header[0] == 0xC9) {
+                    s.state = SERIAL_IN_TPM2_END;
+                } else {
+                    serialFramePublish(SERIAL_PROTO_ADALIGHT, s.received);
+                    s.state = SERIAL_IN_HUNT;
+                }
+            }
+            continue;
+        }
+        
+        int b = Serial.read();
+        if (b < 0) break;
+        available--;
+        s.bytesSinceError++;
+        serialInputByte(b);
+    }
+}
+
+void serialInputByte(uint8_t b) {
+    serial_input_t& s = serialInput;
+    
+    switch (s.state) {
+        // Once a protocol has delivered a frame only its start bytes are
+        // looked for. Unlocked, a 0x00 in raw pixel data can open a COBS frame
+        // that swallows the next header, and stay in step with the frames.
+        case SERIAL_IN_HUNT:
+            if ((b == 'A' || b == 0xC9) && s.lockedProto != SERIAL_PROTO_NATIVE) {
+                s.header[0] = b;
+                s.headerLength = 1;
+                s.state = (b == 'A') ? SERIAL_IN_ADA_HEADER : SERIAL_IN_TPM2_HEADER;
+            }
+            else if (b == 0x00 && (s.lockedProto < 0 || s.lockedProto == SERIAL_PROTO_NATIVE)) {
+                s.cobsCode = 0;
+                s.cobsRemaining = 0;
+                s.decoded = 0;
+                s.overflow = false;
+                s.state = SERIAL_IN_COBS;
+            }
+            else if (b == '\n' || b == '\r') {
+                if (s.lineLength) {
+                    s.line[s.lineLength] = '\0';
+                    s.lineLength = 0;
+                    runCommand(String(s.line));
+                }
+            }
+            else {
+                serialStats.skipped++;
+                serialInputLostSync();
+                if (b >= 0x20 && b < 0x7F && s.lineLength < SERIAL_LINE_MAX - 1) {
+                    s.line[s.lineLength++] = b;
+                } else {
+                    s.lineLength = 0;   // Binary junk, not a command
+                }
+            }
+            break;
+        
+        case SERIAL_IN_ADA_HEADER:
+            s.header[s.headerLength++] = b;
+            if ((s.headerLength == 2 && b != 'd') || (s.headerLength == 3 && b != 'a')) {
+                // Not a header after all; the byte may start the real one
+                serialStats.skipped += s.headerLength - 1;
+                s.state = SERIAL_IN_HUNT;
+                serialInputByte(b);
+            }
+            else if (s.headerLength == 6) {
+                if (s.header[5] != (s.header[3] ^ s.header[4] ^ 0x55)) {
+                    serialInputError(serialStats.headerErrors);
+                    s.state = SERIAL_IN_HUNT;
+                    break;
+                }
+                s.payloadLength = (((uint32_t)s.header[3] << 8 | s.header[4]) + 1) * 3;
+                if (s.payloadLength > logicalLedCount * 3) {
+                    serialInputError(serialStats.headerErrors);
+                    s.state = SERIAL_IN_HUNT;
+                    break;
+                }
+                s.received = 0;
+                s.state = SERIAL_IN_PIXELS;
+            }
+            break;
+        
+        case SERIAL_IN_TPM2_HEADER:
+            s.header[s.headerLength++] = b;
+            if (s.headerLength == 2 && b != 0xDA) {
+                // Only data frames are used; commands and replies are hunted past
+                serialStats.skipped++;
+                s.state = SERIAL_IN_HUNT;
+                serialInputByte(b);
+            }
+            else if (s.headerLength == 4) {
+                s.payloadLength = (uint32_t)s.header[2] << 8 | s.header[3];
+                if (s.payloadLength > logicalLedCount * 3) {
+                    // Oversized frames are what a misread length looks like
+                    serialInputError(serialStats.headerErrors);
+                    s.state = SERIAL_IN_HUNT;
+                    break;
+                }
+                s.received = 0;
+                s.state = s.payloadLength ? SERIAL_IN_PIXELS : SERIAL_IN_TPM2_END;
+            }
+            break;
+        
+        case SERIAL_IN_TPM2_END:
+            s.state = SERIAL_IN_HUNT;
+            if (b == 0x36) {
+                serialFramePublish(SERIAL_PROTO_TPM2, s.received);
+            } else {
+                serialInputError(serialStats.headerErrors);
+                serialInputByte(b);
+            }
+            break;
+        
+        case SERIAL_IN_COBS:
+            if (b == 0x00) {
+                // Delimiter: ends this frame and starts the next. After a bad
+                // one, hunt again unless locked: the 0x00 may be stray pixel data.
+                if ((s.decoded || s.cobsCode) && !finishCobsFrame() &&
+                    s.lockedProto != SERIAL_PROTO_NATIVE) {
+                    s.state = SERIAL_IN_HUNT;
+                    break;
+                }
+                s.cobsCode = 0;
+                s.cobsRemaining = 0;
+                s.decoded = 0;
+                s.overflow = false;
+            }
+            else if (s.cobsRemaining == 0) {
+                if (s.cobsCode && s.cobsCode != 0xFF) cobsEmit(0x00);
+                s.cobsCode = b;
+                s.cobsRemaining = b - 1;
+            }
+            else {
+                cobsEmit(b);
+                s.cobsRemaining--;
+            }
+            break;
+        
+        default:
+            s.state = SERIAL_IN_HUNT;
+            break;
+    }
+}
+
+// Decoded native bytes: four header bytes, then the payload goes straight
+// into the frame buffer four bytes late, so the CRC never lands in it.
+void cobsEmit(uint8_t b) {
+    serial_input_t& s = serialInput;
+    uint32_t index = s.decoded++;
+    
+    if (index < 4) {
+        s.header[index] = b;
+        return;
+    }
+    
+    uint32_t k = index - 4;
+    if (k >= 4) {
+        uint32_t position = k - 4;
+        if (position < FRAME_BYTES_MAX) {
+            s.frame[position] = s.tail[k & 3];
+        } else {
+            s.overflow = true;
+        }
+    }
+    s.tail[k & 3] = b;
+}
+
+bool finishCobsFrame() {
+    serial_input_t& s = serialInput;
+    
+    if (s.cobsRemaining || s.overflow || s.decoded < 8) {
+        serialInputError(serialStats.malformed);
+        return false;
+    }
+    
+    uint32_t length = s.decoded - 8;
+    uint32_t expected = esp_rom_crc32_le(0, s.header, 4);
+    expected = esp_rom_crc32_le(expected, s.frame, length);
+    uint32_t received = 0;
+    for (uint8_t j = 0; j < 4; j++) {
+        received |= (uint32_t)s.tail[(length + j) & 3] << (8 * j);
+    }
+    if (received != expected) {
+        serialInputError(serialStats.crcErrors);
+        return false;
+    }
+    
+    uint16_t seq = s.header[2] | (uint16_t)s.header[3] << 8;
+    if (s.seqValid && (uint16_t)(seq - s.lastSeq) > 1 && (uint16_t)(seq - s.lastSeq) < 1000) {
+        serialStats.seqGaps += (uint16_t)(seq - s.lastSeq) - 1;
+    }
+    s.lastSeq = seq;
+    s.seqValid = true;
+    
+    if (s.header[0] == SERIAL_MSG_FRAME && length <= logicalLedCount * 3) {
+        serialFramePublish(SERIAL_PROTO_NATIVE, length);
+    }
+    else if (s.header[0] == SERIAL_MSG_COMMAND && length < SERIAL_LINE_MAX) {
+        char text[SERIAL_LINE_MAX];
+        memcpy(text, s.frame, length);
+        text[length] = '\0';
+        serialInputGood(SERIAL_PROTO_NATIVE);
+        runCommand(String(text));
+    }
+    else {
+        serialInputError(serialStats.malformed);
+        return false;
+    }
+    return true;
+}
+
+// Short frames leave the rest of the panel dark
+void serialFramePublish(serial_proto_t proto, uint32_t length) {
+    serial_input_t& s = serialInput;
+    uint32_t capacity = logicalLedCount * 3;
+    if (length < capacity) memset(s.frame + length, 0, capacity - length);
+    
+    localFramePublish(s.frame);
+    serialInputGood(proto);
+}
+
+void serialInputGood(serial_proto_t proto) {
+    serial_input_t& s = serialInput;
+    serialStats.frames[proto]++;
+    s.lockedProto = proto;
+    s.failures = 0;
+    if (!s.errorUs) return;
+    
+    // Back in sync: time and bytes since the first error
+    unsigned long resyncUs = micros() - s.errorUs;
+    serialStats.resyncs++;
+    serialStats.resyncUsLast = resyncUs;
+    serialStats.resyncBytesLast = s.bytesSinceError;
+    if (resyncUs > serialStats.resyncUsMax) serialStats.resyncUsMax = resyncUs;
+    if (s.bytesSinceError > serialStats.resyncBytesMax) serialStats.resyncBytesMax = s.bytesSinceError;
+    s.errorUs = 0;
+}
+
+void serialInputError(unsigned long& counter) {
+    serial_input_t& s = serialInput;
+    counter++;
+    if (++s.failures >= SERIAL_LOCK_FAILURES) s.lockedProto = -1;
+    serialInputLostSync();
+}
+
+// Starts the resync clock; hunting past bytes counts, not only detected errors
+void serialInputLostSync() {
+    serial_input_t& s = serialInput;
+    if (s.errorUs) return;
+    s.errorUs = micros();
+    if (!s.errorUs) s.errorUs = 1;   // 0 means in sync
+    s.bytesSinceError = 0;
+}
+
+void printSerialInput() {
+    serial_input_stats_t& st = serialStats;
+    Serial.printf("🔌 Serial input: %s at %lu baud\n",
+                  serialInput.binary ? "binary frames" : "text commands", (unsigned long)serialInput.baud);
+    Serial.printf("   Frames: %lu Adalight, %lu TPM2, %lu native | %lu bytes in\n",
+                  st.frames[SERIAL_PROTO_ADALIGHT], st.frames[SERIAL_PROTO_TPM2],
+                  st.frames[SERIAL_PROTO_NATIVE], st.bytes);
+    Serial.printf("   Errors: %lu header, %lu CRC, %lu malformed, %lu timed out | %lu native seq gaps\n",
+                  st.headerErrors, st.crcErrors, st.malformed, st.timeouts, st.seqGaps);
+    Serial.printf("   Resync: %lu times, last %lu µs / %lu bytes, worst %lu µs / %lu bytes\n",
+                  st.resyncs, st.resyncUsLast, st.resyncBytesLast, st.resyncUsMax, st.resyncBytesMax);
+    Serial.printf("   Skipped %lu bytes hunting\n", st.skipped);
+}
+
+// =============================================================================
+// SERIAL BRIDGE
+// =============================================================================
+uint32_t ringUsed(const byte_ring_t& ring) {
+    return __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE);
+}
+
+uint32_t ringFree(const byte_ring_t& ring) {
+    return SERIAL_BRIDGE_RING - ringUsed(ring);
+}
+
+// Producer side; the caller has checked ringFree()
+void ringPush(byte_ring_t& ring, const uint8_t* data, uint32_t length) {
+    uint32_t head = ring.head;
+    uint32_t at = head & (SERIAL_BRIDGE_RING - 1);
+    uint32_t first = min<uint32_t>(length, SERIAL_BRIDGE_RING - at);
+    memcpy(ring.data + at, data, first);
+    memcpy(ring.data, data + first, length - first);
+    __atomic_store_n(&ring.head, head + length, __ATOMIC_RELEASE);
+}
+
+// Consumer side, leaves the bytes in place
+void ringPeek(const byte_ring_t& ring, uint32_t offset, uint8_t* out, uint32_t length) {
+    uint32_t at = (ring.tail + offset) & (SERIAL_BRIDGE_RING - 1);
+    uint32_t first = min<uint32_t>(length, SERIAL_BRIDGE_RING - at);
+    memcpy(out, ring.data + at, first);
+    memcpy(out + first, ring.data, length - first);
+}
+
+// Bytes readable in place before the wrap
+uint32_t ringContiguous(const byte_ring_t& ring, const uint8_t** data) {
+    uint32_t at = ring.tail & (SERIAL_BRIDGE_RING - 1);
+    *data = ring.data + at;
+    return min<uint32_t>(ringUsed(ring), SERIAL_BRIDGE_RING - at);
+}
+
+void ringDrop(byte_ring_t& ring, uint32_t length) {
+    __atomic_store_n(&ring.tail, ring.tail + length, __ATOMIC_RELEASE);
+}
+
+void serialBridgeBegin() {
+    SERIAL_BRIDGE_PORT.begin(SERIAL_BRIDGE_BAUD, SERIAL_8N1, SERIAL_BRIDGE_RX_PIN, SERIAL_BRIDGE_TX_PIN);
+    
+    memset(&bridge, 0, sizeof(bridge));
+    do {
+        bridge.upSession = esp_random();
+    } while (bridge.upSession == 0);
+    bridge.downDelivered = 0xFFFF;
+    bridgeStats.rateStartMs = millis();
+    
+    if (xTaskCreate(serialBridgeTask, "bridge", SERIAL_BRIDGE_STACK, nullptr,
+                    SERIAL_BRIDGE_PRIORITY, &bridgeTask) != pdPASS) {
+        showError("Serial bridge task failed!");
+        return;
+    }
+    Serial.printf("  🔗 Serial bridge on RX %d / TX %d at %d baud\n",
+                  SERIAL_BRIDGE_RX_PIN, SERIAL_BRIDGE_TX_PIN, SERIAL_BRIDGE_BAUD);
+}
+
+// Owns the UART. Writes only what the TX buffer takes without blocking, so
+// a slow device never stalls the upstream side; sleeps until the WiFi task
+// queues bytes, polling the RX side once a tick.
+void serialBridgeTask(void*) {
+    uint8_t buffer[128];
+    
+    for (;;) {
+        bool busy = false;
+        
+        const uint8_t* data;
+        uint32_t length = ringContiguous(bridgeDown, &data);
+        int room = SERIAL_BRIDGE_PORT.availableForWrite();
+        if (length && room > 0) {
+            length = SERIAL_BRIDGE_PORT.write(data, min<uint32_t>(length, room));
+            ringDrop(bridgeDown, length);
+            bridgeStats.downBytes += length;
+            busy = length > 0;
+        }
+        
+        int available = SERIAL_BRIDGE_PORT.available();
+        if (available > 0) {
+            length = SERIAL_BRIDGE_PORT.read(buffer, min<uint32_t>(available, sizeof(buffer)));
+            uint32_t space = ringFree(bridgeUp);
+            if (length > space) {
+                bridgeStats.upOverruns += length - space;
+                length = space;
+            }
+            ringPush(bridgeUp, buffer, length);
+            busy = true;
+        }
+        
+        if (!busy) ulTaskNotifyTake(pdTRUE, 1);
+    }
+}
+
+// WiFi task. Only the next message in order is assembled; anything else is
+// answered with a credit so the controller resends from the right place.
+void handleSerialFragment(const uint8_t* value, uint8_t length) {
+    serial_fragment_header_t header;
+    memcpy(&header, value, sizeof(header));
+    const uint8_t* payload = value + sizeof(header);
+    uint16_t payloadLength = length - sizeof(header);
+    uint32_t offset = (uint32_t)header.fragIndex * SERIAL_BRIDGE_FRAG_MAX;
+    bool last = header.fragIndex + 1 == header.fragCount;
+    
+    bridge.lastActivityMs = millis();
+    if (header.session == 0 || header.msgLength == 0 || header.msgLength > SERIAL_BRIDGE_MSG_MAX ||
+        header.fragIndex >= header.fragCount || header.fragCount > 32 ||
+        offset + payloadLength > header.msgLength ||
+        (last ? offset + payloadLength != header.msgLength : payloadLength != SERIAL_BRIDGE_FRAG_MAX)) {
+        bridgeStats.downMalformed++;
+        return;
+    }
+    
+    if (header.session != bridge.downSession) {
+        if (bridge.downSession != 0 && header.msgSeq != 0) {
+            bridgeStats.downOutOfOrder++;
+            bridge.creditDue = true;
+            return;
+        }
+        portENTER_CRITICAL(&bridgeMux);
+        bridge.downSession = header.session;
+        bridge.downDelivered = header.msgSeq - 1;
+        portEXIT_CRITICAL(&bridgeMux);
+        bridge.assemblyMask = 0;
+    }
+    
+    int16_t ahead = (int16_t)(header.msgSeq - (uint16_t)(bridge.downDelivered + 1));
+    if (ahead != 0) {
+        if (ahead < 0) bridgeStats.downDuplicates++;
+        else bridgeStats.downOutOfOrder++;
+        bridge.creditDue = true;
+        return;
+    }
+    
+    if (bridge.assemblyMask == 0 || bridge.assemblySeq != header.msgSeq ||
+        bridge.assemblyLength != header.msgLength) {
+        bridge.assemblySeq = header.msgSeq;
+        bridge.assemblyLength = header.msgLength;
+        bridge.assemblyMask = 0;
+    }
+    uint32_t bit = 1UL << header.fragIndex;
+    if (bridge.assemblyMask & bit) {
+        bridgeStats.downDuplicates++;
+        return;
+    }
+    memcpy(bridge.assembly + offset, payload, payloadLength);
+    bridge.assemblyMask |= bit;
+    bridgeStats.downFragments++;
+    
+    uint32_t complete = header.fragCount == 32 ? 0xFFFFFFFFUL : (1UL << header.fragCount) - 1;
+    if (bridge.assemblyMask != complete) return;
+    
+    bridge.assemblyMask = 0;
+    bridge.creditDue = true;
+    if (ringFree(bridgeDown) < bridge.assemblyLength) {
+        bridgeStats.downOverruns++;   // Dropped whole; the controller resends it
+        return;
+    }
+    ringPush(bridgeDown, bridge.assembly, bridge.assemblyLength);
+    portENTER_CRITICAL(&bridgeMux);
+    bridge.downDelivered = header.msgSeq;
+    portEXIT_CRITICAL(&bridgeMux);
+    bridgeStats.downMessages++;
+    if (bridgeTask) xTaskNotifyGive(bridgeTask);
+}
+
+// WiFi task; the loop acts on it
+void handleSerialCredit(const serial_credit_t* credit) {
+    portENTER_CRITICAL(&bridgeMux);
+    memcpy(&bridgePendingCredit, credit, sizeof(bridgePendingCredit));
+    bridgeCreditPending = true;
+    portEXIT_CRITICAL(&bridgeMux);
+    bridge.lastActivityMs = millis();
+}
+
+void appendSerialCredit(wire_packet_t& packet) {
+    serial_credit_t credit;
+    portENTER_CRITICAL(&bridgeMux);
+    credit.session = bridge.downSession;
+    credit.deliveredSeq = bridge.downDelivered;
+    portEXIT_CRITICAL(&bridgeMux);
+    credit.freeBytes = ringFree(bridgeDown);
+    
+    wireAppend(packet, WIRE_REC_SERIAL_CREDIT, &credit, sizeof(credit));
+    bridge.creditDue = false;
+    bridge.lastCreditMs = millis();
+    bridge.lastFreeAdvertised = credit.freeBytes;
+    bridgeStats.creditsSent++;
+}
+
+// Sends the message at the front of the upstream ring, one packet per
+// fragment. The first packet also carries our credit for the other direction.
+void sendSerialMessage(bool retransmit) {
+    if (!retransmit) {
+        bridge.upInFlightSeq = bridge.upNextSeq++;
+        bridge.upInFlightLength = min<uint32_t>(min<uint32_t>(ringUsed(bridgeUp), SERIAL_BRIDGE_MSG_MAX),
+                                                bridge.upPeerFree);
+    }
+    
+    uint16_t length = bridge.upInFlightLength;
+    uint8_t fragCount = (length + SERIAL_BRIDGE_FRAG_MAX - 1) / SERIAL_BRIDGE_FRAG_MAX;
+    uint8_t record[sizeof(serial_fragment_header_t) + SERIAL_BRIDGE_FRAG_MAX];
+    serial_fragment_header_t header = {bridge.upSession, bridge.upInFlightSeq, 0, fragCount, length};
+    
+    for (uint8_t i = 0; i < fragCount; i++) {
+        uint16_t offset = i * SERIAL_BRIDGE_FRAG_MAX;
+        uint16_t slice = min<uint16_t>(SERIAL_BRIDGE_FRAG_MAX, length - offset);
+        header.fragIndex = i;
+        memcpy(record, &header, sizeof(header));
+        ringPeek(bridgeUp, offset, record + sizeof(header), slice);
+        
+        wire_packet_t packet;
+        wireBegin(packet);
+        wireAppend(packet, WIRE_REC_SERIAL_FRAGMENT, record, sizeof(header) + slice);
+        if (i == 0 && (bridge.creditDue || bridge.downSession)) appendSerialCredit(packet);
+        wireSend(packet, controllerAddress);
+        bridgeStats.upFragments++;
+    }
+    bridge.upSentMs = millis();
+    if (retransmit) bridgeStats.upRetransmits++;
+}
+
+void serviceSerialBridge() {
+    unsigned long now = millis();
+    
+    // Upstream: a credit for our session acknowledges the message in flight
+    if (bridgeCreditPending) {
+        serial_credit_t credit;
+        portENTER_CRITICAL(&bridgeMux);
+        credit = bridgePendingCredit;
+        bridgeCreditPending = false;
+        portEXIT_CRITICAL(&bridgeMux);
+        
+        bridgeStats.creditsReceived++;
+        bridge.upPeerReady = true;
+        bridge.upPeerFree = credit.freeBytes;
+        if (bridge.upInFlightLength && credit.session == bridge.upSession &&
+            (int16_t)(credit.deliveredSeq - bridge.upInFlightSeq) >= 0) {
+            ringDrop(bridgeUp, bridge.upInFlightLength);
+            bridgeStats.upBytes += bridge.upInFlightLength;
+            bridgeStats.upMessages++;
+            bridge.upInFlightLength = 0;
+        }
+        if (!bridge.downSession) bridge.creditDue = true;   // Answer the controller's hello
+    }
+    
+    if (bridge.upInFlightLength) {
+        if (now - bridge.upSentMs >= SERIAL_BRIDGE_RETRY_MS) sendSerialMessage(true);
+    } else if (bridge.upPeerReady && bridge.upPeerFree && ringUsed(bridgeUp)) {
+        // Bytes that arrive while a message is in flight batch into the next one
+        sendSerialMessage(false);
+    }
+    
+    // Downstream: credit now if something changed, when the ring has drained
+    // enough to unblock the sender, or as a keepalive while in use
+    bool active = now - bridge.lastActivityMs < SERIAL_BRIDGE_IDLE_MS;
+    uint32_t freed = ringFree(bridgeDown) - min<uint32_t>(ringFree(bridgeDown), bridge.lastFreeAdvertised);
+    if (bridge.creditDue || (bridge.downSession && active &&
+        (freed >= SERIAL_BRIDGE_RING / 4 || now - bridge.lastCreditMs >= SERIAL_BRIDGE_CREDIT_MS))) {
+        wire_packet_t packet;
+        wireBegin(packet);
+        appendSerialCredit(packet);
+        wireSend(packet, controllerAddress);
+    }
+    
+    if (now - bridgeStats.rateStartMs >= SERIAL_BRIDGE_RATE_MS) {
+        serial_bridge_stats_t& st = bridgeStats;
+        uint32_t elapsed = now - st.rateStartMs;
+        uint32_t down = st.downBytes - st.rateDownBase;
+        uint32_t up = st.upBytes - st.rateUpBase;
+        st.downRate = (uint64_t)down * 1000 / elapsed;
+        st.upRate = (uint64_t)up * 1000 / elapsed;
+        st.downPeak = max(st.downPeak, st.downRate);
+        st.upPeak = max(st.upPeak, st.upRate);
+        if (down || up) {
+            st.busyWindows++;
+            st.busyDownBytes += down;
+            st.busyUpBytes += up;
+        }
+        st.rateDownBase += down;
+        st.rateUpBase += up;
+        st.rateStartMs = now;
+    }
+}
+
+void printSerialBridge() {
+    serial_bridge_stats_t& st = bridgeStats;
+    uint32_t busyMs = st.busyWindows * SERIAL_BRIDGE_RATE_MS;
+    
+    Serial.printf("🔗 Serial bridge: %d baud, ring %u/%u down, %u/%u up | %s\n", SERIAL_BRIDGE_BAUD,
+                  (unsigned)ringUsed(bridgeDown), SERIAL_BRIDGE_RING, (unsigned)ringUsed(bridgeUp), SERIAL_BRIDGE_RING,
+                  millis() - bridge.lastActivityMs < SERIAL_BRIDGE_IDLE_MS ? "active" : "idle");
+    Serial.printf("   Down: %lu messages, %lu fragments, %lu bytes to the UART (+%lu unsequenced)\n",
+                  st.downMessages, st.downFragments, (unsigned long)st.downBytes, st.downLegacyBytes);
+    Serial.printf("         %lu duplicate, %lu out of order, %lu over credit, %lu malformed\n",
+                  st.downDuplicates, st.downOutOfOrder, st.downOverruns, st.downMalformed);
+    Serial.printf("   Up:   %lu messages, %lu fragments, %lu bytes acknowledged, %lu retransmits, %lu dropped (ring full)\n",
+                  st.upMessages, st.upFragments, (unsigned long)st.upBytes, st.upRetransmits,
+                  (unsigned long)st.upOverruns);
+    Serial.printf("   Credits: %lu sent, %lu received | controller %s, %u bytes free\n",
+                  st.creditsSent, st.creditsReceived, bridge.upPeerReady ? "ready" : "not heard", bridge.upPeerFree);
+    Serial.printf("   Rate (B/s): down %lu now, %lu peak, %lu sustained | up %lu now, %lu peak, %lu sustained\n",
+                  (unsigned long)st.downRate, (unsigned long)st.downPeak,
+                  busyMs ? (unsigned long)((uint64_t)st.busyDownBytes * 1000 / busyMs) : 0UL,
+                  (unsigned long)st.upRate, (unsigned long)st.upPeak,
+                  busyMs ? (unsigned long)((uint64_t)st.busyUpBytes * 1000 / busyMs) : 0UL);
+}
+
+// =============================================================================
+// UDP PIXEL INPUT
+// =============================================================================
+// Lighting desks and pixel mappers send E1.31 (sACN), Art-Net or DDP. Each
+// datagram's header is peeked, then recvmsg() scatters the header into a
+// small buffer and the channel data straight into pixelFrame at the pixels
+// it covers. pixelFrame still holds the last frame when a new one starts, so
+// a lost universe keeps its previous pixels.
+bool pixelInputBegin() {
+    if (WiFi.status() != WL_CONNECTED) {
+        WiFi.begin(UDP_WIFI_SSID, UDP_WIFI_PASSWORD);
+        unsigned long start = millis();
+        while (WiFi.status() != WL_CONNECTED) {
+            if (millis() - start > UDP_CONNECT_TIMEOUT_MS) return false;
+            delay(100);
+        }
+    }
+    
+    // Universes covering the whole framebuffer, so layout changes need no rejoin
+    uint8_t universes = (FRAME_BYTES_MAX + PIXEL_UNIVERSE_CHANNELS - 1) / PIXEL_UNIVERSE_CHANNELS;
+    pixelSockets[PIXEL_PROTO_SACN] = openPixelSocket(SACN_PORT, universes);
+    pixelSockets[PIXEL_PROTO_ARTNET] = openPixelSocket(ARTNET_PORT, 0);
+    pixelSockets[PIXEL_PROTO_DDP] = openPixelSocket(DDP_PORT, 0);
+    
+    Serial.printf("  💡 Pixel input: sACN %d-%d, Art-Net %d-%d, DDP, at %s\n",
+                  PIXEL_UNIVERSE_START, PIXEL_UNIVERSE_START + universes - 1,
+                  PIXEL_UNIVERSE_START - 1, PIXEL_UNIVERSE_START + universes - 2,
+                  WiFi.localIP().toString().c_str());
+    return true;
+}
+
+// Non-blocking datagram socket; sACN also joins 239.255.<hi>.<lo> per universe
+int openPixelSocket(uint16_t port, uint8_t multicastUniverses) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return -1;
+    
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    
+    for (uint8_t i = 0; i < multicastUniverses; i++) {
+        uint16_t universe = PIXEL_UNIVERSE_START + i;
+        struct ip_mreq mreq;
+        mreq.imr_multiaddr.s_addr = htonl(0xEFFF0000UL | universe);
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+    }
+    return fd;
+}
+
+void servicePixelInput() {
+    for (uint8_t proto = 0; proto < PIXEL_PROTO_COUNT; proto++) {
+        if (pixelSockets[proto] < 0) continue;
+        for (uint8_t n = 0; n < UDP_POLL_BUDGET; n++) {
+            if (!receivePixelPacket((pixel_proto_t)proto)) break;
+        }
+    }
+    
+    // A frame whose last universe never came is shown as it stands
+    if (pixelFrameOpen && millis() - pixelFrameStartMs > PIXEL_FRAME_TIMEOUT_MS) {
+        pixelStats.timeouts++;
+        finishPixelFrame();
+    }
+}
+
+// False when the socket had nothing
+bool receivePixelPacket(pixel_proto_t proto) {
+    int fd = pixelSockets[proto];
+    uint8_t header[SACN_HEADER_BYTES];
+    struct sockaddr_in from;
+    socklen_t fromLength = sizeof(from);
+    
+    int peeked = recvfrom(fd, header, sizeof(header), MSG_PEEK, (struct sockaddr*)&from, &fromLength);
+    if (peeked <= 0) return false;
+    
+    pixel_packet_t packet;
+    bool usable = parsePixelHeader(proto, header, peeked, from.sin_addr.s_addr, &packet) &&
+                  acceptPixelPacket(packet);
+    if (!usable) {
+        recv(fd, header, 1, 0);     // Drops the datagram
+        return true;
+    }
+    
+    // A universe seen twice means the sender moved on to the next frame
+    if (pixelFrameOpen && packet.universeBit && (pixelUniverseMask & packet.universeBit)) {
+        finishPixelFrame();
+    }
+    if (!pixelFrameOpen) startPixelFrame();
+    
+    uint32_t capacity = logicalLedCount * 3;
+    uint32_t length = 0;
+    if (packet.offset < capacity) length = min(packet.length, capacity - packet.offset);
+    
+    struct iovec parts[2];
+    parts[0].iov_base = header;
+    parts[0].iov_len = packet.headerLength;
+    parts[1].iov_base = pixelFrame + packet.offset;
+    parts[1].iov_len = length;
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = parts;
+    message.msg_iovlen = length ? 2 : 1;
+    recvmsg(fd, &message, 0);       // Anything past the panel is truncated away
+    
+    pixelStats.packets[proto]++;
+    pixelUniverseMask |= packet.universeBit;
+    uint32_t frameUniverses = (capacity + PIXEL_UNIVERSE_CHANNELS - 1) / PIXEL_UNIVERSE_CHANNELS;
+    uint32_t allUniverses = (frameUniverses >= 32) ? 0xFFFFFFFFUL : ((1UL << frameUniverses) - 1);
+    if (packet.push || (pixelUniverseMask & allUniverses) == allUniverses) {
+        finishPixelFrame();
+    }
+    return true;
+}
+
+// Validates one protocol header and works out where its data goes
+bool parsePixelHeader(pixel_proto_t proto, const uint8_t* h, int length, uint32_t fromIp,
+                      pixel_packet_t* packet) {
+    memset(packet, 0, sizeof(*packet));
+    packet->priority = SACN_DEFAULT_PRIORITY;
+    memcpy(packet->sourceId, &fromIp, 4);
+    packet->sourceId[15] = proto;
+    
+    uint32_t universe;
+    switch (proto) {
+        case PIXEL_PROTO_SACN: {
+            // Root, framing and DMP layers of an E1.31 data packet
+            static const uint8_t acnId[12] = {'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0};
+            if (length < SACN_HEADER_BYTES || memcmp(h + 4, acnId, 12) != 0 ||
+                h[21] != 0x04 || h[43] != 0x02 || h[117] != 0x02 || h[125] != 0x00) {
+                goto malformed;
+            }
+            if (h[112] & SACN_OPTION_TERMINATED) {
+                forgetPixelSource(h + 22);
+                return false;
+            }
+            memcpy(packet->sourceId, h + 22, 16);
+            packet->priority = h[108];
+            packet->seq = h[111];
+            packet->seqBits = 8;
+            packet->hasSeq = true;
+            universe = (h[113] << 8 | h[114]) - PIXEL_UNIVERSE_START;
+            packet->length = (h[123] << 8 | h[124]) - 1;    // Property count includes the start code
+            packet->headerLength = SACN_HEADER_BYTES;
+            break;
+        }
+        
+        case PIXEL_PROTO_ARTNET:
+            if (length < ARTNET_HEADER_BYTES || memcmp(h, "Art-Net", 8) != 0) goto malformed;
+            if ((h[8] | h[9] << 8) != ARTNET_OP_DMX) return false;  // Polls and the rest are not pixels
+            packet->seq = h[12];
+            packet->seqBits = 8;
+            packet->hasSeq = h[12] != 0;
+            universe = (h[15] << 8 | h[14]) - (PIXEL_UNIVERSE_START - 1);
+            packet->length = h[16] << 8 | h[17];
+            packet->headerLength = ARTNET_HEADER_BYTES;
+            break;
+        
+        case PIXEL_PROTO_DDP: {
+            if (length < DDP_HEADER_BYTES || (h[0] & 0xC0) != DDP_VERSION_1) goto malformed;
+            if (h[0] & (DDP_FLAG_QUERY | DDP_FLAG_REPLY) || (h[3] != DDP_ID_DISPLAY && h[3] != 0)) return false;
+            uint8_t headerLength = (h[0] & DDP_FLAG_TIMECODE) ? DDP_HEADER_BYTES + 4 : DDP_HEADER_BYTES;
+            if (length < headerLength) goto malformed;
+            packet->seq = h[1] & 0x0F;
+            packet->seqBits = 4;
+            packet->hasSeq = packet->seq != 0;
+            packet->offset = (uint32_t)h[4] << 24 | (uint32_t)h[5] << 16 | h[6] << 8 | h[7];
+            packet->length = h[8] << 8 | h[9];
+            packet->headerLength = headerLength;
+            packet->push = h[0] & DDP_FLAG_PUSH;
+            packet->universe = 0;
+            return true;
+        }
+        
+        default:
+            return false;
+    }
+    
+    // DMX universes map onto consecutive runs of channels
+    if (universe >= 32 || universe * PIXEL_UNIVERSE_CHANNELS >= logicalLedCount * 3) {
+        pixelStats.unmapped++;
+        return false;
+    }
+    packet->universe = universe;
+    packet->universeBit = 1UL << universe;
+    packet->offset = universe * PIXEL_UNIVERSE_CHANNELS;
+    packet->length = min(packet->length, (uint32_t)PIXEL_UNIVERSE_CHANNELS);
+    return true;
+    
+malformed:
+    pixelStats.malformed++;
+    return false;
+}
+
+// Source arbitration: the highest live priority wins and, among equals,
+// whoever sent last. Sequence numbers are tracked per source and universe;
+// E1.31 rule: a step back of fewer than 20 is a reordered or repeated packet.
+bool acceptPixelPacket(const pixel_packet_t& packet) {
+    unsigned long now = millis();
+    pixel_source_t* source = nullptr;
+    pixel_source_t* spare = nullptr;
+    uint8_t topPriority = 0;
+    
+    for (uint8_t i = 0; i < PIXEL_MAX_SOURCES; i++) {
+        pixel_source_t& s = pixelSources[i];
+        bool live = s.active && now - s.lastSeenMs <= PIXEL_SOURCE_TIMEOUT_MS;
+        if (s.active && !live) s.active = false;
+        if (s.active && memcmp(s.id, packet.sourceId, 16) == 0) source = &s;
+        else if (!s.active && !spare) spare = &s;
+        if (s.active && s.priority > topPriority) topPriority = s.priority;
+    }
+    
+    if (!source) {
+        if (!spare) {
+            pixelStats.sourcesFull++;
+            return false;
+        }
+        source = spare;
+        memset(source, 0, sizeof(*source));
+        memcpy(source->id, packet.sourceId, 16);
+        source->active = true;
+        pixelStats.sources++;
+    }
+    source->priority = packet.priority;
+    source->lastSeenMs = now;
+    
+    if (packet.priority < topPriority) {
+        pixelStats.outranked++;
+        return false;
+    }
+    
+    if (packet.hasSeq) {
+        uint32_t bit = 1UL << packet.universe;
+        if (source->seqValid & bit) {
+            uint8_t shift = 8 - packet.seqBits;
+            int8_t step = (int8_t)((uint8_t)(packet.seq - source->lastSeq[packet.universe]) << shift) >> shift;
+            if (step <= 0 && step > -20) {
+                pixelStats.outOfOrder++;
+                return false;
+            }
+        }
+        source->lastSeq[packet.universe] = packet.seq;
+        source->seqValid |= bit;
+    }
+    return true;
+}
+
+void forgetPixelSource(const uint8_t* cid) {
+    for (uint8_t i = 0; i < PIXEL_MAX_SOURCES; i++) {
+        if (pixelSources[i].active && memcmp(pixelSources[i].id, cid, 16) == 0) {
+            pixelSources[i].active = false;
+        }
+    }
+}
+
+void startPixelFrame() {
+    pixelFrameOpen = true;
+    pixelUniverseMask = 0;
+    pixelFrameStartMs = millis();
+}
+
+void finishPixelFrame() {
+    localFramePublish(pixelFrame);
+    pixelStats.frames++;
+    pixelFrameOpen = false;
+    pixelUniverseMask = 0;
+}
+
+void printPixelInput() {
+    if (!PIXEL_INPUT_UDP) {
+        Serial.println("💡 Pixel input: disabled (PIXEL_INPUT_UDP)");
+        return;
+    }
+    uint8_t live = 0;
+    for (uint8_t i = 0; i < PIXEL_MAX_SOURCES; i++) {
+        if (pixelSources[i].active && millis() - pixelSources[i].lastSeenMs <= PIXEL_SOURCE_TIMEOUT_MS) live++;
+    }
+    Serial.printf("💡 Pixel input: %lu frames | packets %lu sACN, %lu Art-Net, %lu DDP\n",
+                  pixelStats.frames, pixelStats.packets[PIXEL_PROTO_SACN],
+                  pixelStats.packets[PIXEL_PROTO_ARTNET], pixelStats.packets[PIXEL_PROTO_DDP]);
+    Serial.printf("   Sources: %d live, %lu seen, %lu turned away (table full)\n",
+                  live, pixelStats.sources, pixelStats.sourcesFull);
+    Serial.printf("   Rejected: %lu out of order, %lu outranked, %lu unmapped universe, %lu malformed\n",
+                  pixelStats.outOfOrder, pixelStats.outranked, pixelStats.unmapped, pixelStats.malformed);
+    Serial.printf("   Frames shown incomplete: %lu\n", pixelStats.timeouts);
+}
+
+// =============================================================================
+// ZONES
+// =============================================================================
+void initializeZones() {
+    for (uint8_t z = 0; z < MAX_ZONES; z++) {
+        led_zone_t& zone = zones[z];
+        zone = led_zone_t();
+        zone.effect = 0;
+        zone.speed = 50;
+        zone.brightness = 50;
+        zone.color = CRGB::Red;
+        zone.frameIntervalMs = LED_UPDATE_INTERVAL_MS;
+        updateWhiteMix(zone.whiteMix, 0, 0);
+        resetZoneEffectState(zone);
+        zoneScale[z] = map(zone.brightness, 1, 100, 0, 255);
+    }
 }
 
-void initializeHardware() {
-    Serial.println("🔧 Initializing hardware...");
-    
-    // Configure ESP-NOW log levels
-    esp_log_level_set("wifi", ESP_LOG_WARN);
-    esp_log_level_set("esp_now", ESP_LOG_WARN);
-    
-    // Initialize FastLED
-    FastLED.addLeds<LED_TYPE, LED_PIN, COLOR_ORDER>(leds, NUM_LEDS);
-    FastLED.setBrightness(50);
-    FastLED.clear();
-    FastLED.show();
+// Back to a single zone covering the whole matrix; parameters are kept
+void resetZones() {
+    for (uint8_t z = 1; z < MAX_ZONES; z++) {
+        zones[z].active = false;
+    }
+    setZoneRect(0, 0, 0, matrixWidth, matrixHeight);
+}
+
+bool setZoneRect(uint8_t id, uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+    if (id >= MAX_ZONES || w == 0 || h == 0) return false;
+    if (x + w > matrixWidth || y + h > matrixHeight) return false;
     
-    Serial.println("  ✓ FastLED initialized");
-    Serial.println("  ✓ LED matrix configured (32x8)");
+    led_zone_t& zone = zones[id];
+    zone.shape = ZONE_RECT;
+    zone.x = x;
+    zone.y = y;
+    zone.w = w;
+    zone.h = h;
+    zone.pixelCount = w * h;
+    zone.active = true;
+    zone.lastRenderTime = 0;
+    rebuildZoneMap();
+    return true;
 }
 
-void initializeESPNOW() {
-    Serial.println("📡 Initializing ESP-NOW...");
+bool setZoneRange(uint8_t id, uint16_t start, uint16_t count) {
+    if (id >= MAX_ZONES || count == 0) return false;
+    if ((uint32_t)start + count > logicalLedCount) return false;
     
-    WiFi.mode(WIFI_STA);
-    delay(100);
+    led_zone_t& zone = zones[id];
+    zone.shape = ZONE_RANGE;
+    zone.start = start;
+    zone.pixelCount = count;
+    zone.active = true;
+    zone.lastRenderTime = 0;
+    rebuildZoneMap();
+    return true;
+}
+
+// Overlapping zones: the higher id owns the pixel
+void rebuildZoneMap() {
+    memset(zoneOf, ZONE_NONE, sizeof(zoneOf));
     
-    Serial.printf("  📍 MAC Address: %s\n", WiFi.macAddress().c_str());
+    for (uint8_t z = 0; z < MAX_ZONES; z++) {
+        if (!zones[z].active) continue;
+        zone_cursor_t c;
+        for (zoneCursorBegin(zones[z], c); c.ordinal < zones[z].pixelCount; zoneCursorNext(zones[z], c)) {
+            zoneOf[c.index] = z;
+        }
+    }
     
-    if (esp_now_init() != ESP_OK) {
-        showError("ESP-NOW initialization failed!");
+    fill_solid(frame, NUM_LEDS, CRGB::Black);
+}
+
+// Runs in the WiFi task: only the latest command per zone is kept. Commands
+// for zones this receiver does not have are filtered out.
+void queueZoneCommand(uint8_t zone, const led_command_t* command, uint32_t applyAtMs) {
+    if (zone != ZONE_ALL && (zone >= MAX_ZONES || !zones[zone].active)) {
+        wireStats.zoneFiltered++;
+        commandsDropped++;
         return;
     }
     
-    // Register callbacks
-    esp_now_register_recv_cb(OnDataRecv);
-    esp_now_register_send_cb(OnDataSent);
-    
-    setupPeerConnection();
-    Serial.println("  ✅ ESP-NOW ready");
+    portENTER_CRITICAL(&commandMux);
+    for (uint8_t z = 0; z < MAX_ZONES; z++) {
+        if (zone == z || (zone == ZONE_ALL && zones[z].active)) {
+            if (pendingZoneMask & (1 << z)) commandsCoalesced++;
+            memcpy(&pendingCommands[z], command, sizeof(led_command_t));
+            pendingApplyAt[z] = applyAtMs;
+            pendingZoneMask |= (1 << z);
+        }
+    }
+    portEXIT_CRITICAL(&commandMux);
 }
 
-void setupPeerConnection() {
-    esp_now_peer_info_t peerInfo;
-    memset(&peerInfo, 0, sizeof(peerInfo));
-    memcpy(peerInfo.peer_addr, controllerAddress, 6);
-    peerInfo.channel = 1;
-    peerInfo.encrypt = false;
+void applyZoneCommand(led_zone_t& zone, const led_command_t& command) {
+    zone.color = CRGB(command.red, command.green, command.blue);
+    zone.effect = command.effect;
+    zone.speed = constrain(command.speed, 1, 100);  // Effects map 1-100 onto periods; past 110 fade divides by zero
+    zone.brightness = command.brightness;
+    updateWhiteMix(zone.whiteMix, command.white, command.warmWhite);
+    zoneScale[&zone - zones] = map(constrain(zone.brightness, 1, 100), 1, 100, 0, 255);
+    endLive(&zone - zones);
     
-    if (esp_now_add_peer(&peerInfo) != ESP_OK) {
-        Serial.println("  ❌ Failed to add controller peer");
+    // Reset effect states for smooth transitions
+    resetZoneEffectState(zone);
+    zone.lastRenderTime = 0;
+}
+
+void resetZoneEffectState(led_zone_t& zone) {
+    zone.rainbowHue = 0;
+    zone.strobeState = false;
+    zone.effectEpoch = effectMillis();
+    zone.fadingIn = true;
+    zone.pulsePhase = 0.0;
+}
+
+void zoneCursorBegin(const led_zone_t& zone, zone_cursor_t& c) {
+    c.ordinal = 0;
+    if (zone.shape == ZONE_RECT) {
+        c.x = zone.x;
+        c.y = zone.y;
     } else {
-        Serial.printf("  ✅ Controller peer added: ");
-        for(int i = 0; i < 6; i++) {
-            Serial.printf("%02X", controllerAddress[i]);
-            if(i < 5) Serial.print(":");
-        }
-        Serial.println();
+        c.x = zone.start % matrixWidth;
+        c.y = zone.start / matrixWidth;
     }
+    c.index = c.y * matrixWidth + c.x;
 }
 
-// =============================================================================
-// MAIN LOOP
-// =============================================================================
-void loop() {
-    handleSerialCommands();
-    processReceivedCommand();
-    updateLEDEffects();
+void zoneCursorNext(const led_zone_t& zone, zone_cursor_t& c) {
+    c.ordinal++;
+    c.x++;
+    c.index++;
     
-    // Handle response timeout
-    if (expectingResponse && millis() > responseTimeout) {
-        expectingResponse = false;
-        isConnected = false;
-        Serial.println("⏰ Response timeout - controller may be offline");
+    uint16_t rowEnd = zone.shape == ZONE_RECT ? zone.x + zone.w : matrixWidth;
+    if (c.x >= rowEnd) {
+        c.x = zone.shape == ZONE_RECT ? zone.x : 0;
+        c.y++;
+        c.index = c.y * matrixWidth + c.x;
+    }
+}
+
+uint16_t zonePixelAt(const led_zone_t& zone, uint16_t ordinal) {
+    if (zone.shape == ZONE_RANGE) return zone.start + ordinal;
+    return (zone.y + ordinal / zone.w) * matrixWidth + zone.x + ordinal % zone.w;
+}
+
+void fillZone(const led_zone_t& zone, CRGB color) {
+    if (zone.shape == ZONE_RANGE) {
+        fill_solid(frame + zone.start, zone.pixelCount, color);
+        return;
+    }
+    for (uint16_t row = 0; row < zone.h; row++) {
+        fill_solid(frame + (zone.y + row) * matrixWidth + zone.x, zone.w, color);
+    }
+}
+
+// zones                          - list zones
+// zones reset                    - one zone covering the matrix
+// zones split <n>                - n equal columns sharing zone 0's parameters
+// zone <id> rect <x> <y> <w> <h> - rectangular region
+// zone <id> range <start> <n>    - run of logical pixels
+// zone <id> off                  - disable
+// zone <id> effect|speed|bright|fps <n>
+// zone <id> color <r> <g> <b>
+void handleZoneCommand(String args) {
+    if (args.length() == 0) {
+        printZones();
+        return;
     }
     
-    // Send periodic heartbeat
-    if (millis() - lastHeartbeat > HEARTBEAT_INTERVAL_MS) {
-        if (!expectingResponse) {
-            Serial.println("💓 Sending heartbeat request...");
-            sendColorRequest();
+    if (args == "reset") {
+        resetZones();
+        printZones();
+        return;
+    }
+    
+    if (args.startsWith("split ")) {
+        int count = args.substring(6).toInt();
+        if (count < 1 || count > MAX_ZONES || count > matrixWidth) {
+            Serial.printf("❌ Split must be 1-%d\n", min<int>(MAX_ZONES, matrixWidth));
+            return;
         }
-        lastHeartbeat = millis();
+        for (uint8_t z = 0; z < MAX_ZONES; z++) {
+            zones[z].active = false;
+        }
+        uint16_t x = 0;
+        for (uint8_t z = 0; z < count; z++) {
+            uint16_t w = matrixWidth / count + (z < matrixWidth % count ? 1 : 0);
+            if (z > 0) {
+                zones[z] = zones[0];
+                zoneScale[z] = zoneScale[0];
+            }
+            setZoneRect(z, x, 0, w, matrixHeight);
+            x += w;
+        }
+        printZones();
+        return;
     }
     
-    delay(5);
-}
-
-// =============================================================================
-// COMMAND PROCESSING
-// =============================================================================
-void handleSerialCommands() {
-    if (!Serial.available()) return;
+    // zone <id> <verb> <values...>
+    long values[4] = {0, 0, 0, 0};
+    int space = args.indexOf(' ');
+    int id = args.toInt();
+    if (space < 0 || id < 0 || id >= MAX_ZONES) {
+        Serial.printf("❌ Zone id must be 0-%d\n", MAX_ZONES - 1);
+        return;
+    }
     
-    String command = Serial.readStringUntil('\n');
-    command.trim();
-    command.toLowerCase();
+    String rest = args.substring(space + 1);
+    space = rest.indexOf(' ');
+    String verb = space > 0 ? rest.substring(0, space) : rest;
+    rest = space > 0 ? rest.substring(space + 1) : String("");
     
-    if (command.length() == 0) return;
+    uint8_t valueCount = 0;
+    while (rest.length() > 0 && valueCount < 4) {
+        values[valueCount++] = rest.toInt();
+        space = rest.indexOf(' ');
+        rest = space > 0 ? rest.substring(space + 1) : String("");
+    }
     
-    Serial.println("📝 Command: " + command);
+    led_zone_t& zone = zones[id];
+    bool ok = true;
     
-    if (command == "request" || command == "r") {
-        sendColorRequest();
-    } 
-    else if (command == "status" || command == "s") {
-        printStatus();
+    if (verb == "rect" && valueCount == 4) {
+        ok = setZoneRect(id, values[0], values[1], values[2], values[3]);
     }
-    else if (command == "diag" || command == "d") {
-        printDiagnostics();
+    else if (verb == "range" && valueCount == 2) {
+        ok = setZoneRange(id, values[0], values[1]);
     }
-    else if (command == "test" || command == "t") {
-        bootSequence();
+    else if (verb == "off") {
+        zone.active = false;
+        rebuildZoneMap();
     }
-    else if (command == "clear" || command == "c") {
-        FastLED.clear();
-        FastLED.show();
-        Serial.println("🔄 LEDs cleared");
+    else if (verb == "effect" && valueCount == 1 && values[0] >= 0 && values[0] <= EFFECT_MAX) {
+        zone.effect = values[0];
+        resetZoneEffectState(zone);
     }
-    else if (command == "help" || command == "h") {
-        printHelp();
+    else if (verb == "speed" && valueCount == 1 && values[0] >= 1 && values[0] <= 100) {
+        zone.speed = values[0];
     }
-    else if (command.startsWith("bright ")) {
-        int brightness = command.substring(7).toInt();
-        if (brightness >= 1 && brightness <= 100) {
-            currentBrightness = brightness;
-            FastLED.setBrightness(map(brightness, 1, 100, 0, 255));
-            Serial.printf("☀️  Brightness set to %d%%\n", brightness);
-        } else {
-            Serial.println("❌ Brightness must be 1-100");
-        }
+    else if (verb == "bright" && valueCount == 1 && values[0] >= 1 && values[0] <= 100) {
+        zone.brightness = values[0];
+        zoneScale[id] = map(zone.brightness, 1, 100, 0, 255);
     }
-    else if (command.startsWith("effect ")) {
-        int effect = command.substring(7).toInt();
-        if (effect >= 0 && effect <= 6) {
-            currentEffect = effect;
-            Serial.printf("✨ Effect set to %d\n", effect);
-        } else {
-            Serial.println("❌ Effect must be 0-6");
-        }
+    else if (verb == "fps" && valueCount == 1 && values[0] >= 1 && values[0] <= 100) {
+        zone.frameIntervalMs = 1000 / values[0];
+    }
+    else if (verb == "color" && valueCount == 3) {
+        zone.color = CRGB(values[0], values[1], values[2]);
+        resetZoneEffectState(zone);
     }
     else {
-        Serial.println("❓ Unknown command. Type 'help' for available commands.");
+        Serial.println("❌ Usage: zone <id> rect|range|off|effect|speed|bright|fps|color ...");
+        return;
     }
-}
-
-void processReceivedCommand() {
-    if (!newCommandReceived) return;
-    
-    newCommandReceived = false;
     
-    // Update current state
-    currentColor = CRGB(receivedCommand.red, receivedCommand.green, receivedCommand.blue);
-    currentEffect = receivedCommand.effect;
-    currentSpeed = receivedCommand.speed;
-    currentBrightness = receivedCommand.brightness;
-    
-    // Reset effect states for smooth transitions
-    rainbowHue = 0;
-    strobeState = false;
-    fadeStartTime = millis();
-    fadingIn = true;
-    fadeStartColor = CRGB::Black;
-    fadeTargetColor = currentColor;
-    pulsePhase = 0.0;
-    
-    Serial.printf("🎨 Updated: Color(%d,%d,%d) Effect:%d Speed:%d Brightness:%d%%\n",
-                 currentColor.r, currentColor.g, currentColor.b,
-                 currentEffect, currentSpeed, currentBrightness);
+    if (!ok) {
+        Serial.printf("❌ Region does not fit the %dx%d matrix\n", matrixWidth, matrixHeight);
+        return;
+    }
+    printZones();
 }
 
-void updateLEDEffects() {
-    if (millis() - lastLedUpdateTime < LED_UPDATE_INTERVAL_MS) return;
-    
-    lastLedUpdateTime = millis();
-    FastLED.clear();
-    FastLED.setBrightness(map(currentBrightness, 1, 100, 0, 255));
-    
-    applyEffect();
-    FastLED.show();
+void printZones() {
+    Serial.println("🗺️  Zones:");
+    for (uint8_t z = 0; z < MAX_ZONES; z++) {
+        const led_zone_t& zone = zones[z];
+        if (!zone.active) continue;
+        if (zone.shape == ZONE_RECT) {
+            Serial.printf("   Z%d rect %d,%d %dx%d", z, zone.x, zone.y, zone.w, zone.h);
+        } else {
+            Serial.printf("   Z%d range %d+%d", z, zone.start, zone.pixelCount);
+        }
+        Serial.printf(" | Effect %d Speed %d Bright %d%% | RGB(%d,%d,%d) | %d fps\n",
+                      zone.effect, zone.speed, zone.brightness,
+                      zone.color.r, zone.color.g, zone.color.b,
+                      1000 / zone.frameIntervalMs);
+    }
 }
 
 // =============================================================================
-// LED EFFECTS
+// INSTANT-ON SCENE
 // =============================================================================
-void applyEffect() {
-    switch (currentEffect) {
-        case 0: effectSolid(); break;
-        case 1: effectRainbow(); break;
-        case 2: effectFade(); break;
-        case 3: effectStrobe(); break;
-        case 4: effectPulse(); break;
-        case 5: effectSparkle(); break;
-        case 6: effectWave(); break;
-        default: effectSolid(); break;
+void snapshotScene(scene_t& scene) {
+    memset(&scene, 0, sizeof(scene));
+    scene.version = SCENE_VERSION;
+    scene.width = matrixWidth;
+    scene.height = matrixHeight;
+    for (uint8_t z = 0; z < MAX_ZONES; z++) {
+        const led_zone_t& zone = zones[z];
+        scene_zone_t& saved = scene.zones[z];
+        saved.active = zone.active;
+        saved.shape = zone.shape;
+        saved.x = zone.x;
+        saved.y = zone.y;
+        saved.w = zone.w;
+        saved.h = zone.h;
+        saved.start = zone.start;
+        saved.pixelCount = zone.pixelCount;
+        saved.effect = zone.effect;
+        saved.speed = zone.speed;
+        saved.brightness = zone.brightness;
+        memcpy(saved.color, zone.color.raw, 3);
+        saved.white = zone.whiteMix.white;
+        saved.warmAmount = zone.whiteMix.warmAmount;
+        memcpy(saved.warmColor, zone.whiteMix.warmColor.raw, 3);
+        saved.frameIntervalMs = zone.frameIntervalMs;
     }
 }
 
-void effectSolid() {
-    CRGB adjustedColor = applyWhiteAndWarmWhite(currentColor, receivedCommand.white, receivedCommand.warmWhite);
-    fill_solid(leds, NUM_LEDS, adjustedColor);
+// Zones that no longer fit the matrix are left out; with none left it's
+// the usual single zone. A scene saved for another matrix size keeps its
+// effects but not its zone shapes, which meant other pixels there.
+bool restoreScene() {
+    scene_t scene;
+    scenePrefs.begin("scene", true);
+    bool stored = scenePrefs.getBytesLength("scene") == sizeof(scene) &&
+                  scenePrefs.getBytes("scene", &scene, sizeof(scene)) == sizeof(scene) &&
+                  scene.version == SCENE_VERSION;
+    scenePrefs.end();
+    
+    if (stored) {
+        bool sameMatrix = scene.width == matrixWidth && scene.height == matrixHeight;
+        if (!sameMatrix) {
+            Serial.printf("⚠️  Saved scene is for a %dx%d matrix, now %dx%d: zones reset\n",
+                          scene.width, scene.height, matrixWidth, matrixHeight);
+        }
+        bool any = false;
+        for (uint8_t z = 0; z < MAX_ZONES; z++) {
+            const scene_zone_t& saved = scene.zones[z];
+            led_zone_t& zone = zones[z];
+            zone.active = false;
+            zone.effect = min<uint8_t>(saved.effect, EFFECT_MAX);
+            zone.speed = constrain(saved.speed, 1, 100);
+            zone.brightness = constrain(saved.brightness, 1, 100);
+            zone.color = CRGB(saved.color[0], saved.color[1], saved.color[2]);
+            zone.whiteMix.white = saved.white;
+            zone.whiteMix.warmAmount = saved.warmAmount;
+            zone.whiteMix.warmColor = CRGB(saved.warmColor[0], saved.warmColor[1], saved.warmColor[2]);
+            zone.frameIntervalMs = max<uint16_t>(saved.frameIntervalMs, 1);
+            zoneScale[z] = map(zone.brightness, 1, 100, 0, 255);
+            resetZoneEffectState(zone);
+            if (!saved.active || !sameMatrix) continue;
+            
+            if (saved.shape == ZONE_RECT) {
+                any |= setZoneRect(z, saved.x, saved.y, saved.w, saved.h);
+            } else {
+                any |= setZoneRange(z, saved.start, saved.pixelCount);
+            }
+        }
+        if (any) {
+            rebuildZoneMap();
+        } else {
+            resetZones();
+        }
+    }
+    
+    // Flash is only written once something changes from here
+    sceneRestored = stored;
+    snapshotScene(savedScene);
+    lastSceneCheck = savedScene;
+    sceneTokenMs = millis();
+    return stored;
 }
 
-void effectRainbow() {
-    uint16_t speedFactor = map(currentSpeed, 1, 100, 200, 20);
-    uint8_t hueOffset = (millis() / speedFactor) % 256;
+void writeScene(const scene_t& scene) {
+    unsigned long writeStart = micros();
+    scenePrefs.begin("scene", false);
+    scenePrefs.putBytes("scene", &scene, sizeof(scene));
+    scenePrefs.end();
+    sceneStats.lastWriteUs = micros() - writeStart;
     
-    for (int i = 0; i < NUM_LEDS; i++) {
-        CRGB rainbowColor = CHSV(hueOffset + (i * 256 / NUM_LEDS), 255, 255);
-        leds[i] = applyWhiteAndWarmWhite(rainbowColor, receivedCommand.white, receivedCommand.warmWhite);
-    }
+    savedScene = scene;
+    sceneDirty = false;
+    sceneBudgetNoted = false;
+    lastSceneWriteMs = millis();
+    sceneStats.writes++;
+    if (sceneWriteTokens) sceneWriteTokens--;
 }
 
-void effectFade() {
-    unsigned long fadeDuration = map(currentSpeed, 1, 100, 3000, 300);
-    unsigned long elapsed = millis() - fadeStartTime;
+// Polls the zones instead of hooking every place that changes them. A
+// burst of changes is saved once it settles, or at the latest after
+// SCENE_MAX_DEFER_MS; the interval and hourly budget bound the wear.
+void serviceScene() {
+    unsigned long now = millis();
+    if (now - lastSceneCheckMs < SCENE_CHECK_MS) return;
+    lastSceneCheckMs = now;
     
-    if (elapsed >= fadeDuration) {
-        fadingIn = !fadingIn;
-        fadeStartTime = millis();
-        CRGB adjustedColor = applyWhiteAndWarmWhite(currentColor, receivedCommand.white, receivedCommand.warmWhite);
-        fadeStartColor = fadingIn ? CRGB::Black : adjustedColor;
-        fadeTargetColor = fadingIn ? adjustedColor : CRGB::Black;
-        elapsed = 0;
+    const unsigned long tokenMs = 3600000UL / SCENE_WRITES_PER_HOUR;
+    if (sceneWriteTokens >= SCENE_WRITES_PER_HOUR) {
+        sceneTokenMs = now;
+    } else if (now - sceneTokenMs >= tokenMs) {
+        sceneWriteTokens++;
+        sceneTokenMs += tokenMs;
     }
     
-    float progress = constrain((float)elapsed / fadeDuration, 0.0, 1.0);
-    // Use sine wave for smoother easing
-    progress = (sin(progress * PI - PI/2) + 1.0) / 2.0;
+    scene_t scene;
+    snapshotScene(scene);
+    if (memcmp(&scene, &lastSceneCheck, sizeof(scene)) != 0) {
+        lastSceneCheck = scene;
+        sceneChangedMs = now;
+        sceneStats.changes++;
+    }
+    if (memcmp(&scene, &savedScene, sizeof(scene)) == 0) {
+        // Back to what flash holds
+        sceneDirty = false;
+        return;
+    }
+    if (!sceneDirty) {
+        sceneDirty = true;
+        sceneDirtySinceMs = now;
+    }
     
-    CRGB interpolatedColor = blend(fadeStartColor, fadeTargetColor, (uint8_t)(progress * 255));
-    fill_solid(leds, NUM_LEDS, interpolatedColor);
+    bool settled = now - sceneChangedMs >= SCENE_QUIET_MS;
+    bool overdue = now - sceneDirtySinceMs >= SCENE_MAX_DEFER_MS;
+    if (!settled && !overdue) return;
+    if (now - lastSceneWriteMs < SCENE_MIN_INTERVAL_MS && sceneStats.writes) return;
+    if (!sceneWriteTokens) {
+        if (!sceneBudgetNoted) sceneStats.heldByBudget++;
+        sceneBudgetNoted = true;
+        return;
+    }
+    writeScene(scene);
 }
 
-void effectStrobe() {
-    unsigned long strobeDelay = map(currentSpeed, 1, 100, 800, 30);
-    if (millis() - lastEffectRunTime >= strobeDelay) {
-        lastEffectRunTime = millis();
-        strobeState = !strobeState;
+// scene         - boot timing and what is saved
+// scene save    - write the current scene now
+// scene forget  - boot with defaults (and the test pattern) next time
+void handleSceneCommand(String args) {
+    if (args == "save") {
+        scene_t scene;
+        snapshotScene(scene);
+        writeScene(scene);
+        Serial.printf("💾 Scene saved (%lu µs)\n", (unsigned long)sceneStats.lastWriteUs);
     }
-    
-    CRGB strobeColor = strobeState ? 
-                      applyWhiteAndWarmWhite(currentColor, receivedCommand.white, receivedCommand.warmWhite) : 
-                      CRGB::Black;
-    fill_solid(leds, NUM_LEDS, strobeColor);
+    else if (args == "forget") {
+        scenePrefs.begin("scene", false);
+        scenePrefs.remove("scene");
+        scenePrefs.end();
+        // Written again on the next change, not before
+        snapshotScene(savedScene);
+        sceneDirty = false;
+        Serial.println("🗑️  Saved scene forgotten");
+    }
+    else if (args.length() > 0) {
+        Serial.println("❌ Usage: scene [save|forget]");
+        return;
+    }
+    printScene();
 }
 
-void effectPulse() {
-    unsigned long pulsePeriod = map(currentSpeed, 1, 100, 4000, 400);
-    pulsePhase = (float)(millis() % pulsePeriod) / pulsePeriod * TWO_PI;
-    float brightnessFactor = (sin(pulsePhase) + 1.0) / 2.0;
-    
-    // Apply smooth cubic easing
-    brightnessFactor = brightnessFactor * brightnessFactor * (3.0 - 2.0 * brightnessFactor);
+void printScene() {
+    const scene_stats_t& st = sceneStats;
+    unsigned long now = millis();
     
-    CRGB baseColor = applyWhiteAndWarmWhite(currentColor, receivedCommand.white, receivedCommand.warmWhite);
-    CRGB pulsedColor = baseColor;
-    pulsedColor.nscale8_video(brightnessFactor * 255);
-    fill_solid(leds, NUM_LEDS, pulsedColor);
+    Serial.printf("🎬 Scene: %s at boot\n", sceneRestored ? "restored from flash" : "defaults (nothing saved)");
+    Serial.printf("   Boot: first frame %lu ms, setup done %lu ms, radio ready %s%lu ms\n",
+                  (unsigned long)(st.firstFrameUs / 1000), (unsigned long)(st.setupDoneUs / 1000),
+                  transportReady ? "" : "(not yet) ", (unsigned long)(st.radioReadyUs / 1000));
+    Serial.printf("   Writes: %lu for %lu changes, last took %lu µs | %d of %d left this hour, %lu held back\n",
+                  st.writes, st.changes, (unsigned long)st.lastWriteUs,
+                  sceneWriteTokens, SCENE_WRITES_PER_HOUR, st.heldByBudget);
+    if (sceneDirty) {
+        Serial.printf("   Unsaved change, %lu ms old, last moved %lu ms ago\n",
+                      now - sceneDirtySinceMs, now - sceneChangedMs);
+    } else {
+        Serial.println("   Flash matches what is showing");
+    }
 }
 
-void effectSparkle() {
-    // Fade existing sparkles
-    for (int i = 0; i < NUM_LEDS; i++) {
-        leds[i].nscale8(240); // Fade by ~6%
+// =============================================================================
+// OUTPUT CHANNELS
+// =============================================================================
+void initializeOutputs() {
+    outputChannelCount = 0;
+    for (uint8_t ch = 0; ch < OUTPUT_CHANNELS && ch < MAX_OUTPUT_CHANNELS; ch++) {
+        CLEDController* controller = addOutputController(outputPins[ch], leds, 0);
+        if (!controller) {
+            Serial.printf("  ❌ GPIO %d cannot drive LEDs, channel skipped\n", outputPins[ch]);
+            continue;
+        }
+        outputControllers[outputChannelCount] = controller;
+        outputSegments[outputChannelCount].pin = outputPins[ch];
+        outputChannelCount++;
+    }
+    splitOutputSegments();
+}
+
+// FastLED needs the pin as a template argument, so runtime pins are
+// dispatched through the GPIOs that can drive an RMT output.
+#define OUTPUT_PIN_CASE(p) \
+    case p: return &FastLED.addLeds<LED_TYPE, p, WIRE_COLOR_ORDER>(data, count);
+
+CLEDController* addOutputController(uint8_t pin, CRGB* data, int count) {
+    switch (pin) {
+        OUTPUT_PIN_CASE(2)  OUTPUT_PIN_CASE(4)  OUTPUT_PIN_CASE(5)
+        OUTPUT_PIN_CASE(12) OUTPUT_PIN_CASE(13) OUTPUT_PIN_CASE(14)
+        OUTPUT_PIN_CASE(15) OUTPUT_PIN_CASE(16) OUTPUT_PIN_CASE(17)
+        OUTPUT_PIN_CASE(18) OUTPUT_PIN_CASE(19) OUTPUT_PIN_CASE(21)
+        OUTPUT_PIN_CASE(22) OUTPUT_PIN_CASE(23) OUTPUT_PIN_CASE(25)
+        OUTPUT_PIN_CASE(26) OUTPUT_PIN_CASE(27) OUTPUT_PIN_CASE(32)
+        OUTPUT_PIN_CASE(33)
+        default: return nullptr;
     }
+}
+
+// Default map: wired LEDs split into contiguous, evenly sized runs
+void splitOutputSegments() {
+    if (outputChannelCount == 0) return;
     
-    // Add new sparkles based on speed
-    int sparkleCount = map(currentSpeed, 1, 100, 1, 8);
-    CRGB sparkleColor = applyWhiteAndWarmWhite(currentColor, receivedCommand.white, receivedCommand.warmWhite);
+    output_segment_t segments[MAX_OUTPUT_CHANNELS];
+    uint16_t base = physicalLedCount / outputChannelCount;
+    uint16_t extra = physicalLedCount % outputChannelCount;
+    uint16_t start = 0;
     
-    for (int i = 0; i < sparkleCount; i++) {
-        if (random(100) < 30) { // 30% chance per sparkle
-            int pos = random(NUM_LEDS);
-            leds[pos] = sparkleColor;
-        }
+    for (uint8_t ch = 0; ch < outputChannelCount; ch++) {
+        segments[ch].pin = outputSegments[ch].pin;
+        segments[ch].start = start;
+        segments[ch].count = base + (ch < extra ? 1 : 0);
+        start += segments[ch].count;
     }
+    applyOutputSegments(segments, outputChannelCount);
 }
 
-void effectWave() {
-    unsigned long waveSpeed = map(currentSpeed, 1, 100, 100, 10);
-    float timeOffset = (float)millis() / waveSpeed;
+bool applyOutputSegments(const output_segment_t* segments, uint8_t count) {
+    if (count != outputChannelCount) return false;
     
-    CRGB waveColor = applyWhiteAndWarmWhite(currentColor, receivedCommand.white, receivedCommand.warmWhite);
+    for (uint8_t ch = 0; ch < count; ch++) {
+        if ((uint32_t)segments[ch].start + segments[ch].count > NUM_LEDS) return false;
+    }
     
-    for (int x = 0; x < LED_WIDTH; x++) {
-        for (int y = 0; y < LED_HEIGHT; y++) {
-            float wave1 = sin((x * 0.3) + timeOffset);
-            float wave2 = sin((y * 0.5) + timeOffset * 1.2);
-            float brightness = (wave1 + wave2 + 2.0) / 4.0; // Normalize to 0-1
-            
-            CRGB pixelColor = waveColor;
-            pixelColor.nscale8_video(brightness * 255);
-            
-            int index = getMatrixIndex(x, y);
-            if (index >= 0 && index < NUM_LEDS) {
-                leds[index] = pixelColor;
-            }
-        }
+    for (uint8_t ch = 0; ch < count; ch++) {
+        outputSegments[ch] = segments[ch];
+#if LED_WHITE_CHANNEL
+        // 4 bytes per pixel sent as ceil(4n / 3) RGB triplets
+        uint8_t* wire = rgbwLeds[segments[ch].start].raw;
+        outputControllers[ch]->setLeds((CRGB*)wire, (segments[ch].count * 4 + 2) / 3);
+#else
+        outputControllers[ch]->setLeds(leds + segments[ch].start, segments[ch].count);
+#endif
     }
+    return true;
 }
 
-// =============================================================================
-// UTILITY FUNCTIONS
-// =============================================================================
-CRGB applyWhiteAndWarmWhite(CRGB color, uint8_t white, uint8_t warmWhite) {
-    CHSV hsv = rgb2hsv_approximate(color);
-    hsv.s = map(white, 0, 255, 255, 0); // Higher white = less saturation
-    
-    CRGB saturatedColor;
-    hsv2rgb_spectrum(hsv, saturatedColor);
+uint32_t segmentWireTimeUs(uint16_t count) {
+    return (uint32_t)count * 24 * WS2812_BIT_TIME_NS / 1000 + WS2812_RESET_US;
+}
+
+void showFrame() {
+    uint8_t brightness = FastLED.getBrightness();
     
-    if (warmWhite > 0) {
-        CRGB warmColor = CRGB(255, map(warmWhite, 0, 255, 120, 255), 20);
-        saturatedColor = blend(saturatedColor, warmColor, warmWhite >> 2); // Subtle warm blend
+    if (frameCacheValid && brightness == shownBrightness &&
+        millis() - lastFrameRefresh < FRAME_REFRESH_MS &&
+        memcmp(leds, shownLeds, sizeof(leds)) == 0) {
+        framesSkipped++;
+        return;
     }
     
-    return saturatedColor;
+    unsigned long showStart = micros();
+    encodeWirePixels();
+    FastLED.show();
+    lastShowTimeUs = micros() - showStart;
+    if (lastShowTimeUs > maxShowTimeUs) maxShowTimeUs = lastShowTimeUs;
+    recordTiming(showTiming, lastShowTimeUs);
+    
+    // Only changed frames get here, so the estimate costs nothing when idle
+    estimatedCurrentMa = estimateCurrentMa(leds, physicalLedCount, brightness);
+    
+    memcpy(shownLeds, leds, sizeof(leds));
+    shownBrightness = brightness;
+    frameCacheValid = true;
+    lastFrameRefresh = millis();
+    framesShown++;
 }
 
-int16_t getMatrixIndex(int16_t x, int16_t y) {
-    if (x < 0 || x >= LED_WIDTH || y < 0 || y >= LED_HEIGHT) return -1;
-    
-    // Serpentine layout: even rows left-to-right, odd rows right-to-left
-    if (y % 2 == 0) {
-        return y * LED_WIDTH + x;
-    } else {
-        return y * LED_WIDTH + (LED_WIDTH - 1 - x);
+void invalidateFrameCache() {
+    frameCacheValid = false;
+}
+
+// Show leds[] right away, bypassing the unchanged-frame check
+void showImmediate() {
+    encodeWirePixels();
+    FastLED.show();
+    invalidateFrameCache();
+}
+
+// RGB strips read leds[] directly; 4-channel strips get the white LED split out
+void encodeWirePixels() {
+#if LED_WHITE_CHANNEL
+    for (uint8_t ch = 0; ch < outputChannelCount; ch++) {
+        uint16_t end = outputSegments[ch].start + outputSegments[ch].count;
+        for (uint16_t i = outputSegments[ch].start; i < end; i++) {
+            rgbwLeds[i] = extractWhite(leds[i]);
+        }
     }
+#endif
 }
 
-void sendColorRequest() {
-    if (expectingResponse) {
-        Serial.println("⏳ Already waiting for response...");
+// outputs                 - print the segment map
+// outputs even            - split wired LEDs evenly across channels
+// outputs <n> <n> ...     - explicit LED count per channel, in chain order
+void handleOutputsCommand(String args) {
+    if (args.length() == 0) {
+        printOutputs();
         return;
     }
     
-    color_request_t request = {1, 1}; // requestType=1, fromReceiver=1
+    if (args == "even") {
+        splitOutputSegments();
+        printOutputs();
+        return;
+    }
     
-    Serial.println("📤 Sending color request...");
-    esp_err_t result = esp_now_send(controllerAddress, (uint8_t*)&request, sizeof(request));
+    output_segment_t segments[MAX_OUTPUT_CHANNELS];
+    uint16_t start = 0;
+    uint8_t ch = 0;
     
-    if (result == ESP_OK) {
-        requestsSent++;
-        Serial.println("✅ Request queued successfully");
-    } else {
-        Serial.printf("❌ Request failed: 0x%X\n", result);
+    while (args.length() > 0 && ch < outputChannelCount) {
+        int space = args.indexOf(' ');
+        long count = args.toInt();
+        if (count < 0) break;
+        segments[ch].pin = outputSegments[ch].pin;
+        segments[ch].start = start;
+        segments[ch].count = count;
+        start += count;
+        ch++;
+        args = space > 0 ? args.substring(space + 1) : String("");
     }
+    
+    if (ch != outputChannelCount || args.length() > 0 || !applyOutputSegments(segments, ch)) {
+        Serial.printf("❌ Give one LED count per channel (%d), total <= %d\n", outputChannelCount, NUM_LEDS);
+        return;
+    }
+    printOutputs();
+}
+
+void printOutputs() {
+    uint32_t slowestUs = 0;
+    uint32_t serialUs = segmentWireTimeUs(physicalLedCount);
+    
+    Serial.printf("🔌 Output channels: %d\n", outputChannelCount);
+    for (uint8_t ch = 0; ch < outputChannelCount; ch++) {
+        uint32_t wireUs = segmentWireTimeUs(outputSegments[ch].count);
+        slowestUs = max(slowestUs, wireUs);
+        Serial.printf("   CH%d GPIO %2d: LEDs %d-%d (%d) | wire %lu µs\n",
+                      ch, outputSegments[ch].pin, outputSegments[ch].start,
+                      outputSegments[ch].start + outputSegments[ch].count - 1,
+                      outputSegments[ch].count, (unsigned long)wireUs);
+    }
+    Serial.printf("   Frame wire time: %lu µs parallel vs %lu µs single chain\n",
+                  (unsigned long)slowestUs, (unsigned long)serialUs);
+    Serial.printf("   show(): last %lu µs, max %lu µs\n", lastShowTimeUs, maxShowTimeUs);
+    Serial.printf("   Frames: %lu sent, %lu unchanged and skipped\n", framesShown, framesSkipped);
 }
 
 // =============================================================================
@@ -557,41 +7912,105 @@ void sendColorRequest() {
 // =============================================================================
 void bootSequence() {
     Serial.println("🌈 Running boot sequence...");
+    startStatusAnimation(STATUS_ANIM_BOOT);
+}
+
+// A new animation replaces the one running
+void startStatusAnimation(uint8_t kind) {
+    statusAnimation = kind;
+    statusAnimationStart = millis();
+    lastStatusFrame = statusAnimationStart - STATUS_FRAME_MS;
+}
+
+// Draws the animation straight into leds[] for the time since it started;
+// false once it is over
+bool renderStatusAnimation(unsigned long elapsedMs) {
+    static const CRGB bootColors[] = {CRGB::Red, CRGB::Green, CRGB::Blue, CRGB::Yellow, CRGB::Cyan, CRGB::Magenta};
+    const uint8_t numColors = sizeof(bootColors) / sizeof(bootColors[0]);
     
-    const CRGB colors[] = {CRGB::Red, CRGB::Green, CRGB::Blue, CRGB::Yellow, CRGB::Cyan, CRGB::Magenta};
-    const int numColors = sizeof(colors) / sizeof(colors[0]);
-    
-    FastLED.setBrightness(100);
-    
-    // Color sweep
-    for (int c = 0; c < numColors; c++) {
-        fill_solid(leds, NUM_LEDS, colors[c]);
-        FastLED.show();
-        delay(300);
+    switch (statusAnimation) {
+        case STATUS_ANIM_BOOT:
+            // Color sweep
+            if (elapsedMs < numColors * BOOT_SWEEP_STEP_MS) {
+                FastLED.setBrightness(100);
+                fill_solid(leds, NUM_LEDS, bootColors[elapsedMs / BOOT_SWEEP_STEP_MS]);
+                return true;
+            }
+            elapsedMs -= numColors * BOOT_SWEEP_STEP_MS;
+            
+            // Wave effect
+            if (elapsedMs < BOOT_WAVE_STEPS * BOOT_WAVE_STEP_MS) {
+                uint8_t wave = elapsedMs / BOOT_WAVE_STEP_MS;
+                for (int i = 0; i < NUM_LEDS; i++) {
+                    float brightness = (sin(i * 0.3 + wave * 0.5) + 1.0) / 2.0;
+                    leds[i] = CRGB(brightness * 255, brightness * 100, brightness * 255);
+                }
+                return true;
+            }
+            elapsedMs -= BOOT_WAVE_STEPS * BOOT_WAVE_STEP_MS;
+            
+            // Fade to black on the last wave frame
+            if (elapsedMs < BOOT_FADE_MS) {
+                FastLED.setBrightness(255 - 255 * elapsedMs / BOOT_FADE_MS);
+                return true;
+            }
+            return false;
+        
+        case STATUS_ANIM_ERROR:
+            if (elapsedMs >= 2 * ERROR_FLASH_MS * ERROR_FLASHES) return false;
+            FastLED.setBrightness(MASTER_BRIGHTNESS);
+            fill_solid(leds, NUM_LEDS, (elapsedMs / ERROR_FLASH_MS) % 2 ? CRGB::Black : CRGB::Red);
+            return true;
+        
+        case STATUS_ANIM_SUCCESS:
+            if (elapsedMs >= SUCCESS_FLASH_MS) return false;
+            FastLED.setBrightness(MASTER_BRIGHTNESS);
+            fill_solid(leds, NUM_LEDS, CRGB::Green);
+            return true;
     }
-    
-    // Wave effect
-    for (int wave = 0; wave < 20; wave++) {
-        for (int i = 0; i < NUM_LEDS; i++) {
-            float brightness = (sin(i * 0.3 + wave * 0.5) + 1.0) / 2.0;
-            leds[i] = CRGB(brightness * 255, brightness * 100, brightness * 255);
-        }
-        FastLED.show();
-        delay(50);
+    return false;
+}
+
+// True while an animation owns the LEDs; zones wait underneath
+bool serviceStatusAnimation() {
+    if (statusAnimation == STATUS_ANIM_NONE) return false;
+    if (streamModeActive && streamFrameFresh) {
+        preemptStatusAnimation();
+        return false;
     }
     
-    // Fade to black
-    for (int brightness = 255; brightness >= 0; brightness -= 5) {
-        FastLED.setBrightness(brightness);
-        FastLED.show();
-        delay(20);
-    }
+    unsigned long now = millis();
+    if (now - lastStatusFrame < STATUS_FRAME_MS) return true;
+    lastStatusFrame = now;
     
+    if (!renderStatusAnimation(now - statusAnimationStart)) {
+        if (statusAnimation == STATUS_ANIM_BOOT) Serial.println("✨ Boot sequence complete!");
+        endStatusAnimation();
+        return false;
+    }
+    showFrame();
+    return true;
+}
+
+void preemptStatusAnimation() {
+    if (statusAnimation == STATUS_ANIM_NONE) return;
+    statusPreempted++;
+    endStatusAnimation();
+}
+
+// Dark, then the zones draw again on this pass
+void endStatusAnimation() {
+    statusAnimation = STATUS_ANIM_NONE;
     FastLED.clear();
-    FastLED.setBrightness(map(currentBrightness, 1, 100, 0, 255));
-    FastLED.show();
-    
-    Serial.println("✨ Boot sequence complete!");
+    FastLED.setBrightness(MASTER_BRIGHTNESS);
+    for (uint8_t z = 0; z < MAX_ZONES; z++) zones[z].lastRenderTime = 0;
+    invalidateFrameCache();
+}
+
+void noteLoopPass(unsigned long passStart) {
+    uint32_t us = micros() - passStart;
+    recordTiming(loopTiming, us);
+    if (us > LED_UPDATE_INTERVAL_MS * 1000UL) loopOverruns++;
 }
 
 void printStatus() {
@@ -604,8 +8023,12 @@ void printStatus() {
     Serial.printf("⏳ Expecting response: %s\n", expectingResponse ? "Yes" : "No");
     Serial.printf("💾 Free heap: %d bytes\n", ESP.getFreeHeap());
     Serial.println(repeat("━", 50));
-    Serial.printf("🎨 Current color: RGB(%d, %d, %d)\n", currentColor.r, currentColor.g, currentColor.b);
-    Serial.printf("✨ Effect: %d | Speed: %d | Brightness: %d%%\n", currentEffect, currentSpeed, currentBrightness);
+    Serial.printf("🎨 Current color: RGB(%d, %d, %d)\n", zones[0].color.r, zones[0].color.g, zones[0].color.b);
+    Serial.printf("✨ Effect: %d | Speed: %d | Brightness: %d%%\n", zones[0].effect, zones[0].speed, zones[0].brightness);
+    Serial.printf("🧩 Matrix: %dx%d (%d LEDs)\n", matrixWidth, matrixHeight, physicalLedCount);
+    uint8_t activeZones = 0;
+    for (uint8_t z = 0; z < MAX_ZONES; z++) activeZones += zones[z].active ? 1 : 0;
+    Serial.printf("🗺️  Zones: %d active (zone 0 shown above)\n", activeZones);
     Serial.println(repeat("━", 50) + "\n");
 }
 
@@ -617,8 +8040,8 @@ void printDiagnostics() {
     Serial.printf("📍 MAC Address: %s\n", WiFi.macAddress().c_str());
     Serial.printf("📶 WiFi Status: %d\n", WiFi.status());
     
-    // ESP-NOW info
-    Serial.println("\n🔄 ESP-NOW Peer Info:");
+    // Transport info
+    Serial.printf("\n🔄 %s Peer Info:\n", transport->name);
     Serial.printf("  Controller MAC: ");
     for(int i = 0; i < 6; i++) {
         Serial.printf("%02X", controllerAddress[i]);
@@ -626,6 +8049,8 @@ void printDiagnostics() {
     }
     Serial.println();
     
+    printWireStats();
+    
     // Hardware info
     Serial.printf("\n💾 Memory Info:\n");
     Serial.printf("  Free Heap: %d bytes\n", ESP.getFreeHeap());
@@ -636,6 +8061,10 @@ void printDiagnostics() {
     Serial.printf("  CPU Frequency: %d MHz\n", ESP.getCpuFreqMHz());
     Serial.printf("  Flash Size: %d bytes\n", ESP.getFlashChipSize());
     Serial.printf("  Uptime: %lu seconds\n", millis() / 1000);
+    Serial.printf("  Loop pass: p50 %lu µs, p99 %lu µs, max %lu µs | %lu over one frame (%d ms)\n",
+                  (unsigned long)timingPercentile(loopTiming, 50), (unsigned long)timingPercentile(loopTiming, 99),
+                  (unsigned long)loopTiming.maxUs, loopOverruns, LED_UPDATE_INTERVAL_MS);
+    Serial.printf("  Status animations cut short by commands: %lu\n", statusPreempted);
     
     Serial.println("\n" + repeat("🔧", 55) + "\n");
 }
@@ -650,34 +8079,53 @@ void printHelp() {
     Serial.println("  clear, c       - Turn off all LEDs");
     Serial.println("  help, h        - Show this help message");
     Serial.println("  bright <1-100> - Set brightness (e.g., 'bright 75')");
-    Serial.println("  effect <0-6>   - Set effect (0=Solid, 1=Rainbow, 2=Fade, 3=Strobe, 4=Pulse, 5=Sparkle, 6=Wave)");
+    Serial.println("  effect <0-7>   - Set effect (0=Solid, 1=Rainbow, 2=Fade, 3=Strobe, 4=Pulse, 5=Sparkle, 6=Wave, 7=Stream)");
+    Serial.println("  layout [<w> <h>|serp|prog|rot <0-3>|mirror <none|x|y|xy>|tiles <c> <r> [serp]] - Show or set matrix geometry");
+    Serial.println("  layout map begin | <x> <y> ... | end - Coordinate list for non-rectangular installs");
+    Serial.println("  outputs [even|<n> ...] - Show or set LEDs per output pin");
+    Serial.println("  zones [reset|split <n>] - List, reset or split zones");
+    Serial.println("  zone <id> rect <x> <y> <w> <h> | range <start> <n> | off");
+    Serial.println("  zone <id> effect|speed|bright|fps <n> | color <r> <g> <b>");
+    Serial.println("  scene [save|forget] - Scene kept for instant-on boot: boot timing, flash writes");
+    Serial.println("  stream         - Frame streaming statistics");
+    Serial.println("  binary [baud]  - Take Adalight/TPM2/native frames on this port; 'text' to leave");
+    Serial.println("  serial         - Binary serial input statistics and resync times");
+    Serial.println("  pixels         - sACN / Art-Net / DDP input: sources, frames, rejects");
+    Serial.println("  bridge         - Serial bridge to the second UART: credits, retransmits, throughput");
+    Serial.println("  groups         - List broadcast group subscriptions");
+    Serial.println("  group add|del <id> - Subscribe to / leave a broadcast group");
+    Serial.println("  time           - Shared clock sync status");
+    Serial.println("  live [delay <ms>|reset] - Live parameter smoothing: latency, sample lead, frame kinds");
+    Serial.println("  triggers       - Registered trigger events and trigger-to-show latency");
+    Serial.println("  trigger <id> flash|ripple|sweep <ms> [x y|right|left|down|up] | <id> off");
+    Serial.println("  trigger fire <id> [r g b] [intensity] [zone] | trigger reset");
+    Serial.println("  capture [start|stop|clear|dump] - Record incoming packets to flash / print them");
+    Serial.println("  capture replay [verbose] - Re-run the capture on a virtual clock: deadlines, hashes");
+    Serial.println("  state          - State version sync and staleness");
+    Serial.println("  peers | pair   - List controllers / pair the next unknown one (30 s)");
+    Serial.println("  unpair <n> | peer add <mac> [prio] | peer prio <n> <p>");
+    Serial.println("  relay [on|off|ttl <1-7>] - Relay group traffic for out-of-range receivers");
+    Serial.println("  ota [abort]    - Firmware update progress / cancel and forget resume point");
+    Serial.println("  telemetry      - Show the report sent to the controller");
+    Serial.println("  preview [off|fps <n>|share <pct>|scale <n>] - Framebuffer preview for the controller");
+    Serial.println("  link           - Radio link quality: RSSI, jitter, loss, send failures");
+    Serial.println("  loss <0-100>   - Drop a percentage of incoming packets (testing)");
     Serial.println("\nEffects:");
     Serial.println("  0 - Solid Color    4 - Pulse");
     Serial.println("  1 - Rainbow        5 - Sparkle");
     Serial.println("  2 - Fade           6 - Wave");
-    Serial.println("  3 - Strobe");
+    Serial.println("  3 - Strobe         7 - Stream (frames from controller)");
     Serial.println("\n" + repeat("📚", 58) + "\n");
 }
 
 void showError(const char* message) {
     Serial.printf("❌ ERROR: %s\n", message);
     // Flash red LEDs to indicate error
-    for (int i = 0; i < 3; i++) {
-        fill_solid(leds, NUM_LEDS, CRGB::Red);
-        FastLED.show();
-        delay(200);
-        FastLED.clear();
-        FastLED.show();
-        delay(200);
-    }
+    startStatusAnimation(STATUS_ANIM_ERROR);
 }
 
 void showSuccess(const char* message) {
     Serial.printf("✅ SUCCESS: %s\n", message);
     // Brief green flash
-    fill_solid(leds, NUM_LEDS, CRGB::Green);
-    FastLED.show();
-    delay(300);
-    FastLED.clear();
-    FastLED.show();
+    startStatusAnimation(STATUS_ANIM_SUCCESS);
 }
@@ -0,0 +1,125 @@
+/**
+ * @file      capture_replay.cpp
+ * @brief     Replays a receiver packet capture on a Linux build of the firmware (Recevier.ino, CAPTURE AND REPLAY)
+ *
+ * Takes the capture.bin that 'capture_tool decode' writes, puts its
+ * segments where the firmware keeps them (/capture0.bin, /capture1.bin on
+ * the harness's LittleFS) and runs the firmware's own 'capture replay'
+ * through the host harness (tools/host). The picture, frame digest,
+ * deadline misses and latencies are what the receiver reports, measured
+ * on the harness's virtual clock with modelled LED wire time instead of a
+ * real panel. The replay runs more than once from the same start and the
+ * digests must agree.
+ *
+ * Build:  g++ -std=gnu++17 -O2 -Wall -Wextra -pthread -Itools/host -o capture_replay \
+ *             tools/capture_replay.cpp tools/host/host_runtime.cpp
+ * Run:    ./capture_replay <capture.bin> [options]
+ *           --runs <n>          Replays to compare (default 2)
+ *           --verbose           Print every frame's hash ('capture replay verbose')
+ */
+
+#include "sketch.h"
+
+#include <fstream>
+#include <sstream>
+
+#define BOOT_SETTLE_US           5000000ULL    // Boot pattern and radio bring-up before the first replay
+
+// Segments back to back, each starting with its header, as capture_tool decode writes them
+static bool loadSegments(const char* path, std::vector<std::string>& segments) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string content = buffer.str();
+    if (content.size() < sizeof(capture_header_t) || content.compare(0, 4, "LCAP") != 0) {
+        fprintf(stderr, "%s is not a decoded capture; run capture_tool decode on the serial log first\n", path);
+        return false;
+    }
+
+    size_t start = 0;
+    for (size_t pos = 4; pos + sizeof(capture_header_t) <= content.size(); pos++) {
+        if (content.compare(pos, 4, "LCAP") == 0 && (uint8_t)content[pos + 4] == CAPTURE_VERSION) {
+            segments.push_back(content.substr(start, pos - start));
+            start = pos;
+        }
+    }
+    segments.push_back(content.substr(start));
+    return true;
+}
+
+// Slot order doesn't matter: the firmware replays by segment number
+static bool installSegments(const std::vector<std::string>& segments) {
+    for (uint8_t slot = 0; slot < 2; slot++) {
+        if (LittleFS.exists(captureFiles[slot])) LittleFS.remove(captureFiles[slot]);
+    }
+    for (size_t i = 0; i < segments.size(); i++) {
+        File file = LittleFS.open(captureFiles[i], "w");
+        if (!file || file.write((const uint8_t*)segments[i].data(), segments[i].size()) != segments[i].size()) {
+            fprintf(stderr, "Cannot write %s%s\n", hostFsRoot.c_str(), captureFiles[i]);
+            return false;
+        }
+        file.close();
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    if (argc < 2) {
+        fprintf(stderr, "Usage: capture_replay <capture.bin> [--runs n] [--verbose]\n");
+        return 2;
+    }
+    int runs = 2;
+    bool verbose = false;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc) runs = atoi(argv[++i]);
+        else if (arg == "--verbose") verbose = true;
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+    if (runs < 1) {
+        fprintf(stderr, "Bad --runs\n");
+        return 2;
+    }
+
+    std::vector<std::string> segments;
+    if (!loadSegments(argv[1], segments)) return 1;
+    if (segments.size() > 2) {
+        // The receiver only ever holds the newest two
+        fprintf(stderr, "%zu segments; replaying the last two\n", segments.size());
+        segments.erase(segments.begin(), segments.end() - 2);
+    }
+
+    hostSerialEcho = false;
+    setup();
+    hostRunLoop(BOOT_SETTLE_US);
+    if (!mountCaptureFs() || !installSegments(segments)) return 1;
+
+    std::vector<replay_stats_t> results;
+    for (int run = 0; run < runs; run++) {
+        printf("== Replay %d of %d\n", run + 1, runs);
+        hostSerialEcho = true;
+        runCommand(verbose ? "capture replay verbose" : "capture replay");
+        if (!replayActive) return 1;
+        while (replayActive) hostRunLoop(100000);
+        hostSerialEcho = false;
+        results.push_back(replayStats);
+        printf("   LED output after replay: %08X over %zu channel%s\n", hostOutputHash(), hostOutputs.size(),
+               hostOutputs.size() == 1 ? "" : "s");
+    }
+
+    bool same = true;
+    for (const replay_stats_t& st : results) {
+        if (st.digest != results[0].digest || st.frames != results[0].frames) same = false;
+    }
+    printf("== %d replay%s: %lu frames, digest %08lX, %s\n", runs, runs == 1 ? "" : "s", results[0].frames,
+           (unsigned long)results[0].digest, same ? "identical every run" : "DIGESTS DIFFER");
+    return same ? 0 : 1;
+}
@@ -0,0 +1,362 @@
+/**
+ * @file      capture_tool.cpp
+ * @brief     Decoder and UDP re-sender for receiver packet captures (Recevier.ino, CAPTURE AND REPLAY)
+ *
+ * 'capture dump' on the receiver prints its capture as base64 between
+ * CAPTURE BEGIN / CAPTURE END lines. Save the serial output to a file and
+ * this tool pulls the segments out (checking each CRC), summarises the
+ * traffic, and can send it again to a TRANSPORT_UDP receiver with the
+ * original timing. The deterministic replay, with frame hashes and
+ * deadline misses, is the receiver's own 'capture replay', on the device
+ * or on Linux through tools/capture_replay.
+ *
+ * Build:  g++ -O2 -std=c++17 -o capture_tool tools/capture_tool.cpp
+ * Run:    ./capture_tool decode <serial.log> <capture.bin>
+ *         ./capture_tool summary <serial.log | capture.bin>
+ *         ./capture_tool send <serial.log | capture.bin> [options]
+ *           --host <ip>         Receiver address (default 127.0.0.1)
+ *           --port <n>          UDP port (default 4210)
+ *           --speed <x>         Time scale, 2 = twice as fast (default 1)
+ */
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <netinet/in.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+// Keep in step with the firmware
+#define CAPTURE_VERSION          1
+#define CAPTURE_FLAG_BROADCAST   0x01
+#define WIRE_VERSION_2           0xE2
+#define LEGACY_COMMAND_BYTES     8
+
+#pragma pack(push, 1)
+struct CaptureHeader {
+    char magic[4];
+    uint8_t version;
+    uint8_t reserved;
+    uint16_t ledCount;
+    uint16_t width;
+    uint16_t height;
+    uint32_t segment;
+    int64_t startUs;
+    int64_t clockOffsetUs;
+};
+
+struct CaptureRecord {
+    uint32_t timeUs;
+    uint8_t mac[6];
+    uint8_t flags;
+    uint8_t length;
+};
+#pragma pack(pop)
+
+struct Packet {
+    int64_t timeUs;             // Unwrapped, on the receiver's esp_timer clock
+    uint8_t mac[6];
+    uint8_t flags;
+    std::vector<uint8_t> data;
+};
+
+static const char* recordNames[] = {
+    "pad", "command", "zone command", "frame fragment", "serial data", "target", "time ping",
+    "time pong", "apply at", "state version", "state heartbeat", "state ack", "relay", "ota begin",
+    "ota chunk", "ota status", "ota end", "telemetry", "telemetry req", "serial fragment",
+    "serial credit", "live sample", "trigger"
+};
+
+// Same polynomial and conditioning as esp_rom_crc32_le
+static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t length) {
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+    }
+    return ~crc;
+}
+
+static bool decodeBase64(const std::string& text, std::vector<uint8_t>& out) {
+    uint32_t bits = 0;
+    int count = 0;
+    for (char c : text) {
+        int v;
+        if (c >= 'A' && c <= 'Z') v = c - 'A';
+        else if (c >= 'a' && c <= 'z') v = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') v = c - '0' + 52;
+        else if (c == '+') v = 62;
+        else if (c == '/') v = 63;
+        else if (c == '=') break;
+        else return false;
+        bits = (bits << 6) | v;
+        if (++count == 4) {
+            out.push_back(bits >> 16);
+            out.push_back(bits >> 8);
+            out.push_back(bits);
+            bits = 0;
+            count = 0;
+        }
+    }
+    if (count == 3) {
+        out.push_back(bits >> 10);
+        out.push_back(bits >> 2);
+    } else if (count == 2) {
+        out.push_back(bits >> 4);
+    }
+    return true;
+}
+
+// Segments from a serial log; lines that aren't ours are skipped
+static bool segmentsFromLog(std::istream& in, std::vector<std::vector<uint8_t>>& segments) {
+    std::string line;
+    std::vector<uint8_t> current;
+    bool inside = false;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.rfind("CAPTURE BEGIN", 0) == 0) {
+            current.clear();
+            inside = true;
+        } else if (inside && line.rfind("CAP:", 0) == 0) {
+            if (!decodeBase64(line.substr(4), current)) {
+                fprintf(stderr, "Bad base64 line in segment %zu\n", segments.size() + 1);
+                return false;
+            }
+        } else if (inside && line.rfind("CAPTURE END", 0) == 0) {
+            uint32_t expected = strtoul(line.c_str() + 12, nullptr, 16);
+            uint32_t actual = crc32(0, current.data(), current.size());
+            if (actual != expected) {
+                fprintf(stderr, "Segment %zu: CRC %08X, expected %08X\n", segments.size() + 1, actual, expected);
+                return false;
+            }
+            segments.push_back(current);
+            inside = false;
+        }
+    }
+    if (inside) fprintf(stderr, "Last segment has no CAPTURE END; dropped\n");
+    return true;
+}
+
+static bool loadSegments(const char* path, std::vector<std::vector<uint8_t>>& segments) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string content = buffer.str();
+    if (content.compare(0, 4, "LCAP") != 0) {
+        std::istringstream log(content);
+        return segmentsFromLog(log, segments);
+    }
+
+    // Binary: segments back to back, each starting with its header
+    size_t start = 0;
+    for (size_t pos = 4; pos + 4 <= content.size(); pos++) {
+        if (content.compare(pos, 4, "LCAP") != 0) continue;
+        // Only a boundary if a plausible header follows
+        if (pos + sizeof(CaptureHeader) <= content.size() && (uint8_t)content[pos + 4] == CAPTURE_VERSION) {
+            segments.emplace_back(content.begin() + start, content.begin() + pos);
+            start = pos;
+        }
+    }
+    segments.emplace_back(content.begin() + start, content.end());
+    return true;
+}
+
+// Records in time order; a torn record ends its segment like on the receiver
+static bool parsePackets(const std::vector<std::vector<uint8_t>>& segments, std::vector<Packet>& packets,
+                         CaptureHeader& first) {
+    bool started = false;
+    int64_t timeUs = 0;
+    uint32_t lastRaw = 0;
+    for (const auto& segment : segments) {
+        CaptureHeader header;
+        if (segment.size() < sizeof(header)) continue;
+        memcpy(&header, segment.data(), sizeof(header));
+        if (memcmp(header.magic, "LCAP", 4) != 0 || header.version != CAPTURE_VERSION) {
+            fprintf(stderr, "Not a version %d capture segment\n", CAPTURE_VERSION);
+            return false;
+        }
+        if (!started) {
+            first = header;
+            timeUs = header.startUs;
+            lastRaw = (uint32_t)header.startUs;
+            started = true;
+        }
+
+        size_t pos = sizeof(header);
+        while (pos + sizeof(CaptureRecord) <= segment.size()) {
+            CaptureRecord record;
+            memcpy(&record, &segment[pos], sizeof(record));
+            if (pos + sizeof(record) + record.length > segment.size()) break;
+            timeUs += (uint32_t)(record.timeUs - lastRaw);
+            lastRaw = record.timeUs;
+
+            Packet packet;
+            packet.timeUs = timeUs;
+            memcpy(packet.mac, record.mac, 6);
+            packet.flags = record.flags;
+            packet.data.assign(&segment[pos + sizeof(record)], &segment[pos + sizeof(record) + record.length]);
+            packets.push_back(packet);
+            pos += sizeof(record) + record.length;
+        }
+    }
+    if (!started) fprintf(stderr, "No capture segments found\n");
+    return started;
+}
+
+static std::string macText(const uint8_t* mac) {
+    char text[18];
+    snprintf(text, sizeof(text), "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    return text;
+}
+
+static void summarise(const std::vector<Packet>& packets, const CaptureHeader& header) {
+    printf("Capture: %dx%d matrix (%d LEDs), %zu packets\n", header.width, header.height, header.ledCount,
+           packets.size());
+    if (packets.empty()) return;
+
+    double seconds = (packets.back().timeUs - packets.front().timeUs) / 1e6;
+    printf("  Span:        %.2f s, from %.3f s after the receiver booted\n", seconds,
+           packets.front().timeUs / 1e6);
+
+    std::map<std::string, long> senders;
+    std::map<int, long> records;
+    long broadcasts = 0, legacy = 0, other = 0, bytes = 0;
+    int64_t largestGap = 0, gapAt = 0;
+    std::map<int64_t, long> perSecond;
+    for (size_t i = 0; i < packets.size(); i++) {
+        const Packet& p = packets[i];
+        senders[macText(p.mac)]++;
+        bytes += p.data.size();
+        if (p.flags & CAPTURE_FLAG_BROADCAST) broadcasts++;
+        perSecond[(p.timeUs - packets.front().timeUs) / 1000000]++;
+        if (i > 0 && p.timeUs - packets[i - 1].timeUs > largestGap) {
+            largestGap = p.timeUs - packets[i - 1].timeUs;
+            gapAt = packets[i - 1].timeUs - packets.front().timeUs;
+        }
+
+        if (p.data.size() == LEGACY_COMMAND_BYTES) {
+            legacy++;
+        } else if (p.data.size() >= 4 && p.data[0] == WIRE_VERSION_2) {
+            for (size_t pos = 4; pos + 2 <= p.data.size(); pos += 2 + p.data[pos + 1]) records[p.data[pos]]++;
+        } else {
+            other++;
+        }
+    }
+
+    long peak = 0;
+    for (const auto& s : perSecond) peak = std::max(peak, s.second);
+    printf("  Traffic:     %ld bytes, %.0f packets/s average, %ld in the busiest second\n", bytes,
+           seconds > 0 ? packets.size() / seconds : 0.0, peak);
+    printf("  Broadcasts:  %ld | legacy commands %ld | unrecognised %ld\n", broadcasts, legacy, other);
+    printf("  Largest gap: %.1f ms, at %.3f s\n", largestGap / 1000.0, gapAt / 1e6);
+    printf("  Senders:\n");
+    for (const auto& s : senders) printf("    %s  %ld\n", s.first.c_str(), s.second);
+    printf("  Records:\n");
+    for (const auto& r : records) {
+        const char* name = r.first < (int)(sizeof(recordNames) / sizeof(recordNames[0])) ? recordNames[r.first] : "?";
+        printf("    0x%02X %-16s %ld\n", r.first, name, r.second);
+    }
+}
+
+static int sendPackets(const std::vector<Packet>& packets, const std::string& host, int port, double speed) {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(port);
+    if (!inet_aton(host.c_str(), &to.sin_addr)) {
+        fprintf(stderr, "Bad --host %s\n", host.c_str());
+        return 2;
+    }
+
+    timespec begin;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    long sent = 0;
+    for (const Packet& p : packets) {
+        // The receiver maps our address to one MAC; every sender becomes us
+        int64_t offsetNs = (int64_t)((p.timeUs - packets.front().timeUs) * 1000 / speed);
+        timespec at = begin;
+        at.tv_sec += offsetNs / 1000000000;
+        at.tv_nsec += offsetNs % 1000000000;
+        if (at.tv_nsec >= 1000000000) {
+            at.tv_nsec -= 1000000000;
+            at.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, nullptr);
+        if (sendto(sock, p.data.data(), p.data.size(), 0, (const sockaddr*)&to, sizeof(to)) > 0) sent++;
+    }
+    printf("Sent %ld of %zu packets to %s:%d at %.2fx\n", sent, packets.size(), host.c_str(), port, speed);
+    close(sock);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: capture_tool decode <log> <out.bin> | summary <file> | send <file> [options]\n");
+        return 2;
+    }
+    std::string mode = argv[1];
+    std::vector<std::vector<uint8_t>> segments;
+    if (!loadSegments(argv[2], segments)) return 1;
+
+    if (mode == "decode") {
+        if (argc < 4) {
+            fprintf(stderr, "decode needs an output file\n");
+            return 2;
+        }
+        std::ofstream out(argv[3], std::ios::binary);
+        size_t bytes = 0;
+        for (const auto& segment : segments) {
+            out.write((const char*)segment.data(), segment.size());
+            bytes += segment.size();
+        }
+        printf("Wrote %zu segment%s, %zu bytes, to %s\n", segments.size(), segments.size() == 1 ? "" : "s",
+               bytes, argv[3]);
+        return 0;
+    }
+
+    std::vector<Packet> packets;
+    CaptureHeader header;
+    if (!parsePackets(segments, packets, header)) return 1;
+
+    if (mode == "summary") {
+        summarise(packets, header);
+        return 0;
+    }
+    if (mode == "send") {
+        std::string host = "127.0.0.1";
+        int port = 4210;
+        double speed = 1;
+        for (int i = 3; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--host" && hasValue) host = argv[++i];
+            else if (arg == "--port" && hasValue) port = atoi(argv[++i]);
+            else if (arg == "--speed" && hasValue) speed = atof(argv[++i]);
+            else {
+                fprintf(stderr, "Unknown option %s\n", arg.c_str());
+                return 2;
+            }
+        }
+        if (speed <= 0) {
+            fprintf(stderr, "Bad --speed\n");
+            return 2;
+        }
+        return sendPackets(packets, host, port, speed);
+    }
+    fprintf(stderr, "Unknown mode %s\n", mode.c_str());
+    return 2;
+}
@@ -0,0 +1,214 @@
+/**
+ * @file      Arduino.h
+ * @brief     Host stand-in for the Arduino-ESP32 core, enough to build Recevier.ino on Linux
+ *
+ * Timing calls run on the harness's virtual clock (host.h): delay() and
+ * friends advance it instead of sleeping, so a test can see how long the
+ * firmware would have blocked.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+
+#define PI      3.1415926535897932384626433832795
+#define TWO_PI  6.283185307179586476925286766559
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define PROGMEM
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+using std::min;
+using std::max;
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+long random(long howBig);
+long random(long howSmall, long howBig);
+void randomSeed(unsigned long seed);
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+uint32_t esp_random();
+
+// =============================================================================
+// String
+// =============================================================================
+class String {
+public:
+    String(const char* text = "") : s(text ? text : "") {}
+    String(const std::string& text) : s(text) {}
+    String(char c) : s(1, c) {}
+    String(int value) : s(std::to_string(value)) {}
+    String(unsigned value) : s(std::to_string(value)) {}
+    String(long value) : s(std::to_string(value)) {}
+    String(unsigned long value) : s(std::to_string(value)) {}
+    String(double value, unsigned decimals = 2) {
+        char text[32];
+        snprintf(text, sizeof(text), "%.*f", (int)decimals, value);
+        s = text;
+    }
+
+    unsigned length() const { return s.size(); }
+    const char* c_str() const { return s.c_str(); }
+    char charAt(unsigned i) const { return i < s.size() ? s[i] : 0; }
+    char operator[](unsigned i) const { return charAt(i); }
+
+    String substring(unsigned from) const { return from < s.size() ? s.substr(from) : std::string(); }
+    String substring(unsigned from, unsigned to) const {
+        if (from > to) std::swap(from, to);
+        return from < s.size() ? s.substr(from, to - from) : std::string();
+    }
+    int indexOf(char c, unsigned from = 0) const { return position(s.find(c, from)); }
+    int indexOf(const char* text, unsigned from = 0) const { return position(s.find(text, from)); }
+    int lastIndexOf(char c) const { return position(s.rfind(c)); }
+    bool startsWith(const String& prefix) const { return s.compare(0, prefix.s.size(), prefix.s) == 0; }
+    bool endsWith(const String& suffix) const {
+        return s.size() >= suffix.s.size() &&
+               s.compare(s.size() - suffix.s.size(), suffix.s.size(), suffix.s) == 0;
+    }
+    long toInt() const { return atol(s.c_str()); }
+    float toFloat() const { return atof(s.c_str()); }
+
+    void trim() {
+        size_t first = s.find_first_not_of(" \t\r\n");
+        size_t last = s.find_last_not_of(" \t\r\n");
+        s = first == std::string::npos ? std::string() : s.substr(first, last - first + 1);
+    }
+    void toLowerCase() { for (char& c : s) c = tolower((unsigned char)c); }
+    void toUpperCase() { for (char& c : s) c = toupper((unsigned char)c); }
+    void remove(unsigned index) { if (index < s.size()) s.erase(index); }
+    void remove(unsigned index, unsigned count) { if (index < s.size()) s.erase(index, count); }
+    void replace(const String& from, const String& to) {
+        if (from.s.empty()) return;
+        for (size_t at = s.find(from.s); at != std::string::npos; at = s.find(from.s, at + to.s.size())) {
+            s.replace(at, from.s.size(), to.s);
+        }
+    }
+
+    String& operator+=(const String& other) { s += other.s; return *this; }
+    String& operator+=(const char* other) { s += other; return *this; }
+    String& operator+=(char c) { s += c; return *this; }
+    friend String operator+(const String& a, const String& b) { return String(a.s + b.s); }
+    friend String operator+(const char* a, const String& b) { return String(a + b.s); }
+    friend String operator+(const String& a, const char* b) { return String(a.s + b); }
+    bool operator==(const String& other) const { return s == other.s; }
+    bool operator==(const char* other) const { return s == other; }
+    bool operator!=(const String& other) const { return s != other.s; }
+    bool operator!=(const char* other) const { return s != other; }
+
+private:
+    static int position(size_t at) { return at == std::string::npos ? -1 : (int)at; }
+    std::string s;
+};
+
+// =============================================================================
+// Serial ports
+// =============================================================================
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t b) { return write(&b, 1); }
+    virtual size_t write(const uint8_t* data, size_t length) = 0;
+    size_t write(const char* text) { return write((const uint8_t*)text, strlen(text)); }
+
+    size_t print(const String& text) { return write(text.c_str()); }
+    size_t print(const char* text) { return write(text); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(long value) { return print(String(value)); }
+    size_t print(unsigned long value) { return print(String(value)); }
+    size_t print(int value) { return print(String(value)); }
+    size_t print(unsigned value) { return print(String(value)); }
+    size_t println() { return write("\n"); }
+    template <typename T> size_t println(const T& value) { return print(value) + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        char text[512];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(text, sizeof(text), format, args);
+        va_end(args);
+        if (length < 0) return 0;
+        return write((const uint8_t*)text, min<size_t>(length, sizeof(text) - 1));
+    }
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int availableForWrite() { return 0; }
+    String readStringUntil(char terminator);
+    void setTimeout(unsigned long ms) { timeoutMs = ms; }
+
+protected:
+    unsigned long timeoutMs = 1000;
+};
+
+#define SERIAL_8N1 0x800001c
+
+// USB UART; the test feeds its RX side and reads what the firmware prints
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long baud) { baudRate = baud; }
+    void updateBaudRate(unsigned long baud) { baudRate = baud; }
+    size_t setRxBufferSize(size_t size) { return size; }
+    void flush() {}
+    operator bool() const { return true; }
+
+    int available() override;
+    int read() override;
+    size_t read(uint8_t* data, size_t length);
+    int availableForWrite() override;
+    size_t write(const uint8_t* data, size_t length) override;
+    using Print::write;
+
+    unsigned long baudRate = 115200;
+};
+
+// Second UART for the serial bridge: a loopback wire at the configured baud
+class BridgeSerial : public Stream {
+public:
+    void begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin);
+    int available() override;
+    int read() override;
+    size_t read(uint8_t* data, size_t length);
+    int availableForWrite() override;
+    size_t write(const uint8_t* data, size_t length) override;
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+extern BridgeSerial Serial1;
+
+// =============================================================================
+// Chip
+// =============================================================================
+class EspClass {
+public:
+    uint32_t getFreeHeap() { return 200000; }
+    uint32_t getMinFreeHeap() { return 150000; }
+    uint32_t getMaxAllocHeap() { return 110000; }
+    uint32_t getCpuFreqMHz() { return 240; }
+    uint32_t getFlashChipSize() { return 4 << 20; }
+    void restart();
+};
+
+extern EspClass ESP;
@@ -0,0 +1,141 @@
+/**
+ * @file      FastLED.h
+ * @brief     Host stand-in for FastLED: colour math plus a driver stub that reports per-channel wire time
+ *
+ * show() copies each controller's pixels, in wire colour order with the
+ * global brightness applied, into host_output_t records the test can read
+ * (host.h), and costs the loop the slowest channel's wire time, as the
+ * RMT driver waits for every channel to finish.
+ */
+
+#pragma once
+
+#include "Arduino.h"
+
+typedef uint8_t fract8;
+
+inline uint8_t scale8(uint8_t i, fract8 scale) { return ((uint16_t)i * (1 + scale)) >> 8; }
+inline uint8_t scale8_video(uint8_t i, fract8 scale) { return (((uint16_t)i * scale) >> 8) + ((i && scale) ? 1 : 0); }
+inline uint8_t qadd8(uint8_t a, uint8_t b) { return min(255, a + b); }
+inline uint8_t qsub8(uint8_t a, uint8_t b) { return a > b ? a - b : 0; }
+inline uint8_t blend8(uint8_t a, uint8_t b, fract8 amountOfB) {
+    uint16_t partial = (a << 8) | b;
+    partial += b * amountOfB;
+    partial -= a * amountOfB;
+    return partial >> 8;
+}
+
+struct CHSV {
+    union {
+        struct { uint8_t hue, sat, val; };
+        struct { uint8_t h, s, v; };
+        uint8_t raw[3];
+    };
+    CHSV() : hue(0), sat(0), val(0) {}
+    CHSV(uint8_t ih, uint8_t is, uint8_t iv) : hue(ih), sat(is), val(iv) {}
+};
+
+struct CRGB {
+    union {
+        struct { uint8_t r, g, b; };
+        struct { uint8_t red, green, blue; };
+        uint8_t raw[3];
+    };
+
+    enum HTMLColorCode {
+        Black = 0x000000, Red = 0xFF0000, Green = 0x008000, Blue = 0x0000FF,
+        Yellow = 0xFFFF00, Cyan = 0x00FFFF, Magenta = 0xFF00FF, White = 0xFFFFFF,
+        Orange = 0xFFA500, Purple = 0x800080
+    };
+
+    CRGB() : r(0), g(0), b(0) {}
+    CRGB(uint8_t ir, uint8_t ig, uint8_t ib) : r(ir), g(ig), b(ib) {}
+    CRGB(uint32_t code) : r((code >> 16) & 0xFF), g((code >> 8) & 0xFF), b(code & 0xFF) {}
+    CRGB(HTMLColorCode code) : CRGB((uint32_t)code) {}
+    CRGB(const CHSV& hsv);
+
+    uint8_t& operator[](uint8_t i) { return raw[i]; }
+    const uint8_t& operator[](uint8_t i) const { return raw[i]; }
+    bool operator==(const CRGB& o) const { return r == o.r && g == o.g && b == o.b; }
+    bool operator!=(const CRGB& o) const { return !(*this == o); }
+    explicit operator bool() const { return r || g || b; }
+
+    CRGB& operator+=(const CRGB& o) { r = qadd8(r, o.r); g = qadd8(g, o.g); b = qadd8(b, o.b); return *this; }
+    CRGB& nscale8(uint8_t scale) { r = scale8(r, scale); g = scale8(g, scale); b = scale8(b, scale); return *this; }
+    CRGB& nscale8_video(uint8_t scale) {
+        r = scale8_video(r, scale);
+        g = scale8_video(g, scale);
+        b = scale8_video(b, scale);
+        return *this;
+    }
+    CRGB& fadeToBlackBy(uint8_t amount) { return nscale8(255 - amount); }
+    CRGB& setRGB(uint8_t ir, uint8_t ig, uint8_t ib) { r = ir; g = ig; b = ib; return *this; }
+};
+
+// Six-sector spectrum; close enough to hsv2rgb_rainbow for tests
+inline CRGB::CRGB(const CHSV& hsv) {
+    uint8_t region = hsv.hue / 43;
+    uint8_t rem = (hsv.hue - region * 43) * 6;
+    uint8_t p = scale8(hsv.val, 255 - hsv.sat);
+    uint8_t q = scale8(hsv.val, 255 - scale8(hsv.sat, rem));
+    uint8_t t = scale8(hsv.val, 255 - scale8(hsv.sat, 255 - rem));
+    switch (region) {
+        case 0:  r = hsv.val; g = t; b = p; break;
+        case 1:  r = q; g = hsv.val; b = p; break;
+        case 2:  r = p; g = hsv.val; b = t; break;
+        case 3:  r = p; g = q; b = hsv.val; break;
+        case 4:  r = t; g = p; b = hsv.val; break;
+        default: r = hsv.val; g = p; b = q; break;
+    }
+}
+
+inline CRGB blend(const CRGB& a, const CRGB& b, fract8 amountOfB) {
+    return CRGB(blend8(a.r, b.r, amountOfB), blend8(a.g, b.g, amountOfB), blend8(a.b, b.b, amountOfB));
+}
+inline void fill_solid(CRGB* leds, int count, const CRGB& color) {
+    for (int i = 0; i < count; i++) leds[i] = color;
+}
+inline void nscale8(CRGB* leds, uint16_t count, uint8_t scale) {
+    for (uint16_t i = 0; i < count; i++) leds[i].nscale8(scale);
+}
+void random16_set_seed(uint16_t seed);
+
+// Byte order on the wire: digits name which of r, g, b goes out first
+enum EOrder { RGB = 0012, RBG = 0021, GRB = 0102, GBR = 0120, BRG = 0201, BGR = 0210 };
+
+class WS2812 {};
+class WS2812B {};
+class SK6812 {};
+
+class CLEDController {
+public:
+    CLEDController(uint8_t pin, EOrder order) : pin(pin), order(order) {}
+    void setLeds(CRGB* data, int count) { leds = data; ledCount = count; }
+
+    uint8_t pin;
+    EOrder order;
+    CRGB* leds = nullptr;
+    int ledCount = 0;
+};
+
+class CFastLED {
+public:
+    template <class CHIPSET, uint8_t DATA_PIN, EOrder RGB_ORDER>
+    CLEDController& addLeds(CRGB* data, int count) {
+        CLEDController* controller = addController(DATA_PIN, RGB_ORDER);
+        controller->setLeds(data, count);
+        return *controller;
+    }
+
+    void setBrightness(uint8_t scale) { brightness = scale; }
+    uint8_t getBrightness() const { return brightness; }
+    void setDither(uint8_t) {}
+    void clear(bool writeData = false);
+    void show();
+
+private:
+    CLEDController* addController(uint8_t pin, EOrder order);
+    uint8_t brightness = 255;
+};
+
+extern CFastLED FastLED;
@@ -0,0 +1,35 @@
+/**
+ * @file      LittleFS.h
+ * @brief     Host stand-in for LittleFS, backed by a directory (hostFsRoot in host.h)
+ */
+
+#pragma once
+
+#include "Arduino.h"
+
+class File {
+public:
+    File() {}
+    File(FILE* file) : file(file) {}
+    explicit operator bool() const { return file != nullptr; }
+
+    size_t write(const uint8_t* data, size_t length);
+    int read(uint8_t* data, size_t length);
+    size_t size();
+    void close();
+
+private:
+    FILE* file = nullptr;
+};
+
+class LittleFSFS {
+public:
+    bool begin(bool formatOnFail = false);
+    File open(const char* path, const char* mode);
+    bool exists(const char* path);
+    bool remove(const char* path);
+    size_t usedBytes();
+    size_t totalBytes() { return 1536 * 1024; }
+};
+
+extern LittleFSFS LittleFS;
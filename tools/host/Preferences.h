@@ -0,0 +1,38 @@
+/**
+ * @file      Preferences.h
+ * @brief     Host stand-in for NVS Preferences: one in-memory store that survives hostReboot()
+ *
+ * Every put counts as an NVS write (hostNvsWrites), so tests can check
+ * write coalescing and wear limits.
+ */
+
+#pragma once
+
+#include "Arduino.h"
+
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false);
+    void end() {}
+    bool clear();
+    bool remove(const char* key);
+    bool isKey(const char* key);
+
+    size_t putBytes(const char* key, const void* value, size_t length);
+    size_t getBytes(const char* key, void* buffer, size_t maxLength);
+    size_t getBytesLength(const char* key);
+    size_t putUChar(const char* key, uint8_t value) { return putBytes(key, &value, sizeof(value)); }
+    uint8_t getUChar(const char* key, uint8_t fallback = 0) { return get(key, fallback); }
+    size_t putUInt(const char* key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+    uint32_t getUInt(const char* key, uint32_t fallback = 0) { return get(key, fallback); }
+    size_t putULong(const char* key, uint32_t value) { return putUInt(key, value); }
+    uint32_t getULong(const char* key, uint32_t fallback = 0) { return getUInt(key, fallback); }
+
+private:
+    template <typename T> T get(const char* key, T fallback) {
+        T value;
+        return getBytesLength(key) == sizeof(T) && getBytes(key, &value, sizeof(T)) == sizeof(T) ? value : fallback;
+    }
+    std::string space;
+    bool readOnly = false;
+};
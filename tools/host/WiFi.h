@@ -0,0 +1,44 @@
+/**
+ * @file      WiFi.h
+ * @brief     Host stand-in for the Arduino WiFi class; the station joins at once
+ */
+
+#pragma once
+
+#include "Arduino.h"
+#include "esp_wifi.h"
+
+typedef enum { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA } wifi_mode_t;
+typedef enum { WL_IDLE_STATUS = 0, WL_CONNECTED = 3, WL_DISCONNECTED = 6 } wl_status_t;
+
+class IPAddress {
+public:
+    IPAddress() : octets{0, 0, 0, 0} {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : octets{a, b, c, d} {}
+    uint8_t operator[](int i) const { return octets[i]; }
+    uint8_t& operator[](int i) { return octets[i]; }
+    bool operator==(const IPAddress& o) const { return memcmp(octets, o.octets, 4) == 0; }
+    String toString() const {
+        char text[16];
+        snprintf(text, sizeof(text), "%u.%u.%u.%u", octets[0], octets[1], octets[2], octets[3]);
+        return String(text);
+    }
+
+    uint8_t octets[4];
+};
+
+class WiFiClass {
+public:
+    bool mode(wifi_mode_t m) { current = m; return true; }
+    wifi_mode_t getMode() const { return current; }
+    void begin(const char*, const char*) {}
+    wl_status_t status() const { return WL_CONNECTED; }
+    IPAddress localIP() const { return IPAddress(192, 168, 4, 2); }
+    String macAddress() const;
+    void macAddress(uint8_t* mac) const;
+
+private:
+    wifi_mode_t current = WIFI_OFF;
+};
+
+extern WiFiClass WiFi;
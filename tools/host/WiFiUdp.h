@@ -0,0 +1,27 @@
+/**
+ * @file      WiFiUdp.h
+ * @brief     Host stand-in for WiFiUDP; datagrams go through queues in the harness (host.h)
+ */
+
+#pragma once
+
+#include "WiFi.h"
+
+class WiFiUDP {
+public:
+    uint8_t begin(uint16_t port);
+    int parsePacket();
+    int read(uint8_t* data, size_t length);
+    IPAddress remoteIP() const { return fromIp; }
+    uint16_t remotePort() const { return fromPort; }
+
+    int beginPacket(IPAddress ip, uint16_t port);
+    size_t write(const uint8_t* data, size_t length);
+    int endPacket();
+
+private:
+    std::string rx, tx;
+    size_t rxPos = 0;
+    IPAddress fromIp, toIp;
+    uint16_t fromPort = 0, toPort = 0;
+};
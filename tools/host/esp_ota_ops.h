@@ -0,0 +1,8 @@
+// Host stand-in for esp_ota_ops.h
+#pragma once
+
+#include "esp_partition.h"
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start);
+const esp_partition_t* esp_ota_get_running_partition();
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition);
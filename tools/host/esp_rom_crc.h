@@ -0,0 +1,6 @@
+// Host stand-in for the ROM CRC-32 (reflected 0xEDB88320, inverted in and out)
+#pragma once
+
+#include <stdint.h>
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len);
@@ -0,0 +1,6 @@
+// Host stand-in for esp_timer.h: microseconds on the virtual clock
+#pragma once
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time();
@@ -0,0 +1,19 @@
+// Host stand-in for esp_wifi.h
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum { WIFI_SECOND_CHAN_NONE, WIFI_SECOND_CHAN_ABOVE, WIFI_SECOND_CHAN_BELOW } wifi_second_chan_t;
+
+typedef struct {
+    signed rssi : 8;
+    unsigned rate : 5;
+    unsigned channel : 4;
+    signed noise_floor : 8;
+    unsigned sig_len : 12;
+    unsigned timestamp : 32;
+} wifi_pkt_rx_ctrl_t;
+
+esp_err_t esp_wifi_set_channel(uint8_t primary, wifi_second_chan_t second);
+esp_err_t esp_wifi_get_channel(uint8_t* primary, wifi_second_chan_t* second);
@@ -0,0 +1,46 @@
+/**
+ * @file      FreeRTOS.h
+ * @brief     Host stand-in for the FreeRTOS calls the receiver makes
+ *
+ * Tasks are threads scheduled in lock-step with the loop: a task only runs
+ * while the loop thread is blocked (delay, ulTaskNotifyTake), and each
+ * blocking call waits on the virtual clock. Runs are repeatable.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+typedef struct host_task* TaskHandle_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+
+// One lock stands in for every spinlock; tasks never block while holding it
+typedef struct { int unused; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED     {0}
+void hostEnterCritical();
+void hostExitCritical();
+#define portENTER_CRITICAL(mux)          ((void)(mux), hostEnterCritical())
+#define portEXIT_CRITICAL(mux)           ((void)(mux), hostExitCritical())
+#define portENTER_CRITICAL_ISR(mux)      portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)       portEXIT_CRITICAL(mux)
+
+#define portMAX_DELAY       0xFFFFFFFFu
+#define portTICK_PERIOD_MS  1
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+#define pdTRUE              1
+#define pdFALSE             0
+#define pdPASS              1
+#define pdFAIL              0
+#define tskNO_AFFINITY      0x7FFFFFFF
+
+BaseType_t xTaskCreate(void (*task)(void*), const char* name, uint32_t stack, void* arg,
+                       UBaseType_t priority, TaskHandle_t* handle);
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void*), const char* name, uint32_t stack, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+void xTaskNotifyGive(TaskHandle_t task);
@@ -0,0 +1,95 @@
+/**
+ * @file      host.h
+ * @brief     Test side of the host harness: virtual clock, radio, serial, flash and LED output
+ *
+ * The receiver sketch is built for Linux against the stand-in headers in
+ * this directory and driven from a test's main(), which is the loop task.
+ * Time is virtual. Blocking calls on the loop thread (delay, task
+ * notification waits, flash erases, hashing) advance the clock by what the
+ * ESP32 would spend, so a test can measure how long one loop() pass blocks.
+ *
+ * A test includes "sketch.h" (this header plus Recevier.ino) and links
+ * tools/host/host_runtime.cpp:
+ *
+ *   g++ -std=gnu++17 -O1 -Wall -Wextra -pthread -Itools/host \
+ *       -o host_test tools/host/test_x.cpp tools/host/host_runtime.cpp
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "FastLED.h"
+#include "WiFi.h"
+
+// -----------------------------------------------------------------------------
+// Virtual clock
+// -----------------------------------------------------------------------------
+uint64_t hostNowUs();
+void hostSetNowUs(uint64_t us);             // Only before anything has started
+void hostAdvanceUs(uint64_t us);            // Runs tasks that wake in the meantime
+
+// Costs of blocking work on the loop thread, in virtual time
+#define HOST_FLASH_ERASE_US         45000   // One 4 KB sector
+#define HOST_FLASH_WRITE_NS_PER_B   2700    // Page program, 256 B in ~0.7 ms
+#define HOST_FLASH_READ_NS_PER_B    50      // 20 MB/s through the cache-less read
+#define HOST_SHA256_NS_PER_B        100     // Hardware accelerator through mbedTLS
+#define HOST_OTA_BOOT_SWITCH_US     350000  // esp_ota_set_boot_partition() verifying a ~1 MB image
+
+// Runs loop() for a span of virtual time; returns the longest single pass in µs
+uint64_t hostRunLoop(uint64_t spanUs);
+
+// -----------------------------------------------------------------------------
+// Serial
+// -----------------------------------------------------------------------------
+void hostSerialFeed(const void* data, size_t length);
+void hostSerialFeed(const char* text);
+size_t hostSerialPending();                 // Fed bytes not yet read
+extern bool hostSerialEcho;                 // Firmware output to stdout (default on)
+extern std::string hostSerialOutput;        // Firmware output, when hostSerialCapture
+extern bool hostSerialCapture;
+extern unsigned long hostSerialTimeouts;    // readStringUntil() calls that waited the full timeout
+
+// -----------------------------------------------------------------------------
+// Radio
+// -----------------------------------------------------------------------------
+typedef struct {
+    uint8_t mac[6];
+    std::vector<uint8_t> data;
+    uint64_t atUs;
+} host_packet_t;
+
+extern std::vector<host_packet_t> hostRadioSent;
+extern bool hostRadioSendFails;             // Report the next sends as failed
+void hostRadioReceive(const uint8_t* mac, const void* data, int length, int8_t rssi = -55);
+
+void hostUdpReceive(IPAddress from, uint16_t port, const void* data, size_t length);
+extern std::vector<host_packet_t> hostUdpSent;
+
+// -----------------------------------------------------------------------------
+// Flash and NVS
+// -----------------------------------------------------------------------------
+#define HOST_OTA_PARTITION_SIZE     0x180000
+extern uint8_t hostOtaFlash[HOST_OTA_PARTITION_SIZE];
+extern unsigned long hostFlashErases;
+extern bool hostOtaBootSet;
+extern unsigned long hostRestarts;          // ESP.restart() calls
+extern unsigned long hostNvsWrites;
+extern std::string hostFsRoot;              // Directory behind LittleFS
+void hostNvsClear();
+
+// -----------------------------------------------------------------------------
+// LED output
+// -----------------------------------------------------------------------------
+typedef struct {
+    uint8_t pin;
+    std::vector<uint8_t> bytes;             // Last show(): wire order, brightness applied
+    uint32_t wireUs;                        // 24 bits per pixel at 1.25 µs, plus a 300 µs latch
+} host_output_t;
+
+extern std::vector<host_output_t> hostOutputs;
+extern unsigned long hostShows;
+uint32_t hostOutputHash();                  // FNV-1a over every channel's last frame
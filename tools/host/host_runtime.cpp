@@ -0,0 +1,825 @@
+/**
+ * @file      host_runtime.cpp
+ * @brief     Host harness runtime: virtual clock, lock-step tasks, and the stand-ins behind the stub headers
+ *
+ * The thread that runs main() is the loop task. Other tasks are threads
+ * that run only while the loop thread is blocked: when the loop advances
+ * the clock, every task whose wait has ended is released and the loop
+ * waits until each of them blocks again before it carries on.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <dirent.h>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#include "host.h"
+#include "LittleFS.h"
+#include "Preferences.h"
+#include "WiFiUdp.h"
+#include "esp_now.h"
+#include "esp_ota_ops.h"
+#include "esp_rom_crc.h"
+#include "mbedtls/sha256.h"
+
+// =============================================================================
+// VIRTUAL CLOCK AND TASKS
+// =============================================================================
+struct host_task {
+    bool waiting;               // Blocked until wakeUs or a notification
+    bool onNotify;              // The wait ends early on a notification
+    uint64_t wakeUs;
+    uint32_t notified;
+};
+
+// Never destroyed: task threads are still parked on them when main() returns
+static std::mutex& clockMu = *new std::mutex;
+static std::condition_variable& clockCv = *new std::condition_variable;
+static std::atomic<uint64_t> nowUs(0);
+static int runningTasks = 0;                // Tasks between two waits
+static std::vector<host_task*> tasks;
+static host_task loopTaskState = {false, false, 0, 0};
+static thread_local host_task* currentTask = &loopTaskState;
+static std::recursive_mutex criticalMu;
+
+static bool onLoopThread() {
+    return currentTask == &loopTaskState;
+}
+
+// Caller holds clockMu. Releases the tasks whose wait is over and waits
+// until all of them are blocked again.
+static void releaseTasks(std::unique_lock<std::mutex>& lock) {
+    for (host_task* task : tasks) {
+        if (task->waiting && (nowUs >= task->wakeUs || (task->onNotify && task->notified))) {
+            task->waiting = false;
+            runningTasks++;
+        }
+    }
+    clockCv.notify_all();
+    clockCv.wait(lock, [] { return runningTasks == 0; });
+}
+
+static uint64_t nextTaskWake() {
+    uint64_t next = UINT64_MAX;
+    for (host_task* task : tasks) {
+        if (task->waiting) next = min(next, task->wakeUs);
+    }
+    return next;
+}
+
+static void deliverSendResults();
+
+// Loop thread: moves the clock forward, running tasks at their wake times.
+// With interruptible set, stops early once the loop task is notified.
+static uint64_t advanceLoop(uint64_t us, bool interruptible) {
+    deliverSendResults();
+    std::unique_lock<std::mutex> lock(clockMu);
+    uint64_t start = nowUs;
+    uint64_t target = us > UINT64_MAX - start ? UINT64_MAX : start + us;
+    releaseTasks(lock);
+    while (nowUs < target && !(interruptible && loopTaskState.notified)) {
+        nowUs = min(target, max<uint64_t>(nowUs + 1, nextTaskWake()));
+        releaseTasks(lock);
+    }
+    return nowUs - start;
+}
+
+// Task thread: blocks for virtual time (or a notification) while the loop runs
+static void waitTask(uint64_t us, bool onNotify) {
+    std::unique_lock<std::mutex> lock(clockMu);
+    host_task* task = currentTask;
+    task->wakeUs = us == UINT64_MAX ? UINT64_MAX : nowUs + us;
+    task->onNotify = onNotify;
+    task->waiting = true;
+    runningTasks--;
+    clockCv.notify_all();
+    clockCv.wait(lock, [task] { return !task->waiting; });
+}
+
+// Time spent by blocking work on whichever thread does it
+static void spend(uint64_t us) {
+    if (!us) return;
+    if (onLoopThread()) {
+        advanceLoop(us, false);
+    } else {
+        waitTask(us, false);
+    }
+}
+
+static uint64_t loopWaitUs = 0;             // Loop time spent in ulTaskNotifyTake
+
+uint64_t hostNowUs() { return nowUs; }
+void hostSetNowUs(uint64_t us) { nowUs = us; }
+void hostAdvanceUs(uint64_t us) { advanceLoop(us, false); }
+
+uint64_t hostRunLoop(uint64_t spanUs) {
+    void loop();
+    uint64_t end = nowUs + spanUs;
+    uint64_t longest = 0;
+    while (nowUs < end) {
+        uint64_t start = nowUs;
+        uint64_t waited = loopWaitUs;
+        loop();
+        uint64_t blocked = (nowUs - start) - (loopWaitUs - waited);
+        longest = max(longest, blocked);
+        if (nowUs == start) advanceLoop(1, false);
+    }
+    return longest;
+}
+
+unsigned long millis() { return nowUs / 1000; }
+unsigned long micros() { return nowUs; }
+int64_t esp_timer_get_time() { return nowUs; }
+void delay(unsigned long ms) { spend((uint64_t)ms * 1000); }
+void delayMicroseconds(unsigned int us) { spend(us); }
+void yield() {}
+
+void hostEnterCritical() { criticalMu.lock(); }
+void hostExitCritical() { criticalMu.unlock(); }
+
+static void startTask(void (*entry)(void*), void* arg, TaskHandle_t* handle) {
+    host_task* task = new host_task{true, false, 0, 0};
+    {
+        std::lock_guard<std::mutex> lock(clockMu);
+        tasks.push_back(task);
+        task->wakeUs = nowUs;           // First runs when the loop next blocks
+    }
+    if (handle) *handle = task;
+    std::thread([task, entry, arg] {
+        currentTask = task;
+        {
+            std::unique_lock<std::mutex> lock(clockMu);
+            clockCv.wait(lock, [task] { return !task->waiting; });
+        }
+        entry(arg);
+        // Tasks end by returning; vTaskDelete(nullptr) is a no-op here
+        std::lock_guard<std::mutex> lock(clockMu);
+        tasks.erase(std::find(tasks.begin(), tasks.end(), task));
+        runningTasks--;
+        clockCv.notify_all();
+    }).detach();
+}
+
+BaseType_t xTaskCreate(void (*entry)(void*), const char*, uint32_t, void* arg, UBaseType_t, TaskHandle_t* handle) {
+    startTask(entry, arg, handle);
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(void (*entry)(void*), const char*, uint32_t, void* arg, UBaseType_t,
+                                   TaskHandle_t* handle, BaseType_t) {
+    startTask(entry, arg, handle);
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t) {}
+
+void vTaskDelay(TickType_t ticks) { spend((uint64_t)ticks * 1000); }
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return currentTask; }
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+    host_task* task = currentTask;
+    uint64_t us = ticks == portMAX_DELAY ? UINT64_MAX : (uint64_t)ticks * 1000;
+    bool pending;
+    {
+        std::lock_guard<std::mutex> lock(clockMu);
+        pending = task->notified > 0;
+    }
+    if (!pending) {
+        if (onLoopThread()) {
+            loopWaitUs += advanceLoop(us, true);
+        } else {
+            waitTask(us, true);
+        }
+    }
+    std::lock_guard<std::mutex> lock(clockMu);
+    uint32_t count = task->notified;
+    task->notified = clear ? 0 : (count ? count - 1 : 0);
+    return count;
+}
+
+// A woken task runs when the loop next blocks, as a lower-priority task would
+void xTaskNotifyGive(TaskHandle_t task) {
+    if (!task) return;
+    std::lock_guard<std::mutex> lock(clockMu);
+    task->notified++;
+}
+
+// =============================================================================
+// ARDUINO CORE
+// =============================================================================
+HardwareSerial Serial;
+BridgeSerial Serial1;
+EspClass ESP;
+WiFiClass WiFi;
+CFastLED FastLED;
+LittleFSFS LittleFS;
+
+static uint32_t randomState = 1;
+
+long random(long howBig) {
+    if (howBig <= 0) return 0;
+    randomState = randomState * 1103515245 + 12345;
+    return (randomState >> 8) % howBig;
+}
+
+long random(long howSmall, long howBig) {
+    return howBig <= howSmall ? howSmall : howSmall + random(howBig - howSmall);
+}
+
+void randomSeed(unsigned long seed) { randomState = seed; }
+
+long map(long x, long inMin, long inMax, long outMin, long outMax) {
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+uint32_t esp_random() {
+    randomState = randomState * 1103515245 + 12345;
+    return randomState ^ (randomState >> 16) * 2654435761u;
+}
+
+unsigned long hostRestarts = 0;
+
+// The test decides what a reboot means; the sketch carries on meanwhile
+void EspClass::restart() {
+    hostRestarts++;
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+    return code == ESP_OK ? "ESP_OK" : "ESP_FAIL";
+}
+
+// -----------------------------------------------------------------------------
+// Serial
+// -----------------------------------------------------------------------------
+static std::deque<uint8_t> serialRx;
+bool hostSerialEcho = true;
+bool hostSerialCapture = false;
+std::string hostSerialOutput;
+unsigned long hostSerialTimeouts = 0;
+
+void hostSerialFeed(const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    serialRx.insert(serialRx.end(), bytes, bytes + length);
+}
+
+void hostSerialFeed(const char* text) { hostSerialFeed(text, strlen(text)); }
+
+size_t hostSerialPending() { return serialRx.size(); }
+
+int HardwareSerial::available() { return serialRx.size(); }
+
+int HardwareSerial::read() {
+    if (serialRx.empty()) return -1;
+    uint8_t b = serialRx.front();
+    serialRx.pop_front();
+    return b;
+}
+
+size_t HardwareSerial::read(uint8_t* data, size_t length) {
+    size_t n = min(length, serialRx.size());
+    std::copy(serialRx.begin(), serialRx.begin() + n, data);
+    serialRx.erase(serialRx.begin(), serialRx.begin() + n);
+    return n;
+}
+
+int HardwareSerial::availableForWrite() { return 256; }
+
+size_t HardwareSerial::write(const uint8_t* data, size_t length) {
+    if (hostSerialEcho) fwrite(data, 1, length, stdout);
+    if (hostSerialCapture) hostSerialOutput.append((const char*)data, length);
+    return length;
+}
+
+// Arduino's version: reads until the terminator, or gives up after the
+// stream timeout with what it has
+String Stream::readStringUntil(char terminator) {
+    std::string line;
+    for (;;) {
+        int c = read();
+        if (c < 0) {
+            hostSerialTimeouts++;
+            spend((uint64_t)timeoutMs * 1000);
+            return String(line);
+        }
+        if (c == terminator) return String(line);
+        line += (char)c;
+    }
+}
+
+// Serial1: both directions of a loopback wire at the configured baud, 10
+// bits per byte, with a 256-byte TX FIFO in front of it
+static std::mutex bridgeMu;
+static std::deque<uint8_t> bridgeTx, bridgeRx;
+static uint64_t bridgeByteNs = 86806;
+static uint64_t bridgeShiftedUs = 0;
+
+static void bridgeShift() {
+    uint64_t now = nowUs;
+    if (bridgeTx.empty()) {
+        bridgeShiftedUs = now;
+        return;
+    }
+    uint64_t bytes = (now - bridgeShiftedUs) * 1000 / bridgeByteNs;
+    while (bytes-- && !bridgeTx.empty()) {
+        bridgeRx.push_back(bridgeTx.front());
+        bridgeTx.pop_front();
+        bridgeShiftedUs += bridgeByteNs / 1000;
+    }
+}
+
+void BridgeSerial::begin(unsigned long baud, uint32_t, int8_t, int8_t) {
+    bridgeByteNs = 10000000000ULL / baud;
+}
+
+int BridgeSerial::available() {
+    std::lock_guard<std::mutex> lock(bridgeMu);
+    bridgeShift();
+    return bridgeRx.size();
+}
+
+int BridgeSerial::read() {
+    uint8_t b;
+    return read(&b, 1) ? b : -1;
+}
+
+size_t BridgeSerial::read(uint8_t* data, size_t length) {
+    std::lock_guard<std::mutex> lock(bridgeMu);
+    bridgeShift();
+    size_t n = min(length, bridgeRx.size());
+    std::copy(bridgeRx.begin(), bridgeRx.begin() + n, data);
+    bridgeRx.erase(bridgeRx.begin(), bridgeRx.begin() + n);
+    return n;
+}
+
+int BridgeSerial::availableForWrite() {
+    std::lock_guard<std::mutex> lock(bridgeMu);
+    bridgeShift();
+    return 256 - (int)bridgeTx.size();
+}
+
+size_t BridgeSerial::write(const uint8_t* data, size_t length) {
+    std::lock_guard<std::mutex> lock(bridgeMu);
+    bridgeShift();
+    length = min(length, (size_t)(256 - bridgeTx.size()));
+    bridgeTx.insert(bridgeTx.end(), data, data + length);
+    return length;
+}
+
+// =============================================================================
+// RADIO
+// =============================================================================
+static esp_now_recv_cb_t radioRecv = nullptr;
+static esp_now_send_cb_t radioSent = nullptr;
+static std::vector<std::pair<std::vector<uint8_t>, esp_now_send_status_t>> sendResults;
+std::vector<host_packet_t> hostRadioSent;
+bool hostRadioSendFails = false;
+
+// Peers as IDF keeps them: nothing before esp_now_init(), and a unicast
+// to a MAC that was never added fails
+static bool radioInit = false;
+static std::set<std::vector<uint8_t>> radioPeers;
+
+static std::vector<uint8_t> macKey(const uint8_t* mac) {
+    return std::vector<uint8_t>(mac, mac + 6);
+}
+
+esp_err_t esp_now_init() { radioInit = true; return ESP_OK; }
+esp_err_t esp_now_deinit() { radioInit = false; radioPeers.clear(); return ESP_OK; }
+esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t cb) { radioRecv = cb; return ESP_OK; }
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t cb) { radioSent = cb; return ESP_OK; }
+
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t* peer) {
+    if (!radioInit) return ESP_ERR_ESPNOW_NOT_INIT;
+    return radioPeers.insert(macKey(peer->peer_addr)).second ? ESP_OK : ESP_ERR_ESPNOW_EXIST;
+}
+
+esp_err_t esp_now_del_peer(const uint8_t* mac) {
+    if (!radioInit) return ESP_ERR_ESPNOW_NOT_INIT;
+    return radioPeers.erase(macKey(mac)) ? ESP_OK : ESP_ERR_ESPNOW_NOT_FOUND;
+}
+
+bool esp_now_is_peer_exist(const uint8_t* mac) {
+    return radioInit && radioPeers.count(macKey(mac));
+}
+
+esp_err_t esp_now_send(const uint8_t* mac, const uint8_t* data, size_t len) {
+    if (len > ESP_NOW_MAX_DATA_LEN) return ESP_ERR_INVALID_SIZE;
+    if (!radioInit) return ESP_ERR_ESPNOW_NOT_INIT;
+    if (!esp_now_is_peer_exist(mac)) return ESP_ERR_ESPNOW_NOT_FOUND;
+    host_packet_t packet;
+    memcpy(packet.mac, mac, 6);
+    packet.data.assign(data, data + len);
+    packet.atUs = nowUs;
+    hostRadioSent.push_back(packet);
+    sendResults.push_back({std::vector<uint8_t>(mac, mac + 6),
+                           hostRadioSendFails ? ESP_NOW_SEND_FAIL : ESP_NOW_SEND_SUCCESS});
+    return ESP_OK;
+}
+
+// Send results come back from the WiFi task, so they arrive once the loop blocks
+static void deliverSendResults() {
+    std::vector<std::pair<std::vector<uint8_t>, esp_now_send_status_t>> results;
+    results.swap(sendResults);
+    for (auto& result : results) {
+        if (radioSent) radioSent(result.first.data(), result.second);
+    }
+}
+
+void hostRadioReceive(const uint8_t* mac, const void* data, int length, int8_t rssi) {
+    static uint8_t self[6] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01};
+    wifi_pkt_rx_ctrl_t control = {};
+    control.rssi = rssi;
+    esp_now_recv_info_t info = {(uint8_t*)mac, self, &control};
+    if (radioRecv) radioRecv(&info, (const uint8_t*)data, length);
+}
+
+esp_err_t esp_wifi_set_channel(uint8_t, wifi_second_chan_t) { return ESP_OK; }
+
+esp_err_t esp_wifi_get_channel(uint8_t* primary, wifi_second_chan_t* second) {
+    *primary = 1;
+    if (second) *second = WIFI_SECOND_CHAN_NONE;
+    return ESP_OK;
+}
+
+String WiFiClass::macAddress() const { return String("24:0A:C4:00:00:01"); }
+
+void WiFiClass::macAddress(uint8_t* mac) const {
+    static const uint8_t self[6] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01};
+    memcpy(mac, self, 6);
+}
+
+// -----------------------------------------------------------------------------
+// UDP
+// -----------------------------------------------------------------------------
+static std::deque<host_packet_t> udpRx;
+std::vector<host_packet_t> hostUdpSent;
+
+void hostUdpReceive(IPAddress from, uint16_t port, const void* data, size_t length) {
+    host_packet_t packet;
+    memcpy(packet.mac, from.octets, 4);
+    packet.mac[4] = port >> 8;
+    packet.mac[5] = port & 0xFF;
+    packet.data.assign((const uint8_t*)data, (const uint8_t*)data + length);
+    packet.atUs = nowUs;
+    udpRx.push_back(packet);
+}
+
+uint8_t WiFiUDP::begin(uint16_t) { return 1; }
+
+int WiFiUDP::parsePacket() {
+    if (udpRx.empty()) return 0;
+    host_packet_t& packet = udpRx.front();
+    fromIp = IPAddress(packet.mac[0], packet.mac[1], packet.mac[2], packet.mac[3]);
+    fromPort = packet.mac[4] << 8 | packet.mac[5];
+    rx.assign(packet.data.begin(), packet.data.end());
+    rxPos = 0;
+    udpRx.pop_front();
+    return rx.size();
+}
+
+int WiFiUDP::read(uint8_t* data, size_t length) {
+    size_t n = min(length, rx.size() - rxPos);
+    memcpy(data, rx.data() + rxPos, n);
+    rxPos += n;
+    return n;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+    toIp = ip;
+    toPort = port;
+    tx.clear();
+    return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t* data, size_t length) {
+    tx.append((const char*)data, length);
+    return length;
+}
+
+int WiFiUDP::endPacket() {
+    host_packet_t packet;
+    memcpy(packet.mac, toIp.octets, 4);
+    packet.mac[4] = toPort >> 8;
+    packet.mac[5] = toPort & 0xFF;
+    packet.data.assign(tx.begin(), tx.end());
+    packet.atUs = nowUs;
+    hostUdpSent.push_back(packet);
+    return 1;
+}
+
+// =============================================================================
+// FLASH, NVS AND FILES
+// =============================================================================
+uint8_t hostOtaFlash[HOST_OTA_PARTITION_SIZE];
+unsigned long hostFlashErases = 0;
+bool hostOtaBootSet = false;
+
+static const esp_partition_t otaPartition = {0x210000, HOST_OTA_PARTITION_SIZE, "ota_1"};
+static const esp_partition_t runningPartition = {0x10000, 0x200000, "ota_0"};
+
+static bool inPartition(size_t offset, size_t size) {
+    return offset <= HOST_OTA_PARTITION_SIZE && size <= HOST_OTA_PARTITION_SIZE - offset;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t*, size_t offset, size_t size) {
+    if (offset % SPI_FLASH_SEC_SIZE || size % SPI_FLASH_SEC_SIZE || !inPartition(offset, size)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(hostOtaFlash + offset, 0xFF, size);
+    hostFlashErases += size / SPI_FLASH_SEC_SIZE;
+    spend((uint64_t)HOST_FLASH_ERASE_US * (size / SPI_FLASH_SEC_SIZE));
+    return ESP_OK;
+}
+
+// NOR flash: programming only clears bits
+esp_err_t esp_partition_write(const esp_partition_t*, size_t offset, const void* src, size_t size) {
+    if (!inPartition(offset, size)) return ESP_ERR_INVALID_ARG;
+    for (size_t i = 0; i < size; i++) hostOtaFlash[offset + i] &= ((const uint8_t*)src)[i];
+    spend((uint64_t)size * HOST_FLASH_WRITE_NS_PER_B / 1000);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t*, size_t offset, void* dst, size_t size) {
+    if (!inPartition(offset, size)) return ESP_ERR_INVALID_ARG;
+    memcpy(dst, hostOtaFlash + offset, size);
+    spend((uint64_t)size * HOST_FLASH_READ_NS_PER_B / 1000);
+    return ESP_OK;
+}
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t*) { return &otaPartition; }
+const esp_partition_t* esp_ota_get_running_partition() { return &runningPartition; }
+
+// IDF reads the new image back and checks it before writing otadata
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t*) {
+    spend(HOST_OTA_BOOT_SWITCH_US);
+    hostOtaBootSet = true;
+    return ESP_OK;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+    }
+    return ~crc;
+}
+
+// -----------------------------------------------------------------------------
+// SHA-256 (FIPS 180-4)
+// -----------------------------------------------------------------------------
+static const uint32_t sha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+static void sha256Block(mbedtls_sha256_context* ctx, const uint8_t* p) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)p[4 * i] << 24 | p[4 * i + 1] << 16 | p[4 * i + 2] << 8 | p[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t v[8];
+    memcpy(v, ctx->state, sizeof(v));
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = v[7] + (rotr(v[4], 6) ^ rotr(v[4], 11) ^ rotr(v[4], 25)) +
+                      ((v[4] & v[5]) ^ (~v[4] & v[6])) + sha256K[i] + w[i];
+        uint32_t t2 = (rotr(v[0], 2) ^ rotr(v[0], 13) ^ rotr(v[0], 22)) +
+                      ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+        memmove(v + 1, v, 7 * sizeof(uint32_t));
+        v[4] += t1;
+        v[0] = t1 + t2;
+    }
+    for (int i = 0; i < 8; i++) ctx->state[i] += v[i];
+}
+
+void mbedtls_sha256_init(mbedtls_sha256_context* ctx) { memset(ctx, 0, sizeof(*ctx)); }
+void mbedtls_sha256_free(mbedtls_sha256_context* ctx) { memset(ctx, 0, sizeof(*ctx)); }
+
+int mbedtls_sha256_starts(mbedtls_sha256_context* ctx, int) {
+    static const uint32_t iv[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                   0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    memcpy(ctx->state, iv, sizeof(iv));
+    ctx->total = 0;
+    ctx->used = 0;
+    return 0;
+}
+
+static void sha256Absorb(mbedtls_sha256_context* ctx, const uint8_t* input, size_t length) {
+    while (length--) {
+        ctx->block[ctx->used++] = *input++;
+        if (ctx->used == 64) {
+            sha256Block(ctx, ctx->block);
+            ctx->used = 0;
+        }
+    }
+}
+
+int mbedtls_sha256_update(mbedtls_sha256_context* ctx, const unsigned char* input, size_t length) {
+    ctx->total += length;
+    sha256Absorb(ctx, input, length);
+    spend((uint64_t)length * HOST_SHA256_NS_PER_B / 1000);
+    return 0;
+}
+
+int mbedtls_sha256_finish(mbedtls_sha256_context* ctx, unsigned char output[32]) {
+    uint64_t bits = ctx->total * 8;
+    uint8_t pad = 0x80;
+    sha256Absorb(ctx, &pad, 1);
+    pad = 0;
+    while (ctx->used != 56) sha256Absorb(ctx, &pad, 1);
+    uint8_t length[8];
+    for (int i = 0; i < 8; i++) length[i] = bits >> (56 - 8 * i);
+    sha256Absorb(ctx, length, 8);
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 4; j++) output[4 * i + j] = ctx->state[i] >> (24 - 8 * j);
+    }
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+// NVS
+// -----------------------------------------------------------------------------
+static std::map<std::string, std::vector<uint8_t>> nvs;
+unsigned long hostNvsWrites = 0;
+
+void hostNvsClear() { nvs.clear(); }
+
+bool Preferences::begin(const char* name, bool ro) {
+    space = std::string(name) + "/";
+    readOnly = ro;
+    return true;
+}
+
+bool Preferences::clear() {
+    if (readOnly) return false;
+    for (auto it = nvs.begin(); it != nvs.end();) {
+        it = it->first.compare(0, space.size(), space) == 0 ? nvs.erase(it) : std::next(it);
+    }
+    hostNvsWrites++;
+    return true;
+}
+
+bool Preferences::remove(const char* key) {
+    if (readOnly || !nvs.erase(space + key)) return false;
+    hostNvsWrites++;
+    return true;
+}
+
+bool Preferences::isKey(const char* key) { return nvs.count(space + key) > 0; }
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t length) {
+    if (readOnly) return 0;
+    nvs[space + key].assign((const uint8_t*)value, (const uint8_t*)value + length);
+    hostNvsWrites++;
+    return length;
+}
+
+size_t Preferences::getBytes(const char* key, void* buffer, size_t maxLength) {
+    auto it = nvs.find(space + key);
+    if (it == nvs.end() || it->second.size() > maxLength) return 0;
+    memcpy(buffer, it->second.data(), it->second.size());
+    return it->second.size();
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+    auto it = nvs.find(space + key);
+    return it == nvs.end() ? 0 : it->second.size();
+}
+
+// -----------------------------------------------------------------------------
+// LittleFS
+// -----------------------------------------------------------------------------
+std::string hostFsRoot;
+
+static std::string fsPath(const char* path) {
+    if (hostFsRoot.empty()) {
+        char name[] = "/tmp/receiver-fs-XXXXXX";
+        hostFsRoot = mkdtemp(name) ? name : "/tmp";
+    }
+    return hostFsRoot + path;
+}
+
+size_t File::write(const uint8_t* data, size_t length) {
+    return file ? fwrite(data, 1, length, file) : 0;
+}
+
+int File::read(uint8_t* data, size_t length) {
+    return file ? (int)fread(data, 1, length, file) : -1;
+}
+
+size_t File::size() {
+    if (!file) return 0;
+    long at = ftell(file);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, at, SEEK_SET);
+    return size;
+}
+
+void File::close() {
+    if (file) fclose(file);
+    file = nullptr;
+}
+
+bool LittleFSFS::begin(bool) {
+    fsPath("");
+    return true;
+}
+
+File LittleFSFS::open(const char* path, const char* mode) {
+    const char* stdioMode = mode[0] == 'w' ? "wb" : mode[0] == 'a' ? "ab" : "rb";
+    return File(fopen(fsPath(path).c_str(), stdioMode));
+}
+
+bool LittleFSFS::exists(const char* path) {
+    struct stat st;
+    return stat(fsPath(path).c_str(), &st) == 0;
+}
+
+bool LittleFSFS::remove(const char* path) {
+    return ::remove(fsPath(path).c_str()) == 0;
+}
+
+size_t LittleFSFS::usedBytes() {
+    size_t used = 0;
+    DIR* dir = opendir(fsPath("").c_str());
+    if (!dir) return 0;
+    while (dirent* entry = readdir(dir)) {
+        struct stat st;
+        std::string path = hostFsRoot + "/" + entry->d_name;
+        if (entry->d_name[0] != '.' && stat(path.c_str(), &st) == 0) used += st.st_size;
+    }
+    closedir(dir);
+    return used;
+}
+
+// =============================================================================
+// LED OUTPUT
+// =============================================================================
+static std::vector<CLEDController*> controllers;
+std::vector<host_output_t> hostOutputs;
+unsigned long hostShows = 0;
+
+void random16_set_seed(uint16_t seed) { randomSeed(seed); }
+
+CLEDController* CFastLED::addController(uint8_t pin, EOrder order) {
+    CLEDController* controller = new CLEDController(pin, order);
+    controllers.push_back(controller);
+    hostOutputs.push_back({pin, {}, 0});
+    return controller;
+}
+
+void CFastLED::clear(bool writeData) {
+    for (CLEDController* controller : controllers) {
+        if (controller->leds) memset((void*)controller->leds, 0, controller->ledCount * sizeof(CRGB));
+    }
+    if (writeData) show();
+}
+
+// Every channel shifts out at once; show() returns when the longest is done
+void CFastLED::show() {
+    uint32_t slowestUs = 0;
+    for (size_t ch = 0; ch < controllers.size(); ch++) {
+        CLEDController* controller = controllers[ch];
+        host_output_t& out = hostOutputs[ch];
+        out.bytes.clear();
+        for (int i = 0; i < controller->ledCount; i++) {
+            for (int k = 2; k >= 0; k--) {
+                uint8_t channel = (controller->order >> (3 * k)) & 7;
+                out.bytes.push_back(scale8(controller->leds[i].raw[channel], brightness));
+            }
+        }
+        out.wireUs = controller->ledCount * 24 * 1250 / 1000 + 300;
+        slowestUs = max(slowestUs, out.wireUs);
+    }
+    hostShows++;
+    spend(slowestUs);
+}
+
+uint32_t hostOutputHash() {
+    uint32_t hash = 2166136261u;
+    for (const host_output_t& out : hostOutputs) {
+        for (uint8_t b : out.bytes) hash = (hash ^ b) * 16777619u;
+    }
+    return hash;
+}
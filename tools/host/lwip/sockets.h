@@ -0,0 +1,8 @@
+// Host stand-in: the POSIX socket API is what lwIP mirrors
+#pragma once
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
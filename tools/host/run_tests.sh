@@ -0,0 +1,16 @@
+#!/bin/sh
+# Builds every tools/host/test_*.cpp against the sketch and runs it.
+# Run from the repository root: sh tools/host/run_tests.sh [test_name ...]
+set -e
+out=${TMPDIR:-/tmp}/receiver-host-tests
+mkdir -p "$out"
+tests=${*:-$(cd tools/host && ls test_*.cpp | sed 's/\.cpp$//')}
+failed=0
+for t in $tests; do
+    echo "=== $t"
+    g++ -std=gnu++17 -O1 -Wall -Wextra -Werror -pthread -Itools/host \
+        -o "$out/$t" "tools/host/$t.cpp" tools/host/host_runtime.cpp
+    (cd "$out" && "./$t") || failed=$((failed + 1))
+done
+echo "=== $failed test(s) failed"
+[ "$failed" -eq 0 ]
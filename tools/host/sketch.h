@@ -0,0 +1,15 @@
+/**
+ * @file      sketch.h
+ * @brief     The receiver sketch built into a host test, with the harness controls from host.h
+ *
+ * The Arduino builder adds a prototype for every sketch function; the few
+ * the sketch's own prototype lists leave out are declared here.
+ */
+
+#pragma once
+
+#include "host.h"
+
+void printHelp();
+
+#include "../../Recevier.ino"
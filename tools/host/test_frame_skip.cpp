@@ -0,0 +1,97 @@
+/**
+ * @file      test_frame_skip.cpp
+ * @brief     Host test: unchanged frames are not sent to the LEDs (Recevier.ino, OUTPUT CHANNELS)
+ *
+ * Runs a solid colour for ten seconds: the strip must get only the
+ * periodic refresh, once per FRAME_REFRESH_MS, while every other render is
+ * counted as skipped, and the LEDs keep showing the same bytes. A moving
+ * effect must be sent every frame. Then calls showFrame() directly: the
+ * same frame again is skipped, and a changed pixel, a brightness change,
+ * an expired refresh and showImmediate() each put a frame on the wire.
+ *
+ * Build:  g++ -std=gnu++17 -O1 -Wall -Wextra -pthread -Itools/host -o test_frame_skip \
+ *             tools/host/test_frame_skip.cpp tools/host/host_runtime.cpp
+ * Run:    ./test_frame_skip
+ */
+
+#include "sketch.h"
+
+static const uint8_t testController[6] = {0x64, 0xE8, 0x33, 0x7A, 0x88, 0x70};
+static const uint64_t testSpanUs = 10000000ULL;
+static int testFailures = 0;
+
+static void check(bool ok, const char* what) {
+    printf("## %s %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) testFailures++;
+}
+
+static void sendEffect(uint8_t effect, uint8_t speed) {
+    led_command_t command = {200, 60, 20, 0, 0, 100, effect, speed};
+    hostRadioReceive(testController, &command, sizeof(command));
+    hostRunLoop(1000000);
+}
+
+// Shows and skips over testSpanUs of loop
+static void runScene(const char* name, unsigned long* shows, unsigned long* skipped) {
+    unsigned long showsBefore = hostShows, skippedBefore = framesSkipped;
+    hostRunLoop(testSpanUs);
+    *shows = hostShows - showsBefore;
+    *skipped = framesSkipped - skippedBefore;
+    printf("   %-6s %4lu frames sent, %4lu skipped in %llu s\n", name, *shows, *skipped,
+           (unsigned long long)(testSpanUs / 1000000));
+}
+
+// One showFrame(): true if it reached the wire
+static bool shown() {
+    unsigned long before = hostShows;
+    showFrame();
+    return hostShows != before;
+}
+
+int main() {
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    hostSerialEcho = false;
+    setup();
+    hostRunLoop(5000000);
+
+    unsigned long shows, skipped;
+    const unsigned long frames = testSpanUs / 1000 / LED_UPDATE_INTERVAL_MS;
+    const unsigned long refreshes = testSpanUs / 1000 / FRAME_REFRESH_MS;
+
+    sendEffect(0, 50);
+    uint32_t before = hostOutputHash();
+    runScene("solid", &shows, &skipped);
+    check(shows >= refreshes - 1 && shows <= refreshes + 1, "solid: only the periodic refresh is sent");
+    check(skipped >= frames * 9 / 10, "solid: the other renders are skipped");
+    check(hostOutputHash() == before, "solid: the LEDs keep the same bytes");
+
+    // Top speed moves the rainbow a hue step faster than the frame rate
+    sendEffect(1, 100);
+    runScene("moving", &shows, &skipped);
+    check(shows >= frames * 9 / 10 && skipped <= refreshes, "moving: every frame is sent");
+
+    // Straight through showFrame(), with the loop out of the way
+    hostAdvanceUs(FRAME_REFRESH_MS * 1000ULL);
+    check(shown(), "first frame after the refresh interval sent");
+    check(!shown(), "same frame again skipped");
+
+    leds[17] += CRGB(1, 0, 0);
+    check(shown(), "one changed pixel sent");
+    check(!shown(), "and then skipped");
+
+    FastLED.setBrightness(FastLED.getBrightness() ^ 1);
+    check(shown(), "brightness change sent");
+
+    hostAdvanceUs(FRAME_REFRESH_MS * 1000ULL - 1000);
+    check(!shown(), "unchanged frame skipped just inside the refresh interval");
+    hostAdvanceUs(1000);
+    check(shown(), "unchanged frame resent once the refresh interval is up");
+
+    unsigned long showsBefore = hostShows;
+    showImmediate();
+    check(hostShows == showsBefore + 1, "showImmediate() always sends");
+    check(shown(), "the frame after showImmediate() is not skipped");
+
+    printf("## %d failure%s\n", testFailures, testFailures == 1 ? "" : "s");
+    return testFailures ? 1 : 0;
+}
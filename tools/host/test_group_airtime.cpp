@@ -0,0 +1,153 @@
+/**
+ * @file      test_group_airtime.cpp
+ * @brief     Host test: airtime of group broadcasts against unicast to every receiver (Recevier.ino, GROUP ADDRESSING)
+ *
+ * A controller drives N receivers at the LED frame rate for ten seconds,
+ * either with one unicast per receiver, each answered by an ACK, or with
+ * one broadcast to their group, sent twice because broadcasts are never
+ * acked. Airtime comes from the firmware's estimateAirtimeUs(). The
+ * broadcast cost must not grow with N and must beat unicast from two
+ * receivers up.
+ *
+ * One receiver is the firmware itself, subscribed to the group. It gets
+ * both copies of every broadcast, some of them reordered, and another
+ * group's traffic in between. It must apply each command once, drop the
+ * other group's, and count the same airtime the simulation charged for
+ * one copy of each broadcast. A unicast repeated after the resync silence
+ * must still count as a copy, while an older seq then is a restart.
+ *
+ * Build:  g++ -std=gnu++17 -O1 -Wall -Wextra -pthread -Itools/host -o test_group_airtime \
+ *             tools/host/test_group_airtime.cpp tools/host/host_runtime.cpp
+ * Run:    ./test_group_airtime
+ */
+
+#include "sketch.h"
+
+#define SIM_COMMANDS        300     // Ten seconds at the frame rate
+#define SIM_COPIES          2       // Sends of each broadcast
+#define SIM_ACK_US          (10 + AIRTIME_PREAMBLE_US + 14 * 8)  // SIFS and a 14-byte ACK at 1 Mbps
+#define SIM_GROUP           7
+#define SIM_OTHER_GROUP     9
+
+static const uint8_t testController[6] = {0x64, 0xE8, 0x33, 0x7A, 0x88, 0x70};
+static uint8_t testSelf[6] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01};
+static int testFailures = 0;
+
+static void check(bool ok, const char* what) {
+    printf("## %s %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) testFailures++;
+}
+
+// A command for every zone, optionally for a group, as the controller builds it
+static std::vector<uint8_t> commandPacket(uint16_t seq, int group, uint8_t red) {
+    std::vector<uint8_t> packet = {WIRE_VERSION_2, 0, (uint8_t)seq, (uint8_t)(seq >> 8)};
+    if (group >= 0) packet.insert(packet.end(), {WIRE_REC_TARGET, sizeof(wire_target_t), (uint8_t)group});
+    led_command_t command = {red, 0x20, 0x40, 0, 0, 100, 0, 50};
+    packet.insert(packet.end(), {WIRE_REC_COMMAND, sizeof(command)});
+    packet.insert(packet.end(), (const uint8_t*)&command, (const uint8_t*)&command + sizeof(command));
+    return packet;
+}
+
+static void broadcast(const std::vector<uint8_t>& packet) {
+    esp_now_recv_info_t info = {(uint8_t*)testController, (uint8_t*)broadcastAddress, nullptr};
+    OnDataRecv(&info, packet.data(), packet.size());
+}
+
+static void simulate() {
+    uint32_t unicastUs = estimateAirtimeUs(commandPacket(0, -1, 0).size()) + SIM_ACK_US;
+    uint32_t broadcastUs = estimateAirtimeUs(commandPacket(0, SIM_GROUP, 0).size()) * SIM_COPIES;
+    const uint64_t spanUs = (uint64_t)SIM_COMMANDS * LED_UPDATE_INTERVAL_MS * 1000;
+
+    printf("   receivers | unicast airtime | broadcast airtime (%d copies)\n", SIM_COPIES);
+    bool flat = true, cheaper = true;
+    uint64_t firstBroadcast = 0;
+    for (int receivers : {1, 2, 4, 8, 16, 32}) {
+        uint64_t unicast = (uint64_t)SIM_COMMANDS * receivers * unicastUs;
+        uint64_t grouped = (uint64_t)SIM_COMMANDS * broadcastUs;
+        if (!firstBroadcast) firstBroadcast = grouped;
+        printf("   %9d | %8.1f ms %5.1f%% | %8.1f ms %5.1f%%\n", receivers, unicast / 1000.0,
+               100.0 * unicast / spanUs, grouped / 1000.0, 100.0 * grouped / spanUs);
+        if (grouped != firstBroadcast) flat = false;
+        if (receivers >= 2 && grouped >= unicast) cheaper = false;
+    }
+    check(flat, "broadcast airtime is the same for any number of receivers");
+    check(cheaper, "broadcast beats unicast from two receivers up");
+}
+
+// The firmware as one member of the group
+static void member() {
+    runCommand("group add 7");
+    group_state_t* state = findGroupState(SIM_GROUP);
+    check(state != nullptr, "subscribed to the group");
+    if (!state) return;
+    unsigned long notSubscribed = wireStats.notSubscribed;
+    unsigned long relayDuplicates = relayStats.duplicates;
+
+    uint16_t seq = 1;
+    std::vector<uint8_t> late;
+    for (int i = 0; i < SIM_COMMANDS; i++) {
+        std::vector<uint8_t> packet = commandPacket(seq++, SIM_GROUP, i & 0xFF);
+        broadcast(packet);
+        // Every tenth second copy arrives after the next command
+        if (late.size()) broadcast(late);
+        late.clear();
+        if (i % 10 == 9) {
+            late = packet;
+        } else {
+            for (int copy = 1; copy < SIM_COPIES; copy++) broadcast(packet);
+        }
+
+        broadcast(commandPacket(seq++, SIM_OTHER_GROUP, 0xEE));
+        hostRunLoop(LED_UPDATE_INTERVAL_MS * 1000);
+    }
+    if (late.size()) broadcast(late);
+    hostRunLoop(500000);
+
+    uint32_t packetUs = estimateAirtimeUs(commandPacket(0, SIM_GROUP, 0).size());
+    unsigned long duplicates = state->duplicates + relayStats.duplicates - relayDuplicates;
+    printf("   member: %lu accepted, %lu duplicates, %lu us airtime, %lu other-group packets dropped\n",
+           state->accepted, duplicates, state->airtimeUs, wireStats.notSubscribed - notSubscribed);
+    check(state->accepted == SIM_COMMANDS && state->broadcasts == SIM_COMMANDS, "each command accepted once");
+    check(duplicates == SIM_COMMANDS * (SIM_COPIES - 1), "every second copy dropped, reordered ones too");
+    check(wireStats.notSubscribed - notSubscribed == SIM_COMMANDS, "other group's packets dropped");
+    check(state->airtimeUs == (unsigned long)SIM_COMMANDS * packetUs, "member counts one copy of each broadcast");
+    check(zones[0].color == CRGB((SIM_COMMANDS - 1) & 0xFF, 0x20, 0x40), "last group command on the LEDs");
+
+    // A unicast still arrives outside the group
+    esp_now_recv_info_t info = {(uint8_t*)testController, testSelf, nullptr};
+    std::vector<uint8_t> direct = commandPacket(1, -1, 0x55);
+    OnDataRecv(&info, direct.data(), direct.size());
+    hostRunLoop(500000);
+    check(zones[0].color == CRGB(0x55, 0x20, 0x40) && groupStates[0].airtimeUs == 0,
+          "unicast applied and not counted as broadcast airtime");
+
+    // The same packet once more after a quiet spell is still a copy
+    runCommand("zone 0 color 0 0 0");
+    hostRunLoop((SEQ_RESYNC_SILENCE_MS + 500) * 1000ULL);
+    unsigned long accepted = groupStates[0].accepted, resyncs = wireStats.seqResyncs;
+    OnDataRecv(&info, direct.data(), direct.size());
+    hostRunLoop(500000);
+    check(groupStates[0].accepted == accepted && wireStats.seqResyncs == resyncs &&
+          zones[0].color == CRGB::Black, "last packet repeated after the resync silence is not applied again");
+
+    // An older seq after the silence is a controller that restarted
+    hostRunLoop((SEQ_RESYNC_SILENCE_MS + 500) * 1000ULL);
+    std::vector<uint8_t> restarted = commandPacket(0, -1, 0x66);
+    OnDataRecv(&info, restarted.data(), restarted.size());
+    hostRunLoop(500000);
+    check(wireStats.seqResyncs == resyncs + 1 && zones[0].color == CRGB(0x66, 0x20, 0x40),
+          "older seq after the silence taken as a restart");
+}
+
+int main() {
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    hostSerialEcho = false;
+    setup();
+    hostRunLoop(5000000);
+
+    simulate();
+    member();
+
+    printf("## %d failure%s\n", testFailures, testFailures == 1 ? "" : "s");
+    return testFailures ? 1 : 0;
+}
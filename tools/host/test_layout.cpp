@@ -0,0 +1,91 @@
+/**
+ * @file      test_layout.cpp
+ * @brief     Host test: rejected layout commands leave the layout alone (Recevier.ino, MATRIX GEOMETRY)
+ *
+ * Splits the matrix into zones and shows a picture, then sends layout
+ * commands that must be refused: a panel bigger than NUM_LEDS, a tile
+ * count past 255, and a coordinate list with one cell twice. Each must
+ * be reported and keep the geometry, the pixel map, the zones and the
+ * picture. A good coordinate list must still be taken.
+ *
+ * Build:  g++ -std=gnu++17 -O1 -Wall -Wextra -pthread -Itools/host -o test_layout \
+ *             tools/host/test_layout.cpp tools/host/host_runtime.cpp
+ * Run:    ./test_layout
+ */
+
+#include "sketch.h"
+
+static int testFailures = 0;
+
+static void check(bool ok, const char* what) {
+    printf("## %s %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) testFailures++;
+}
+
+static struct {
+    matrix_layout_t layout;
+    uint16_t width, height, physical;
+    uint16_t pixelMap[NUM_LEDS];
+    bool zoneActive[MAX_ZONES];
+    CRGB leds[NUM_LEDS];
+} testBefore;
+
+static void remember() {
+    testBefore.layout = matrixLayout;
+    testBefore.width = matrixWidth;
+    testBefore.height = matrixHeight;
+    testBefore.physical = physicalLedCount;
+    memcpy(testBefore.pixelMap, pixelMap, sizeof(testBefore.pixelMap));
+    for (uint8_t z = 0; z < MAX_ZONES; z++) testBefore.zoneActive[z] = zones[z].active;
+    memcpy(testBefore.leds, leds, sizeof(testBefore.leds));
+}
+
+static void checkUnchanged(const char* command) {
+    hostSerialCapture = true;
+    hostSerialOutput.clear();
+    runCommand(command);
+    hostSerialCapture = false;
+    char what[96];
+    snprintf(what, sizeof(what), "'%s': refused", command);
+    check(hostSerialOutput.find("❌") != std::string::npos, what);
+    snprintf(what, sizeof(what), "'%s': geometry and pixel map kept", command);
+    check(memcmp(&testBefore.layout, &matrixLayout, sizeof(matrixLayout)) == 0 &&
+          testBefore.width == matrixWidth && testBefore.height == matrixHeight &&
+          testBefore.physical == physicalLedCount &&
+          memcmp(testBefore.pixelMap, pixelMap, sizeof(testBefore.pixelMap)) == 0, what);
+    bool zonesKept = true;
+    for (uint8_t z = 0; z < MAX_ZONES; z++) zonesKept &= testBefore.zoneActive[z] == zones[z].active;
+    snprintf(what, sizeof(what), "'%s': zones and picture kept", command);
+    check(zonesKept && memcmp(testBefore.leds, leds, sizeof(testBefore.leds)) == 0, what);
+}
+
+int main() {
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    hostSerialEcho = false;
+    setup();
+    hostRunLoop(5000000);
+
+    runCommand("zones split 4");
+    runCommand("zone 1 color 255 0 0");
+    hostRunLoop(500000);
+    check(zones[3].active, "four zones set up");
+    remember();
+
+    checkUnchanged("layout 40 40");
+    checkUnchanged("layout tiles 257 1");
+    checkUnchanged("layout tiles 1 300");
+
+    // Three LEDs in a row, the last one on the first one's cell
+    runCommand("layout map begin");
+    runCommand("layout map 0 0 1 0 0 0");
+    checkUnchanged("layout map end");
+
+    runCommand("layout map begin");
+    runCommand("layout map 0 0 1 0 2 0 2 1");
+    runCommand("layout map end");
+    check(customLayoutActive && physicalLedCount == 4 && matrixWidth == 3 && matrixHeight == 2,
+          "list without repeats accepted");
+
+    printf("## %d failure%s\n", testFailures, testFailures == 1 ? "" : "s");
+    return testFailures ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file      test_local_frames.cpp
+ * @brief     Host test: serial frames and radio frames don't tear each other (Recevier.ino, FRAME STREAMING)
+ *
+ * A serial frame arrives over several loop passes. While it does, a radio
+ * frame is decoded and published. Both must come out of the triple buffer
+ * whole: the radio frame without serial bytes in it, the serial frame
+ * without radio bytes, and neither dropped.
+ *
+ * Build:  g++ -std=gnu++17 -O1 -Wall -Wextra -pthread -Itools/host -o test_local_frames \
+ *             tools/host/test_local_frames.cpp tools/host/host_runtime.cpp
+ * Run:    ./test_local_frames
+ */
+
+#include "sketch.h"
+
+static int testFailures = 0;
+
+static void check(bool ok, const char* what) {
+    printf("## %s %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) testFailures++;
+}
+
+// Radio frame in fragments, all raw pixels of one value
+static void sendRadioFrame(uint16_t seq, uint8_t value) {
+    const uint16_t frameBytes = logicalLedCount * 3;
+    const uint16_t slice = 200;
+    uint8_t fragCount = (frameBytes + slice - 1) / slice;
+    for (uint8_t i = 0; i < fragCount; i++) {
+        uint8_t record[sizeof(frame_fragment_header_t) + slice];
+        frame_fragment_header_t header = {FRAME_CODEC_RAW, seq, 0, i, fragCount, frameBytes, (uint16_t)(i * slice)};
+        uint16_t length = min<uint16_t>(slice, frameBytes - i * slice);
+        memcpy(record, &header, sizeof(header));
+        memset(record + sizeof(header), value, length);
+        handleFrameFragment(record, sizeof(header) + length);
+    }
+}
+
+static bool frameIs(const uint8_t* frame, uint8_t value) {
+    for (uint16_t i = 0; i < logicalLedCount * 3; i++) {
+        if (frame[i] != value) return false;
+    }
+    return true;
+}
+
+// The ready buffer, as the loop would take it
+static bool takeFrame(uint8_t value) {
+    if (!streamFrameFresh) return false;
+    bool whole = frameIs(streamBuffers[streamReadyIdx], value);
+    streamFrameFresh = false;
+    return whole;
+}
+
+int main() {
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    hostSerialEcho = false;
+    setSerialBinary(true, SERIAL_BINARY_BAUD);
+
+    // Adalight header and the first half of the pixels
+    uint16_t n = logicalLedCount - 1;
+    std::vector<uint8_t> serialFrame = {'A', 'd', 'a', (uint8_t)(n >> 8), (uint8_t)n,
+                                        (uint8_t)((n >> 8) ^ (n & 0xFF) ^ 0x55)};
+    serialFrame.resize(serialFrame.size() + logicalLedCount * 3, 0x11);
+    size_t half = serialFrame.size() / 2;
+    hostSerialFeed(serialFrame.data(), half);
+    serviceSerialInput();
+    check(!streamFrameFresh, "half a serial frame publishes nothing");
+
+    // The radio publishes in between
+    sendRadioFrame(1, 0x22);
+    check(takeFrame(0x22), "radio frame published whole mid serial frame");
+
+    hostAdvanceUs(1000);
+    hostSerialFeed(serialFrame.data() + half, serialFrame.size() - half);
+    serviceSerialInput();
+    check(serialStats.frames[SERIAL_PROTO_ADALIGHT] == 1, "serial frame accepted");
+    check(takeFrame(0x11), "serial frame published whole after the radio's");
+
+    // And the other way round: a radio frame right after, the serial one not clobbered
+    hostSerialFeed(serialFrame.data(), half);
+    serviceSerialInput();
+    sendRadioFrame(2, 0x33);
+    check(takeFrame(0x33), "second radio frame whole");
+    hostSerialFeed(serialFrame.data() + half, serialFrame.size() - half);
+    serviceSerialInput();
+    check(takeFrame(0x11), "second serial frame whole");
+
+    printf("## %d failure%s\n", testFailures, testFailures == 1 ? "" : "s");
+    return testFailures ? 1 : 0;
+}
@@ -0,0 +1,151 @@
+/**
+ * @file      test_loop_budget.cpp
+ * @brief     Host test: no loop() pass blocks for longer than one frame (Recevier.ino, MAIN LOOP)
+ *
+ * Runs the receiver on the virtual clock through the paths that used to
+ * block: the boot, test, error and success animations, serial commands
+ * typed a few characters at a time, and an OTA transfer through erase,
+ * write, SHA-256 verify and the boot partition switch. Every pass's
+ * blocking time (the wait at the end of loop() excluded) must stay within
+ * LED_UPDATE_INTERVAL_MS.
+ *
+ * Build:  g++ -std=gnu++17 -O1 -Wall -Wextra -pthread -Itools/host -o test_loop_budget \
+ *             tools/host/test_loop_budget.cpp tools/host/host_runtime.cpp
+ * Run:    ./test_loop_budget
+ */
+
+#include "sketch.h"
+
+#include <random>
+
+static const uint8_t testController[6] = {0x64, 0xE8, 0x33, 0x7A, 0x88, 0x70};
+static const uint64_t testBudgetUs = LED_UPDATE_INTERVAL_MS * 1000ULL;
+static uint16_t testSeq = 1;
+static int testFailures = 0;
+
+static void check(bool ok, const char* what) {
+    printf("## %s %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) testFailures++;
+}
+
+static void checkBudget(uint64_t worstUs, const char* phase) {
+    char what[96];
+    snprintf(what, sizeof(what), "%s: longest pass %llu us (budget %llu)", phase,
+             (unsigned long long)worstUs, (unsigned long long)testBudgetUs);
+    check(worstUs <= testBudgetUs, what);
+}
+
+static void sendRecord(uint8_t type, const void* value, uint8_t length) {
+    uint8_t packet[ESP_NOW_MAX_DATA_LEN] = {WIRE_VERSION_2, 0, (uint8_t)testSeq, (uint8_t)(testSeq >> 8), type, length};
+    testSeq++;
+    memcpy(packet + 6, value, length);
+    hostRadioReceive(testController, packet, 6 + length);
+}
+
+static void testAnimations() {
+    checkBudget(hostRunLoop(5000000), "boot pattern with the radio coming up");
+    check(statusAnimation == STATUS_ANIM_NONE, "boot pattern has ended");
+
+    hostSerialFeed("test\n");
+    uint64_t worst = hostRunLoop(500000);
+    led_command_t command = {0, 0, 255, 0, 0, 100, 0, 50};
+    hostRadioReceive(testController, &command, sizeof(command));
+    worst = max(worst, hostRunLoop(100000));
+    checkBudget(worst, "'test' cut short by a radio command");
+    check(statusAnimation == STATUS_ANIM_NONE, "radio command ended the test pattern");
+
+    showError("simulated");
+    worst = hostRunLoop(2000000);
+    showSuccess("simulated");
+    worst = max(worst, hostRunLoop(1000000));
+    checkBudget(worst, "error and success flashes");
+}
+
+static void testSerialLines() {
+    hostSerialCapture = true;
+    hostSerialOutput.clear();
+    unsigned long timeoutsBefore = hostSerialTimeouts;
+
+    // A terminal that sends a command in pieces, with gaps between them
+    uint64_t worst = 0;
+    for (const char* piece : {"sta", "t", "us"}) {
+        hostSerialFeed(piece);
+        worst = max(worst, hostRunLoop(300000));
+    }
+    check(hostSerialOutput.find("Command: status") == std::string::npos, "partial line not run early");
+    hostSerialFeed("\r\n");
+    worst = max(worst, hostRunLoop(50000));
+    check(hostSerialOutput.find("Command: status") != std::string::npos, "line runs once its newline is in");
+
+    // Longer than the 64-byte binary-mode line, as 'layout map' runs are
+    std::string mapLine = "layout map begin\nlayout map";
+    for (int i = 0; i < 32; i++) mapLine += " " + std::to_string(i) + " 0";
+    mapLine += "\nlayout map end\n";
+    hostSerialOutput.clear();
+    hostSerialFeed(mapLine.c_str());
+    worst = max(worst, hostRunLoop(50000));
+    check(hostSerialOutput.find("32 LEDs in the list") != std::string::npos, "long 'layout map' line taken whole");
+    runCommand("layout 32 8");
+
+    check(hostSerialTimeouts == timeoutsBefore, "no readStringUntil() timeouts");
+    checkBudget(worst, "serial commands in pieces");
+    hostSerialCapture = false;
+}
+
+static void testOta() {
+    const uint32_t imageSize = 600 * 1024;
+    const uint16_t chunkSize = 200;
+    std::mt19937 rng(7);
+    std::vector<uint8_t> image(imageSize);
+    for (uint8_t& b : image) b = rng();
+
+    ota_begin_t begin = {0xC0FFEE, imageSize, chunkSize, {}};
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    mbedtls_sha256_update(&sha, image.data(), imageSize);
+    mbedtls_sha256_finish(&sha, begin.sha256);
+
+    uint64_t worst = 0;
+    uint32_t chunkCount = (imageSize + chunkSize - 1) / chunkSize;
+    sendRecord(WIRE_REC_OTA_BEGIN, &begin, sizeof(begin));
+    worst = max(worst, hostRunLoop(10000));
+
+    // A controller that keeps the receive queue full from the watermark up
+    uint64_t deadline = hostNowUs() + 120000000ULL;
+    while (ota.state == OTA_RECEIVING && ota.watermark < chunkCount && hostNowUs() < deadline) {
+        for (uint32_t i = ota.watermark; i < min(ota.watermark + OTA_QUEUE_SIZE, chunkCount); i++) {
+            uint8_t value[sizeof(ota_chunk_header_t) + OTA_CHUNK_MAX];
+            uint32_t length = min<uint32_t>(chunkSize, imageSize - i * chunkSize);
+            ota_chunk_header_t header = {begin.transferId, i, esp_rom_crc32_le(0, image.data() + i * chunkSize, length)};
+            memcpy(value, &header, sizeof(header));
+            memcpy(value + sizeof(header), image.data() + i * chunkSize, length);
+            sendRecord(WIRE_REC_OTA_CHUNK, value, sizeof(header) + length);
+        }
+        worst = max(worst, hostRunLoop(5000));
+    }
+    ota_end_t end = {begin.transferId};
+    sendRecord(WIRE_REC_OTA_END, &end, sizeof(end));
+    while (ota.state == OTA_RECEIVING || ota.state == OTA_VERIFYING) {
+        worst = max(worst, hostRunLoop(5000));
+        if (hostNowUs() > deadline) break;
+    }
+
+    check(ota.state == OTA_DONE && hostOtaBootSet, "OTA image verified and boot partition switched");
+    check(memcmp(hostOtaFlash, image.data(), imageSize) == 0, "flash holds the image byte for byte");
+    checkBudget(worst, "OTA erase, write, verify and boot switch");
+}
+
+int main() {
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    hostSerialEcho = false;
+    setup();
+
+    testAnimations();
+    testSerialLines();
+    testOta();
+
+    printf("## %d failure%s; loop overruns counted by the firmware: %lu\n",
+           testFailures, testFailures == 1 ? "" : "s", loopOverruns);
+    return testFailures ? 1 : 0;
+}
@@ -0,0 +1,221 @@
+/**
+ * @file      test_ota.cpp
+ * @brief     Host test: an OTA transfer over a lossy link with a reboot halfway (Recevier.ino, OTA UPDATE)
+ *
+ * A controller sends an image through the radio path: BEGIN, then chunks
+ * from the watermark its last status reported, resending what the status
+ * bitmap shows missing, then END. A fifth of the packets each way are
+ * lost and a few chunks arrive corrupted. Halfway through the receiver
+ * loses power: the session in RAM is gone, NVS and flash are kept. When
+ * the controller hears nothing it announces the image again, and the
+ * receiver must resume from the watermark it saved instead of chunk 0.
+ * At the end the flash must hold the image byte for byte, the boot
+ * partition must be switched and the receiver must restart. An image
+ * whose SHA-256 doesn't match must not be booted.
+ *
+ * Build:  g++ -std=gnu++17 -O1 -Wall -Wextra -pthread -Itools/host -o test_ota \
+ *             tools/host/test_ota.cpp tools/host/host_runtime.cpp
+ * Run:    ./test_ota
+ */
+
+#include "sketch.h"
+
+#include <random>
+
+#define TEST_TICK_US        5000
+#define TEST_LOSS_PCT       20
+#define TEST_CORRUPT_PCT    2
+#define TEST_RESEND_US      150000  // A chunk still missing this long after it was sent goes again
+#define TEST_SILENCE_US     500000  // No status this long: announce the image again
+#define TEST_DEADLINE_US    300000000ULL
+
+static const uint8_t testController[6] = {0x64, 0xE8, 0x33, 0x7A, 0x88, 0x70};
+static std::mt19937 testRng(0x07A);
+static uint16_t testSeq = 1;
+static int testFailures = 0;
+
+static void check(bool ok, const char* what) {
+    printf("## %s %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) testFailures++;
+}
+
+static bool lost() {
+    return testRng() % 100 < TEST_LOSS_PCT;
+}
+
+static void sendRecord(uint8_t type, const void* value, uint8_t length) {
+    uint8_t packet[ESP_NOW_MAX_DATA_LEN] = {WIRE_VERSION_2, 0, (uint8_t)testSeq, (uint8_t)(testSeq >> 8), type, length};
+    testSeq++;
+    memcpy(packet + 6, value, length);
+    if (!lost()) hostRadioReceive(testController, packet, 6 + length);
+}
+
+// The sending side, knowing only what the receiver's statuses told it
+struct Controller {
+    std::vector<uint8_t> image;
+    ota_begin_t begin;
+    uint32_t chunkCount;
+    std::vector<uint64_t> sentUs;
+    uint32_t watermark = 0;
+    uint32_t receivedMask = 0;
+    uint8_t state = OTA_IDLE;
+    uint64_t lastStatusUs = 0, lastBeginUs = 0, lastEndUs = 0;
+    size_t heard = 0;               // hostRadioSent entries already looked at
+    unsigned long chunksSent = 0, statuses = 0;
+
+    Controller(uint32_t transferId, uint32_t imageSize, bool badDigest) : image(imageSize) {
+        for (uint8_t& b : image) b = testRng();
+        begin = {transferId, imageSize, OTA_CHUNK_MAX, {}};
+        mbedtls_sha256_context sha;
+        mbedtls_sha256_init(&sha);
+        mbedtls_sha256_starts(&sha, 0);
+        mbedtls_sha256_update(&sha, image.data(), imageSize);
+        mbedtls_sha256_finish(&sha, begin.sha256);
+        if (badDigest) begin.sha256[0] ^= 1;
+        chunkCount = (imageSize + OTA_CHUNK_MAX - 1) / OTA_CHUNK_MAX;
+        sentUs.assign(chunkCount, 0);
+        heard = hostRadioSent.size();
+    }
+
+    void readStatuses() {
+        for (; heard < hostRadioSent.size(); heard++) {
+            const host_packet_t& packet = hostRadioSent[heard];
+            if (memcmp(packet.mac, testController, 6) != 0 ||
+                packet.data.size() < sizeof(wire_header_t) + sizeof(wire_record_t) + sizeof(ota_status_t) ||
+                packet.data[sizeof(wire_header_t)] != WIRE_REC_OTA_STATUS || lost()) {
+                continue;
+            }
+            ota_status_t status;
+            memcpy(&status, packet.data.data() + sizeof(wire_header_t) + sizeof(wire_record_t), sizeof(status));
+            if (status.transferId != begin.transferId) continue;
+            watermark = status.watermark;
+            receivedMask = status.receivedMask;
+            state = status.state;
+            lastStatusUs = hostNowUs();
+            statuses++;
+        }
+    }
+
+    bool held(uint32_t index) {
+        return index < watermark || (index > watermark && index - watermark - 1 < 32 &&
+                                     (receivedMask & (1UL << (index - watermark - 1))));
+    }
+
+    void sendChunk(uint32_t index) {
+        uint8_t value[sizeof(ota_chunk_header_t) + OTA_CHUNK_MAX];
+        uint32_t length = min<uint32_t>(OTA_CHUNK_MAX, image.size() - index * OTA_CHUNK_MAX);
+        ota_chunk_header_t header = {begin.transferId, index,
+                                     esp_rom_crc32_le(0, image.data() + index * OTA_CHUNK_MAX, length)};
+        memcpy(value, &header, sizeof(header));
+        memcpy(value + sizeof(header), image.data() + index * OTA_CHUNK_MAX, length);
+        if (testRng() % 100 < TEST_CORRUPT_PCT) value[sizeof(header) + testRng() % length] ^= 0x10;
+        sendRecord(WIRE_REC_OTA_CHUNK, value, sizeof(header) + length);
+        sentUs[index] = hostNowUs();
+        chunksSent++;
+    }
+
+    // One tick: announce, fill the window, or close
+    void tick() {
+        readStatuses();
+        uint64_t now = hostNowUs();
+        bool silent = now - lastStatusUs >= TEST_SILENCE_US;
+
+        if ((state == OTA_IDLE || (state == OTA_RECEIVING && silent)) && now - lastBeginUs >= TEST_SILENCE_US) {
+            sendRecord(WIRE_REC_OTA_BEGIN, &begin, sizeof(begin));
+            lastBeginUs = now;
+            return;
+        }
+        if (state != OTA_RECEIVING) return;
+
+        if (watermark >= chunkCount) {
+            if (now - lastEndUs >= TEST_RESEND_US) {
+                ota_end_t end = {begin.transferId};
+                sendRecord(WIRE_REC_OTA_END, &end, sizeof(end));
+                lastEndUs = now;
+            }
+            return;
+        }
+        int budget = OTA_QUEUE_SIZE;
+        for (uint32_t i = watermark; i < min<uint32_t>(watermark + OTA_WINDOW, chunkCount) && budget; i++) {
+            if (held(i) || (sentUs[i] && now - sentUs[i] < TEST_RESEND_US)) continue;
+            sendChunk(i);
+            budget--;
+        }
+    }
+
+    // The receiver's outcome, whether or not its last status got through
+    bool finished() {
+        return ota.transferId == begin.transferId && (ota.state == OTA_DONE || ota.state == OTA_FAILED);
+    }
+};
+
+// What a power cut takes: the session in RAM. NVS and flash are kept.
+static void powerCut() {
+    otaEraseStop = true;
+    while (otaEraseRunning) hostRunLoop(1000);
+    portENTER_CRITICAL(&otaMux);
+    memset(&ota, 0, sizeof(ota));
+    memset(otaQueue, 0, sizeof(otaQueue));
+    portEXIT_CRITICAL(&otaMux);
+    otaBeginPending = false;
+    otaEndPending = false;
+}
+
+static void testLossAndReboot() {
+    Controller controller(0x5EC0DE, 300 * 1024, false);
+    uint32_t savedMark = 0;
+    bool cut = false;
+    unsigned long restarts = hostRestarts;
+
+    uint64_t deadline = hostNowUs() + TEST_DEADLINE_US;
+    while (!controller.finished() && hostNowUs() < deadline) {
+        controller.tick();
+        hostRunLoop(TEST_TICK_US);
+        if (!cut && ota.state == OTA_RECEIVING && ota.watermark >= controller.chunkCount / 2) {
+            savedMark = ota.persistedWatermark;
+            powerCut();
+            cut = true;
+        }
+    }
+    hostRunLoop((OTA_REBOOT_DELAY_MS + 100) * 1000ULL);
+
+    printf("   %lu chunks for %lu, %lu statuses heard, resumed at %lu, %lu CRC errors, %lu duplicates, %.1f s\n",
+           controller.chunksSent, (unsigned long)controller.chunkCount, controller.statuses,
+           (unsigned long)ota.resumedFrom, ota.crcErrors, ota.duplicates, (hostNowUs() - (deadline - TEST_DEADLINE_US)) / 1e6);
+    check(cut && savedMark > 0 && ota.resumedFrom == savedMark, "resumed at the watermark saved before the power cut");
+    check(controller.chunksSent < controller.chunkCount * 2, "resume didn't send the image again");
+    check(ota.state == OTA_DONE && hostOtaBootSet, "image verified and boot partition switched");
+    check(memcmp(hostOtaFlash, controller.image.data(), controller.image.size()) == 0,
+          "flash holds the image byte for byte");
+    check(hostRestarts > restarts, "receiver restarts into the new image");
+
+    Preferences prefs;
+    prefs.begin("ota", true);
+    check(prefs.getUInt("id", 0) == 0, "resume point cleared once finished");
+    prefs.end();
+}
+
+static void testBadDigest() {
+    hostOtaBootSet = false;
+    Controller controller(0xBADD16, 20 * 1024, true);
+    uint64_t deadline = hostNowUs() + TEST_DEADLINE_US;
+    while (!controller.finished() && hostNowUs() < deadline) {
+        controller.tick();
+        hostRunLoop(TEST_TICK_US);
+    }
+    check(ota.state == OTA_FAILED && !hostOtaBootSet,
+          "image with the wrong SHA-256 reported failed and not booted");
+}
+
+int main() {
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    hostSerialEcho = false;
+    setup();
+    hostRunLoop(5000000);
+
+    testLossAndReboot();
+    testBadDigest();
+
+    printf("## %d failure%s\n", testFailures, testFailures == 1 ? "" : "s");
+    return testFailures ? 1 : 0;
+}
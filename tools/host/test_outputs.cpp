@@ -0,0 +1,128 @@
+/**
+ * @file      test_outputs.cpp
+ * @brief     Host test: parallel output segments and their wire time (Recevier.ino, OUTPUT CHANNELS)
+ *
+ * Brings up all four output pins the way initializeOutputs() does with
+ * OUTPUT_CHANNELS at 4, then shows a frame in which every LED is distinct.
+ * Each channel must carry exactly its segment of leds[], in wire colour
+ * order, and together the channels must carry the whole chain once. The
+ * modelled wire time per channel must match segmentWireTimeUs(), and
+ * show() must cost the slowest channel, not the sum. Covers the even
+ * split, an uneven layout, an explicit 'outputs' map and maps that are
+ * refused.
+ *
+ * Build:  g++ -std=gnu++17 -O1 -Wall -Wextra -pthread -Itools/host -o test_outputs \
+ *             tools/host/test_outputs.cpp tools/host/host_runtime.cpp
+ * Run:    ./test_outputs
+ */
+
+#include "sketch.h"
+
+static int testFailures = 0;
+
+static void check(bool ok, const char* what) {
+    printf("## %s %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) testFailures++;
+}
+
+// The rest of MAX_OUTPUT_CHANNELS, added as initializeOutputs() would
+static void addChannels() {
+    for (uint8_t ch = outputChannelCount; ch < MAX_OUTPUT_CHANNELS; ch++) {
+        outputControllers[ch] = addOutputController(outputPins[ch], leds, 0);
+        outputSegments[ch].pin = outputPins[ch];
+        outputChannelCount++;
+    }
+    splitOutputSegments();
+}
+
+// Every LED different, shown at full brightness past the frame cache
+static uint64_t showPattern() {
+    for (uint16_t i = 0; i < NUM_LEDS; i++) leds[i] = CRGB(i & 0xFF, 0x40 | (i >> 8), 0x80 ^ (i & 0x7F));
+    FastLED.setBrightness(255);
+    invalidateFrameCache();
+    uint64_t start = hostNowUs();
+    showFrame();
+    return hostNowUs() - start;
+}
+
+// Channel bytes against leds[] in GRB, and the chain covered once
+static bool segmentsCarryChain() {
+    uint16_t next = 0;
+    for (uint8_t ch = 0; ch < outputChannelCount; ch++) {
+        const output_segment_t& seg = outputSegments[ch];
+        const std::vector<uint8_t>& bytes = hostOutputs[ch].bytes;
+        if (seg.start != next || bytes.size() != seg.count * 3u) return false;
+        for (uint16_t i = 0; i < seg.count; i++) {
+            const CRGB& led = leds[seg.start + i];
+            if (bytes[i * 3] != led.g || bytes[i * 3 + 1] != led.r || bytes[i * 3 + 2] != led.b) return false;
+        }
+        next += seg.count;
+    }
+    return next == physicalLedCount;
+}
+
+static bool wireTimesMatch(uint64_t showUs) {
+    uint32_t slowest = 0;
+    for (uint8_t ch = 0; ch < outputChannelCount; ch++) {
+        uint32_t wireUs = segmentWireTimeUs(outputSegments[ch].count);
+        if (hostOutputs[ch].wireUs != wireUs) return false;
+        slowest = max(slowest, wireUs);
+    }
+    return showUs == slowest && lastShowTimeUs == slowest;
+}
+
+static void report(const char* name, uint64_t showUs) {
+    printf("   %-8s", name);
+    for (uint8_t ch = 0; ch < outputChannelCount; ch++) printf(" %3d", outputSegments[ch].count);
+    printf(" LEDs | show %llu us vs %lu us single chain\n", (unsigned long long)showUs,
+           (unsigned long)segmentWireTimeUs(physicalLedCount));
+}
+
+int main() {
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    hostSerialEcho = false;
+    setup();
+    hostRunLoop(5000000);
+
+    uint64_t showUs = showPattern();
+    check(outputChannelCount == 1 && segmentsCarryChain(), "one channel carries the whole chain");
+    check(wireTimesMatch(showUs), "one channel: show() costs segmentWireTimeUs(NUM_LEDS)");
+
+    addChannels();
+    showUs = showPattern();
+    report("even", showUs);
+    check(outputChannelCount == MAX_OUTPUT_CHANNELS && hostOutputs.size() == MAX_OUTPUT_CHANNELS,
+          "all channels driven");
+    check(segmentsCarryChain(), "even split: each channel carries its own run");
+    check(wireTimesMatch(showUs), "even split: show() costs the slowest channel");
+    check(showUs * 2 < segmentWireTimeUs(physicalLedCount), "four channels at least twice as fast as one chain");
+
+    runCommand("outputs 100 50 50 56");
+    showUs = showPattern();
+    report("explicit", showUs);
+    check(outputSegments[0].count == 100 && outputSegments[3].start == 200, "explicit map applied");
+    check(segmentsCarryChain(), "explicit map: each channel carries its own run");
+    check(wireTimesMatch(showUs), "explicit map: show() costs the longest segment");
+
+    output_segment_t before[MAX_OUTPUT_CHANNELS];
+    memcpy(before, outputSegments, sizeof(before));
+    runCommand("outputs 100 100 100 100");
+    runCommand("outputs 64 64 64");
+    runCommand("outputs 64 64 64 64 64");
+    check(memcmp(before, outputSegments, sizeof(before)) == 0, "too many LEDs or wrong channel count refused");
+
+    // 30x7 = 210 wired LEDs, which four channels can't split evenly
+    matrixLayout.panelWidth = 30;
+    matrixLayout.panelHeight = 7;
+    matrixLayout.tilesX = 1;
+    matrixLayout.tilesY = 1;
+    check(rebuildPixelMap(), "30x7 layout accepted");
+    showUs = showPattern();
+    report("uneven", showUs);
+    check(outputSegments[0].count == 53 && outputSegments[3].count == 52, "layout change rebalances the channels");
+    check(segmentsCarryChain(), "uneven split: each channel carries its own run");
+    check(wireTimesMatch(showUs), "uneven split: show() costs the slowest channel");
+
+    printf("## %d failure%s\n", testFailures, testFailures == 1 ? "" : "s");
+    return testFailures ? 1 : 0;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file      test_pixel_frames.cpp
+ * @brief     Host test: UDP pixel frames and radio frames don't tear each other (Recevier.ino, UDP PIXEL INPUT)
+ *
+ * DDP datagrams go to the firmware's pixel sockets over loopback. A frame
+ * split across two datagrams, with a radio frame published between them,
+ * must come out whole, as must the radio frame. A later frame that covers
+ * only part of the panel keeps the previous frame's pixels elsewhere.
+ *
+ * Build:  g++ -std=gnu++17 -O1 -Wall -Wextra -pthread -Itools/host -o test_pixel_frames \
+ *             tools/host/test_pixel_frames.cpp tools/host/host_runtime.cpp
+ * Run:    ./test_pixel_frames
+ */
+
+#include "sketch.h"
+
+static int testFailures = 0;
+static int testSocket = -1;
+static uint8_t testDdpSeq = 1;
+
+static void check(bool ok, const char* what) {
+    printf("## %s %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) testFailures++;
+}
+
+static void sendDdp(uint32_t offset, uint16_t length, uint8_t value, bool push) {
+    uint8_t datagram[DDP_HEADER_BYTES + FRAME_BYTES_MAX] = {
+        (uint8_t)(DDP_VERSION_1 | (push ? DDP_FLAG_PUSH : 0)), testDdpSeq, 0, DDP_ID_DISPLAY,
+        (uint8_t)(offset >> 24), (uint8_t)(offset >> 16), (uint8_t)(offset >> 8), (uint8_t)offset,
+        (uint8_t)(length >> 8), (uint8_t)length};
+    testDdpSeq = testDdpSeq % 15 + 1;
+    memset(datagram + DDP_HEADER_BYTES, value, length);
+
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(DDP_PORT);
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sendto(testSocket, datagram, DDP_HEADER_BYTES + length, 0, (struct sockaddr*)&to, sizeof(to));
+}
+
+static void sendRadioFrame(uint16_t seq, uint8_t value) {
+    const uint16_t frameBytes = logicalLedCount * 3;
+    const uint16_t slice = 200;
+    uint8_t fragCount = (frameBytes + slice - 1) / slice;
+    for (uint8_t i = 0; i < fragCount; i++) {
+        uint8_t record[sizeof(frame_fragment_header_t) + slice];
+        frame_fragment_header_t header = {FRAME_CODEC_RAW, seq, 0, i, fragCount, frameBytes, (uint16_t)(i * slice)};
+        uint16_t length = min<uint16_t>(slice, frameBytes - i * slice);
+        memcpy(record, &header, sizeof(header));
+        memset(record + sizeof(header), value, length);
+        handleFrameFragment(record, sizeof(header) + length);
+    }
+}
+
+// The ready buffer, as the loop would take it: first `split` bytes one value, the rest another
+static bool takeFrame(uint8_t first, uint8_t rest, uint16_t split) {
+    if (!streamFrameFresh) return false;
+    const uint8_t* frame = streamBuffers[streamReadyIdx];
+    streamFrameFresh = false;
+    for (uint16_t i = 0; i < logicalLedCount * 3; i++) {
+        if (frame[i] != (i < split ? first : rest)) return false;
+    }
+    return true;
+}
+
+int main() {
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    hostSerialEcho = false;
+    testSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (!pixelInputBegin() || pixelSockets[PIXEL_PROTO_DDP] < 0 || testSocket < 0) {
+        printf("## FAIL no loopback UDP for the DDP port\n");
+        return 1;
+    }
+    const uint16_t frameBytes = logicalLedCount * 3;
+    const uint16_t half = frameBytes / 2;
+
+    sendDdp(0, half, 0x11, false);
+    servicePixelInput();
+    check(!streamFrameFresh, "first DDP datagram publishes nothing");
+
+    sendRadioFrame(1, 0x22);
+    check(takeFrame(0x22, 0x22, 0), "radio frame published whole mid pixel frame");
+
+    sendDdp(half, frameBytes - half, 0x11, true);
+    servicePixelInput();
+    check(pixelStats.frames == 1, "pixel frame pushed");
+    check(takeFrame(0x11, 0x11, 0), "pixel frame published whole after the radio's");
+
+    // A frame that only repaints the first half keeps the rest of the last one
+    sendRadioFrame(2, 0x33);
+    check(takeFrame(0x33, 0x33, 0), "second radio frame whole");
+    sendDdp(0, half, 0x44, true);
+    servicePixelInput();
+    check(takeFrame(0x44, 0x11, half), "partial pixel frame based on the last pixel frame, not the radio's");
+
+    close(testSocket);
+    printf("## %d failure%s\n", testFailures, testFailures == 1 ? "" : "s");
+    return testFailures ? 1 : 0;
+}
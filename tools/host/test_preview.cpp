@@ -0,0 +1,165 @@
+/**
+ * @file      test_preview.cpp
+ * @brief     Host test: framebuffer preview size, airtime share and decodability (Recevier.ino, FRAMEBUFFER PREVIEW)
+ *
+ * Turns the preview on and runs a moving, a static and a sparkling scene.
+ * Every preview the receiver sends is decoded the way the controller's
+ * display would (key frames, and deltas only on top of their base frame)
+ * and must end up equal to the receiver's own reference. Per scene it
+ * reports bytes per preview and the airtime share, which must stay within
+ * the configured share plus the banked burst; a static scene sends only
+ * the periodic key frames.
+ *
+ * Build:  g++ -std=gnu++17 -O1 -Wall -Wextra -pthread -Itools/host -o test_preview \
+ *             tools/host/test_preview.cpp tools/host/host_runtime.cpp
+ * Run:    ./test_preview
+ */
+
+#include "sketch.h"
+
+static const uint8_t testController[6] = {0x64, 0xE8, 0x33, 0x7A, 0x88, 0x70};
+static int testFailures = 0;
+
+static void check(bool ok, const char* what) {
+    printf("## %s %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) testFailures++;
+}
+
+// The controller's display: the last preview it could apply
+static struct {
+    bool valid = false;
+    uint16_t frame = 0;
+    uint8_t width = 0, height = 0;
+    uint8_t pixels[PREVIEW_MAX_PIXELS];
+    unsigned long applied = 0, keyframes = 0, waited = 0, broken = 0;
+} testDisplay;
+
+static size_t testSeen = 0;
+
+// Zero-run RLE, XORed onto the base for a delta (decodeStreamFrame's format)
+static bool testDecode(const uint8_t* in, uint16_t length, bool delta, uint8_t* out, uint16_t count) {
+    uint16_t at = 0, pos = 0;
+    while (at < length) {
+        uint8_t control = in[at++];
+        uint16_t run = (control & 0x7F) + 1;
+        if (pos + run > count) return false;
+        if (control & 0x80) {
+            if (at + run > length) return false;
+            for (uint16_t i = 0; i < run; i++) out[pos + i] = delta ? out[pos + i] ^ in[at + i] : in[at + i];
+            at += run;
+        } else if (!delta) {
+            memset(out + pos, 0, run);
+        }
+        pos += run;
+    }
+    return pos == count;
+}
+
+static void testShowPreview(const uint8_t* value, uint8_t length) {
+    preview_header_t header;
+    memcpy(&header, value, sizeof(header));
+    bool keyframe = header.flags & PREVIEW_FLAG_KEYFRAME;
+    uint16_t count = header.width * header.height;
+    if (count > PREVIEW_MAX_PIXELS) {
+        testDisplay.broken++;
+        return;
+    }
+    if (!keyframe && (!testDisplay.valid || header.base != testDisplay.frame ||
+                      header.width != testDisplay.width || header.height != testDisplay.height)) {
+        testDisplay.waited++;
+        return;
+    }
+    uint8_t pixels[PREVIEW_MAX_PIXELS];
+    memcpy(pixels, testDisplay.pixels, sizeof(pixels));
+    if (!testDecode(value + sizeof(header), length - sizeof(header), !keyframe, pixels, count)) {
+        testDisplay.broken++;
+        testDisplay.valid = false;
+        return;
+    }
+    memcpy(testDisplay.pixels, pixels, count);
+    testDisplay.valid = true;
+    testDisplay.frame = header.frame;
+    testDisplay.width = header.width;
+    testDisplay.height = header.height;
+    testDisplay.applied++;
+    if (keyframe) testDisplay.keyframes++;
+}
+
+typedef struct {
+    unsigned long previews = 0, bytes = 0, keyframes = 0;
+    uint64_t airtimeUs = 0;
+} test_uplink_t;
+
+// Previews sent since the last call, shown on the display
+static test_uplink_t testCollect() {
+    test_uplink_t uplink;
+    for (; testSeen < hostRadioSent.size(); testSeen++) {
+        const std::vector<uint8_t>& data = hostRadioSent[testSeen].data;
+        if (data.size() < sizeof(wire_header_t) || data[0] != WIRE_VERSION_2) continue;
+        for (size_t pos = sizeof(wire_header_t); pos + sizeof(wire_record_t) <= data.size();
+             pos += sizeof(wire_record_t) + data[pos + 1]) {
+            if (data[pos] != WIRE_REC_PREVIEW || pos + sizeof(wire_record_t) + data[pos + 1] > data.size()) continue;
+            const uint8_t* value = &data[pos + sizeof(wire_record_t)];
+            uplink.previews++;
+            uplink.bytes += data.size();
+            uplink.airtimeUs += estimateAirtimeUs(data.size());
+            if (value[4] & PREVIEW_FLAG_KEYFRAME) uplink.keyframes++;
+            testShowPreview(value, data[pos + 1]);
+        }
+    }
+    return uplink;
+}
+
+static void runScene(const char* name, uint8_t effect, uint8_t speed, uint64_t spanUs, bool still) {
+    led_command_t command = {200, 60, 20, 0, 0, 100, effect, speed};
+    hostRadioReceive(testController, &command, sizeof(command));
+    hostRunLoop(500000);
+    testCollect();
+
+    hostRunLoop(spanUs);
+    test_uplink_t uplink = testCollect();
+    double share = 100.0 * uplink.airtimeUs / spanUs;
+    printf("   %-9s %3lu previews (%lu key), %5.1f bytes each, %.2f%% airtime\n", name, uplink.previews,
+           uplink.keyframes, uplink.previews ? (double)uplink.bytes / uplink.previews : 0.0, share);
+
+    char what[96];
+    snprintf(what, sizeof(what), "%s: airtime within %d%% plus the banked burst", name, previewSharePct);
+    check(uplink.airtimeUs <= spanUs * previewSharePct / 100 + PREVIEW_BURST_US, what);
+    uint8_t width, height;
+    previewGeometry(&width, &height);
+    snprintf(what, sizeof(what), "%s: display matches the receiver's last preview", name);
+    check(testDisplay.valid && memcmp(testDisplay.pixels, previewReference, width * height) == 0, what);
+    if (still) {
+        snprintf(what, sizeof(what), "%s: unchanged frames send only key frames", name);
+        check(uplink.previews == uplink.keyframes &&
+              uplink.keyframes <= spanUs / 1000 / PREVIEW_KEYFRAME_MS + 1, what);
+    }
+}
+
+int main() {
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    hostSerialEcho = false;
+    setup();
+    hostRunLoop(5000000);
+
+    runCommand("preview fps 5");
+    uint8_t width, height;
+    uint8_t scale = previewGeometry(&width, &height);
+    printf("   %dx%d matrix -> %dx%d preview (1:%d) at %d fps\n", matrixWidth, matrixHeight, width, height, scale,
+           previewFps);
+
+    runScene("rainbow", 1, 60, 10000000, false);
+    runScene("solid", 0, 50, 10000000, true);
+    runScene("sparkle", 5, 80, 10000000, false);
+
+    // Top rate against the smallest share
+    runCommand("preview fps 10");
+    runCommand("preview share 1");
+    runScene("capped", 5, 100, 10000000, false);
+
+    check(testDisplay.broken == 0, "every preview decodes");
+    printf("   display: %lu applied (%lu key), %lu waited for a key frame\n", testDisplay.applied,
+           testDisplay.keyframes, testDisplay.waited);
+    printf("## %d failure%s\n", testFailures, testFailures == 1 ? "" : "s");
+    return testFailures ? 1 : 0;
+}
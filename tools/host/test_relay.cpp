@@ -0,0 +1,398 @@
+/**
+ * @file      test_relay.cpp
+ * @brief     Host test: the relay mesh across several receivers (Recevier.ino, RELAY MESH)
+ *
+ * Every receiver is the firmware in its own process, forked before setup()
+ * so each has its own state and clock. This process is the medium: all
+ * receivers advance in 1 ms steps, and what one broadcasts in a step is
+ * delivered in the next to the receivers in its range. The controller
+ * reaches only receiver 0. Checks, on the real receivePacket() and
+ * serviceRelay() paths:
+ *   - a line of receivers: group commands reach as far as the TTL allows
+ *     and no further, and a longer TTL reaches the end
+ *   - a cluster in range of each other: every receiver applies every
+ *     command, and relays heard from neighbours suppress some of its own
+ *   - only group show traffic is carried: broadcasts without a group are
+ *     not relayed, bridge records inside a relay are refused, and a relay
+ *     naming the controller as origin for a unicast is not applied
+ *
+ * Collisions are not modelled; a step is one 1 ms slot in which every
+ * transmission is heard.
+ *
+ * Build:  g++ -std=gnu++17 -O1 -Wall -Wextra -pthread -Itools/host -o test_relay \
+ *             tools/host/test_relay.cpp tools/host/host_runtime.cpp
+ * Run:    ./test_relay
+ */
+
+#include "sketch.h"
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define MESH_STEP_US        1000
+#define MESH_BOOT_US        5000000ULL
+#define MESH_COMMANDS       40
+#define MESH_GROUP          7
+
+static const uint8_t testController[6] = {0x64, 0xE8, 0x33, 0x7A, 0x88, 0x70};
+static int testFailures = 0;
+
+static void check(bool ok, const char* what) {
+    printf("## %s %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) testFailures++;
+}
+
+// What a receiver reports back to the medium
+typedef struct {
+    unsigned long accepted;         // Packets taken for MESH_GROUP
+    unsigned long relayed, suppressed, unicast, refused;
+    unsigned long received[RELAY_MAX_TTL + 1];
+    uint8_t red, green, blue;
+} node_stats_t;
+
+static bool readAll(int fd, void* buffer, size_t length) {
+    uint8_t* at = (uint8_t*)buffer;
+    while (length) {
+        ssize_t got = read(fd, at, length);
+        if (got <= 0) return false;
+        at += got;
+        length -= got;
+    }
+    return true;
+}
+
+static void writeAll(int fd, const void* buffer, size_t length) {
+    const uint8_t* at = (const uint8_t*)buffer;
+    while (length) {
+        ssize_t put = write(fd, at, length);
+        if (put <= 0) _exit(3);
+        at += put;
+        length -= put;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Receiver side: one firmware per process, driven over a socket
+// -----------------------------------------------------------------------------
+static void nodeMain(int fd, uint8_t index) {
+    hostSerialEcho = false;
+    setup();
+    randomSeed(1000 + index);   // Different backoffs on every receiver
+    size_t reported = 0;
+
+    for (;;) {
+        uint8_t op;
+        if (!readAll(fd, &op, 1)) _exit(0);
+
+        if (op == 'S') {
+            uint32_t spanUs;
+            readAll(fd, &spanUs, sizeof(spanUs));
+            hostRunLoop(spanUs);
+            uint16_t count = 0;
+            for (size_t i = reported; i < hostRadioSent.size(); i++) {
+                if (memcmp(hostRadioSent[i].mac, broadcastAddress, 6) == 0) count++;
+            }
+            writeAll(fd, &count, sizeof(count));
+            for (; reported < hostRadioSent.size(); reported++) {
+                const host_packet_t& packet = hostRadioSent[reported];
+                if (memcmp(packet.mac, broadcastAddress, 6) != 0) continue;
+                uint16_t length = packet.data.size();
+                writeAll(fd, &length, sizeof(length));
+                writeAll(fd, packet.data.data(), length);
+            }
+        } else if (op == 'P') {
+            uint8_t src[6];
+            uint16_t length;
+            uint8_t data[ESP_NOW_MAX_DATA_LEN];
+            readAll(fd, src, sizeof(src));
+            readAll(fd, &length, sizeof(length));
+            readAll(fd, data, length);
+            esp_now_recv_info_t info = {src, (uint8_t*)broadcastAddress, nullptr};
+            OnDataRecv(&info, data, length);
+        } else if (op == 'C') {
+            uint16_t length;
+            char text[128] = {0};
+            readAll(fd, &length, sizeof(length));
+            readAll(fd, text, length);
+            runCommand(text);
+        } else if (op == 'T') {
+            node_stats_t stats;
+            memset(&stats, 0, sizeof(stats));
+            group_state_t* group = findGroupState(MESH_GROUP);
+            stats.accepted = group ? group->accepted : 0;
+            stats.relayed = relayStats.relayed;
+            stats.suppressed = relayStats.suppressed;
+            stats.unicast = relayStats.unicast;
+            stats.refused = relayStats.refused;
+            memcpy(stats.received, relayStats.received, sizeof(stats.received));
+            stats.red = zones[0].color.r;
+            stats.green = zones[0].color.g;
+            stats.blue = zones[0].color.b;
+            writeAll(fd, &stats, sizeof(stats));
+        } else {
+            _exit(0);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// The medium
+// -----------------------------------------------------------------------------
+typedef struct {
+    uint8_t mac[6];
+    std::vector<uint8_t> data;
+} air_packet_t;
+
+struct Mesh {
+    std::vector<int> fds;
+    std::vector<pid_t> pids;
+    std::vector<std::vector<bool>> hears;   // hears[a][b]: b receives what a sends
+    std::vector<bool> nearController;
+    std::vector<air_packet_t> inFlight;
+    std::vector<unsigned long> transmissions;
+
+    void start(size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            int pair[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) exit(2);
+            pid_t pid = fork();
+            if (pid == 0) {
+                for (int fd : fds) close(fd);
+                close(pair[0]);
+                nodeMain(pair[1], i);
+            }
+            close(pair[1]);
+            fds.push_back(pair[0]);
+            pids.push_back(pid);
+        }
+        hears.assign(count, std::vector<bool>(count, false));
+        nearController.assign(count, false);
+        nearController[0] = true;
+        transmissions.assign(count, 0);
+        step(MESH_BOOT_US);
+    }
+
+    void stop() {
+        for (int fd : fds) {
+            writeAll(fd, "Q", 1);
+            close(fd);
+        }
+        for (pid_t pid : pids) waitpid(pid, nullptr, 0);
+        fds.clear();
+        pids.clear();
+        inFlight.clear();
+    }
+
+    void line() {
+        for (size_t i = 0; i + 1 < fds.size(); i++) hears[i][i + 1] = hears[i + 1][i] = true;
+    }
+
+    void cluster() {
+        for (size_t a = 0; a < fds.size(); a++) {
+            for (size_t b = 0; b < fds.size(); b++) hears[a][b] = a != b;
+        }
+    }
+
+    void command(const char* text) {
+        for (int fd : fds) {
+            uint16_t length = strlen(text);
+            writeAll(fd, "C", 1);
+            writeAll(fd, &length, sizeof(length));
+            writeAll(fd, text, length);
+        }
+    }
+
+    void deliver(size_t to, const uint8_t* mac, const std::vector<uint8_t>& data) {
+        uint16_t length = data.size();
+        writeAll(fds[to], "P", 1);
+        writeAll(fds[to], mac, 6);
+        writeAll(fds[to], &length, sizeof(length));
+        writeAll(fds[to], data.data(), length);
+    }
+
+    void fromController(const std::vector<uint8_t>& data) {
+        for (size_t i = 0; i < fds.size(); i++) {
+            if (nearController[i]) deliver(i, testController, data);
+        }
+    }
+
+    // Last step's transmissions land, then everyone runs one step
+    void step(uint32_t spanUs) {
+        for (const air_packet_t& packet : inFlight) {
+            size_t from = packet.mac[5];
+            for (size_t to = 0; to < fds.size(); to++) {
+                if (hears[from][to]) deliver(to, packet.mac, packet.data);
+            }
+        }
+        inFlight.clear();
+
+        for (int fd : fds) {
+            writeAll(fd, "S", 1);
+            writeAll(fd, &spanUs, sizeof(spanUs));
+        }
+        for (size_t i = 0; i < fds.size(); i++) {
+            uint16_t count;
+            if (!readAll(fds[i], &count, sizeof(count))) exit(2);
+            for (uint16_t n = 0; n < count; n++) {
+                air_packet_t packet = {{0x02, 0x00, 0x00, 0x00, 0x00, (uint8_t)i}, {}};
+                uint16_t length;
+                readAll(fds[i], &length, sizeof(length));
+                packet.data.resize(length);
+                readAll(fds[i], packet.data.data(), length);
+                inFlight.push_back(packet);
+                transmissions[i]++;
+            }
+        }
+    }
+
+    void run(uint64_t spanUs) {
+        for (uint64_t t = 0; t < spanUs; t += MESH_STEP_US) step(MESH_STEP_US);
+    }
+
+    node_stats_t stats(size_t i) {
+        node_stats_t stats;
+        writeAll(fds[i], "T", 1);
+        if (!readAll(fds[i], &stats, sizeof(stats))) exit(2);
+        return stats;
+    }
+};
+
+static uint16_t testSeq = 1;
+
+// Commands for the group at the frame rate, red counting up from `first`
+static void sendCommands(Mesh& mesh, int count, uint8_t first) {
+    for (int i = 0; i < count; i++) {
+        led_command_t command = {(uint8_t)(first + i), 0x20, 0x40, 0, 0, 100, 0, 50};
+        std::vector<uint8_t> packet = {WIRE_VERSION_2, 0, (uint8_t)testSeq, (uint8_t)(testSeq >> 8),
+                                       WIRE_REC_TARGET, sizeof(wire_target_t), MESH_GROUP,
+                                       WIRE_REC_COMMAND, sizeof(command)};
+        testSeq++;
+        packet.insert(packet.end(), (const uint8_t*)&command, (const uint8_t*)&command + sizeof(command));
+        mesh.fromController(packet);
+        mesh.run(LED_UPDATE_INTERVAL_MS * 1000);
+    }
+    mesh.run(500000);
+}
+
+static void report(Mesh& mesh, const char* name) {
+    printf("   %s:\n", name);
+    for (size_t i = 0; i < mesh.fds.size(); i++) {
+        node_stats_t st = mesh.stats(i);
+        printf("     R%zu  %3lu accepted | %3lu relayed, %3lu suppressed | hops", i, st.accepted, st.relayed,
+               st.suppressed);
+        for (int h = 0; h <= RELAY_DEFAULT_TTL + 1; h++) printf(" %lu", st.received[h]);
+        printf("\n");
+    }
+}
+
+static void testLine() {
+    Mesh mesh;
+    mesh.start(5);
+    mesh.line();
+    mesh.command("group add 7");
+    mesh.command("relay on");
+
+    sendCommands(mesh, MESH_COMMANDS, 0);
+    report(mesh, "line, TTL 3");
+    bool reached = true;
+    for (size_t i = 0; i <= RELAY_DEFAULT_TTL; i++) {
+        node_stats_t st = mesh.stats(i);
+        reached &= st.accepted == MESH_COMMANDS && st.red == MESH_COMMANDS - 1;
+        reached &= st.received[i] == MESH_COMMANDS;
+    }
+    check(reached, "line: receivers within the TTL apply every command, one hop further each");
+    check(mesh.stats(RELAY_DEFAULT_TTL + 1).accepted == 0, "line: nothing past the TTL");
+    check(mesh.stats(RELAY_DEFAULT_TTL).relayed == 0, "line: the last hop the TTL allows doesn't relay");
+
+    mesh.command("relay ttl 4");
+    sendCommands(mesh, MESH_COMMANDS, 100);
+    node_stats_t last = mesh.stats(4);
+    check(last.accepted == MESH_COMMANDS && last.red == 100 + MESH_COMMANDS - 1, "line: TTL 4 reaches the end");
+    mesh.stop();
+}
+
+static void testCluster() {
+    Mesh mesh;
+    mesh.start(6);
+    mesh.cluster();
+    mesh.command("group add 7");
+    mesh.command("relay on");
+
+    sendCommands(mesh, MESH_COMMANDS, 0);
+    report(mesh, "cluster");
+    bool all = true;
+    unsigned long relayed = 0, suppressed = 0;
+    for (size_t i = 0; i < mesh.fds.size(); i++) {
+        node_stats_t st = mesh.stats(i);
+        all &= st.accepted == MESH_COMMANDS && st.red == MESH_COMMANDS - 1;
+        relayed += st.relayed;
+        suppressed += st.suppressed;
+    }
+    printf("     %.1f relays per command for %zu receivers\n", (double)relayed / MESH_COMMANDS, mesh.fds.size());
+    check(all, "cluster: every receiver applies every command");
+    check(suppressed > 0 && relayed < MESH_COMMANDS * mesh.fds.size(), "cluster: neighbours' relays suppress some");
+    mesh.stop();
+}
+
+static void testWhatIsRelayed() {
+    Mesh mesh;
+    mesh.start(2);
+    mesh.line();
+    mesh.command("group add 7");
+    mesh.command("relay on");
+
+    // No target record: R0 takes it, nobody carries it on
+    led_command_t command = {0x11, 0x22, 0x33, 0, 0, 100, 0, 50};
+    std::vector<uint8_t> direct = {WIRE_VERSION_2, 0, (uint8_t)testSeq, (uint8_t)(testSeq >> 8),
+                                   WIRE_REC_COMMAND, sizeof(command)};
+    testSeq++;
+    direct.insert(direct.end(), (const uint8_t*)&command, (const uint8_t*)&command + sizeof(command));
+    mesh.fromController(direct);
+    mesh.run(200000);
+    check(mesh.stats(0).red == 0x11 && mesh.stats(0).relayed == 0 && mesh.stats(1).red != 0x11,
+          "broadcast without a group applied but not relayed");
+
+    // Group command with bridge data: the command crosses, the data doesn't
+    std::vector<uint8_t> mixed = {WIRE_VERSION_2, 0, (uint8_t)testSeq, (uint8_t)(testSeq >> 8),
+                                  WIRE_REC_TARGET, sizeof(wire_target_t), MESH_GROUP,
+                                  WIRE_REC_COMMAND, sizeof(command)};
+    testSeq++;
+    command.red = 0x44;
+    mixed.insert(mixed.end(), (const uint8_t*)&command, (const uint8_t*)&command + sizeof(command));
+    mixed.insert(mixed.end(), {WIRE_REC_SERIAL_DATA, 4, 'd', 'a', 't', 'a'});
+    mesh.fromController(mixed);
+    mesh.run(200000);
+    node_stats_t far = mesh.stats(1);
+    check(far.red == 0x44 && far.refused == 1, "relayed group command applied, its bridge record refused");
+
+    // A neighbour claiming the controller sent a unicast through it
+    std::vector<uint8_t> inner = {WIRE_VERSION_2, 0, (uint8_t)testSeq, (uint8_t)(testSeq >> 8),
+                                  WIRE_REC_COMMAND, sizeof(command)};
+    testSeq++;
+    command.red = 0x55;
+    inner.insert(inner.end(), (const uint8_t*)&command, (const uint8_t*)&command + sizeof(command));
+    relay_header_t relay = {{0}, 2, 1, 0};
+    memcpy(relay.origin, testController, 6);
+    std::vector<uint8_t> forged = {WIRE_VERSION_2, 0, 0x00, 0x10, WIRE_REC_RELAY,
+                                   (uint8_t)(sizeof(relay) + inner.size())};
+    forged.insert(forged.end(), (const uint8_t*)&relay, (const uint8_t*)&relay + sizeof(relay));
+    forged.insert(forged.end(), inner.begin(), inner.end());
+    unsigned long relayedBefore = far.relayed;
+    mesh.inFlight.push_back({{0x02, 0x00, 0x00, 0x00, 0x00, 0x00}, forged});
+    mesh.run(200000);
+    far = mesh.stats(1);
+    check(far.red == 0x44 && far.unicast == 1 && far.relayed == relayedBefore,
+          "relayed unicast neither applied nor passed on");
+    mesh.stop();
+}
+
+int main() {
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+
+    testLine();
+    testCluster();
+    testWhatIsRelayed();
+
+    printf("## %d failure%s\n", testFailures, testFailures == 1 ? "" : "s");
+    return testFailures ? 1 : 0;
+}
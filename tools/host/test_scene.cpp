@@ -0,0 +1,146 @@
+/**
+ * @file      test_scene.cpp
+ * @brief     Host test: instant-on scene restore and coalesced scene writes (Recevier.ino, INSTANT-ON SCENE)
+ *
+ * Boots with a scene already in NVS and checks it is on the LEDs in the
+ * first frame, before the radio is up, with out-of-range values clamped
+ * and no test pattern. Then drives the zones from the radio like a slider
+ * and a live stream would and counts the NVS writes that come of it, and
+ * restores a scene saved for another matrix size.
+ *
+ * Build:  g++ -std=gnu++17 -O1 -Wall -Wextra -pthread -Itools/host -o test_scene \
+ *             tools/host/test_scene.cpp tools/host/host_runtime.cpp
+ * Run:    ./test_scene
+ */
+
+#include "sketch.h"
+
+static const uint8_t testController[6] = {0x64, 0xE8, 0x33, 0x7A, 0x88, 0x70};
+static const uint64_t testBudgetUs = LED_UPDATE_INTERVAL_MS * 1000ULL;
+static int testFailures = 0;
+
+static void check(bool ok, const char* what) {
+    printf("## %s %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) testFailures++;
+}
+
+// One full-matrix zone, written the way writeScene() would
+static void storeScene(uint16_t width, uint16_t height, uint8_t speed, uint8_t red) {
+    scene_t scene;
+    memset(&scene, 0, sizeof(scene));
+    scene.version = SCENE_VERSION;
+    scene.width = width;
+    scene.height = height;
+    scene_zone_t& zone = scene.zones[0];
+    zone.active = 1;
+    zone.shape = ZONE_RECT;
+    zone.w = width;
+    zone.h = height;
+    zone.effect = 0;
+    zone.speed = speed;
+    zone.brightness = 100;
+    zone.color[0] = red;
+    zone.color[1] = 0x34;
+    zone.color[2] = 0x56;
+    zone.frameIntervalMs = LED_UPDATE_INTERVAL_MS;
+
+    Preferences prefs;
+    prefs.begin("scene", false);
+    prefs.putBytes("scene", &scene, sizeof(scene));
+    prefs.end();
+}
+
+static void sendColor(uint8_t red) {
+    led_command_t command = {red, 0x34, 0x56, 0, 0, 100, 0, 50};
+    hostRadioReceive(testController, &command, sizeof(command));
+}
+
+static void testBoot() {
+    storeScene(LED_WIDTH, LED_HEIGHT, 0, 0x12);
+    uint64_t start = hostNowUs();
+    setup();
+    uint64_t setupUs = hostNowUs() - start;
+
+    check(sceneRestored, "saved scene found at boot");
+    check(zones[0].color == CRGB(0x12, 0x34, 0x56), "saved colour restored");
+    check(zones[0].speed == 1, "saved speed 0 clamped to 1");
+    check(hostShows >= 1 && hostOutputs.size() && hostOutputs[0].bytes.size() >= 3 &&
+          hostOutputs[0].bytes[0] + hostOutputs[0].bytes[1] + hostOutputs[0].bytes[2] > 0,
+          "first frame shows the scene");
+    check(!transportReady && sceneStats.firstFrameUs <= sceneStats.setupDoneUs,
+          "first frame before the radio is up");
+    check(statusAnimation == STATUS_ANIM_NONE, "no test pattern over a restored scene");
+    printf("   setup() took %llu us, first frame at %lld us\n", (unsigned long long)setupUs,
+           (long long)sceneStats.firstFrameUs);
+    check(setupUs <= testBudgetUs, "setup() returns within one frame");
+
+    uint64_t worst = 0, deadline = hostNowUs() + 10000000ULL;
+    while (!transportReady && hostNowUs() < deadline) worst = max(worst, hostRunLoop(50000));
+    check(transportReady, "radio comes up in its task");
+    check(esp_now_is_peer_exist(testController), "controller registered as a radio peer");
+    size_t sent = hostRadioSent.size();
+    sendTimePing();
+    check(hostRadioSent.size() == sent + 1, "unicast to the controller goes out");
+    check(worst <= testBudgetUs, "loop keeps frame time while the radio comes up");
+    check(zones[0].color == CRGB(0x12, 0x34, 0x56), "scene still showing once the radio is up");
+}
+
+static void testWrites() {
+    // Settle anything boot left to save
+    hostRunLoop(15000000);
+
+    // A slider: 21 values in one second
+    unsigned long before = sceneStats.writes, nvsBefore = hostNvsWrites;
+    for (int i = 0; i <= 20; i++) {
+        sendColor(0x20 + i);
+        hostRunLoop(50000);
+    }
+    hostRunLoop(SCENE_QUIET_MS * 1000ULL / 2);
+    check(sceneStats.writes == before, "nothing written while the slider moves");
+    hostRunLoop(SCENE_QUIET_MS * 1000ULL * 2);
+    printf("   slider: %lu scene writes, %lu NVS writes\n", sceneStats.writes - before, hostNvsWrites - nvsBefore);
+    check(sceneStats.writes - before == 1 && hostNvsWrites - nvsBefore == 1, "slider drag saved once");
+
+    // Changed and changed back before it settled
+    hostRunLoop(SCENE_MIN_INTERVAL_MS * 1000ULL);
+    before = sceneStats.writes;
+    sendColor(0x99);
+    hostRunLoop(500000);
+    sendColor(0x34);
+    hostRunLoop(SCENE_QUIET_MS * 1000ULL * 2);
+    check(sceneStats.writes == before, "change and change back writes nothing");
+
+    // A live stream changing the colour twice a second for a minute
+    before = sceneStats.writes;
+    for (int i = 0; i < 120; i++) {
+        sendColor(0x40 + (i & 0x3F));
+        hostRunLoop(500000);
+    }
+    unsigned long streamed = sceneStats.writes - before;
+    printf("   stream: %lu scene writes in 60 s\n", streamed);
+    check(streamed >= 1 && streamed <= 60000 / SCENE_MAX_DEFER_MS + 1,
+          "stream saved at most once per SCENE_MAX_DEFER_MS");
+}
+
+static void testOtherMatrix() {
+    storeScene(LED_WIDTH / 2, LED_HEIGHT, 50, 0x77);
+    hostSerialCapture = true;
+    hostSerialOutput.clear();
+    restoreScene();
+    hostSerialCapture = false;
+    check(hostSerialOutput.find("zones reset") != std::string::npos, "scene for another matrix size reported");
+    check(zones[0].active && zones[0].pixelCount == logicalLedCount, "its zone shape not used");
+    check(zones[0].color == CRGB(0x77, 0x34, 0x56), "its effect settings still restored");
+}
+
+int main() {
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    hostSerialEcho = false;
+
+    testBoot();
+    testWrites();
+    testOtherMatrix();
+
+    printf("## %d failure%s\n", testFailures, testFailures == 1 ? "" : "s");
+    return testFailures ? 1 : 0;
+}
@@ -0,0 +1,639 @@
+/**
+ * @file      load_gen.cpp
+ * @brief     Linux controller load generator for the UDP transport (Recevier.ino, TRANSPORT)
+ *
+ * Speaks wire protocol v2 to a receiver built with TRANSPORT_UDP 1 and
+ * replays a scripted scenario at a fixed rate. Every command goes out under
+ * a state version, and the receiver's acks give end-to-end latency; the
+ * latest unacked version is retransmitted like the real controller does.
+ * Time pings are answered so the receiver's staleness stats work too, and
+ * a telemetry report is requested at the end.
+ *
+ * Build:  g++ -O2 -std=c++17 -o load_gen tools/load_gen.cpp
+ * Run:    ./load_gen [options]
+ *           --host <ip>         Receiver address (default 127.0.0.1)
+ *           --port <n>          UDP port (default 4210)
+ *           --scenario <name>   slider | flips | stream | mixed | live | triggers (default slider)
+ *           --rate <hz>         Commands or frames per second (default 200)
+ *           --seconds <n>       Run time (default 10)
+ *           --leds <n>          Frame size for stream scenarios (default 256)
+ *           --jitter <ms>       live: delay each sample by up to this much, reordering some
+ *           --loss <pct>        live: drop this share of samples
+ *           --preview <fps>     Ask for the receiver's framebuffer preview during the run
+ *           --echo              Be a minimal receiver instead, for a one-machine dry run
+ *
+ * Prints sent/acked/superseded/lost counts, ack latency percentiles and the
+ * receiver's own counters. The live scenario sends timestamped slider
+ * samples instead of versioned commands; try --rate 25 with some jitter
+ * and loss, and watch the receiver's 'live' command. The triggers scenario
+ * fires the default trigger events in turn, each cue sent twice; the
+ * receiver's 'triggers' command shows the duplicates it dropped and its
+ * trigger-to-show latency. With --preview the previews are decoded as the
+ * controller's display would, and the last one is drawn in ASCII.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <arpa/inet.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <netinet/in.h>
+#include <poll.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+// Keep in step with the firmware
+#define WIRE_VERSION_2           0xE2
+#define WIRE_REC_COMMAND         0x01
+#define WIRE_REC_FRAME_FRAGMENT  0x03
+#define WIRE_REC_TIME_PING       0x06
+#define WIRE_REC_TIME_PONG       0x07
+#define WIRE_REC_STATE_VERSION   0x09
+#define WIRE_REC_STATE_HEARTBEAT 0x0A
+#define WIRE_REC_STATE_ACK       0x0B
+#define WIRE_REC_TELEMETRY       0x11
+#define WIRE_REC_TELEMETRY_REQ   0x12
+#define WIRE_REC_LIVE_SAMPLE     0x15
+#define WIRE_REC_TRIGGER         0x16
+#define WIRE_REC_PREVIEW         0x17
+#define WIRE_REC_PREVIEW_CONFIG  0x18
+#define PREVIEW_FLAG_KEYFRAME    0x01
+#define PREVIEW_HEADER_BYTES     7
+#define TRIGGER_COPIES           2
+#define FRAME_CODEC_RAW          0
+#define TELEMETRY_FLAG_KEYFRAME  0x01
+#define MAX_PACKET               250
+#define FRAGMENT_PAYLOAD_MAX     (MAX_PACKET - 4 - 2 - 11)
+
+// Controller behaviour
+#define RETRANSMIT_MS            20    // Resend the latest version until acked
+#define HEARTBEAT_MS             500
+#define CONNECT_TIMEOUT_MS       5000  // Receiver pairs the first sender it hears
+#define DRAIN_MS                 500   // Wait for late acks before reporting
+
+static const char* telemetryNames[] = {
+    "fps x10", "render p50 us", "render p95 us", "show p50 us", "show p95 us", "show max us",
+    "commands", "dropped", "coalesced", "free heap", "min heap", "rssi", "current mA", "uptime s",
+    "shown fps x10"
+};
+
+static int sock = -1;
+static sockaddr_in peer;
+static bool peerKnown = false;
+static uint16_t wireSeq = 0;
+
+static int64_t nowUs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+struct Packet {
+    uint8_t data[MAX_PACKET];
+    size_t len = 0;
+
+    Packet() {
+        data[0] = WIRE_VERSION_2;
+        data[1] = 0;
+        memcpy(data + 2, &wireSeq, 2);
+        wireSeq++;
+        len = 4;
+    }
+
+    void append(uint8_t type, const void* value, uint8_t length) {
+        data[len++] = type;
+        data[len++] = length;
+        if (length) memcpy(data + len, value, length);
+        len += length;
+    }
+
+    // The receiver treats 8-byte packets as legacy commands
+    void send() {
+        if (len == 8) append(0x00, nullptr, 0);
+        sendto(sock, data, len, 0, (const sockaddr*)&peer, sizeof(peer));
+    }
+};
+
+static void putU16(uint8_t* p, uint16_t v) { memcpy(p, &v, 2); }
+static void putU32(uint8_t* p, uint32_t v) { memcpy(p, &v, 4); }
+
+static const uint8_t* getVarint(const uint8_t* p, const uint8_t* end, uint32_t* value) {
+    *value = 0;
+    for (int shift = 0; p < end && shift < 35; shift += 7) {
+        *value |= (uint32_t)(*p & 0x7F) << shift;
+        if (!(*p++ & 0x80)) return p;
+    }
+    return nullptr;
+}
+
+// -----------------------------------------------------------------------------
+// Controller side
+// -----------------------------------------------------------------------------
+struct Controller {
+    uint16_t version = 0;
+    uint16_t acked = 0;
+    bool anyAck = false;
+    uint8_t lastCommand[8] = {0};
+    int64_t lastSendUs = 0;
+    std::map<uint16_t, int64_t> outstanding;   // Version -> first send time
+    std::vector<double> latenciesMs;
+    long sent = 0, retransmits = 0, superseded = 0, acks = 0, pongs = 0;
+    long frames = 0, fragments = 0, bytes = 0;
+    long liveSamples = 0, liveDropped = 0, liveReordered = 0;
+    long triggers = 0;
+    uint8_t cue = 0;
+    std::multimap<int64_t, std::vector<uint8_t>> liveDelayed;   // Send time -> record
+    std::mt19937 rng{1};
+    bool telemetryWanted = false, telemetryReceived = false;
+    std::vector<uint8_t> preview;               // RGB332, as the display would hold it
+    int previewWidth = 0, previewHeight = 0;
+    uint16_t previewFrame = 0;
+    bool previewValid = false;
+    long previewKeys = 0, previewDeltas = 0, previewOutOfSync = 0, previewBytes = 0;
+
+    void sendState(bool retransmit) {
+        Packet packet;
+        uint8_t state[6];
+        putU16(state, version);
+        putU32(state + 2, (uint32_t)(outstanding.count(version) ? outstanding[version] / 1000 : nowUs() / 1000));
+        packet.append(WIRE_REC_STATE_VERSION, state, sizeof(state));
+        packet.append(WIRE_REC_COMMAND, lastCommand, sizeof(lastCommand));
+        packet.send();
+        bytes += packet.len;
+        lastSendUs = nowUs();
+        if (retransmit) retransmits++;
+    }
+
+    void command(const uint8_t* cmd) {
+        memcpy(lastCommand, cmd, 8);
+        version++;
+        outstanding[version] = nowUs();
+        sent++;
+        sendState(false);
+    }
+
+    void heartbeat() {
+        Packet packet;
+        uint8_t beat[2];
+        putU16(beat, version);
+        packet.append(WIRE_REC_STATE_HEARTBEAT, beat, sizeof(beat));
+        packet.send();
+        lastSendUs = nowUs();
+    }
+
+    void frame(uint16_t frameSeq, int leds) {
+        int length = leds * 3;
+        int count = (length + FRAGMENT_PAYLOAD_MAX - 1) / FRAGMENT_PAYLOAD_MAX;
+        for (int i = 0; i < count; i++) {
+            int offset = i * FRAGMENT_PAYLOAD_MAX;
+            int slice = std::min(FRAGMENT_PAYLOAD_MAX, length - offset);
+            uint8_t record[11 + FRAGMENT_PAYLOAD_MAX];
+            record[0] = FRAME_CODEC_RAW;
+            putU16(record + 1, frameSeq);
+            putU16(record + 3, 0);
+            record[5] = i;
+            record[6] = count;
+            putU16(record + 7, length);
+            putU16(record + 9, offset);
+            for (int b = 0; b < slice; b++) record[11 + b] = (uint8_t)(frameSeq + offset + b);
+
+            Packet packet;
+            packet.append(WIRE_REC_FRAME_FRAGMENT, record, 11 + slice);
+            packet.send();
+            bytes += packet.len;
+            fragments++;
+        }
+        frames++;
+    }
+
+    // Stamped now on the shared clock (ours, via the pongs), sent after a random delay
+    void live(const uint8_t* values, double jitterMs, double lossPct) {
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        std::vector<uint8_t> record(11);
+        record[0] = 0xFF;                       // Every zone
+        putU32(record.data() + 1, (uint32_t)(nowUs() / 1000));
+        memcpy(record.data() + 5, values, 6);
+        liveSamples++;
+        if (uniform(rng) * 100 < lossPct) {
+            liveDropped++;
+            return;
+        }
+        int64_t sendAt = nowUs() + (int64_t)(uniform(rng) * jitterMs * 1000);
+        if (!liveDelayed.empty() && sendAt < liveDelayed.rbegin()->first) liveReordered++;
+        liveDelayed.emplace(sendAt, record);
+    }
+
+    void sendDueLive() {
+        while (!liveDelayed.empty() && liveDelayed.begin()->first <= nowUs()) {
+            Packet packet;
+            packet.append(WIRE_REC_LIVE_SAMPLE, liveDelayed.begin()->second.data(), 11);
+            packet.send();
+            bytes += packet.len;
+            liveDelayed.erase(liveDelayed.begin());
+        }
+    }
+
+    // Every zone; the copies share a cue so the receiver fires once
+    void trigger(uint8_t event, uint8_t red, uint8_t green, uint8_t blue) {
+        cue = cue == 255 ? 1 : cue + 1;
+        uint8_t record[7] = {event, 0xFF, cue, red, green, blue, 255};
+        for (int copy = 0; copy < TRIGGER_COPIES; copy++) {
+            Packet packet;
+            packet.append(WIRE_REC_TRIGGER, record, sizeof(record));
+            packet.send();
+            bytes += packet.len;
+        }
+        triggers++;
+    }
+
+    void requestTelemetry() {
+        telemetryWanted = true;
+        Packet packet;
+        packet.append(WIRE_REC_TELEMETRY_REQ, nullptr, 0);
+        packet.send();
+    }
+
+    // fps 0 turns it off; every config also gets a key frame
+    void configurePreview(uint8_t fps) {
+        uint8_t config[3] = {fps, 0, 0};
+        Packet packet;
+        packet.append(WIRE_REC_PREVIEW_CONFIG, config, sizeof(config));
+        packet.send();
+    }
+
+    void handlePreview(const uint8_t* value, uint8_t length) {
+        uint16_t frame, base;
+        memcpy(&frame, value, 2);
+        memcpy(&base, value + 2, 2);
+        bool key = value[4] & PREVIEW_FLAG_KEYFRAME;
+        int width = value[5], height = value[6];
+        previewBytes += length;
+        if (!key && (!previewValid || base != previewFrame || width != previewWidth || height != previewHeight)) {
+            previewOutOfSync++;
+            return;
+        }
+
+        // Zero runs keep the base (black on a key frame), literals XOR onto it
+        std::vector<uint8_t> next = key ? std::vector<uint8_t>(width * height, 0) : preview;
+        const uint8_t* p = value + PREVIEW_HEADER_BYTES;
+        const uint8_t* end = value + length;
+        size_t pos = 0;
+        while (p < end && pos < next.size()) {
+            uint8_t control = *p++;
+            size_t run = (control & 0x7F) + 1;
+            if (!(control & 0x80)) {
+                pos += run;
+                continue;
+            }
+            for (size_t i = 0; i < run && p < end && pos < next.size(); i++) next[pos++] ^= *p++;
+        }
+        if (pos != next.size()) {
+            previewOutOfSync++;
+            return;
+        }
+        preview = next;
+        previewWidth = width;
+        previewHeight = height;
+        previewFrame = frame;
+        previewValid = true;
+        if (key) previewKeys++;
+        else previewDeltas++;
+    }
+
+    void printPreview() {
+        static const char ramp[] = " .:-=+*#%@";
+        for (int y = 0; y < previewHeight; y++) {
+            printf("    |");
+            for (int x = 0; x < previewWidth; x++) {
+                uint8_t v = preview[y * previewWidth + x];
+                int luma = (2 * (v >> 5) * 255 / 7 + 5 * ((v >> 2) & 7) * 255 / 7 + (v & 3) * 255 / 3) / 8;
+                putchar(ramp[luma * 10 / 256]);
+            }
+            printf("|\n");
+        }
+    }
+
+    void handleAck(uint16_t ackVersion) {
+        acks++;
+        anyAck = true;
+        acked = ackVersion;
+        int64_t now = nowUs();
+        for (auto it = outstanding.begin(); it != outstanding.end();) {
+            if ((int16_t)(it->first - ackVersion) > 0) {
+                ++it;
+                continue;
+            }
+            if (it->first == ackVersion) {
+                latenciesMs.push_back((now - it->second) / 1000.0);
+            } else {
+                superseded++;
+            }
+            it = outstanding.erase(it);
+        }
+    }
+
+    void handleTelemetry(const uint8_t* p, uint8_t length) {
+        const uint8_t* end = p + length;
+        uint8_t flags = *p++;
+        uint32_t seq, count;
+        if (!(p = getVarint(p, end, &seq)) || p >= end) return;
+        count = *p++;
+        printf("\nReceiver telemetry #%u%s:\n", seq, flags & TELEMETRY_FLAG_KEYFRAME ? "" : " (delta)");
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t raw;
+            if (!(p = getVarint(p, end, &raw))) break;
+            int32_t value = (int32_t)(raw >> 1) ^ -(int32_t)(raw & 1);
+            const char* name = i < sizeof(telemetryNames) / sizeof(telemetryNames[0]) ? telemetryNames[i] : "?";
+            printf("  %-16s %d\n", name, value);
+        }
+        telemetryReceived = true;
+    }
+
+    // Answers pings and collects acks; returns after timeoutMs or the first packet
+    void pollOnce(int timeoutMs) {
+        pollfd pfd = {sock, POLLIN, 0};
+        if (poll(&pfd, 1, timeoutMs) <= 0) return;
+
+        uint8_t buf[MAX_PACKET];
+        sockaddr_in from;
+        socklen_t fromLen = sizeof(from);
+        int64_t t2 = nowUs();
+        ssize_t n = recvfrom(sock, buf, sizeof(buf), 0, (sockaddr*)&from, &fromLen);
+        if (n < 4 || buf[0] != WIRE_VERSION_2) return;
+
+        for (ssize_t off = 4; off + 2 <= n;) {
+            uint8_t type = buf[off], length = buf[off + 1];
+            const uint8_t* value = buf + off + 2;
+            if (off + 2 + length > n) break;
+            off += 2 + length;
+
+            if (type == WIRE_REC_STATE_ACK && length >= 2) {
+                uint16_t v;
+                memcpy(&v, value, 2);
+                handleAck(v);
+            } else if (type == WIRE_REC_TIME_PING && length >= 8) {
+                uint8_t pong[24];
+                memcpy(pong, value, 8);
+                memcpy(pong + 8, &t2, 8);
+                int64_t t3 = nowUs();
+                memcpy(pong + 16, &t3, 8);
+                Packet packet;
+                packet.append(WIRE_REC_TIME_PONG, pong, sizeof(pong));
+                packet.send();
+                pongs++;
+            } else if (type == WIRE_REC_TELEMETRY && length >= 3 && telemetryWanted) {
+                handleTelemetry(value, length);
+            } else if (type == WIRE_REC_PREVIEW && length >= PREVIEW_HEADER_BYTES) {
+                handlePreview(value, length);
+            }
+        }
+    }
+
+    void service() {
+        pollOnce(0);
+        sendDueLive();
+        int64_t now = nowUs();
+        bool unacked = (int16_t)(version - acked) > 0;
+        if (unacked && now - lastSendUs > RETRANSMIT_MS * 1000) sendState(true);
+        else if (!unacked && now - lastSendUs > HEARTBEAT_MS * 1000) heartbeat();
+    }
+};
+
+static void fillCommand(uint8_t* cmd, int r, int g, int b, int brightness, int effect, int speed) {
+    cmd[0] = r; cmd[1] = g; cmd[2] = b; cmd[3] = 0; cmd[4] = 0;
+    cmd[5] = brightness; cmd[6] = effect; cmd[7] = speed;
+}
+
+static int runController(const std::string& scenario, double rate, double seconds, int leds,
+                         double jitterMs, double lossPct, int previewFps) {
+    Controller c;
+    uint8_t cmd[8];
+
+    // The receiver pairs the first unknown sender, then it has to win arbitration
+    printf("Connecting to %s:%d...\n", inet_ntoa(peer.sin_addr), ntohs(peer.sin_port));
+    fillCommand(cmd, 255, 255, 255, 64, 0, 50);
+    int64_t start = nowUs();
+    c.command(cmd);
+    while (!c.anyAck) {
+        if (nowUs() - start > CONNECT_TIMEOUT_MS * 1000) {
+            printf("No ack from the receiver (is it built with TRANSPORT_UDP and paired?)\n");
+            return 1;
+        }
+        c.pollOnce(10);
+        if (nowUs() - c.lastSendUs > 100000) c.sendState(false);
+    }
+    printf("Connected after %.0f ms\n", (nowUs() - start) / 1000.0);
+    // A restarted run reuses the receiver's peer slot; carry on from its version
+    c.version = c.acked;
+    c.outstanding.clear();
+    c.latenciesMs.clear();
+    c.sent = c.retransmits = c.superseded = c.acks = c.bytes = 0;
+    if (previewFps) c.configurePreview(previewFps);
+
+    int64_t periodUs = (int64_t)(1e6 / rate);
+    int64_t begin = nowUs(), next = begin;
+    long tick = 0;
+    uint16_t frameSeq = 0;
+    while (nowUs() - begin < seconds * 1e6) {
+        if (nowUs() >= next) {
+            if (scenario == "slider" || (scenario == "mixed" && tick % 4 == 0)) {
+                // Brightness swept up and down, like a finger on a slider
+                int phase = (tick / (scenario == "mixed" ? 4 : 1)) % 510;
+                fillCommand(cmd, 255, 120, 40, phase < 255 ? phase : 509 - phase, 0, 50);
+                c.command(cmd);
+            }
+            if (scenario == "flips") {
+                fillCommand(cmd, tick * 37, tick * 91, tick * 13, 128, tick % 7, 50);
+                c.command(cmd);
+            }
+            if (scenario == "stream" || scenario == "mixed") {
+                c.frame(frameSeq++, leds);
+            }
+            if (scenario == "live") {
+                // Brightness and a red/blue cross-fade on a 4 s triangle
+                double t = fmod((nowUs() - begin) / 1e6, 4.0) / 2.0;
+                double x = t < 1.0 ? t : 2.0 - t;
+                uint8_t values[6] = {(uint8_t)(255 * x), 60, (uint8_t)(255 * (1 - x)), 0, 0,
+                                     (uint8_t)(1 + 99 * x)};
+                c.live(values, jitterMs, lossPct);
+            }
+            if (scenario == "triggers") {
+                c.trigger(tick % 7, tick * 53, tick * 101, tick * 29);
+            }
+            tick++;
+            next += periodUs;
+        }
+        c.service();
+        int64_t wait = next - nowUs();
+        if (wait > 1000) c.pollOnce(1);
+    }
+    double elapsed = (nowUs() - begin) / 1e6;
+
+    int64_t drainStart = nowUs();
+    while (nowUs() - drainStart < DRAIN_MS * 1000) c.service();
+    if (previewFps) c.configurePreview(0);
+    c.requestTelemetry();
+    drainStart = nowUs();
+    while (!c.telemetryReceived && nowUs() - drainStart < DRAIN_MS * 1000) c.pollOnce(10);
+
+    printf("\nScenario %s at %.0f Hz for %.1f s\n", scenario.c_str(), rate, elapsed);
+    printf("  Wire:        %ld bytes, %.1f KB/s\n", c.bytes, c.bytes / 1024.0 / elapsed);
+    if (c.sent) {
+        std::vector<double>& l = c.latenciesMs;
+        std::sort(l.begin(), l.end());
+        auto pct = [&](double p) { return l.empty() ? 0.0 : l[std::min(l.size() - 1, (size_t)(l.size() * p))]; };
+        printf("  Commands:    %ld sent (%.0f/s), %ld retransmits\n", c.sent, c.sent / elapsed, c.retransmits);
+        printf("  Acked:       %zu exactly, %ld superseded by a newer version, %zu never acked\n",
+               l.size(), c.superseded, c.outstanding.size());
+        printf("  Latency ms:  p50 %.2f  p95 %.2f  p99 %.2f  max %.2f\n",
+               pct(0.50), pct(0.95), pct(0.99), l.empty() ? 0.0 : l.back());
+    }
+    if (c.frames) {
+        printf("  Frames:      %ld sent (%.0f/s) in %ld fragments\n", c.frames, c.frames / elapsed, c.fragments);
+    }
+    if (c.triggers) {
+        printf("  Triggers:    %ld cues (%.0f/s), %d copies each\n", c.triggers, c.triggers / elapsed,
+               TRIGGER_COPIES);
+    }
+    if (c.liveSamples) {
+        printf("  Live:        %ld samples (%.0f/s), %ld dropped, %ld reordered by jitter\n",
+               c.liveSamples, c.liveSamples / elapsed, c.liveDropped, c.liveReordered);
+    }
+    if (previewFps) {
+        long previews = c.previewKeys + c.previewDeltas;
+        printf("  Preview:     %ld shown (%.1f/s), %ld key, %ld deltas, %ld out of sync | %ld bytes, %.0f B/s\n",
+               previews, previews / elapsed, c.previewKeys, c.previewDeltas, c.previewOutOfSync,
+               c.previewBytes, c.previewBytes / elapsed);
+        if (c.previewValid) c.printPreview();
+    }
+    printf("  Time pongs:  %ld\n", c.pongs);
+    if (!c.telemetryReceived) printf("  No telemetry reply\n");
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+// Echo receiver: acks the newest version once per 5 ms "loop", counts
+// commands and frames. Checks the tool and the host's UDP path, not the firmware.
+// -----------------------------------------------------------------------------
+static int runEcho() {
+    printf("Echo receiver on port %d\n", ntohs(peer.sin_port));
+    uint16_t applied = 0;
+    bool ackDue = false;
+    long commands = 0, fragments = 0;
+    int64_t lastLoop = nowUs(), started = nowUs();
+
+    for (;;) {
+        pollfd pfd = {sock, POLLIN, 0};
+        if (poll(&pfd, 1, 1) > 0) {
+            uint8_t buf[MAX_PACKET];
+            socklen_t fromLen = sizeof(peer);
+            ssize_t n = recvfrom(sock, buf, sizeof(buf), 0, (sockaddr*)&peer, &fromLen);
+            peerKnown = true;
+            if (n < 4 || buf[0] != WIRE_VERSION_2) continue;
+            bool skip = false;
+            for (ssize_t off = 4; off + 2 <= n;) {
+                uint8_t type = buf[off], length = buf[off + 1];
+                const uint8_t* value = buf + off + 2;
+                if (off + 2 + length > n) break;
+                off += 2 + length;
+                if (type == WIRE_REC_STATE_VERSION && length >= 2) {
+                    uint16_t v;
+                    memcpy(&v, value, 2);
+                    skip = (int16_t)(v - applied) <= 0 && commands;
+                    if (!skip) applied = v;
+                    ackDue = true;
+                } else if (type == WIRE_REC_COMMAND && !skip) {
+                    commands++;
+                } else if (type == WIRE_REC_FRAME_FRAGMENT) {
+                    fragments++;
+                } else if (type == WIRE_REC_TELEMETRY_REQ) {
+                    // Keyframe with only the command counter filled in
+                    uint8_t report[32], *p = report;
+                    *p++ = TELEMETRY_FLAG_KEYFRAME;
+                    *p++ = 0;
+                    *p++ = 14;
+                    for (int i = 0; i < 14; i++) {
+                        uint32_t v = i == 6 ? (uint32_t)commands << 1 :
+                                     i == 13 ? (uint32_t)((nowUs() - started) / 1000000) << 1 : 0;
+                        while (v >= 0x80) { *p++ = (v & 0x7F) | 0x80; v >>= 7; }
+                        *p++ = v;
+                    }
+                    Packet packet;
+                    packet.append(WIRE_REC_TELEMETRY, report, p - report);
+                    packet.send();
+                    printf("Telemetry requested: %ld commands, %ld fragments so far\n", commands, fragments);
+                }
+            }
+        }
+        if (peerKnown && ackDue && nowUs() - lastLoop >= 5000) {
+            Packet packet;
+            uint8_t ack[2];
+            putU16(ack, applied);
+            packet.append(WIRE_REC_STATE_ACK, ack, sizeof(ack));
+            packet.send();
+            ackDue = false;
+        }
+        if (nowUs() - lastLoop >= 5000) lastLoop = nowUs();
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string host = "127.0.0.1", scenario = "slider";
+    int port = 4210, leds = 256;
+    double rate = 200, seconds = 10, jitterMs = 0, lossPct = 0;
+    int previewFps = 0;
+    bool echo = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--host" && hasValue) host = argv[++i];
+        else if (arg == "--port" && hasValue) port = atoi(argv[++i]);
+        else if (arg == "--scenario" && hasValue) scenario = argv[++i];
+        else if (arg == "--rate" && hasValue) rate = atof(argv[++i]);
+        else if (arg == "--seconds" && hasValue) seconds = atof(argv[++i]);
+        else if (arg == "--leds" && hasValue) leds = atoi(argv[++i]);
+        else if (arg == "--jitter" && hasValue) jitterMs = atof(argv[++i]);
+        else if (arg == "--loss" && hasValue) lossPct = atof(argv[++i]);
+        else if (arg == "--preview" && hasValue) previewFps = atoi(argv[++i]);
+        else if (arg == "--echo") echo = true;
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+    if (scenario != "slider" && scenario != "flips" && scenario != "stream" && scenario != "mixed" &&
+        scenario != "live" && scenario != "triggers") {
+        fprintf(stderr, "Unknown scenario %s\n", scenario.c_str());
+        return 2;
+    }
+    if (rate <= 0 || leds <= 0 || leds * 3 > 32 * FRAGMENT_PAYLOAD_MAX || previewFps < 0 || previewFps > 255) {
+        fprintf(stderr, "Bad --rate, --leds or --preview\n");
+        return 2;
+    }
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&peer, 0, sizeof(peer));
+    peer.sin_family = AF_INET;
+    peer.sin_port = htons(port);
+    if (echo) {
+        peer.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(sock, (const sockaddr*)&peer, sizeof(peer)) < 0) {
+            perror("bind");
+            return 1;
+        }
+        return runEcho();
+    }
+    if (inet_aton(host.c_str(), &peer.sin_addr) == 0) {
+        fprintf(stderr, "Bad host %s\n", host.c_str());
+        return 2;
+    }
+    return runController(scenario, rate, seconds, leds, jitterMs, lossPct, previewFps);
+}
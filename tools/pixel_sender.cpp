@@ -0,0 +1,275 @@
+/**
+ * @file      pixel_sender.cpp
+ * @brief     E1.31 / Art-Net / DDP test sender for the receiver (Recevier.ino, UDP PIXEL INPUT)
+ *
+ * Plays a moving test pattern as a lighting desk would, with optional
+ * packet loss, duplication and reordering to exercise the receiver's
+ * sequence checks. Run two instances with different --priority or --cid
+ * values to check source merging.
+ *
+ * Build:  g++ -O2 -std=c++17 -o pixel_sender tools/pixel_sender.cpp
+ * Run:    ./pixel_sender [options]
+ *           --proto <name>      sacn | artnet | ddp (default sacn)
+ *           --host <ip>         Receiver, or "multicast" for sACN 239.255.x.y (default 127.0.0.1)
+ *           --fps <n>           Frames per second (default 40)
+ *           --seconds <n>       Run time (default 5)
+ *           --leds <n>          Pixels to send (default 256)
+ *           --priority <n>      sACN priority, 0-200 (default 100)
+ *           --cid <n>           Seed for the sACN source CID (default 1)
+ *           --color <r,g,b>     Solid colour instead of the pattern
+ *           --loss <pct>        Drop packets
+ *           --dup <pct>         Send packets twice
+ *           --reorder <pct>     Hold a packet back and send it after the next one
+ *           --terminate         Send E1.31 stream-terminated packets at the end
+ */
+
+#include <arpa/inet.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <netinet/in.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+// Keep in step with the firmware
+#define PIXEL_UNIVERSE_START     1
+#define PIXEL_UNIVERSE_CHANNELS  510
+#define SACN_PORT                5568
+#define ARTNET_PORT              6454
+#define DDP_PORT                 4048
+#define DDP_CHUNK                1440  // Channel bytes per DDP packet
+#define SACN_OPTION_TERMINATED   0x40
+
+enum Proto { SACN, ARTNET, DDP };
+
+struct Options {
+    Proto proto = SACN;
+    std::string host = "127.0.0.1";
+    double fps = 40, seconds = 5;
+    int leds = 256, priority = 100, cid = 1;
+    int color[3] = {-1, -1, -1};
+    double loss = 0, dup = 0, reorder = 0;
+    bool terminate = false;
+};
+
+static int sock;
+static std::mt19937 rng(1);
+static long sent = 0, dropped = 0, duplicated = 0, reordered = 0;
+static std::vector<uint8_t> heldPacket;
+static sockaddr_in heldTo;
+
+static double percent() { return std::uniform_real_distribution<double>(0, 100)(rng); }
+
+static void rawSend(const std::vector<uint8_t>& p, const sockaddr_in& to) {
+    sendto(sock, p.data(), p.size(), 0, (const sockaddr*)&to, sizeof(to));
+    sent++;
+}
+
+// Applies the impairments, then sends
+static void sendPacket(const std::vector<uint8_t>& p, const sockaddr_in& to, const Options& o) {
+    if (percent() < o.loss) {
+        dropped++;
+        return;
+    }
+    if (heldPacket.empty() && percent() < o.reorder) {
+        heldPacket = p;
+        heldTo = to;
+        reordered++;
+        return;
+    }
+    rawSend(p, to);
+    if (percent() < o.dup) {
+        rawSend(p, to);
+        duplicated++;
+    }
+    if (!heldPacket.empty()) {
+        rawSend(heldPacket, heldTo);
+        heldPacket.clear();
+    }
+}
+
+static sockaddr_in destination(const Options& o, uint16_t port, int universe) {
+    sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(port);
+    if (o.host == "multicast") {
+        to.sin_addr.s_addr = htonl(0xEFFF0000u | universe);
+    } else {
+        inet_aton(o.host.c_str(), &to.sin_addr);
+    }
+    return to;
+}
+
+static std::vector<uint8_t> sacnPacket(const Options& o, int universe, uint8_t seq, const uint8_t* data,
+                                       int length, uint8_t options) {
+    std::vector<uint8_t> p(126 + length, 0);
+    auto flagsLength = [&](int at) {
+        int len = p.size() - at;
+        p[at] = 0x70 | (len >> 8);
+        p[at + 1] = len & 0xFF;
+    };
+    // Root layer
+    p[1] = 0x10;
+    memcpy(&p[4], "ASC-E1.17\0\0\0", 12);
+    flagsLength(16);
+    p[21] = 0x04;
+    for (int i = 0; i < 16; i++) p[22 + i] = (uint8_t)(o.cid * 31 + i * 7);
+    // Framing layer
+    flagsLength(38);
+    p[43] = 0x02;
+    snprintf((char*)&p[44], 64, "pixel_sender %d", o.cid);
+    p[108] = o.priority;
+    p[111] = seq;
+    p[112] = options;
+    p[113] = universe >> 8;
+    p[114] = universe & 0xFF;
+    // DMP layer
+    flagsLength(115);
+    p[117] = 0x02;
+    p[118] = 0xA1;
+    p[122] = 0x01;
+    p[123] = (length + 1) >> 8;
+    p[124] = (length + 1) & 0xFF;
+    memcpy(&p[126], data, length);
+    return p;
+}
+
+static std::vector<uint8_t> artnetPacket(int universe, uint8_t seq, const uint8_t* data, int length) {
+    std::vector<uint8_t> p(18 + length, 0);
+    memcpy(&p[0], "Art-Net", 8);
+    p[9] = 0x50;                    // OpDmx, little endian
+    p[11] = 14;                     // Protocol version
+    p[12] = seq;
+    p[14] = universe & 0xFF;
+    p[15] = (universe >> 8) & 0x7F;
+    p[16] = length >> 8;
+    p[17] = length & 0xFF;
+    memcpy(&p[18], data, length);
+    return p;
+}
+
+static std::vector<uint8_t> ddpPacket(uint8_t seq, uint32_t offset, const uint8_t* data, int length, bool push) {
+    std::vector<uint8_t> p(10 + length, 0);
+    p[0] = 0x40 | (push ? 0x01 : 0);
+    p[1] = seq & 0x0F;
+    p[2] = 0x0B;                    // RGB, 8 bits per channel
+    p[3] = 1;                       // Default output device
+    p[4] = offset >> 24;
+    p[5] = offset >> 16;
+    p[6] = offset >> 8;
+    p[7] = offset;
+    p[8] = length >> 8;
+    p[9] = length & 0xFF;
+    memcpy(&p[10], data, length);
+    return p;
+}
+
+int main(int argc, char** argv) {
+    Options o;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--proto" && hasValue) {
+            std::string name = argv[++i];
+            if (name == "sacn") o.proto = SACN;
+            else if (name == "artnet") o.proto = ARTNET;
+            else if (name == "ddp") o.proto = DDP;
+            else {
+                fprintf(stderr, "Unknown protocol %s\n", name.c_str());
+                return 2;
+            }
+        }
+        else if (arg == "--host" && hasValue) o.host = argv[++i];
+        else if (arg == "--fps" && hasValue) o.fps = atof(argv[++i]);
+        else if (arg == "--seconds" && hasValue) o.seconds = atof(argv[++i]);
+        else if (arg == "--leds" && hasValue) o.leds = atoi(argv[++i]);
+        else if (arg == "--priority" && hasValue) o.priority = atoi(argv[++i]);
+        else if (arg == "--cid" && hasValue) o.cid = atoi(argv[++i]);
+        else if (arg == "--color" && hasValue) sscanf(argv[++i], "%d,%d,%d", &o.color[0], &o.color[1], &o.color[2]);
+        else if (arg == "--loss" && hasValue) o.loss = atof(argv[++i]);
+        else if (arg == "--dup" && hasValue) o.dup = atof(argv[++i]);
+        else if (arg == "--reorder" && hasValue) o.reorder = atof(argv[++i]);
+        else if (arg == "--terminate") o.terminate = true;
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+    if (o.fps <= 0 || o.leds <= 0) {
+        fprintf(stderr, "Bad --fps or --leds\n");
+        return 2;
+    }
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    int one = 1;
+    setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &one, sizeof(one));
+    rng.seed(o.cid);
+
+    int channels = o.leds * 3;
+    int universes = (channels + PIXEL_UNIVERSE_CHANNELS - 1) / PIXEL_UNIVERSE_CHANNELS;
+    std::vector<uint8_t> frame(channels);
+    std::vector<uint8_t> seqs(universes, 0);
+    uint8_t ddpSeq = 0;
+    long frames = (long)(o.fps * o.seconds);
+    const char* names[] = {"sACN", "Art-Net", "DDP"};
+    printf("%s to %s: %d LEDs, %d universe%s, %.0f fps for %.1f s\n", names[o.proto], o.host.c_str(),
+           o.leds, universes, universes == 1 ? "" : "s", o.fps, o.seconds);
+
+    timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (long k = 0; k < frames; k++) {
+        for (int i = 0; i < channels; i++) {
+            frame[i] = o.color[0] >= 0 ? o.color[i % 3] : (uint8_t)(k * 7 + i * 13);
+        }
+
+        if (o.proto == DDP) {
+            ddpSeq = ddpSeq % 15 + 1;
+            for (int offset = 0; offset < channels; offset += DDP_CHUNK) {
+                int length = std::min(DDP_CHUNK, channels - offset);
+                sendPacket(ddpPacket(ddpSeq, offset, &frame[offset], length, offset + length >= channels),
+                           destination(o, DDP_PORT, 0), o);
+            }
+        } else {
+            for (int u = 0; u < universes; u++) {
+                int offset = u * PIXEL_UNIVERSE_CHANNELS;
+                int length = std::min(PIXEL_UNIVERSE_CHANNELS, channels - offset);
+                uint8_t seq = ++seqs[u];
+                if (o.proto == ARTNET && seq == 0) seq = seqs[u] = 1;   // 0 means "no sequence"
+                if (o.proto == SACN) {
+                    int universe = PIXEL_UNIVERSE_START + u;
+                    sendPacket(sacnPacket(o, universe, seq, &frame[offset], length, 0),
+                               destination(o, SACN_PORT, universe), o);
+                } else {
+                    sendPacket(artnetPacket(PIXEL_UNIVERSE_START - 1 + u, seq, &frame[offset], length),
+                               destination(o, ARTNET_PORT, 0), o);
+                }
+            }
+        }
+
+        next.tv_nsec += (long)(1e9 / o.fps);
+        while (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+    }
+
+    if (o.terminate && o.proto == SACN) {
+        for (int u = 0; u < universes; u++) {
+            int universe = PIXEL_UNIVERSE_START + u;
+            for (int r = 0; r < 3; r++) {
+                rawSend(sacnPacket(o, universe, ++seqs[u], frame.data(), 0, SACN_OPTION_TERMINATED),
+                        destination(o, SACN_PORT, universe));
+            }
+        }
+    }
+    printf("%ld frames, %ld packets sent | impairments: %ld dropped, %ld duplicated, %ld reordered\n",
+           frames, sent, dropped, duplicated, reordered);
+    return 0;
+}
@@ -0,0 +1,385 @@
+/**
+ * @file      serial_bridge.cpp
+ * @brief     Controller end of the serial bridge over the UDP transport (Recevier.ino, SERIAL BRIDGE)
+ *
+ * Streams a pseudo-random byte pattern to a receiver built with
+ * TRANSPORT_UDP 1, within the credits the receiver hands out, and takes
+ * whatever comes back from the bridge UART. With the UART's RX tied to its
+ * TX the upstream stream must equal the downstream one byte for byte,
+ * which is checked.
+ *
+ * Build:  g++ -O2 -std=c++17 -o serial_bridge tools/serial_bridge.cpp
+ * Run:    ./serial_bridge [options]
+ *           --host <ip>         Receiver address (default 127.0.0.1)
+ *           --port <n>          UDP port (default 4210)
+ *           --seconds <n>       Sending time (default 10)
+ *           --rate <B/s>        Offered load, 0 = as fast as credits allow (default 0)
+ *           --loss <pct>        Drop this share of packets in each direction
+ *           --no-loopback       Don't compare upstream bytes with what was sent
+ *
+ * Prints throughput each second and totals at the end.
+ */
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <netinet/in.h>
+#include <poll.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+// Keep in step with the firmware
+#define WIRE_VERSION_2           0xE2
+#define WIRE_REC_SERIAL_FRAGMENT 0x13
+#define WIRE_REC_SERIAL_CREDIT   0x14
+#define SERIAL_BRIDGE_MSG_MAX    1024
+#define SERIAL_BRIDGE_FRAG_MAX   224
+#define MAX_PACKET               250
+
+// Controller behaviour
+#define RETRY_MS                 80    // Go back to the oldest unacked message after this
+#define HELLO_MS                 100   // Credit sent until the receiver answers
+#define CONNECT_TIMEOUT_MS       5000
+#define DRAIN_MS                 3000  // Wait for acks and upstream bytes at the end
+#define OUR_FREE_BYTES           8192  // Credit we grant upstream
+
+struct __attribute__((packed)) FragmentHeader {
+    uint16_t session;
+    uint16_t msgSeq;
+    uint8_t fragIndex;
+    uint8_t fragCount;
+    uint16_t msgLength;
+};
+
+struct __attribute__((packed)) Credit {
+    uint16_t session;
+    uint16_t deliveredSeq;
+    uint16_t freeBytes;
+};
+
+struct Message {
+    uint16_t seq;
+    std::vector<uint8_t> bytes;
+    int64_t sentUs;
+};
+
+static int sock = -1;
+static sockaddr_in peer;
+static uint16_t wireSeq = 0;
+static std::mt19937 rng(7);
+static double lossPct = 0;
+static long dropped = 0;
+
+static int64_t nowUs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static bool lose() {
+    if (lossPct <= 0 || std::uniform_real_distribution<double>(0, 100)(rng) >= lossPct) return false;
+    dropped++;
+    return true;
+}
+
+struct Packet {
+    uint8_t data[MAX_PACKET];
+    size_t len = 0;
+
+    Packet() {
+        data[0] = WIRE_VERSION_2;
+        data[1] = 0;
+        memcpy(data + 2, &wireSeq, 2);
+        wireSeq++;
+        len = 4;
+    }
+
+    void append(uint8_t type, const void* value, uint8_t length) {
+        data[len++] = type;
+        data[len++] = length;
+        if (length) memcpy(data + len, value, length);
+        len += length;
+    }
+
+    void send() {
+        if (len == 8) append(0x00, nullptr, 0);   // 8 bytes reads as a legacy command
+        if (lose()) return;
+        sendto(sock, data, len, 0, (const sockaddr*)&peer, sizeof(peer));
+    }
+};
+
+// The byte stream both ends should see
+static uint8_t patternByte(uint64_t index) {
+    uint32_t x = (uint32_t)(index * 2654435761u) ^ (uint32_t)(index >> 7);
+    return (uint8_t)(x >> 13);
+}
+
+struct Bridge {
+    // Downstream sender
+    uint16_t session;
+    uint16_t nextSeq = 0;
+    std::deque<Message> unacked;
+    uint16_t peerFree = 0;
+    uint16_t peerRing = 0;          // Largest free space seen, taken as the ring size
+    bool peerHeard = false;
+    uint64_t offered = 0;           // Pattern bytes handed to messages
+    uint64_t downAcked = 0;
+    long downMessages = 0, downFragments = 0, downRetransmits = 0;
+
+    // Upstream receiver
+    uint16_t upSession = 0;
+    uint16_t upDelivered = 0xFFFF;
+    uint16_t asmSeq = 0, asmLength = 0;
+    uint32_t asmMask = 0;
+    uint8_t assembly[SERIAL_BRIDGE_MSG_MAX];
+    uint64_t upBytes = 0;
+    long upMessages = 0, upDuplicates = 0, upOutOfOrder = 0, mismatches = 0;
+    int64_t firstMismatchAt = -1;
+    bool checkLoopback = true;
+
+    uint32_t outstanding() const {
+        uint32_t total = 0;
+        for (const Message& m : unacked) total += m.bytes.size();
+        return total;
+    }
+
+    void sendCredit() {
+        Credit credit = {upSession, upDelivered, OUR_FREE_BYTES};
+        Packet packet;
+        packet.append(WIRE_REC_SERIAL_CREDIT, &credit, sizeof(credit));
+        packet.send();
+    }
+
+    void sendMessage(Message& m) {
+        uint16_t length = m.bytes.size();
+        uint8_t fragCount = (length + SERIAL_BRIDGE_FRAG_MAX - 1) / SERIAL_BRIDGE_FRAG_MAX;
+        uint8_t record[sizeof(FragmentHeader) + SERIAL_BRIDGE_FRAG_MAX];
+        for (uint8_t i = 0; i < fragCount; i++) {
+            uint16_t offset = i * SERIAL_BRIDGE_FRAG_MAX;
+            uint16_t slice = std::min<uint16_t>(SERIAL_BRIDGE_FRAG_MAX, length - offset);
+            FragmentHeader header = {session, m.seq, i, fragCount, length};
+            memcpy(record, &header, sizeof(header));
+            memcpy(record + sizeof(header), m.bytes.data() + offset, slice);
+            Packet packet;
+            packet.append(WIRE_REC_SERIAL_FRAGMENT, record, sizeof(header) + slice);
+            packet.send();
+            downFragments++;
+        }
+        m.sentUs = nowUs();
+    }
+
+    // New message if the credit and the offered load allow it. Slivers of
+    // credit are left to grow (the receiver credits again once a quarter of
+    // its ring has drained), so messages stay large and the receiver isn't
+    // asked for a credit per handful of bytes.
+    bool sendNext(uint64_t allowedBytes) {
+        uint32_t inFlight = outstanding();
+        if (!peerHeard || peerFree <= inFlight || offered >= allowedBytes) return false;
+        uint32_t length = std::min<uint64_t>({(uint64_t)SERIAL_BRIDGE_MSG_MAX, (uint64_t)(peerFree - inFlight),
+                                              allowedBytes - offered});
+        uint32_t worthSending = std::min<uint32_t>(SERIAL_BRIDGE_MSG_MAX, peerRing / 4);
+        if (length < worthSending && allowedBytes - offered >= worthSending) return false;
+        Message m;
+        m.seq = nextSeq++;
+        for (uint32_t i = 0; i < length; i++) m.bytes.push_back(patternByte(offered + i));
+        offered += length;
+        unacked.push_back(m);
+        sendMessage(unacked.back());
+        downMessages++;
+        return true;
+    }
+
+    void retransmit() {
+        if (unacked.empty() || nowUs() - unacked.front().sentUs < RETRY_MS * 1000) return;
+        for (Message& m : unacked) {
+            sendMessage(m);
+            downRetransmits++;
+        }
+    }
+
+    void handleCredit(const Credit& credit) {
+        peerHeard = true;
+        peerFree = credit.freeBytes;
+        peerRing = std::max(peerRing, peerFree);
+        if (credit.session != session) return;   // Receiver hasn't adopted us yet
+        while (!unacked.empty() && (int16_t)(credit.deliveredSeq - unacked.front().seq) >= 0) {
+            downAcked += unacked.front().bytes.size();
+            unacked.pop_front();
+        }
+    }
+
+    // Mirrors the firmware's downstream assembly
+    void handleFragment(const uint8_t* value, uint8_t length) {
+        FragmentHeader header;
+        memcpy(&header, value, sizeof(header));
+        uint16_t payloadLength = length - sizeof(header);
+        uint32_t offset = header.fragIndex * SERIAL_BRIDGE_FRAG_MAX;
+        if (header.msgLength == 0 || header.msgLength > SERIAL_BRIDGE_MSG_MAX ||
+            header.fragIndex >= header.fragCount || offset + payloadLength > header.msgLength) return;
+
+        if (header.session != upSession) {
+            if (upSession != 0 && header.msgSeq != 0) {
+                upOutOfOrder++;
+                sendCredit();
+                return;
+            }
+            upSession = header.session;
+            upDelivered = header.msgSeq - 1;
+            asmMask = 0;
+        }
+        int16_t ahead = (int16_t)(header.msgSeq - (uint16_t)(upDelivered + 1));
+        if (ahead != 0) {
+            if (ahead < 0) upDuplicates++;
+            else upOutOfOrder++;
+            sendCredit();
+            return;
+        }
+        if (asmMask == 0 || asmSeq != header.msgSeq) {
+            asmSeq = header.msgSeq;
+            asmLength = header.msgLength;
+            asmMask = 0;
+        }
+        memcpy(assembly + offset, value + sizeof(header), payloadLength);
+        asmMask |= 1u << header.fragIndex;
+        if (asmMask != (1u << header.fragCount) - 1) return;
+
+        asmMask = 0;
+        for (uint16_t i = 0; i < asmLength; i++) {
+            if (checkLoopback && assembly[i] != patternByte(upBytes + i)) {
+                if (firstMismatchAt < 0) firstMismatchAt = upBytes + i;
+                mismatches++;
+            }
+        }
+        upBytes += asmLength;
+        upMessages++;
+        upDelivered = header.msgSeq;
+        sendCredit();
+    }
+
+    void poll(int timeoutMs) {
+        pollfd pfd = {sock, POLLIN, 0};
+        if (::poll(&pfd, 1, timeoutMs) <= 0) return;
+        uint8_t buf[MAX_PACKET];
+        ssize_t n;
+        while ((n = recv(sock, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+            if (n < 4 || buf[0] != WIRE_VERSION_2 || lose()) continue;
+            for (ssize_t off = 4; off + 2 <= n;) {
+                uint8_t type = buf[off], length = buf[off + 1];
+                const uint8_t* value = buf + off + 2;
+                if (off + 2 + length > n) break;
+                off += 2 + length;
+                if (type == WIRE_REC_SERIAL_CREDIT && length >= sizeof(Credit)) {
+                    Credit credit;
+                    memcpy(&credit, value, sizeof(credit));
+                    handleCredit(credit);
+                } else if (type == WIRE_REC_SERIAL_FRAGMENT && length > sizeof(FragmentHeader)) {
+                    handleFragment(value, length);
+                }
+            }
+        }
+    }
+};
+
+int main(int argc, char** argv) {
+    std::string host = "127.0.0.1";
+    int port = 4210;
+    double seconds = 10, rate = 0;
+    bool loopback = true;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--host" && hasValue) host = argv[++i];
+        else if (arg == "--port" && hasValue) port = atoi(argv[++i]);
+        else if (arg == "--seconds" && hasValue) seconds = atof(argv[++i]);
+        else if (arg == "--rate" && hasValue) rate = atof(argv[++i]);
+        else if (arg == "--loss" && hasValue) lossPct = atof(argv[++i]);
+        else if (arg == "--no-loopback") loopback = false;
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&peer, 0, sizeof(peer));
+    peer.sin_family = AF_INET;
+    peer.sin_port = htons(port);
+    if (!inet_aton(host.c_str(), &peer.sin_addr)) {
+        fprintf(stderr, "Bad host %s\n", host.c_str());
+        return 2;
+    }
+
+    Bridge b;
+    b.checkLoopback = loopback;
+    std::random_device seed;
+    do {
+        b.session = seed();
+    } while (b.session == 0);
+
+    // An empty credit says hello; the receiver answers with its own
+    printf("Connecting to %s:%d...\n", host.c_str(), port);
+    int64_t start = nowUs(), lastHello = 0;
+    while (!b.peerHeard) {
+        if (nowUs() - start > CONNECT_TIMEOUT_MS * 1000) {
+            printf("No credit from the receiver (is it built with TRANSPORT_UDP and paired?)\n");
+            return 1;
+        }
+        if (nowUs() - lastHello > HELLO_MS * 1000) {
+            b.sendCredit();
+            lastHello = nowUs();
+        }
+        b.poll(10);
+    }
+    printf("Connected after %.0f ms, receiver has %u bytes free\n", (nowUs() - start) / 1000.0, b.peerFree);
+
+    start = nowUs();
+    int64_t end = start + (int64_t)(seconds * 1e6);
+    int64_t lastReport = start;
+    uint64_t lastDown = 0, lastUp = 0;
+    printf("%6s %12s %12s %10s\n", "t (s)", "down B/s", "up B/s", "in flight");
+    for (;;) {
+        int64_t now = nowUs();
+        bool sending = now < end;
+        uint64_t allowed = !sending ? b.offered : rate > 0 ? (uint64_t)((now - start) * rate / 1e6) : UINT64_MAX;
+        while (b.sendNext(allowed)) {
+        }
+        b.retransmit();
+        b.poll(1);
+
+        if (now - lastReport >= 1000000) {
+            double dt = (now - lastReport) / 1e6;
+            printf("%6.1f %12.0f %12.0f %10u\n", (now - start) / 1e6, (b.downAcked - lastDown) / dt,
+                   (b.upBytes - lastUp) / dt, b.outstanding());
+            lastDown = b.downAcked;
+            lastUp = b.upBytes;
+            lastReport = now;
+        }
+        bool drained = b.unacked.empty() && (!loopback || b.upBytes >= b.offered);
+        if (!sending && (drained || now - end > DRAIN_MS * 1000)) break;
+    }
+
+    double elapsed = (nowUs() - start) / 1e6;
+    printf("\nDown: %llu bytes acked in %ld messages (%ld fragments, %ld retransmitted), %.0f B/s\n",
+           (unsigned long long)b.downAcked, b.downMessages, b.downFragments, b.downRetransmits,
+           b.downAcked / elapsed);
+    printf("Up:   %llu bytes in %ld messages, %ld duplicate, %ld out of order, %.0f B/s\n",
+           (unsigned long long)b.upBytes, b.upMessages, b.upDuplicates, b.upOutOfOrder, b.upBytes / elapsed);
+    if (lossPct > 0) printf("Dropped %ld packets on purpose\n", dropped);
+    if (loopback) {
+        if (b.mismatches) {
+            printf("Loopback: %ld bytes differ, first at offset %lld\n", b.mismatches, (long long)b.firstMismatchAt);
+        } else {
+            printf("Loopback: %llu of %llu bytes back, all matching\n",
+                   (unsigned long long)b.upBytes, (unsigned long long)b.offered);
+        }
+    }
+    return b.mismatches || !b.unacked.empty() ? 1 : 0;
+}
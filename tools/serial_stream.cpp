@@ -0,0 +1,309 @@
+/**
+ * @file      serial_stream.cpp
+ * @brief     Binary serial frame streams for the receiver (Recevier.ino, SERIAL FRAME INPUT)
+ *
+ * Generates Adalight, TPM2 and native (COBS + CRC-32) frame streams,
+ * optionally corrupted (bit flips, dropped bytes, inserted junk, truncated
+ * frames), and feeds them to the firmware's own parser, built through the
+ * host harness (tools/host), to check that it resynchronises and how long
+ * that takes at the line rate. Streams can be saved for replay, checked
+ * from a file, or sent to a serial port.
+ *
+ * Build:  g++ -std=gnu++17 -O2 -Wall -Wextra -pthread -Itools/host -o serial_stream \
+ *             tools/serial_stream.cpp tools/host/host_runtime.cpp
+ * Run:    ./serial_stream                                   Self-test table
+ *         ./serial_stream gen <ada|tpm2|native> <frames> [corrupt %] [leds] > s.bin
+ *         ./serial_stream check <ada|tpm2|native> <file> [leds]
+ *         ./serial_stream send <ada|tpm2|native> <tty> [fps] [leds] [baud]
+ *
+ * Frame k carries k in its first two bytes and a pattern derived from k in
+ * the rest, so the checker can tell intact frames from corrupted ones that
+ * slipped through (Adalight and TPM2 have no payload checksum).
+ */
+
+#include "sketch.h"
+
+#include <fcntl.h>
+#include <random>
+#include <termios.h>
+#include <unistd.h>
+
+#define DEFAULT_LEDS             NUM_LEDS
+#define FEED_CHUNK               32    // Bytes per serviceSerialInput() call, about a UART FIFO's worth
+
+enum Proto { ADALIGHT, TPM2, NATIVE };
+
+static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t len) {
+    // Same as esp_rom_crc32_le: reflected 0xEDB88320, inverted in and out
+    crc = ~crc;
+    while (len--) {
+        crc ^= *data++;
+        for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+static std::vector<uint8_t> framePixels(uint32_t k, int leds) {
+    std::vector<uint8_t> px(leds * 3);
+    for (size_t i = 0; i < px.size(); i++) px[i] = (uint8_t)(k * 7 + i * 13);
+    px[0] = k & 0xFF;
+    px[1] = (k >> 8) & 0xFF;
+    return px;
+}
+
+static bool pixelsIntact(const uint8_t* px, int leds) {
+    uint32_t k = px[0] | px[1] << 8;
+    std::vector<uint8_t> want = framePixels(k, leds);
+    // The two index bytes only hold k mod 65536
+    return memcmp(px + 2, want.data() + 2, want.size() - 2) == 0;
+}
+
+static std::vector<uint8_t> encodeFrame(Proto proto, uint32_t k, int leds) {
+    std::vector<uint8_t> px = framePixels(k, leds), out;
+    if (proto == ADALIGHT) {
+        uint16_t n = leds - 1;
+        out = {'A', 'd', 'a', (uint8_t)(n >> 8), (uint8_t)n, (uint8_t)((n >> 8) ^ (n & 0xFF) ^ 0x55)};
+        out.insert(out.end(), px.begin(), px.end());
+    } else if (proto == TPM2) {
+        out = {0xC9, 0xDA, (uint8_t)(px.size() >> 8), (uint8_t)px.size()};
+        out.insert(out.end(), px.begin(), px.end());
+        out.push_back(0x36);
+    } else {
+        std::vector<uint8_t> raw = {SERIAL_MSG_FRAME, 0, (uint8_t)k, (uint8_t)(k >> 8)};
+        raw.insert(raw.end(), px.begin(), px.end());
+        uint32_t crc = crc32(0, raw.data(), raw.size());
+        for (int j = 0; j < 4; j++) raw.push_back(crc >> (8 * j));
+
+        // COBS, then the 0x00 delimiter
+        size_t codeAt = out.size();
+        out.push_back(0);
+        uint8_t code = 1;
+        for (uint8_t b : raw) {
+            if (b) {
+                out.push_back(b);
+                code++;
+            }
+            if (!b || code == 0xFF) {
+                out[codeAt] = code;
+                codeAt = out.size();
+                out.push_back(0);
+                code = 1;
+            }
+        }
+        out[codeAt] = code;
+        out.push_back(0x00);
+    }
+    return out;
+}
+
+// Returns the stream; corruptPct of frames get one random defect
+static std::vector<uint8_t> generate(Proto proto, int frames, double corruptPct, int leds, std::mt19937& rng) {
+    std::uniform_real_distribution<double> uniform(0.0, 100.0);
+    std::vector<uint8_t> stream;
+    if (proto == NATIVE) stream.push_back(0x00);   // Senders lead with a delimiter
+    for (int k = 0; k < frames; k++) {
+        std::vector<uint8_t> f = encodeFrame(proto, k, leds);
+        if (uniform(rng) < corruptPct) {
+            size_t at = rng() % f.size();
+            switch (rng() % 4) {
+                case 0: f[at] ^= 1 << (rng() % 8); break;
+                case 1: f.erase(f.begin() + at); break;
+                case 2: for (int n = 1 + rng() % 20; n; n--) f.insert(f.begin() + at, (uint8_t)rng()); break;
+                case 3: f.resize(at); break;
+            }
+        }
+        stream.insert(stream.end(), f.begin(), f.end());
+    }
+    return stream;
+}
+
+// -----------------------------------------------------------------------------
+// The firmware's parser: bytes go in through the UART stand-in a chunk at a
+// time, on a virtual clock running at the line rate, and every frame it
+// publishes is taken out of the stream's ready buffer and checked.
+// -----------------------------------------------------------------------------
+struct Checker {
+    int leds;
+    long accepted = 0, intact = 0, errors = 0, resyncs = 0;
+    std::vector<unsigned long> resyncUs;    // As the firmware measured them
+    uint64_t startUs = hostNowUs();
+
+    explicit Checker(int n) : leds(n) {
+        logicalLedCount = n;
+        memset(&serialStats, 0, sizeof(serialStats));
+        memset(&serialInput, 0, sizeof(serialInput));
+        streamFrameFresh = false;
+        setSerialBinary(true, SERIAL_BINARY_BAUD);
+    }
+
+    void feed(const std::vector<uint8_t>& stream) {
+        double usPerByte = 10e6 / SERIAL_BINARY_BAUD;
+        double sentUs = 0;
+        for (size_t at = 0; at < stream.size(); at += FEED_CHUNK) {
+            size_t n = std::min<size_t>(FEED_CHUNK, stream.size() - at);
+            sentUs += n * usPerByte;
+            hostAdvanceUs((uint64_t)sentUs - (hostNowUs() - startUs));
+            hostSerialFeed(stream.data() + at, n);
+
+            unsigned long before = published(), resyncsBefore = serialStats.resyncs;
+            serviceSerialInput();
+            unsigned long frames = published() - before;
+            if (frames && streamFrameFresh) {
+                // Only the last of the chunk's frames is still there to look at
+                accepted += frames;
+                if (pixelsIntact(streamBuffers[streamReadyIdx], leds)) intact++;
+                streamFrameFresh = false;
+            }
+            if (serialStats.resyncs != resyncsBefore) {
+                resyncs += serialStats.resyncs - resyncsBefore;
+                resyncUs.push_back(serialStats.resyncUsLast);
+            }
+        }
+        errors = serialStats.headerErrors + serialStats.crcErrors + serialStats.malformed + serialStats.timeouts;
+    }
+
+    static unsigned long published() {
+        return serialStats.frames[SERIAL_PROTO_ADALIGHT] + serialStats.frames[SERIAL_PROTO_TPM2] +
+               serialStats.frames[SERIAL_PROTO_NATIVE];
+    }
+};
+
+static bool parseProto(const char* name, Proto* proto) {
+    std::string s = name;
+    if (s == "ada") *proto = ADALIGHT;
+    else if (s == "tpm2") *proto = TPM2;
+    else if (s == "native") *proto = NATIVE;
+    else return false;
+    return true;
+}
+
+static void report(const char* label, double corrupt, int frames, const Checker& c) {
+    std::vector<unsigned long> r = c.resyncUs;
+    std::sort(r.begin(), r.end());
+    unsigned long worst = r.empty() ? 0 : r.back();
+    unsigned long median = r.empty() ? 0 : r[r.size() / 2];
+    printf("%-7s %5.1f%%  %7d %8ld %8ld %8ld %6ld   %7lu %8lu\n", label, corrupt, frames, c.accepted,
+           c.intact, c.accepted - c.intact, c.resyncs, median, worst);
+}
+
+static int selfTest() {
+    const char* names[] = {"ada", "tpm2", "native"};
+    std::mt19937 rng(1);
+    printf("%d LEDs, resync times at %d baud\n", DEFAULT_LEDS, SERIAL_BINARY_BAUD);
+    printf("%-7s %-7s %7s %8s %8s %8s %6s   %7s %8s\n", "proto", "corrupt", "frames", "accepted",
+           "intact", "bad", "resync", "p50 us", "max us");
+    int failures = 0;
+    for (int proto = ADALIGHT; proto <= NATIVE; proto++) {
+        for (double corrupt : {0.0, 1.0, 5.0, 20.0}) {
+            int frames = 5000;
+            std::vector<uint8_t> stream = generate((Proto)proto, frames, corrupt, DEFAULT_LEDS, rng);
+            Checker c(DEFAULT_LEDS);
+            c.feed(stream);
+            report(names[proto], corrupt, frames, c);
+
+            // A clean stream must be taken whole; the native protocol must never
+            // show a damaged frame
+            if (corrupt == 0 && c.intact != frames) failures++;
+            if (proto == NATIVE && c.accepted != c.intact) failures++;
+        }
+    }
+    printf(failures ? "FAILED (%d)\n" : "OK\n", failures);
+    return failures ? 1 : 0;
+}
+
+static speed_t baudConstant(int baud) {
+    switch (baud) {
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        case 1000000: return B1000000;
+        case 1500000: return B1500000;
+        case 2000000: return B2000000;
+        default: return 0;
+    }
+}
+
+static int sendToPort(Proto proto, const char* tty, double fps, int leds, int baud) {
+    int fd = open(tty, O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        perror(tty);
+        return 1;
+    }
+    termios t;
+    tcgetattr(fd, &t);
+    cfmakeraw(&t);
+    speed_t speed = baudConstant(baud);
+    if (!speed) {
+        fprintf(stderr, "Unsupported baud %d\n", baud);
+        return 2;
+    }
+    cfsetispeed(&t, speed);
+    cfsetospeed(&t, speed);
+    tcsetattr(fd, TCSANOW, &t);
+
+    // Switch the receiver over at its text baud first if it isn't already
+    printf("Streaming %d LEDs at %.0f fps to %s (%d baud); Ctrl-C to stop\n", leds, fps, tty, baud);
+    if (proto == NATIVE && write(fd, "\0", 1) != 1) return 1;
+    for (uint32_t k = 0;; k++) {
+        std::vector<uint8_t> f = encodeFrame(proto, k, leds);
+        if (write(fd, f.data(), f.size()) != (ssize_t)f.size()) {
+            perror("write");
+            return 1;
+        }
+        usleep((useconds_t)(1e6 / fps));
+    }
+}
+
+int main(int argc, char** argv) {
+    hostSerialEcho = false;
+    if (argc < 2) return selfTest();
+
+    std::string mode = argv[1];
+    Proto proto;
+    if (argc < 4 || !parseProto(argv[2], &proto)) {
+        fprintf(stderr, "Usage: see the header of tools/serial_stream.cpp\n");
+        return 2;
+    }
+
+    if (mode == "gen") {
+        int frames = atoi(argv[3]);
+        double corrupt = argc > 4 ? atof(argv[4]) : 0;
+        int leds = argc > 5 ? atoi(argv[5]) : DEFAULT_LEDS;
+        std::mt19937 rng(1);
+        std::vector<uint8_t> stream = generate(proto, frames, corrupt, leds, rng);
+        fwrite(stream.data(), 1, stream.size(), stdout);
+        return 0;
+    }
+    if (mode == "check") {
+        int leds = argc > 4 ? atoi(argv[4]) : DEFAULT_LEDS;
+        if (leds < 1 || leds > NUM_LEDS) {
+            fprintf(stderr, "The firmware is built for at most %d LEDs\n", NUM_LEDS);
+            return 2;
+        }
+        FILE* f = fopen(argv[3], "rb");
+        if (!f) {
+            perror(argv[3]);
+            return 1;
+        }
+        std::vector<uint8_t> stream;
+        int c;
+        while ((c = fgetc(f)) != EOF) stream.push_back(c);
+        fclose(f);
+        Checker checker(leds);
+        checker.feed(stream);
+        printf("%-7s %-7s %7s %8s %8s %8s %6s   %7s %8s\n", "proto", "corrupt", "frames", "accepted",
+               "intact", "bad", "resync", "p50 us", "max us");
+        report(argv[2], 0, 0, checker);
+        printf("%ld bytes, %ld errors\n", (long)stream.size(), checker.errors);
+        return 0;
+    }
+    if (mode == "send") {
+        double fps = argc > 4 ? atof(argv[4]) : 60;
+        int leds = argc > 5 ? atoi(argv[5]) : DEFAULT_LEDS;
+        int baud = argc > 6 ? atoi(argv[6]) : SERIAL_BINARY_BAUD;
+        return sendToPort(proto, argv[3], fps, leds, baud);
+    }
+    fprintf(stderr, "Unknown mode %s\n", mode.c_str());
+    return 2;
+}